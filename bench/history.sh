@@ -0,0 +1,214 @@
+#!/bin/sh
+# Benchmark history and regression check for bench/run.sh results.
+#
+#   bench/history.sh save results.json        store under the current git commit
+#   bench/history.sh list                     show the stored results
+#   bench/history.sh compare [-t pct] [-a alpha] BASE NEW
+#
+# BASE and NEW are result files or commits with stored results (HEAD~1,
+# a branch, a hash). compare prints each workload's median speedup and a
+# Mann-Whitney U test of the two sets of run times, and exits with status 1
+# when a workload is slower by more than pct percent (default 5) with a
+# two-sided p-value below alpha (default 0.05).
+#
+# Results are kept in $EAP_BENCH_HISTORY (default: bench/history), one file
+# per commit; "-dirty" marks results of a modified working tree.
+
+set -u
+
+BENCH_DIR=$(cd "$(dirname "$0")" && pwd)
+HISTORY=${EAP_BENCH_HISTORY:-$BENCH_DIR/history}
+
+usage() {
+    sed -n '2,16s/^# \{0,1\}//p' "$0" >&2
+    exit 2
+}
+
+# Stored result file of a commit, or the argument itself if it is a file
+resolve() {
+    if [ -f "$1" ]; then
+        echo "$1"
+        return
+    fi
+    sha=$(git -C "$BENCH_DIR" rev-parse --verify --quiet "$1^{commit}") || {
+        echo "history.sh: $1 is neither a file nor a commit" >&2
+        exit 2
+    }
+    for file in "$HISTORY/$sha.json" "$HISTORY/$sha-dirty.json"; do
+        if [ -f "$file" ]; then
+            echo "$file"
+            return
+        fi
+    done
+    echo "history.sh: no stored results for $1 ($sha)" >&2
+    exit 2
+}
+
+save() {
+    [ $# -eq 1 ] && [ -f "$1" ] || usage
+    sha=$(git -C "$BENCH_DIR" rev-parse HEAD) || exit 2
+    if [ -n "$(git -C "$BENCH_DIR" status --porcelain --untracked-files=no)" ]; then
+        sha=$sha-dirty
+    fi
+    mkdir -p "$HISTORY"
+    cp "$1" "$HISTORY/$sha.json"
+    echo "Saved as $HISTORY/$sha.json"
+}
+
+list() {
+    [ -d "$HISTORY" ] || exit 0
+    for file in "$HISTORY"/*.json; do
+        [ -f "$file" ] || continue
+        name=$(basename "$file" .json)
+        sha=${name%-dirty}
+        subject=$(git -C "$BENCH_DIR" log -1 --format='%h %cs %s' "$sha" 2>/dev/null || echo "$sha (not in this repository)")
+        date=$(sed -n 's/.*"date": "\([^"]*\)".*/\1/p' "$file")
+        echo "$date  $subject${name#"$sha"}"
+    done | sort
+}
+
+compare() {
+    threshold=5
+    alpha=0.05
+    OPTIND=1
+    while getopts t:a: option; do
+        case $option in
+        t) threshold=$OPTARG ;;
+        a) alpha=$OPTARG ;;
+        *) usage ;;
+        esac
+    done
+    shift $((OPTIND - 1))
+    [ $# -eq 2 ] || usage
+    base=$(resolve "$1") || exit 2
+    new=$(resolve "$2") || exit 2
+
+    awk -v threshold="$threshold" -v alpha="$alpha" -v base_name="$1" -v new_name="$2" '
+        # One result object per line, as written by run.sh
+        function parse(line, file,    key, samples, n, i, parts) {
+            if (!match(line, /"workload": "[^"]*"/))
+                return
+            key = substr(line, RSTART + 13, RLENGTH - 14)
+            match(line, /"mode": "[^"]*"/)
+            key = key " (" substr(line, RSTART + 9, RLENGTH - 10) ")"
+            if (!(key in order_seen)) {
+                order_seen[key] = 1
+                order[++num_keys] = key
+            }
+            if (!match(line, /"samples_ms": \[[^]]*\]/))
+                return
+            samples = substr(line, RSTART + 15, RLENGTH - 16)
+            n = split(samples, parts, /, */)
+            count[file, key] = n
+            for (i = 1; i <= n; i++)
+                value[file, key, i] = parts[i] + 0
+        }
+
+        function median(file, key,    n, i, j, t, sorted) {
+            n = count[file, key]
+            for (i = 1; i <= n; i++)
+                sorted[i] = value[file, key, i]
+            for (i = 2; i <= n; i++)
+                for (j = i; j > 1 && sorted[j - 1] > sorted[j]; j--) {
+                    t = sorted[j]; sorted[j] = sorted[j - 1]; sorted[j - 1] = t
+                }
+            return n % 2 ? sorted[(n + 1) / 2] : (sorted[n / 2] + sorted[n / 2 + 1]) / 2
+        }
+
+        # Two-sided p-value of the Mann-Whitney U test: exact for small
+        # samples without ties, normal approximation otherwise
+        function mann_whitney(key,    n1, n2, i, j, u, ties, mean, sd, z, a, b, k, total, tail, c) {
+            n1 = count[1, key]
+            n2 = count[2, key]
+            u = 0
+            ties = 0
+            for (i = 1; i <= n1; i++)
+                for (j = 1; j <= n2; j++) {
+                    if (value[1, key, i] > value[2, key, j])
+                        u += 1
+                    else if (value[1, key, i] == value[2, key, j]) {
+                        u += 0.5
+                        ties = 1
+                    }
+                }
+            if (u > n1 * n2 / 2)
+                u = n1 * n2 - u
+
+            if (!ties && n1 * n2 <= 400) {
+                # c[a, b, k]: orderings of a base and b new times with U = k;
+                # the largest time is either a base one (above all b) or a new one
+                for (a = 0; a <= n1; a++)
+                    for (b = 0; b <= n2; b++)
+                        for (k = 0; k <= a * b; k++) {
+                            if (a == 0 || b == 0)
+                                c[a, b, k] = (k == 0)
+                            else
+                                c[a, b, k] = (k >= b ? c[a - 1, b, k - b] : 0) + (k <= a * (b - 1) ? c[a, b - 1, k] : 0)
+                        }
+                total = 0
+                tail = 0
+                for (k = 0; k <= n1 * n2; k++) {
+                    total += c[n1, n2, k]
+                    if (k <= u)
+                        tail += c[n1, n2, k]
+                }
+                return 2 * tail / total > 1 ? 1 : 2 * tail / total
+            }
+
+            mean = n1 * n2 / 2
+            sd = sqrt(n1 * n2 * (n1 + n2 + 1) / 12)
+            if (sd == 0)
+                return 1
+            z = (u - mean + 0.5) / sd
+            return 2 * normal_cdf(z) > 1 ? 1 : 2 * normal_cdf(z)
+        }
+
+        function normal_cdf(z,    t, y) {
+            # Abramowitz and Stegun 7.1.26
+            t = 1 / (1 + 0.3275911 * (z < 0 ? -z : z) / sqrt(2))
+            y = 1 - (((((1.061405429 * t - 1.453152027) * t) + 1.421413741) * t - 0.284496736) * t + 0.254829592) * t * exp(-z * z / 2)
+            return z < 0 ? (1 - y) / 2 : (1 + y) / 2
+        }
+
+        FNR == 1 { file++ }
+        { parse($0, file) }
+
+        END {
+            printf "Comparing %s (base) with %s (new)\n\n", base_name, new_name
+            printf "%-28s %12s %12s %9s %9s  %s\n", "Workload", "Base ms", "New ms", "Speedup", "p", "Verdict"
+            regressions = 0
+            for (i = 1; i <= num_keys; i++) {
+                key = order[i]
+                if (!((1, key) in count) || !((2, key) in count)) {
+                    printf "%-28s %12s %12s %9s %9s  %s\n", key, ((1, key) in count) ? sprintf("%.3f", median(1, key)) : "-",
+                           ((2, key) in count) ? sprintf("%.3f", median(2, key)) : "-", "", "", "not in both runs"
+                    continue
+                }
+                before = median(1, key)
+                after = median(2, key)
+                p = mann_whitney(key)
+                speedup = after > 0 ? before / after : 0
+                change = before > 0 ? 100 * (after - before) / before : 0
+                verdict = "no significant change"
+                if (p < alpha && change > threshold) {
+                    verdict = sprintf("REGRESSION (+%.1f%%)", change)
+                    regressions++
+                } else if (p < alpha && change < -threshold)
+                    verdict = sprintf("faster (%.1f%%)", change)
+                printf "%-28s %12.3f %12.3f %8.3fx %9.4f  %s\n", key, before, after, speedup, p, verdict
+            }
+            printf "\n%d significant regression%s beyond %s%% (alpha %s)\n", regressions, regressions == 1 ? "" : "s", threshold, alpha
+            exit regressions > 0
+        }
+    ' "$base" "$new"
+}
+
+[ $# -ge 1 ] || usage
+command=$1
+shift
+case $command in
+save) save "$@" ;;
+list) list "$@" ;;
+compare) compare "$@" ;;
+*) usage ;;
+esac
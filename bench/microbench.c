@@ -0,0 +1,318 @@
+/*
+ * Micro-benchmarks of the interpreter's primitives, in nanoseconds per
+ * operation. The interpreter is compiled into this file, so the static
+ * functions are measured exactly as the interpreter runs them.
+ *
+ * Compile and run from the repository root:
+ *   gcc -O2 -o microbench bench/microbench.c -lm
+ *   ./microbench            # everything
+ *   ./microbench env_get    # only benchmarks whose name contains env_get
+ *
+ * Add -DEAP_NO_COMPUTED_GOTO to measure execute_block with a switch instead of
+ * threaded dispatch.
+ */
+
+#define EAP_NO_MAIN
+#pragma GCC diagnostic ignored "-Wunused-function"
+#include "../interpreter.c"
+
+// Each benchmark is repeated, doubling the count, until it runs this long
+#define MICRO_MIN_SECONDS 0.2
+
+typedef struct
+{
+    const char *name;
+    const char *unit; // What one operation is, for the report
+    void (*run)(long iterations);
+    long ops_per_iteration;
+} MicroBench;
+
+static volatile uintptr_t micro_sink; // Keeps results alive
+
+// ============================================================================
+// FIXTURES
+// ============================================================================
+
+static const char *volatile micro_keys[] = {"i", "counter_total", "a_rather_long_identifier_name_used_in_the_benchmark_sixty_four_"};
+static HashMap *micro_map;
+static Environment *micro_envs[17]; // micro_envs[d] is d scopes below the globals
+static ArrayObject *micro_arrays[4]; // Indexed by dimension count
+static RuntimeValue micro_values[4];
+static char *micro_source;
+static int micro_source_tokens;
+static ASTNode *micro_block[64]; // Cheap statements of mixed kinds
+
+static const char *micro_program =
+    "ΑΛΓΟΡΙΘΜΟΣ Micro\n"
+    "ΔΕΔΟΜΕΝΑ\n"
+    "    a: ARRAY[1..100] OF INTEGER;\n"
+    "    i, j, t, n: INTEGER;\n"
+    "ΑΡΧΗ\n";
+
+static const char *micro_body =
+    "    ΓΙΑ i:=1 ΕΩΣ n - 1 ΕΠΑΝΑΛΑΒΕ\n"
+    "        ΓΙΑ j:=1 ΕΩΣ n - i ΕΠΑΝΑΛΑΒΕ\n"
+    "            ΕΑΝ (a[j] > a[j + 1]) ΤΟΤΕ\n"
+    "                t:=a[j];\n"
+    "                a[j]:=a[j + 1];\n"
+    "                a[j + 1]:=t;\n"
+    "            ΕΑΝ-ΤΕΛΟΣ\n"
+    "        ΓΙΑ-ΤΕΛΟΣ\n"
+    "    ΓΙΑ-ΤΕΛΟΣ\n";
+
+static void micro_setup(void)
+{
+    micro_map = create_hashmap();
+    char key[32];
+    for (int i = 0; i < 100; i++)
+    {
+        sprintf(key, "var%d", i);
+        hashmap_set(micro_map, key, NULL);
+    }
+
+    RuntimeValue zero;
+    zero.type = VAL_INT;
+    zero.value.int_val = 0;
+    micro_envs[0] = create_environment(NULL);
+    env_define(micro_envs[0], "total", zero);
+    for (int depth = 1; depth <= 16; depth++)
+    {
+        micro_envs[depth] = create_environment(micro_envs[depth - 1]);
+        env_define(micro_envs[depth], "local", zero);
+    }
+
+    ArrayBound bounds[3] = {{1, 100}, {1, 100}, {1, 100}};
+    for (int dims = 1; dims <= 3; dims++)
+    {
+        micro_arrays[dims] = create_array(bounds, dims);
+        int indices[3] = {50, 50, 50};
+        array_set(micro_arrays[dims], indices, dims, zero);
+    }
+
+    micro_values[0].type = VAL_INT;
+    micro_values[0].value.int_val = 42;
+    micro_values[1].type = VAL_REAL;
+    micro_values[1].value.real_val = 3.14;
+    micro_values[2].type = VAL_BOOL;
+    micro_values[2].value.bool_val = true;
+    micro_values[3].type = VAL_STRING;
+    micro_values[3].value.str_val = "Καλημέρα";
+
+    // The sort body repeated up to about half of MAX_TOKENS
+    size_t len = strlen(micro_program) + strlen("ΤΕΛΟΣ\n") + 1;
+    int copies = 60;
+    micro_source = malloc(len + copies * strlen(micro_body));
+    strcpy(micro_source, micro_program);
+    for (int i = 0; i < copies; i++)
+        strcat(micro_source, micro_body);
+    strcat(micro_source, "ΤΕΛΟΣ\n");
+
+    token_count = 0;
+    tokenize(micro_source);
+    micro_source_tokens = token_count;
+
+    // An empty ΤΥΠΩΣΕ, an ΕΑΝ and an ΕΝΟΣΩ whose conditions are FALSE, in a
+    // fixed pseudo-random order: running them is mostly dispatching them
+    ASTNode *condition = calloc(1, sizeof(ASTNode));
+    condition->type = AST_LITERAL;
+    condition->literal.value.type = VAL_BOOL;
+    condition->literal.value.value.bool_val = false;
+    unsigned int seed = 1;
+    for (int i = 0; i < 64; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        ASTNode *stmt = calloc(1, sizeof(ASTNode));
+        stmt->line = i + 1;
+        switch ((seed >> 16) % 3)
+        {
+        case 0:
+            stmt->type = AST_PRINT;
+            break;
+        case 1:
+            stmt->type = AST_IF;
+            stmt->if_stmt.condition = condition;
+            break;
+        default:
+            stmt->type = AST_WHILE;
+            stmt->while_loop.condition = condition;
+            break;
+        }
+        micro_block[i] = stmt;
+    }
+}
+
+// ============================================================================
+// BENCHMARKS
+// ============================================================================
+
+#define MICRO_HASH(N, KEY)                                 \
+    static void micro_hash_##N(long iterations)            \
+    {                                                      \
+        unsigned int sum = 0;                              \
+        for (long i = 0; i < iterations; i++)              \
+            sum += hash_string(micro_keys[KEY]);           \
+        micro_sink = sum;                                  \
+    }
+MICRO_HASH(short, 0)
+MICRO_HASH(medium, 1)
+MICRO_HASH(long, 2)
+
+static void micro_hashmap_get_hit(long iterations)
+{
+    for (long i = 0; i < iterations; i++)
+        micro_sink = (uintptr_t)hashmap_get(micro_map, "var57");
+}
+
+static void micro_hashmap_get_miss(long iterations)
+{
+    for (long i = 0; i < iterations; i++)
+        micro_sink = (uintptr_t)hashmap_get(micro_map, "missing");
+}
+
+static void micro_hashmap_set_update(long iterations)
+{
+    for (long i = 0; i < iterations; i++)
+        hashmap_set(micro_map, "var57", (void *)(uintptr_t)i);
+}
+
+#define MICRO_ENV(DEPTH)                                                  \
+    static void micro_env_get_##DEPTH(long iterations)                    \
+    {                                                                     \
+        for (long i = 0; i < iterations; i++)                             \
+            micro_sink = (uintptr_t)env_get(micro_envs[DEPTH], "total"); \
+    }
+MICRO_ENV(0)
+MICRO_ENV(1)
+MICRO_ENV(4)
+MICRO_ENV(16)
+
+#define MICRO_ARRAY(DIMS)                                                     \
+    static void micro_array_get_##DIMS(long iterations)                       \
+    {                                                                         \
+        int indices[3] = {50, 50, 50};                                        \
+        for (long i = 0; i < iterations; i++)                                 \
+            micro_sink = array_get(micro_arrays[DIMS], indices, DIMS).type;   \
+    }                                                                         \
+    static void micro_array_set_##DIMS(long iterations)                       \
+    {                                                                         \
+        int indices[3] = {50, 50, 50};                                        \
+        for (long i = 0; i < iterations; i++)                                 \
+            array_set(micro_arrays[DIMS], indices, DIMS, micro_values[0]);    \
+    }
+MICRO_ARRAY(1)
+MICRO_ARRAY(2)
+MICRO_ARRAY(3)
+
+#define MICRO_COPY(N, INDEX)                                          \
+    static void micro_copy_##N(long iterations)                       \
+    {                                                                 \
+        for (long i = 0; i < iterations; i++)                         \
+        {                                                             \
+            RuntimeValue copy = copy_runtime_value(&micro_values[INDEX]); \
+            micro_sink = copy.type;                                   \
+            free_runtime_value(&copy);                                \
+        }                                                             \
+    }
+MICRO_COPY(int, 0)
+MICRO_COPY(real, 1)
+MICRO_COPY(bool, 2)
+MICRO_COPY(string, 3)
+
+static void micro_tokenize(long iterations)
+{
+    for (long i = 0; i < iterations; i++)
+    {
+        token_count = 0;
+        tokenize(micro_source);
+    }
+}
+
+static void micro_execute_block(long iterations)
+{
+    for (long i = 0; i < iterations; i++)
+        execute_block(micro_block, 64, micro_envs[0]);
+}
+
+// The interpreter never frees a parsed tree, so neither does this; a run
+// allocates a few hundred MB
+static void micro_parse_program(long iterations)
+{
+    token_count = 0;
+    tokenize(micro_source);
+    for (long i = 0; i < iterations; i++)
+    {
+        token_pos = 0;
+        micro_sink = (uintptr_t)parse_program();
+    }
+}
+
+// ============================================================================
+// DRIVER
+// ============================================================================
+
+static MicroBench micro_benches[] = {
+    {"hash_string/1 char", "call", micro_hash_short, 1},
+    {"hash_string/13 chars", "call", micro_hash_medium, 1},
+    {"hash_string/64 chars", "call", micro_hash_long, 1},
+    {"hashmap_get/hit", "call", micro_hashmap_get_hit, 1},
+    {"hashmap_get/miss", "call", micro_hashmap_get_miss, 1},
+    {"hashmap_set/update", "call", micro_hashmap_set_update, 1},
+    {"env_get/depth 0", "call", micro_env_get_0, 1},
+    {"env_get/depth 1", "call", micro_env_get_1, 1},
+    {"env_get/depth 4", "call", micro_env_get_4, 1},
+    {"env_get/depth 16", "call", micro_env_get_16, 1},
+    {"array_get/1-D", "call", micro_array_get_1, 1},
+    {"array_get/2-D", "call", micro_array_get_2, 1},
+    {"array_get/3-D", "call", micro_array_get_3, 1},
+    {"array_set/1-D", "call", micro_array_set_1, 1},
+    {"array_set/2-D", "call", micro_array_set_2, 1},
+    {"array_set/3-D", "call", micro_array_set_3, 1},
+    {"copy_runtime_value/INTEGER", "copy+free", micro_copy_int, 1},
+    {"copy_runtime_value/REAL", "copy+free", micro_copy_real, 1},
+    {"copy_runtime_value/BOOLEAN", "copy+free", micro_copy_bool, 1},
+    {"copy_runtime_value/STRING", "copy+free", micro_copy_string, 1},
+    {"execute_block/mixed", "statement", micro_execute_block, 64},
+    {"tokenize", "token", micro_tokenize, 0},
+    {"parse_program", "token", micro_parse_program, 0},
+};
+
+static double micro_seconds(void)
+{
+    return profile_wall_seconds();
+}
+
+int main(int argc, char **argv)
+{
+    const char *filter = argc > 1 ? argv[1] : NULL;
+    micro_setup();
+
+    printf("%-30s %12s %12s  %s\n", "Benchmark", "Operations", "ns/op", "Operation");
+    for (size_t b = 0; b < sizeof(micro_benches) / sizeof(micro_benches[0]); b++)
+    {
+        MicroBench *bench = &micro_benches[b];
+        if (filter && !strstr(bench->name, filter))
+            continue;
+        long per_iteration = bench->ops_per_iteration ? bench->ops_per_iteration : micro_source_tokens;
+
+        bench->run(1); // Warm the caches
+        long iterations = 1;
+        double elapsed;
+        for (;;)
+        {
+            double start = micro_seconds();
+            bench->run(iterations);
+            elapsed = micro_seconds() - start;
+            if (elapsed >= MICRO_MIN_SECONDS || iterations >= (1L << 40))
+                break;
+            iterations *= 2;
+        }
+
+        double ops = (double)iterations * per_iteration;
+        printf("%-30s %12.0f %12.2f  %s", bench->name, ops, elapsed * 1e9 / ops, bench->unit);
+        if (!bench->ops_per_iteration)
+            printf(" (%.1f MB/s of source)", iterations * strlen(micro_source) / elapsed / 1e6);
+        printf("\n");
+        fflush(stdout);
+    }
+    return 0;
+}
@@ -0,0 +1,167 @@
+#!/bin/sh
+# Benchmark harness for the EAP interpreter.
+#
+# Runs every workload of this directory (or the ones named on the command
+# line) in the interpreter (the tree walker, or the closure compiler of
+# --engine=closure) and as transpiled C, with warm-up runs and timed
+# repetitions, and prints the results as JSON:
+#
+#   bench/run.sh [-e eap_interpreter] [-r runs] [-w warmup] [-m modes] [-o results.json] [workload...]
+#
+#   -e  interpreter to measure (default: ./eap_interpreter, or $EAP)
+#   -r  timed runs per workload and mode (default: 5)
+#   -w  untimed warm-up runs before them (default: 1)
+#   -m  comma-separated modes: interpreter, closure, transpile (default:
+#       interpreter,transpile)
+#   -o  write the JSON there instead of standard output
+#
+# Every workload reads its size from standard input; the inputs are generated
+# here so runs on different machines see the same data. The transpiled
+# programs are compiled once with $CC -O2 (not timed) and their output is
+# checked against the interpreter's.
+
+set -u
+
+EAP=${EAP:-./eap_interpreter}
+CC=${CC:-gcc}
+RUNS=5
+WARMUP=1
+MODES=interpreter,transpile
+OUTPUT=
+
+while getopts e:r:w:m:o: option; do
+    case $option in
+    e) EAP=$OPTARG ;;
+    r) RUNS=$OPTARG ;;
+    w) WARMUP=$OPTARG ;;
+    m) MODES=$OPTARG ;;
+    o) OUTPUT=$OPTARG ;;
+    *) sed -n '2,22s/^# \{0,1\}//p' "$0" >&2; exit 2 ;;
+    esac
+done
+shift $((OPTIND - 1))
+
+BENCH_DIR=$(cd "$(dirname "$0")" && pwd)
+WORKLOADS=${*:-bubble insertion merge quick sieve fib matmul strings io dispatch}
+
+if [ ! -x "$EAP" ]; then
+    echo "run.sh: interpreter $EAP not found (build it or pass -e)" >&2
+    exit 2
+fi
+
+WORK=$(mktemp -d "${TMPDIR:-/tmp}/eap-bench.XXXXXX")
+trap 'rm -rf "$WORK"' EXIT INT TERM
+
+# Input of each workload: the problem size, then any data it reads
+bench_input() {
+    case $1 in
+    bubble) echo 3000 ;;
+    insertion) echo 5000 ;;
+    merge | quick | sieve) echo 100000 ;;
+    fib) echo 18 ;;
+    dispatch) echo 10000 ;;
+    matmul) echo 100 ;;
+    strings) awk 'BEGIN { print 5000; print 50; for (i = 1; i <= 5000; i++) printf "w%05d\n", (i * 7919) % 100003 }' ;;
+    io) awk 'BEGIN { print 20000; for (i = 1; i <= 20000; i++) print (i * 7919) % 100003 }' ;;
+    *) return 1 ;;
+    esac
+}
+
+# Nanoseconds since some fixed point
+now_ns() {
+    date +%s%N 2>/dev/null | grep -v N ||
+        perl -MTime::HiRes=time -e 'printf "%d\n", time() * 1e9'
+}
+
+# Runs "$@" with the workload input, WARMUP + RUNS times; prints the run times
+# in milliseconds, one per line, or nothing if a run fails
+time_runs() {
+    input=$1
+    shift
+    i=0
+    while [ $i -lt "$WARMUP" ]; do
+        "$@" <"$input" >/dev/null 2>&1 || return 1
+        i=$((i + 1))
+    done
+    i=0
+    while [ $i -lt "$RUNS" ]; do
+        start=$(now_ns)
+        "$@" <"$input" >/dev/null 2>&1 || return 1
+        end=$(now_ns)
+        echo $(((end - start) / 1000)) | awk '{ printf "%.3f\n", $1 / 1000 }'
+        i=$((i + 1))
+    done
+}
+
+# JSON object of a list of times: median and p95 by nearest rank
+summarize() {
+    sort -n | awk -v name="$1" -v mode="$2" -v status="$3" '
+        { t[NR] = $1 }
+        END {
+            printf "    {\"workload\": \"%s\", \"mode\": \"%s\", \"status\": \"%s\"", name, mode, status
+            if (NR > 0) {
+                median = NR % 2 ? t[(NR + 1) / 2] : (t[NR / 2] + t[NR / 2 + 1]) / 2
+                p95 = t[int(0.95 * NR + 0.999999)]
+                printf ", \"runs\": %d, \"min_ms\": %.3f, \"median_ms\": %.3f, \"p95_ms\": %.3f, \"max_ms\": %.3f, \"samples_ms\": [", NR, t[1], median, p95, t[NR]
+                for (i = 1; i <= NR; i++)
+                    printf "%s%.3f", (i > 1 ? ", " : ""), t[i]
+                printf "]"
+            }
+            printf "}"
+        }'
+}
+
+{
+    printf '{\n  "interpreter": "%s",\n  "compiler": "%s",\n' "$EAP" "$CC"
+    printf '  "host": "%s",\n  "date": "%s",\n' "$(uname -sm)" "$(date -u +%Y-%m-%dT%H:%M:%SZ)"
+    printf '  "warmup": %d,\n  "results": [\n' "$WARMUP"
+
+    separator=
+    for name in $WORKLOADS; do
+        program=$BENCH_DIR/$name.eap
+        input=$WORK/$name.in
+        if [ ! -f "$program" ] || ! bench_input "$name" >"$input"; then
+            echo "run.sh: unknown workload $name" >&2
+            continue
+        fi
+        "$EAP" "$program" <"$input" >"$WORK/$name.expected" 2>/dev/null
+
+        for mode in $(echo "$MODES" | tr ',' ' '); do
+            status=ok
+            : >"$WORK/times"
+            case $mode in
+            interpreter)
+                time_runs "$input" "$EAP" "$program" >"$WORK/times" || status=failed
+                ;;
+            closure)
+                if ! "$EAP" "$program" --engine=closure <"$input" 2>/dev/null | cmp -s - "$WORK/$name.expected"; then
+                    status=output_differs
+                else
+                    time_runs "$input" "$EAP" "$program" --engine=closure >"$WORK/times" || status=failed
+                fi
+                ;;
+            transpile)
+                if ! "$EAP" "$program" --transpile >"$WORK/$name.c" 2>/dev/null ||
+                    ! $CC -O2 -o "$WORK/$name" "$WORK/$name.c" -lm >/dev/null 2>&1; then
+                    status=compile_failed
+                elif ! "$WORK/$name" <"$input" 2>/dev/null | cmp -s - "$WORK/$name.expected"; then
+                    status=output_differs
+                else
+                    time_runs "$input" "$WORK/$name" >"$WORK/times" || status=failed
+                fi
+                ;;
+            *)
+                echo "run.sh: unknown mode $mode" >&2
+                continue
+                ;;
+            esac
+            [ $status = ok ] || : >"$WORK/times"
+            printf '%s' "$separator"
+            summarize "$name" "$mode" "$status" <"$WORK/times"
+            separator=',
+'
+            echo "$name ($mode): $status" >&2
+        done
+    done
+    printf '\n  ]\n}\n'
+} >"${OUTPUT:-/dev/stdout}"
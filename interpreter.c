@@ -5,9 +5,22 @@
  * Compile with:
  *   gcc -o eap_interpreter interpreter.c -lm
  *
+ * Micro-benchmarks of the internals (bench/microbench.c):
+ *   gcc -O2 -o microbench bench/microbench.c -lm
+ *
  * Usage:
  *   ./eap_interpreter program.eap
  *   ./eap_interpreter program.eap --debug
+ *   ./eap_interpreter program.eap --debug-trace=debug.trace
+ *   ./eap_interpreter --decode-trace debug.trace
+ *   ./eap_interpreter program.eap --native
+ *   ./eap_interpreter program.eap --jit
+ *   ./eap_interpreter program.eap --profile
+ *   ./eap_interpreter program.eap --sample
+ *   ./eap_interpreter program.eap --stats
+ *   ./eap_interpreter program.eap --coverage
+ *   ./eap_interpreter program.eap --compile-only -o program.eapc
+ *   ./eap_interpreter program.eapc
  */
 
 #include <stdio.h>
@@ -17,6 +30,36 @@
 #include <stdbool.h>
 #include <math.h>
 #include <stdarg.h>
+#include <stdint.h>
+#include <limits.h>
+#include <errno.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#ifdef _WIN32
+#include <direct.h>
+#include <io.h>
+#include <process.h>
+#else
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
 
 #define MAX_TOKEN_LEN 256
 #define MAX_TOKENS 10000
@@ -25,6 +68,314 @@
 #define MAX_STACK_DEPTH 1000
 #define MAX_STRING_LEN 1024
 #define MAX_HASH_SIZE 10007
+#define MAX_JIT_PARAMS 32
+
+// ============================================================================
+// RUNTIME STATISTICS
+// ============================================================================
+// Counters of the interpreter's hot paths, reported by --stats. They are
+// plain increments, cheap enough to keep on in every run. All allocations go
+// through the wrappers below (see the macros after them). With --stats,
+// --mem-report or --max-memory they keep each block's size in a header so live
+// and peak heap usage can be tracked; otherwise they call the C library
+// directly, so other runs use no extra memory.
+
+typedef struct
+{
+    uint64_t statements;
+    uint64_t env_lookups;        // env_get and friends
+    uint64_t env_assigns;
+    uint64_t env_entries_walked; // Hash-chain entries compared by both
+    uint64_t env_scopes_walked;  // Environments searched by both
+    uint64_t environments;
+    uint64_t array_gets;
+    uint64_t array_sets;
+    uint64_t string_copies; // Strings duplicated by copy_runtime_value
+    uint64_t quickened;     // Operators specialized to their operand types
+    uint64_t deoptimized;   // ... and sent back to the generic path
+    uint64_t allocations;
+    uint64_t bytes_allocated;
+    uint64_t bytes_live;
+    uint64_t bytes_peak;
+} RuntimeStats;
+
+static RuntimeStats stats;
+
+// Set by main before the first allocation and never changed after it: a block
+// must be freed by the wrapper that allocated it
+static bool alloc_accounting = false;
+
+// --mem-report charges every block to an owner: the variable whose value it
+// holds, or one of the fixed owners below. mem_owner is the owner of blocks
+// allocated now; code that allocates for a variable sets it around the call.
+#define MEM_MAX_OWNERS 1024
+
+enum
+{
+    MEM_INTERPRETER, // Everything not attributed to something else
+    MEM_SOURCE,
+    MEM_AST,
+    MEM_ENVIRONMENTS,
+    MEM_OTHER_VARIABLES, // Variables beyond MEM_MAX_OWNERS
+    MEM_FIXED_OWNERS
+};
+
+typedef struct
+{
+    char name[64];
+    const char *kind; // "array", "string" or NULL for the fixed owners
+    int line;         // Of the declaration, 0 if unknown
+    uint64_t allocations;
+    uint64_t blocks_live;
+    uint64_t bytes_live;
+    uint64_t bytes_peak;
+} MemOwner;
+
+static bool mem_report_enabled = false;
+static int mem_owner = MEM_INTERPRETER;
+static int mem_num_owners = MEM_FIXED_OWNERS;
+static MemOwner mem_owners[MEM_MAX_OWNERS] = {
+    {"interpreter", NULL, 0, 0, 0, 0, 0},
+    {"source text", NULL, 0, 0, 0, 0, 0},
+    {"AST (parsed program)", NULL, 0, 0, 0, 0, 0},
+    {"environment frames", NULL, 0, 0, 0, 0, 0},
+    {"other variables", NULL, 0, 0, 0, 0, 0},
+};
+
+static inline int mem_enter(int owner)
+{
+    int saved = mem_owner;
+    mem_owner = owner;
+    return saved;
+}
+
+typedef union
+{
+    struct
+    {
+        size_t size;
+        int owner;
+    } block;
+    long double align; // Keeps the block after the header suitably aligned
+} AllocHeader;
+
+static inline void stats_allocated(AllocHeader *header, size_t requested, size_t live)
+{
+    stats.allocations++;
+    stats.bytes_allocated += requested;
+    stats.bytes_live += live;
+    if (stats.bytes_live > stats.bytes_peak)
+        stats.bytes_peak = stats.bytes_live;
+
+    if (mem_report_enabled)
+    {
+        MemOwner *owner = &mem_owners[header->block.owner];
+        owner->allocations++;
+        owner->blocks_live++;
+        owner->bytes_live += live;
+        if (owner->bytes_live > owner->bytes_peak)
+            owner->bytes_peak = owner->bytes_live;
+    }
+}
+
+static inline void stats_released(AllocHeader *header)
+{
+    stats.bytes_live -= header->block.size;
+    if (mem_report_enabled)
+    {
+        mem_owners[header->block.owner].blocks_live--;
+        mem_owners[header->block.owner].bytes_live -= header->block.size;
+    }
+}
+
+static void *stats_malloc(size_t size)
+{
+    if (!alloc_accounting)
+        return malloc(size);
+    AllocHeader *header = malloc(sizeof(AllocHeader) + size);
+    if (!header)
+        return NULL;
+    header->block.size = size;
+    header->block.owner = mem_owner;
+    stats_allocated(header, size, size);
+    return header + 1;
+}
+
+static void *stats_calloc(size_t count, size_t size)
+{
+    if (!alloc_accounting)
+        return calloc(count, size);
+    if (size && count > (SIZE_MAX - sizeof(AllocHeader)) / size)
+        return NULL;
+    AllocHeader *header = calloc(1, sizeof(AllocHeader) + count * size);
+    if (!header)
+        return NULL;
+    header->block.size = count * size;
+    header->block.owner = mem_owner;
+    stats_allocated(header, header->block.size, header->block.size);
+    return header + 1;
+}
+
+// The block keeps the owner it was first allocated for
+static void *stats_realloc(void *ptr, size_t size)
+{
+    if (!alloc_accounting)
+        return realloc(ptr, size);
+    if (!ptr)
+        return stats_malloc(size);
+
+    AllocHeader *header = (AllocHeader *)ptr - 1;
+    size_t old_size = header->block.size;
+    stats_released(header);
+    header = realloc(header, sizeof(AllocHeader) + size);
+    if (!header)
+        return NULL;
+    header->block.size = size;
+    stats_allocated(header, size > old_size ? size - old_size : 0, size);
+    return header + 1;
+}
+
+static void stats_free(void *ptr)
+{
+    if (!alloc_accounting)
+    {
+        free(ptr);
+        return;
+    }
+    if (!ptr)
+        return;
+    AllocHeader *header = (AllocHeader *)ptr - 1;
+    stats_released(header);
+    free(header);
+}
+
+static char *stats_strdup(const char *str)
+{
+    size_t len = strlen(str) + 1;
+    char *copy = stats_malloc(len);
+    if (copy)
+        memcpy(copy, str, len);
+    return copy;
+}
+
+static bool stats_json = false;
+
+// Peak resident set size in bytes, 0 where unknown
+static uint64_t stats_peak_rss(void)
+{
+#ifdef _WIN32
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#ifdef __APPLE__
+    return (uint64_t)usage.ru_maxrss; // Bytes on macOS
+#else
+    return (uint64_t)usage.ru_maxrss * 1024; // Kilobytes elsewhere
+#endif
+#endif
+}
+
+static void stats_report(void)
+{
+    uint64_t env_operations = stats.env_lookups + stats.env_assigns;
+    double chain = env_operations ? (double)stats.env_entries_walked / env_operations : 0;
+    double scopes = env_operations ? (double)stats.env_scopes_walked / env_operations : 0;
+    unsigned long long peak_rss = stats_peak_rss();
+
+    if (stats_json)
+    {
+        fprintf(stderr, "{\"statements\": %llu, \"env_get\": %llu, \"env_assign\": %llu, "
+                        "\"env_avg_chain\": %.3f, \"env_avg_scopes\": %.3f, \"environments\": %llu, "
+                        "\"array_get\": %llu, \"array_set\": %llu, \"string_copies\": %llu, "
+                        "\"quickened\": %llu, \"deoptimized\": %llu, "
+                        "\"allocations\": %llu, \"bytes_allocated\": %llu, \"bytes_live\": %llu, "
+                        "\"heap_peak\": %llu, \"peak_rss\": %llu}\n",
+                (unsigned long long)stats.statements, (unsigned long long)stats.env_lookups,
+                (unsigned long long)stats.env_assigns, chain, scopes, (unsigned long long)stats.environments,
+                (unsigned long long)stats.array_gets, (unsigned long long)stats.array_sets,
+                (unsigned long long)stats.string_copies, (unsigned long long)stats.quickened,
+                (unsigned long long)stats.deoptimized, (unsigned long long)stats.allocations,
+                (unsigned long long)stats.bytes_allocated, (unsigned long long)stats.bytes_live,
+                (unsigned long long)stats.bytes_peak, peak_rss);
+        return;
+    }
+
+    fprintf(stderr, "\nRuntime statistics\n");
+    fprintf(stderr, "  Statements executed   %14llu\n", (unsigned long long)stats.statements);
+    fprintf(stderr, "  env_get               %14llu\n", (unsigned long long)stats.env_lookups);
+    fprintf(stderr, "  env_assign            %14llu\n", (unsigned long long)stats.env_assigns);
+    fprintf(stderr, "    avg chain walked    %14.3f entries\n", chain);
+    fprintf(stderr, "    avg scopes searched %14.3f\n", scopes);
+    fprintf(stderr, "  Environments created  %14llu\n", (unsigned long long)stats.environments);
+    fprintf(stderr, "  array_get             %14llu\n", (unsigned long long)stats.array_gets);
+    fprintf(stderr, "  array_set             %14llu\n", (unsigned long long)stats.array_sets);
+    fprintf(stderr, "  String copies         %14llu\n", (unsigned long long)stats.string_copies);
+    fprintf(stderr, "  Operators quickened   %14llu\n", (unsigned long long)stats.quickened);
+    fprintf(stderr, "    deoptimized         %14llu\n", (unsigned long long)stats.deoptimized);
+    fprintf(stderr, "  Allocations           %14llu\n", (unsigned long long)stats.allocations);
+    fprintf(stderr, "  Bytes allocated       %14llu\n", (unsigned long long)stats.bytes_allocated);
+    fprintf(stderr, "  Heap in use at exit   %14llu bytes\n", (unsigned long long)stats.bytes_live);
+    fprintf(stderr, "  Heap peak             %14llu bytes\n", (unsigned long long)stats.bytes_peak);
+    if (peak_rss)
+        fprintf(stderr, "  Peak RSS              %14llu bytes\n", peak_rss);
+}
+
+static const char *mem_report_path = NULL;
+
+static int mem_compare_peak(const void *a, const void *b)
+{
+    const MemOwner *x = *(const MemOwner *const *)a;
+    const MemOwner *y = *(const MemOwner *const *)b;
+    if (x->bytes_peak != y->bytes_peak)
+        return x->bytes_peak < y->bytes_peak ? 1 : -1;
+    return strcmp(x->name, y->name);
+}
+
+static void mem_report(void)
+{
+    FILE *out = mem_report_path ? fopen(mem_report_path, "w") : stderr;
+    if (!out)
+    {
+        fprintf(stderr, "Warning: Cannot write memory report to %s\n", mem_report_path);
+        return;
+    }
+
+    const MemOwner *sorted[MEM_MAX_OWNERS];
+    int count = 0;
+    for (int i = 0; i < mem_num_owners; i++)
+        if (mem_owners[i].allocations)
+            sorted[count++] = &mem_owners[i];
+    qsort(sorted, count, sizeof(sorted[0]), mem_compare_peak);
+
+    if (out == stderr)
+        fprintf(out, "\n");
+    fprintf(out, "Heap profile (bytes requested by the interpreter, by owner)\n");
+    fprintf(out, "%-32s %-7s %6s %14s %14s %12s\n", "Owner", "Kind", "Line", "Peak", "At exit", "Allocations");
+    for (int i = 0; i < count; i++)
+    {
+        const MemOwner *owner = sorted[i];
+        char line[16] = "";
+        if (owner->line)
+            snprintf(line, sizeof(line), "%d", owner->line);
+        fprintf(out, "%-32s %-7s %6s %14llu %14llu %12llu\n", owner->name, owner->kind ? owner->kind : "",
+                line, (unsigned long long)owner->bytes_peak, (unsigned long long)owner->bytes_live,
+                (unsigned long long)owner->allocations);
+    }
+    fprintf(out, "%-32s %-7s %6s %14llu %14llu %12llu\n", "Total", "", "", (unsigned long long)stats.bytes_peak,
+            (unsigned long long)stats.bytes_live, (unsigned long long)stats.allocations);
+
+    if (out != stderr)
+        fclose(out);
+}
+
+#undef strdup
+#define malloc(size) stats_malloc(size)
+#define calloc(count, size) stats_calloc(count, size)
+#define realloc(ptr, size) stats_realloc(ptr, size)
+#define free(ptr) stats_free(ptr)
+#define strdup(str) stats_strdup(str)
 
 // Token Types
 typedef enum
@@ -131,6 +482,9 @@ typedef enum
 typedef struct ArrayValue ArrayValue; // Προσθέστε αυτό ψηλά στις δηλώσεις
 typedef struct ASTNode ASTNode;
 typedef struct Environment Environment;
+typedef struct BcePlan BcePlan;
+typedef struct CoverageCounter CoverageCounter;
+typedef struct Closure Closure;
 
 typedef struct
 {
@@ -161,6 +515,7 @@ typedef struct
     HashMap *data;
     ArrayBound bounds[MAX_ARRAY_DIMS];
     int num_dims;
+    int mem_owner; // Of its elements, for --mem-report
 } ArrayObject;
 
 typedef union
@@ -187,21 +542,15 @@ typedef struct
     Value value;
     ValueType type;
 } RuntimeValue;
-// Array bounds tracking
+// Transpiler symbol table entry
 typedef struct
 {
-    char *array_name;
+    const char *c_type; // "int", "double", "bool", "char*"; element type of arrays
+    int num_dims;       // 0 for scalars
+    bool dynamic;       // Bounds known only at run time, kept in <name>_lo<k>/_hi<k>/_st<k>
     int bounds_start[MAX_ARRAY_DIMS];
     int bounds_end[MAX_ARRAY_DIMS];
-    int num_dims;
-} ArrayBoundsInfo;
-
-// Variable type tracking
-typedef struct
-{
-    char *var_name;
-    char *type_name; // "int", "double", "bool", "char*"
-} VarTypeInfo;
+} CodegenSymbol;
 
 // Enhanced Code Generator
 typedef struct
@@ -214,19 +563,28 @@ typedef struct
     ASTNode *program;            // Store program AST for lookups
     ASTNode *current_subroutine; // ✅ ADD THIS - Track current function/procedure
 
-    // Array bounds tracking
-    ArrayBoundsInfo array_bounds[100];
-    int num_arrays;
+    // Symbol tables keyed by upper-case name; locals shadow globals
+    HashMap *globals;
+    HashMap *locals; // Subroutine being generated, NULL in the main program
 
-    // Variable type tracking
-    VarTypeInfo var_types[1000];
-    int num_vars;
+    int temp_counter; // Suffix for generated temporaries
+
+    // Array accesses whose bounds the enclosing loop guard has proven
+    ASTNode **unchecked;
+    int num_unchecked;
+    int unchecked_capacity;
+
+    // While emitting a loop guard, the loop variable is replaced by this text
+    const char *bce_var;
+    const char *bce_value;
 } CodeGenerator;
 
 struct ASTNode
 {
     ASTNodeType type;
     int line;
+    CoverageCounter *coverage; // Statements and subroutines under --coverage, see COVERAGE
+    ValueType static_type;     // Set by the type checker, VAL_NONE if unknown
 
     union
     {
@@ -237,6 +595,7 @@ struct ASTNode
             int num_decls;
             ASTNode **body;
             int num_stmts;
+            Closure *closure; // Body under --engine=closure, see CLOSURE COMPILER
         } program;
 
         struct
@@ -258,6 +617,7 @@ struct ASTNode
             int num_local_decls;
             ASTNode **body;
             int num_stmts;
+            Closure *closure; // Body, compiled on the first call under --engine=closure
         } subroutine;
 
         struct
@@ -304,6 +664,7 @@ struct ASTNode
             ASTNode *step;
             ASTNode **body;
             int num_stmts;
+            BcePlan *bce; // Built on first use, see BOUNDS-CHECK ELIMINATION
         } for_loop;
 
         struct
@@ -327,6 +688,8 @@ struct ASTNode
             char *operator;
             ASTNode *left;
             ASTNode *right;
+            uint8_t op;    // BinaryOperator, resolved on first use
+            uint8_t quick; // QuickState, see QUICKENING
         } binary;
 
         struct
@@ -350,6 +713,7 @@ struct ASTNode
             char *name;
             ASTNode **indices;
             int num_indices;
+            int unchecked; // > 0 while an enclosing loop has proven the indices
         } array_access;
     };
 };
@@ -374,16 +738,25 @@ static Token tokens[MAX_TOKENS];
 static int token_count = 0;
 static int token_pos = 0;
 static bool debug_mode = false;
+static bool jit_enabled = false;
 
 // Forward declarations
 static void execute_statement(ASTNode *stmt, Environment *env);
+static void execute_block(ASTNode **stmts, int count, Environment *env);
 static RuntimeValue evaluate(ASTNode *expr, Environment *env);
 static void free_runtime_value(RuntimeValue *val);
 static RuntimeValue copy_runtime_value(RuntimeValue *val);
+static void define_local_arrays(ASTNode *subroutine, Environment *sub_env);
+static bool jit_try_call(ASTNode *sub, ASTNode **args, int num_args, Environment *env, RuntimeValue *result);
+static int jit_enter(ASTNode *sub);
+static void jit_leave(int caller);
+static void jit_backedge(void);
 
 // Codegen declarations
 // Codegen declarations
 void codegen_init(CodeGenerator *gen, FILE *out);
+void codegen_bind_program(CodeGenerator *gen, ASTNode *prog);
+void codegen_prelude(CodeGenerator *gen, ASTNode *prog);
 void codegen_program(CodeGenerator *gen, ASTNode *prog);
 char *sanitize_identifier(const char *name); // Ensure this exists
 const char *map_type(const char *eap_type);  // Ensure this exists
@@ -392,6 +765,8 @@ void codegen_function(CodeGenerator *gen, ASTNode *func);
 void codegen_procedure(CodeGenerator *gen, ASTNode *proc);
 void codegen_statement(CodeGenerator *gen, ASTNode *stmt);
 void codegen_expression(CodeGenerator *gen, ASTNode *expr);
+void codegen_indent(CodeGenerator *gen);
+void codegen_line(CodeGenerator *gen, const char *fmt, ...);
 
 // ============================================================================
 // UTILITY FUNCTIONS
@@ -412,17 +787,404 @@ static double to_real(RuntimeValue *val)
     return 0.0;
 }
 
+// ============================================================================
+// DEBUG TRACE
+// ============================================================================
+
+// --debug messages. DEBUG_LOG evaluates its arguments only when --debug is
+// on, and building with -DEAP_NO_TRACE removes the calls altogether. With
+// --debug-trace=file each message is written as a binary event instead of
+// text: its format string once, then only the arguments and a timestamp.
+// --decode-trace turns the file back into the text --debug would print.
+#ifdef EAP_NO_TRACE
+#define DEBUG_LOG(...) ((void)0)
+#else
+#define DEBUG_LOG(...)              \
+    do                              \
+    {                               \
+        if (debug_mode)             \
+            debug_log(__VA_ARGS__); \
+    } while (0)
+#endif
+
+// File layout (integers little-endian): the magic, then records
+//   'F' u16 id, u16 length, format      defines format id
+//   'E' u16 id, u64 ns, arguments       one message; integers and doubles
+//                                       are 8 bytes, strings u32 length + bytes
+//   'Z' u64 events                      written at exit; a trace without it
+//                                       was cut short (killed, disk full)
+#define DEBUG_TRACE_MAGIC "EAPDTRC2"
+#define DEBUG_TRACE_MAX_FORMATS 1024
+
+typedef enum
+{
+    DEBUG_ARG_NONE,
+    DEBUG_ARG_INT,
+    DEBUG_ARG_UINT,
+    DEBUG_ARG_LONG,
+    DEBUG_ARG_ULONG,
+    DEBUG_ARG_LLONG,
+    DEBUG_ARG_ULLONG,
+    DEBUG_ARG_SIZE,
+    DEBUG_ARG_DOUBLE,
+    DEBUG_ARG_STRING
+} DebugArgKind;
+
+// Finds the next conversion of a printf format. Copies the text before it to
+// out (if not NULL), the conversion itself to spec and returns what follows,
+// or NULL at the end of the format.
+static const char *debug_format_next(const char *fmt, FILE *out, char *spec, size_t spec_size, DebugArgKind *kind)
+{
+    for (;;)
+    {
+        const char *percent = strchr(fmt, '%');
+        if (!percent)
+        {
+            if (out)
+                fputs(fmt, out);
+            return NULL;
+        }
+        if (out)
+            fwrite(fmt, 1, percent - fmt, out);
+        if (percent[1] == '%')
+        {
+            if (out)
+                fputc('%', out);
+            fmt = percent + 2;
+            continue;
+        }
+
+        const char *p = percent + 1;
+        while (*p && strchr("-+ #0123456789.", *p))
+            p++;
+        int longs = 0;
+        bool size = false;
+        for (; *p == 'l' || *p == 'z' || *p == 'h'; p++)
+        {
+            if (*p == 'l')
+                longs++;
+            else if (*p == 'z')
+                size = true;
+        }
+
+        switch (*p)
+        {
+        case 'd':
+        case 'i':
+        case 'c':
+            *kind = size ? DEBUG_ARG_SIZE : longs == 0 ? DEBUG_ARG_INT : longs == 1 ? DEBUG_ARG_LONG : DEBUG_ARG_LLONG;
+            break;
+        case 'u':
+        case 'x':
+        case 'X':
+        case 'o':
+            *kind = size ? DEBUG_ARG_SIZE : longs == 0 ? DEBUG_ARG_UINT : longs == 1 ? DEBUG_ARG_ULONG : DEBUG_ARG_ULLONG;
+            break;
+        case 'f':
+        case 'g':
+        case 'e':
+            *kind = DEBUG_ARG_DOUBLE;
+            break;
+        case 's':
+            *kind = DEBUG_ARG_STRING;
+            break;
+        default:
+            *kind = DEBUG_ARG_NONE; // Printed as it is
+            break;
+        }
+        if (*p)
+            p++;
+        size_t len = (size_t)(p - percent) < spec_size ? (size_t)(p - percent) : spec_size - 1;
+        memcpy(spec, percent, len);
+        spec[len] = '\0';
+        return p;
+    }
+}
+
+#ifndef EAP_NO_TRACE
+static double profile_wall_seconds(void);
+
+static FILE *debug_trace_file = NULL;
+static const char *debug_trace_formats[DEBUG_TRACE_MAX_FORMATS];
+static int debug_trace_num_formats = 0;
+static double debug_trace_origin;
+static uint64_t debug_trace_events;
+
+static void debug_trace_put_u64(uint64_t v, int bytes)
+{
+    for (int i = 0; i < bytes; i++)
+        fputc((int)((v >> (8 * i)) & 0xFF), debug_trace_file);
+}
+
+// Formats are string literals, so the pointer identifies the call site
+static int debug_trace_format_id(const char *fmt)
+{
+    for (int i = 0; i < debug_trace_num_formats; i++)
+        if (debug_trace_formats[i] == fmt)
+            return i;
+    if (debug_trace_num_formats == DEBUG_TRACE_MAX_FORMATS)
+        return -1;
+
+    int id = debug_trace_num_formats++;
+    debug_trace_formats[id] = fmt;
+    size_t len = strlen(fmt) < 0xFFFF ? strlen(fmt) : 0xFFFF;
+    fputc('F', debug_trace_file);
+    debug_trace_put_u64(id, 2);
+    debug_trace_put_u64(len, 2);
+    fwrite(fmt, 1, len, debug_trace_file);
+    return id;
+}
+
+static void debug_trace_event(const char *fmt, va_list args)
+{
+    int id = debug_trace_format_id(fmt);
+    if (id < 0)
+        return;
+
+    debug_trace_events++;
+    fputc('E', debug_trace_file);
+    debug_trace_put_u64(id, 2);
+    debug_trace_put_u64((uint64_t)((profile_wall_seconds() - debug_trace_origin) * 1e9), 8);
+
+    char spec[32];
+    DebugArgKind kind;
+    while ((fmt = debug_format_next(fmt, NULL, spec, sizeof(spec), &kind)))
+    {
+        uint64_t v = 0;
+        switch (kind)
+        {
+        case DEBUG_ARG_NONE:
+            continue;
+        case DEBUG_ARG_INT:
+            v = (uint64_t)(int64_t)va_arg(args, int);
+            break;
+        case DEBUG_ARG_UINT:
+            v = va_arg(args, unsigned int);
+            break;
+        case DEBUG_ARG_LONG:
+            v = (uint64_t)(int64_t)va_arg(args, long);
+            break;
+        case DEBUG_ARG_ULONG:
+            v = va_arg(args, unsigned long);
+            break;
+        case DEBUG_ARG_LLONG:
+            v = (uint64_t)va_arg(args, long long);
+            break;
+        case DEBUG_ARG_ULLONG:
+            v = va_arg(args, unsigned long long);
+            break;
+        case DEBUG_ARG_SIZE:
+            v = va_arg(args, size_t);
+            break;
+        case DEBUG_ARG_DOUBLE:
+        {
+            double d = va_arg(args, double);
+            memcpy(&v, &d, sizeof(v));
+            break;
+        }
+        case DEBUG_ARG_STRING:
+        {
+            const char *str = va_arg(args, const char *);
+            if (!str)
+                str = "(null)";
+            size_t len = strlen(str);
+            debug_trace_put_u64(len, 4);
+            fwrite(str, 1, len, debug_trace_file);
+            continue;
+        }
+        }
+        debug_trace_put_u64(v, 8);
+    }
+}
+
+static void debug_trace_close(void)
+{
+    if (debug_trace_file)
+    {
+        fputc('Z', debug_trace_file);
+        debug_trace_put_u64(debug_trace_events, 8);
+        fclose(debug_trace_file);
+    }
+    debug_trace_file = NULL;
+}
+
+static void debug_trace_init(const char *path)
+{
+    debug_trace_file = fopen(path, "wb");
+    if (!debug_trace_file)
+    {
+        fprintf(stderr, "Error: Cannot create file '%s'\n", path);
+        exit(1);
+    }
+    setvbuf(debug_trace_file, NULL, _IOFBF, 1 << 16);
+    fwrite(DEBUG_TRACE_MAGIC, 1, strlen(DEBUG_TRACE_MAGIC), debug_trace_file);
+    debug_trace_origin = profile_wall_seconds();
+    atexit(debug_trace_close); // Also keeps the events before a runtime error
+}
+
 static void debug_log(const char *fmt, ...)
 {
-    if (debug_mode)
+    va_list args;
+    va_start(args, fmt);
+    if (debug_trace_file)
+    {
+        debug_trace_event(fmt, args);
+    }
+    else
     {
-        va_list args;
-        va_start(args, fmt);
         fprintf(stderr, "[DEBUG] ");
         vfprintf(stderr, fmt, args);
         fprintf(stderr, "\n");
-        va_end(args);
     }
+    va_end(args);
+}
+#endif // EAP_NO_TRACE
+
+static bool debug_trace_get(FILE *in, uint64_t *v, int bytes)
+{
+    *v = 0;
+    for (int i = 0; i < bytes; i++)
+    {
+        int c = fgetc(in);
+        if (c == EOF)
+            return false;
+        *v |= (uint64_t)c << (8 * i);
+    }
+    return true;
+}
+
+// Prints the messages of a --debug-trace file as --debug would, each with
+// the seconds since the start of the run
+static int debug_trace_decode(const char *path)
+{
+    FILE *in = fopen(path, "rb");
+    if (!in)
+    {
+        fprintf(stderr, "Error: Cannot open file '%s'\n", path);
+        return 1;
+    }
+    char magic[sizeof(DEBUG_TRACE_MAGIC) - 1];
+    if (fread(magic, 1, sizeof(magic), in) != sizeof(magic) || memcmp(magic, DEBUG_TRACE_MAGIC, sizeof(magic)) != 0)
+    {
+        fprintf(stderr, "Error: '%s' is not a debug trace\n", path);
+        fclose(in);
+        return 1;
+    }
+
+    char *formats[DEBUG_TRACE_MAX_FORMATS] = {NULL};
+    char *text = NULL;
+    size_t text_capacity = 0;
+    bool ok = true;
+    bool ended = false;
+    uint64_t events = 0;
+    int record;
+    while (ok && !ended && (record = fgetc(in)) != EOF)
+    {
+        uint64_t id, len, ns;
+        if (record == 'Z')
+        {
+            uint64_t written;
+            ended = true;
+            ok = debug_trace_get(in, &written, 8) && written == events && fgetc(in) == EOF;
+        }
+        else if (!debug_trace_get(in, &id, 2) || id >= DEBUG_TRACE_MAX_FORMATS)
+        {
+            ok = false;
+        }
+        else if (record == 'F')
+        {
+            ok = debug_trace_get(in, &len, 2);
+            free(formats[id]);
+            formats[id] = malloc(len + 1);
+            ok = ok && fread(formats[id], 1, len, in) == len;
+            formats[id][ok ? len : 0] = '\0';
+        }
+        else if (record == 'E' && formats[id] && debug_trace_get(in, &ns, 8))
+        {
+            printf("[%12.6f] [DEBUG] ", ns / 1e9);
+            const char *fmt = formats[id];
+            char spec[32];
+            DebugArgKind kind;
+            while (ok && (fmt = debug_format_next(fmt, stdout, spec, sizeof(spec), &kind)))
+            {
+                uint64_t v = 0;
+                double d;
+                if (kind == DEBUG_ARG_NONE)
+                {
+                    fputs(spec, stdout);
+                    continue;
+                }
+                if (kind == DEBUG_ARG_STRING)
+                {
+                    ok = debug_trace_get(in, &len, 4);
+                    if (ok && len + 1 > text_capacity)
+                    {
+                        text_capacity = len + 1;
+                        text = realloc(text, text_capacity);
+                    }
+                    ok = ok && fread(text, 1, len, in) == len;
+                    if (ok)
+                    {
+                        text[len] = '\0';
+                        printf(spec, text);
+                    }
+                    continue;
+                }
+                ok = debug_trace_get(in, &v, 8);
+                switch (kind)
+                {
+                case DEBUG_ARG_INT:
+                    printf(spec, (int)(int64_t)v);
+                    break;
+                case DEBUG_ARG_UINT:
+                    printf(spec, (unsigned int)v);
+                    break;
+                case DEBUG_ARG_LONG:
+                    printf(spec, (long)(int64_t)v);
+                    break;
+                case DEBUG_ARG_ULONG:
+                    printf(spec, (unsigned long)v);
+                    break;
+                case DEBUG_ARG_LLONG:
+                    printf(spec, (long long)v);
+                    break;
+                case DEBUG_ARG_ULLONG:
+                    printf(spec, (unsigned long long)v);
+                    break;
+                case DEBUG_ARG_SIZE:
+                    printf(spec, (size_t)v);
+                    break;
+                default:
+                    memcpy(&d, &v, sizeof(d));
+                    printf(spec, d);
+                    break;
+                }
+            }
+            printf("\n");
+            events += ok;
+        }
+        else
+        {
+            ok = false;
+        }
+    }
+
+    for (int i = 0; i < DEBUG_TRACE_MAX_FORMATS; i++)
+        free(formats[i]);
+    free(text);
+    fclose(in);
+    if (!ok)
+    {
+        fprintf(stderr, "Error: '%s' is truncated or corrupt after %llu events\n", path, (unsigned long long)events);
+        return 1;
+    }
+    if (!ended)
+    {
+        fprintf(stderr, "Warning: Trace '%s' truncated after %llu events; the program did not finish writing it\n",
+                path, (unsigned long long)events);
+        return 1;
+    }
+    return 0;
 }
 
 static char *str_upper(const char *str)
@@ -522,6 +1284,34 @@ static void free_hashmap(HashMap *map)
     free(map);
 }
 
+// ============================================================================
+// HEAP PROFILE OWNERS
+// ============================================================================
+
+// Owner of the blocks of an EAP variable, created on first use. Variables of
+// the same name and kind share an owner, whichever scope they live in;
+// EAP names are case-insensitive.
+static int mem_variable(const char *name, const char *kind, int line)
+{
+    for (int i = MEM_FIXED_OWNERS; i < mem_num_owners; i++)
+    {
+        if (mem_owners[i].kind == kind && str_equals_ignore_case(mem_owners[i].name, name))
+        {
+            if (!mem_owners[i].line)
+                mem_owners[i].line = line;
+            return i;
+        }
+    }
+    if (mem_num_owners == MEM_MAX_OWNERS)
+        return MEM_OTHER_VARIABLES;
+
+    MemOwner *owner = &mem_owners[mem_num_owners];
+    snprintf(owner->name, sizeof(owner->name), "%s", name);
+    owner->kind = kind;
+    owner->line = line;
+    return mem_num_owners++;
+}
+
 // ============================================================================
 // ARRAY OBJECT
 // ============================================================================
@@ -531,6 +1321,7 @@ static ArrayObject *create_array(ArrayBound *bounds, int num_dims)
     ArrayObject *arr = malloc(sizeof(ArrayObject));
     arr->data = create_hashmap();
     arr->num_dims = num_dims;
+    arr->mem_owner = mem_owner;
     for (int i = 0; i < num_dims; i++)
     {
         arr->bounds[i] = bounds[i];
@@ -558,10 +1349,10 @@ static void validate_array_indices(ArrayObject *arr, int *indices, int num_indic
     }
 }
 
-static RuntimeValue array_get(ArrayObject *arr, int *indices, int num_indices)
+// Element lookup without bounds checking, for indices already proven valid
+static RuntimeValue array_get_unchecked(ArrayObject *arr, int *indices, int num_indices)
 {
-    validate_array_indices(arr, indices, num_indices);
-
+    stats.array_gets++;
     char key[256] = {0};
     for (int i = 0; i < num_indices; i++)
     {
@@ -584,8 +1375,17 @@ static RuntimeValue array_get(ArrayObject *arr, int *indices, int num_indices)
     return default_val;
 }
 
-void array_set(ArrayObject *arr, int *indices, int num_indices, RuntimeValue val)
+static RuntimeValue array_get(ArrayObject *arr, int *indices, int num_indices)
+{
+    validate_array_indices(arr, indices, num_indices);
+    return array_get_unchecked(arr, indices, num_indices);
+}
+
+// Element store without bounds checking, for indices already checked
+static void array_set_unchecked(ArrayObject *arr, int *indices, int num_indices, RuntimeValue val)
 {
+    stats.array_sets++;
+
     // 1. Δημιουργία κλειδιού (ΠΡΕΠΕΙ να είναι ίδια με την array_get)
     char key[256] = {0};
     for (int i = 0; i < num_indices; i++)
@@ -598,15 +1398,28 @@ void array_set(ArrayObject *arr, int *indices, int num_indices, RuntimeValue val
     }
 
     // 2. Δέσμευση μνήμης για την τιμή
+    int saved_owner = mem_enter(arr->mem_owner);
     RuntimeValue *new_val = malloc(sizeof(RuntimeValue));
     if (!new_val)
+    {
+        mem_owner = saved_owner;
         return;
+    }
 
     // 3. Αντιγραφή της τιμής
     *new_val = copy_runtime_value(&val);
 
     // 4. Αποθήκευση στο HashMap
     hashmap_set(arr->data, key, new_val);
+    mem_owner = saved_owner;
+}
+
+// Writes are checked like reads, as the transpiled and --native programs check
+// them
+void array_set(ArrayObject *arr, int *indices, int num_indices, RuntimeValue val)
+{
+    validate_array_indices(arr, indices, num_indices);
+    array_set_unchecked(arr, indices, num_indices, val);
 }
 
 static void free_array(ArrayObject *arr)
@@ -657,6 +1470,7 @@ static RuntimeValue copy_runtime_value(RuntimeValue *val)
             else
             {
                 copy.value.str_val = strdup(val->value.str_val);
+                stats.string_copies++;
             }
         }
         break;
@@ -723,13 +1537,29 @@ static int to_int(RuntimeValue *val)
 
 static Environment *create_environment(Environment *parent)
 {
+    int saved_owner = mem_enter(MEM_ENVIRONMENTS);
     Environment *env = calloc(1, sizeof(Environment));
+    mem_owner = saved_owner;
     env->parent = parent;
+    stats.environments++;
     return env;
 }
 
+// Copies a value into a variable; strings are charged to the variable
+static RuntimeValue env_copy_value(const char *name, RuntimeValue *value)
+{
+    if (!mem_report_enabled || value->type != VAL_STRING)
+        return copy_runtime_value(value);
+
+    int saved_owner = mem_enter(mem_variable(name, "string", 0));
+    RuntimeValue copy = copy_runtime_value(value);
+    mem_owner = saved_owner;
+    return copy;
+}
+
 static void env_define(Environment *env, const char *name, RuntimeValue value)
 {
+    int saved_owner = mem_enter(MEM_ENVIRONMENTS);
     char *upper_name = str_upper(name);
     unsigned int idx = hash_string(upper_name);
 
@@ -742,8 +1572,9 @@ static void env_define(Environment *env, const char *name, RuntimeValue value)
             {
                 free_runtime_value(&existing->value);
             }
-            existing->value = copy_runtime_value(&value);
+            existing->value = env_copy_value(name, &value);
             free(upper_name);
+            mem_owner = saved_owner;
             return;
         }
         existing = existing->next;
@@ -751,14 +1582,16 @@ static void env_define(Environment *env, const char *name, RuntimeValue value)
 
     EnvEntry *entry = malloc(sizeof(EnvEntry));
     entry->name = upper_name;
-    entry->value = copy_runtime_value(&value);
+    entry->value = env_copy_value(name, &value);
     entry->subroutine = NULL;
     entry->next = env->entries[idx];
     env->entries[idx] = entry;
+    mem_owner = saved_owner;
 }
 
 static void env_define_subroutine(Environment *env, const char *name, ASTNode *subroutine)
 {
+    int saved_owner = mem_enter(MEM_ENVIRONMENTS);
     char *upper_name = str_upper(name);
     unsigned int idx = hash_string(upper_name);
 
@@ -768,33 +1601,43 @@ static void env_define_subroutine(Environment *env, const char *name, ASTNode *s
     entry->subroutine = subroutine;
     entry->next = env->entries[idx];
     env->entries[idx] = entry;
+    mem_owner = saved_owner;
 }
 
-static RuntimeValue *env_get(Environment *env, const char *name)
+// Like env_get, but returns NULL for undefined names
+static RuntimeValue *env_lookup(Environment *env, const char *name)
 {
     char *upper_name = str_upper(name);
     unsigned int idx = hash_string(upper_name);
+    stats.env_lookups++;
 
-    EnvEntry *entry = env->entries[idx];
-    while (entry)
+    for (; env; env = env->parent)
     {
-        if (strcmp(entry->name, upper_name) == 0)
+        stats.env_scopes_walked++;
+        for (EnvEntry *entry = env->entries[idx]; entry; entry = entry->next)
         {
-            free(upper_name);
-            return &entry->value;
+            stats.env_entries_walked++;
+            if (strcmp(entry->name, upper_name) == 0)
+            {
+                free(upper_name);
+                return &entry->value;
+            }
         }
-        entry = entry->next;
     }
 
-    if (env->parent)
+    free(upper_name);
+    return NULL;
+}
+
+static RuntimeValue *env_get(Environment *env, const char *name)
+{
+    RuntimeValue *val = env_lookup(env, name);
+    if (!val)
     {
-        free(upper_name);
-        return env_get(env->parent, name);
+        fprintf(stderr, "Runtime Error: Undefined variable: %s\n", name);
+        exit(1);
     }
-
-    fprintf(stderr, "Runtime Error: Undefined variable: %s\n", name);
-    free(upper_name);
-    exit(1);
+    return val;
 }
 
 static ASTNode *env_get_subroutine(Environment *env, const char *name)
@@ -828,28 +1671,27 @@ static void env_assign(Environment *env, const char *name, RuntimeValue value)
 {
     char *upper_name = str_upper(name);
     unsigned int idx = hash_string(upper_name);
+    stats.env_assigns++;
 
-    EnvEntry *entry = env->entries[idx];
-    while (entry)
+    for (;; env = env->parent)
     {
-        if (strcmp(entry->name, upper_name) == 0)
+        stats.env_scopes_walked++;
+        for (EnvEntry *entry = env->entries[idx]; entry; entry = entry->next)
         {
-            free_runtime_value(&entry->value);
-            entry->value = copy_runtime_value(&value);
-            free(upper_name);
-            return;
+            stats.env_entries_walked++;
+            if (strcmp(entry->name, upper_name) == 0)
+            {
+                free_runtime_value(&entry->value);
+                entry->value = env_copy_value(name, &value);
+                free(upper_name);
+                return;
+            }
         }
-        entry = entry->next;
-    }
-
-    if (env->parent)
-    {
-        free(upper_name);
-        env_assign(env->parent, name, value);
-        return;
+        if (!env->parent)
+            break;
     }
 
-    // Define if not found
+    // Define if not found (in the outermost environment)
     free(upper_name);
     env_define(env, name, value);
 }
@@ -1278,6 +2120,7 @@ static ASTNode *create_node(ASTNodeType type)
     ASTNode *node = calloc(1, sizeof(ASTNode));
     node->type = type;
     node->line = current_token()->line;
+    node->static_type = VAL_NONE;
     return node;
 }
 
@@ -1797,6 +2640,66 @@ static ASTNode **parse_block(int *num_stmts)
 
 static ASTNode **parse_parameters(int *num_params, char *func_name);
 
+// Parses the type of a DATA declaration: a simple type, or ARRAY[a..b, ...] OF
+// type. Returns the (element) type; array bounds are stored in bounds.
+static char *parse_var_type(ArrayBoundExpr *bounds, int *num_dims)
+{
+    *num_dims = 0;
+
+    if (match_token(TOK_ARRAY))
+    {
+        advance_token();
+        expect_token(TOK_LEFT_BRACKET);
+
+        // Parse array dimensions
+        do
+        {
+            if (*num_dims >= MAX_ARRAY_DIMS)
+            {
+                fprintf(stderr, "Syntax Error: Too many array dimensions at line %d\n", current_token()->line);
+                exit(1);
+            }
+            // Parse start..end
+            bounds[*num_dims].start_expr = parse_expression();
+            expect_token(TOK_DOT);
+            bounds[*num_dims].end_expr = parse_expression();
+            (*num_dims)++;
+        } while (match_token(TOK_COMMA) && (advance_token(), 1));
+
+        expect_token(TOK_RIGHT_BRACKET);
+        expect_token(TOK_OF);
+    }
+
+    // Accept either type keyword or identifier
+    if (match_any(5, TOK_INTEGER_TYPE, TOK_REAL_TYPE, TOK_BOOLEAN_TYPE, TOK_CHAR_TYPE, TOK_STRING_TYPE) ||
+        match_token(TOK_IDENTIFIER))
+    {
+        char *type_str = strdup(current_token()->value);
+        advance_token();
+        return type_str;
+    }
+
+    fprintf(stderr, "Syntax Error: Expected type%s at line %d\n", *num_dims > 0 ? " after OF" : "",
+            current_token()->line);
+    exit(1);
+}
+
+// line is the line of the name: the parser has read the type by now
+static ASTNode *create_var_decl(char *name, int line, const char *type_str, ArrayBoundExpr *bounds, int num_dims)
+{
+    ASTNode *var_decl = create_node(AST_VAR_DECL);
+    var_decl->line = line;
+    var_decl->decl.name = name;
+    var_decl->decl.var_type = strdup(type_str);
+    var_decl->decl.num_arr_dims = num_dims;
+    if (num_dims > 0)
+    {
+        var_decl->decl.arr_bound_exprs = malloc(num_dims * sizeof(ArrayBoundExpr));
+        memcpy(var_decl->decl.arr_bound_exprs, bounds, num_dims * sizeof(ArrayBoundExpr));
+    }
+    return var_decl;
+}
+
 static ASTNode **parse_interface(int *num_params, char *func_name)
 {
     expect_token(TOK_INTERFACE);
@@ -2039,6 +2942,7 @@ static ASTNode *parse_function()
         {
             int name_cap = 10;
             char **names = malloc(name_cap * sizeof(char *));
+            int *lines = malloc(name_cap * sizeof(int));
             int name_count = 0;
 
             do
@@ -2047,29 +2951,18 @@ static ASTNode *parse_function()
                 {
                     name_cap *= 2;
                     names = realloc(names, name_cap * sizeof(char *));
+                    lines = realloc(lines, name_cap * sizeof(int));
                 }
+                lines[name_count] = current_token()->line;
                 names[name_count++] = strdup(current_token()->value);
                 expect_token(TOK_IDENTIFIER);
             } while (match_token(TOK_COMMA) && (advance_token(), 1));
 
             expect_token(TOK_COLON);
 
-            char *type_str = NULL;
-            if (match_any(5, TOK_INTEGER_TYPE, TOK_REAL_TYPE, TOK_BOOLEAN_TYPE, TOK_CHAR_TYPE, TOK_STRING_TYPE))
-            {
-                type_str = strdup(current_token()->value);
-                advance_token();
-            }
-            else if (match_token(TOK_IDENTIFIER))
-            {
-                type_str = strdup(current_token()->value);
-                advance_token();
-            }
-            else
-            {
-                fprintf(stderr, "Syntax Error: Expected type at line %d\n", current_token()->line);
-                exit(1);
-            }
+            ArrayBoundExpr bounds[MAX_ARRAY_DIMS];
+            int num_dims;
+            char *type_str = parse_var_type(bounds, &num_dims);
 
             expect_token(TOK_SEMICOLON);
 
@@ -2081,13 +2974,11 @@ static ASTNode *parse_function()
                     node->subroutine.local_decls = realloc(node->subroutine.local_decls, cap * sizeof(ASTNode *));
                 }
 
-                ASTNode *var_decl = create_node(AST_VAR_DECL);
-                var_decl->decl.name = names[i];
-                var_decl->decl.var_type = strdup(type_str);
-                var_decl->decl.num_arr_dims = 0;
+                ASTNode *var_decl = create_var_decl(names[i], lines[i], type_str, bounds, num_dims);
                 node->subroutine.local_decls[node->subroutine.num_local_decls++] = var_decl;
             }
 
+            free(lines);
             free(names);
             free(type_str);
         }
@@ -2142,6 +3033,7 @@ static ASTNode *parse_procedure()
         {
             int name_cap = 10;
             char **names = malloc(name_cap * sizeof(char *));
+            int *lines = malloc(name_cap * sizeof(int));
             int name_count = 0;
 
             // Collect variable names
@@ -2151,30 +3043,19 @@ static ASTNode *parse_procedure()
                 {
                     name_cap *= 2;
                     names = realloc(names, name_cap * sizeof(char *));
+                    lines = realloc(lines, name_cap * sizeof(int));
                 }
+                lines[name_count] = current_token()->line;
                 names[name_count++] = strdup(current_token()->value);
                 expect_token(TOK_IDENTIFIER);
             } while (match_token(TOK_COMMA) && (advance_token(), 1));
 
             expect_token(TOK_COLON);
 
-            // Parse type
-            char *type_str = NULL;
-            if (match_any(5, TOK_INTEGER_TYPE, TOK_REAL_TYPE, TOK_BOOLEAN_TYPE, TOK_CHAR_TYPE, TOK_STRING_TYPE))
-            {
-                type_str = strdup(current_token()->value);
-                advance_token();
-            }
-            else if (match_token(TOK_IDENTIFIER))
-            {
-                type_str = strdup(current_token()->value);
-                advance_token();
-            }
-            else
-            {
-                fprintf(stderr, "Syntax Error: Expected type at line %d\n", current_token()->line);
-                exit(1);
-            }
+            // Parse type (could be simple type or ARRAY type)
+            ArrayBoundExpr bounds[MAX_ARRAY_DIMS];
+            int num_dims;
+            char *type_str = parse_var_type(bounds, &num_dims);
 
             expect_token(TOK_SEMICOLON);
 
@@ -2187,13 +3068,11 @@ static ASTNode *parse_procedure()
                     node->subroutine.local_decls = realloc(node->subroutine.local_decls, cap * sizeof(ASTNode *));
                 }
 
-                ASTNode *var_decl = create_node(AST_VAR_DECL);
-                var_decl->decl.name = names[i];
-                var_decl->decl.var_type = strdup(type_str);
-                var_decl->decl.num_arr_dims = 0;
+                ASTNode *var_decl = create_var_decl(names[i], lines[i], type_str, bounds, num_dims);
                 node->subroutine.local_decls[node->subroutine.num_local_decls++] = var_decl;
             }
 
+            free(lines);
             free(names);
             free(type_str);
         }
@@ -2257,6 +3136,7 @@ static ASTNode *parse_program()
         {
             int name_cap = 10;
             char **names = malloc(name_cap * sizeof(char *));
+            int *lines = malloc(name_cap * sizeof(int));
             int name_count = 0;
 
             do
@@ -2265,7 +3145,9 @@ static ASTNode *parse_program()
                 {
                     name_cap *= 2;
                     names = realloc(names, name_cap * sizeof(char *));
+                    lines = realloc(lines, name_cap * sizeof(int));
                 }
+                lines[name_count] = current_token()->line;
                 names[name_count++] = strdup(current_token()->value);
                 expect_token(TOK_IDENTIFIER);
             } while (match_token(TOK_COMMA) && (advance_token(), 1));
@@ -2273,86 +3155,15 @@ static ASTNode *parse_program()
             expect_token(TOK_COLON);
 
             // Parse type (could be simple type or ARRAY type)
-            bool is_array = false;
             ArrayBoundExpr array_bound_exprs[MAX_ARRAY_DIMS];
-            int num_dims = 0;
-            char *base_type = NULL;
-
-            if (match_token(TOK_ARRAY))
-            {
-                is_array = true;
-                advance_token();
-                expect_token(TOK_LEFT_BRACKET);
-
-                // Parse array dimensions
-                do
-                {
-                    // Parse start..end
-                    array_bound_exprs[num_dims].start_expr = parse_expression();
-                    expect_token(TOK_DOT);
-                    array_bound_exprs[num_dims].end_expr = parse_expression();
-                    num_dims++;
-                } while (match_token(TOK_COMMA) && (advance_token(), 1));
-
-                expect_token(TOK_RIGHT_BRACKET);
-                expect_token(TOK_OF);
-
-                // Accept either type keyword or identifier
-                if (match_any(5, TOK_INTEGER_TYPE, TOK_REAL_TYPE, TOK_BOOLEAN_TYPE, TOK_CHAR_TYPE, TOK_STRING_TYPE))
-                {
-                    base_type = strdup(current_token()->value);
-                    advance_token();
-                }
-                else if (match_token(TOK_IDENTIFIER))
-                {
-                    base_type = strdup(current_token()->value);
-                    advance_token();
-                }
-                else
-                {
-                    fprintf(stderr, "Syntax Error: Expected type after OF at line %d\n", current_token()->line);
-                    exit(1);
-                }
-            }
-            else
-            {
-                // Simple type
-                if (match_any(5, TOK_INTEGER_TYPE, TOK_REAL_TYPE, TOK_BOOLEAN_TYPE, TOK_CHAR_TYPE, TOK_STRING_TYPE))
-                {
-                    base_type = strdup(current_token()->value);
-                    advance_token();
-                }
-                else if (match_token(TOK_IDENTIFIER))
-                {
-                    base_type = strdup(current_token()->value);
-                    advance_token();
-                }
-                else
-                {
-                    fprintf(stderr, "Syntax Error: Expected type at line %d\n", current_token()->line);
-                    exit(1);
-                }
-            }
+            int num_dims;
+            char *base_type = parse_var_type(array_bound_exprs, &num_dims);
 
             expect_token(TOK_SEMICOLON);
 
             for (int i = 0; i < name_count; i++)
             {
-                ASTNode *var_decl = create_node(AST_VAR_DECL);
-                var_decl->decl.name = names[i];
-
-                if (is_array)
-                {
-                    var_decl->decl.arr_bound_exprs = malloc(num_dims * sizeof(ArrayBoundExpr));
-                    memcpy(var_decl->decl.arr_bound_exprs, array_bound_exprs, num_dims * sizeof(ArrayBoundExpr));
-                    var_decl->decl.num_arr_dims = num_dims;
-                    var_decl->decl.var_type = base_type;
-                }
-                else
-                {
-                    var_decl->decl.var_type = strdup(base_type);
-                    var_decl->decl.num_arr_dims = 0;
-                }
+                ASTNode *var_decl = create_var_decl(names[i], lines[i], base_type, array_bound_exprs, num_dims);
 
                 if (prog->program.num_decls >= cap)
                 {
@@ -2362,11 +3173,9 @@ static ASTNode *parse_program()
                 prog->program.declarations[prog->program.num_decls++] = var_decl;
             }
 
+            free(lines);
             free(names);
-            // if (!is_array)
-            //{
             free(base_type);
-            //}
         }
     }
 
@@ -2397,809 +3206,4961 @@ static ASTNode *parse_program()
 }
 
 // ============================================================================
-// INTERPRETER
+// BOUNDS-CHECK ELIMINATION
 // ============================================================================
-static RuntimeValue evaluate(ASTNode *expr, Environment *env)
+// A FOR loop whose body makes no calls and never assigns its variable visits
+// start, start + step, ..., last. An index that is affine in the loop
+// variable (a*i + c, where c uses only literals and variables the body never
+// assigns) takes its extreme values at the first and the last iteration, so
+// checking those two values against the array bounds once before the loop
+// proves every execution of the access inside it.
+
+typedef struct
 {
-    RuntimeValue result;
-    memset(&result, 0, sizeof(RuntimeValue));
-    result.type = VAL_NONE;
+    ASTNode *node; // AST_ARRAY_ACCESS, or AST_ASSIGN to an array element
+    int same_as;   // Earlier entry with the same array and indices, or -1
+    bool proven;   // Result of bce_enter for the current run of the loop
+} BceAccess;
+
+struct BcePlan
+{
+    BceAccess *accesses;
+    int count;
+    int capacity;
+};
+
+#define BCE_LIMIT (1LL << 40) // Larger intermediate values are not analysed
 
+static bool bce_expr_has_call(ASTNode *expr)
+{
     if (!expr)
-        return result;
+        return false;
 
     switch (expr->type)
     {
-    case AST_LITERAL:
-        // ΠΑΝΤΑ επιστρέφουμε αντίγραφο για να αποφύγουμε double-free με το AST
-        return copy_runtime_value(&expr->literal.value);
-
-    case AST_IDENTIFIER:
-    {
-        RuntimeValue *val = env_get(env, expr->identifier.name);
-        return copy_runtime_value(val);
-    }
-
+    case AST_CALL:
+        return true;
     case AST_BINARY_OP:
-    {
-        RuntimeValue left = evaluate(expr->binary.left, env);
-        RuntimeValue right = evaluate(expr->binary.right, env);
-
-        result.type = VAL_INT;
-
-        if (strcmp(expr->binary.operator, "+") == 0)
-        {
-            if (left.type == VAL_REAL || right.type == VAL_REAL)
-            {
-                result.type = VAL_REAL;
-                result.value.real_val = (left.type == VAL_REAL ? left.value.real_val : left.value.int_val) +
-                                        (right.type == VAL_REAL ? right.value.real_val : right.value.int_val);
-            }
-            else
-            {
-                result.value.int_val = left.value.int_val + right.value.int_val;
-            }
-        }
-        else if (strcmp(expr->binary.operator, "-") == 0)
-        {
-            if (left.type == VAL_REAL || right.type == VAL_REAL)
-            {
-                result.type = VAL_REAL;
-                result.value.real_val = (left.type == VAL_REAL ? left.value.real_val : left.value.int_val) -
-                                        (right.type == VAL_REAL ? right.value.real_val : right.value.int_val);
-            }
-            else
-            {
-                result.value.int_val = left.value.int_val - right.value.int_val;
-            }
-        }
-        else if (strcmp(expr->binary.operator, "*") == 0)
+        return bce_expr_has_call(expr->binary.left) || bce_expr_has_call(expr->binary.right);
+    case AST_UNARY_OP:
+        return bce_expr_has_call(expr->unary.operand);
+    case AST_ARRAY_ACCESS:
+        for (int i = 0; i < expr->array_access.num_indices; i++)
         {
-            if (left.type == VAL_REAL || right.type == VAL_REAL)
-            {
-                result.type = VAL_REAL;
-                result.value.real_val = (left.type == VAL_REAL ? left.value.real_val : left.value.int_val) *
-                                        (right.type == VAL_REAL ? right.value.real_val : right.value.int_val);
-            }
-            else
-            {
-                result.value.int_val = left.value.int_val * right.value.int_val;
-            }
+            if (bce_expr_has_call(expr->array_access.indices[i]))
+                return true;
         }
-        else if (strcmp(expr->binary.operator, "/") == 0)
+        return false;
+    default:
+        return false;
+    }
+}
+
+// Calls are rejected outright: with dynamic scoping any subroutine may
+// assign the loop variable or the variables an index depends on
+static bool bce_block_has_call(ASTNode **stmts, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        ASTNode *stmt = stmts[i];
+        switch (stmt->type)
         {
-            result.type = VAL_REAL;
-            double l = left.type == VAL_REAL ? left.value.real_val : left.value.int_val;
-            double r = right.type == VAL_REAL ? right.value.real_val : right.value.int_val;
-            if (r == 0)
+        case AST_CALL:
+            return true;
+        case AST_ASSIGN:
+            if (bce_expr_has_call(stmt->assign.value))
+                return true;
+            for (int j = 0; j < stmt->assign.num_indices; j++)
             {
-                fprintf(stderr, "Runtime Error: Division by zero\n");
-                exit(1);
+                if (bce_expr_has_call(stmt->assign.indices[j]))
+                    return true;
             }
-            result.value.real_val = l / r;
-        }
-        else if (strcmp(expr->binary.operator, "DIV") == 0)
-        {
-            int r = to_int(&right);
-            if (r == 0)
+            break;
+        case AST_PRINT:
+            for (int j = 0; j < stmt->print.num_exprs; j++)
             {
-                fprintf(stderr, "Runtime Error: Division by zero\n");
-                exit(1);
+                if (bce_expr_has_call(stmt->print.expressions[j]))
+                    return true;
             }
-            result.value.int_val = to_int(&left) / r;
-        }
-        else if (strcmp(expr->binary.operator, "MOD") == 0)
-        {
-            int r = to_int(&right);
-            if (r == 0)
+            break;
+        case AST_READ:
+            for (int j = 0; j < stmt->read.num_vars; j++)
             {
-                fprintf(stderr, "Runtime Error: Modulo by zero\n");
-                exit(1);
+                if (bce_expr_has_call(stmt->read.variables[j]))
+                    return true;
             }
-            result.value.int_val = to_int(&left) % r;
-        }
-        else if (strcmp(expr->binary.operator, "=") == 0)
-        {
-            result.type = VAL_BOOL;
-            double l = left.type == VAL_REAL ? left.value.real_val : (left.type == VAL_INT ? left.value.int_val : 0);
-            double r = right.type == VAL_REAL ? right.value.real_val : (right.type == VAL_INT ? right.value.int_val : 0);
-            result.value.bool_val = (l == r);
-        }
-        else if (strcmp(expr->binary.operator, "<>") == 0)
-        {
-            result.type = VAL_BOOL;
-            double l = left.type == VAL_REAL ? left.value.real_val : (left.type == VAL_INT ? left.value.int_val : 0);
-            double r = right.type == VAL_REAL ? right.value.real_val : (right.type == VAL_INT ? right.value.int_val : 0);
-            result.value.bool_val = (l != r);
-        }
-        else if (strcmp(expr->binary.operator, "<") == 0)
-        {
-            result.type = VAL_BOOL;
-            double l = (left.type == VAL_REAL) ? left.value.real_val : (double)left.value.int_val;
-            double r = (right.type == VAL_REAL) ? right.value.real_val : (double)right.value.int_val;
-            result.value.bool_val = l < r;
-        }
-        else if (strcmp(expr->binary.operator, ">") == 0)
-        {
-            result.type = VAL_BOOL;
-            double l = (left.type == VAL_REAL) ? left.value.real_val : (double)left.value.int_val;
-            double r = (right.type == VAL_REAL) ? right.value.real_val : (double)right.value.int_val;
-            result.value.bool_val = l > r;
-        }
-        else if (strcmp(expr->binary.operator, "<=") == 0)
-        {
-            result.type = VAL_BOOL;
-            double l = (left.type == VAL_REAL) ? left.value.real_val : (double)left.value.int_val;
-            double r = (right.type == VAL_REAL) ? right.value.real_val : (double)right.value.int_val;
-            result.value.bool_val = l <= r;
-        }
-        else if (strcmp(expr->binary.operator, ">=") == 0)
-        {
-            result.type = VAL_BOOL;
-            double l = (left.type == VAL_REAL) ? left.value.real_val : (double)left.value.int_val;
-            double r = (right.type == VAL_REAL) ? right.value.real_val : (double)right.value.int_val;
-            result.value.bool_val = l >= r;
-        }
-        else if (str_equals_ignore_case(expr->binary.operator, "AND") || str_equals_ignore_case(expr->binary.operator, "ΚΑΙ"))
-        {
-            result.type = VAL_BOOL;
-            result.value.bool_val = to_bool(&left) && to_bool(&right);
-        }
-        else if (str_equals_ignore_case(expr->binary.operator, "OR") || str_equals_ignore_case(expr->binary.operator, "Ή"))
-        {
-            result.type = VAL_BOOL;
-            result.value.bool_val = to_bool(&left) || to_bool(&right);
+            break;
+        case AST_IF:
+            if (bce_expr_has_call(stmt->if_stmt.condition) ||
+                bce_block_has_call(stmt->if_stmt.then_branch, stmt->if_stmt.num_then) ||
+                bce_block_has_call(stmt->if_stmt.else_branch, stmt->if_stmt.num_else))
+                return true;
+            break;
+        case AST_FOR:
+            if (bce_expr_has_call(stmt->for_loop.start) || bce_expr_has_call(stmt->for_loop.end) ||
+                bce_expr_has_call(stmt->for_loop.step) ||
+                bce_block_has_call(stmt->for_loop.body, stmt->for_loop.num_stmts))
+                return true;
+            break;
+        case AST_WHILE:
+            if (bce_expr_has_call(stmt->while_loop.condition) ||
+                bce_block_has_call(stmt->while_loop.body, stmt->while_loop.num_stmts))
+                return true;
+            break;
+        default:
+            break;
         }
-
-        // Καθαρισμός προσωρινών τιμών
-        free_runtime_value(&left);
-        free_runtime_value(&right);
-        return result;
     }
+    return false;
+}
 
-    case AST_UNARY_OP:
+// Whether any statement in the block assigns the scalar variable (or array
+// as a whole) called name
+static bool bce_block_assigns(ASTNode **stmts, int count, const char *name)
+{
+    for (int i = 0; i < count; i++)
     {
-        RuntimeValue operand = evaluate(expr->unary.operand, env);
-        if (strcmp(expr->unary.operator, "-") == 0)
+        ASTNode *stmt = stmts[i];
+        switch (stmt->type)
         {
-            if (operand.type == VAL_REAL)
+        case AST_ASSIGN:
+            if (stmt->assign.num_indices == 0 && str_equals_ignore_case(stmt->assign.identifier, name))
+                return true;
+            break;
+        case AST_READ:
+            for (int j = 0; j < stmt->read.num_vars; j++)
             {
-                result.type = VAL_REAL;
-                result.value.real_val = -operand.value.real_val;
-            }
-            else
-            {
-                result.type = VAL_INT;
-                result.value.int_val = -operand.value.int_val;
+                ASTNode *var = stmt->read.variables[j];
+                if (var->type == AST_IDENTIFIER && str_equals_ignore_case(var->identifier.name, name))
+                    return true;
             }
+            break;
+        case AST_IF:
+            if (bce_block_assigns(stmt->if_stmt.then_branch, stmt->if_stmt.num_then, name) ||
+                bce_block_assigns(stmt->if_stmt.else_branch, stmt->if_stmt.num_else, name))
+                return true;
+            break;
+        case AST_FOR:
+            if (str_equals_ignore_case(stmt->for_loop.variable, name) ||
+                bce_block_assigns(stmt->for_loop.body, stmt->for_loop.num_stmts, name))
+                return true;
+            break;
+        case AST_WHILE:
+            if (bce_block_assigns(stmt->while_loop.body, stmt->while_loop.num_stmts, name))
+                return true;
+            break;
+        default:
+            break;
         }
-        else if (str_equals_ignore_case(expr->unary.operator, "NOT") || str_equals_ignore_case(expr->unary.operator, "ΟΧΙ"))
-        {
+    }
+    return false;
+}
 
-            result.type = VAL_BOOL;
-            bool operand_bool = to_bool(&operand);
-            result.value.bool_val = !operand_bool;
-            result.value.bool_val = !to_bool(&operand);
-        }
+// Degree of an index expression in the loop variable: 0 if loop invariant,
+// 1 if affine, -1 if neither (or not an integer expression we can bound)
+static int bce_degree(ASTNode *loop, ASTNode *expr)
+{
+    switch (expr->type)
+    {
+    case AST_LITERAL:
+        return expr->literal.value.type == VAL_INT ? 0 : -1;
 
-        free_runtime_value(&operand);
-        return result;
-    }
+    case AST_IDENTIFIER:
+        if (str_equals_ignore_case(expr->identifier.name, loop->for_loop.variable))
+            return 1;
+        return bce_block_assigns(loop->for_loop.body, loop->for_loop.num_stmts, expr->identifier.name) ? -1 : 0;
 
-    case AST_ARRAY_ACCESS:
+    case AST_UNARY_OP:
+        return strcmp(expr->unary.operator, "-") == 0 ? bce_degree(loop, expr->unary.operand) : -1;
+
+    case AST_BINARY_OP:
     {
-        RuntimeValue *arr_val = env_get(env, expr->array_access.name);
-        int indices[MAX_ARRAY_DIMS];
-        for (int i = 0; i < expr->array_access.num_indices; i++)
-        {
-            RuntimeValue idx = evaluate(expr->array_access.indices[i], env);
-            indices[i] = to_int(&idx);
-            free_runtime_value(&idx);
-        }
-        // ΠΡΟΣΟΧΗ: Παίρνουμε την τιμή από τον πίνακα και επιστρέφουμε ΑΝΤΙΓΡΑΦΟ
-        RuntimeValue val_in_array = array_get(arr_val->value.arr_val, indices, expr->array_access.num_indices);
-        return copy_runtime_value(&val_in_array);
+        const char *op = expr->binary.operator;
+        if (strcmp(op, "+") != 0 && strcmp(op, "-") != 0 && strcmp(op, "*") != 0)
+            return -1;
+
+        int left = bce_degree(loop, expr->binary.left);
+        int right = bce_degree(loop, expr->binary.right);
+        if (left < 0 || right < 0)
+            return -1;
+        if (op[0] == '*')
+            return left + right <= 1 ? left + right : -1;
+        return left > right ? left : right;
     }
 
-    case AST_CALL:
+    default:
+        return -1;
+    }
+}
+
+static void bce_access_parts(ASTNode *node, const char **name, ASTNode ***indices, int *num_indices)
+{
+    if (node->type == AST_ASSIGN)
+    {
+        *name = node->assign.identifier;
+        *indices = node->assign.indices;
+        *num_indices = node->assign.num_indices;
+    }
+    else
     {
+        *name = node->array_access.name;
+        *indices = node->array_access.indices;
+        *num_indices = node->array_access.num_indices;
+    }
+}
 
-        ASTNode *function = env_get_subroutine(env, expr->call.name);
+static bool bce_same_expr(ASTNode *a, ASTNode *b)
+{
+    if (a->type != b->type)
+        return false;
 
-        if (!function || function->type != AST_FUNC_DECL)
-        {
-            fprintf(stderr, "Runtime Error: %s is not a function\n", expr->call.name);
-            exit(1);
-        }
+    switch (a->type)
+    {
+    case AST_LITERAL:
+        return a->literal.value.type == VAL_INT && b->literal.value.type == VAL_INT &&
+               a->literal.value.value.int_val == b->literal.value.value.int_val;
+    case AST_IDENTIFIER:
+        return str_equals_ignore_case(a->identifier.name, b->identifier.name);
+    case AST_UNARY_OP:
+        return strcmp(a->unary.operator, b->unary.operator) == 0 &&
+               bce_same_expr(a->unary.operand, b->unary.operand);
+    case AST_BINARY_OP:
+        return strcmp(a->binary.operator, b->binary.operator) == 0 &&
+               bce_same_expr(a->binary.left, b->binary.left) &&
+               bce_same_expr(a->binary.right, b->binary.right);
+    default:
+        return false;
+    }
+}
 
-        // Create environment with parent for global access
-        Environment *func_env = create_environment(env);
+static void bce_add_access(BcePlan *plan, ASTNode *loop, ASTNode *node)
+{
+    const char *name;
+    ASTNode **indices;
+    int num_indices;
+    bce_access_parts(node, &name, &indices, &num_indices);
 
-        // Initialize local variables
-        if (function->subroutine.local_decls)
-        {
-            for (int i = 0; i < function->subroutine.num_local_decls; i++)
-            {
-                ASTNode *decl = function->subroutine.local_decls[i];
-                RuntimeValue val;
-                val.type = VAL_INT;
-                val.value.int_val = 0;
-                env_define(func_env, decl->decl.name, val);
-            }
-        }
+    if (num_indices == 0 || bce_block_assigns(loop->for_loop.body, loop->for_loop.num_stmts, name))
+        return;
+    for (int i = 0; i < num_indices; i++)
+    {
+        if (bce_degree(loop, indices[i]) < 0)
+            return;
+    }
 
-        // Bind parameters
-        for (int i = 0; i < function->subroutine.num_params && i < expr->call.num_args; i++)
-        {
-            ASTNode *param = function->subroutine.parameters[i];
-            ASTNode *arg = expr->call.arguments[i];
+    int same_as = -1;
+    for (int i = 0; i < plan->count && same_as < 0; i++)
+    {
+        const char *other_name;
+        ASTNode **other_indices;
+        int other_num;
+        bce_access_parts(plan->accesses[i].node, &other_name, &other_indices, &other_num);
+        if (other_num != num_indices || !str_equals_ignore_case(other_name, name))
+            continue;
 
-            // Handle array parameters
-            if (arg->type == AST_IDENTIFIER)
-            {
-                RuntimeValue *potential_array = env_get(env, arg->identifier.name);
-                if (potential_array && potential_array->type == VAL_ARRAY)
-                { // <-- ΑΦΑΙΡΕΣΗ του && param->param.is_reference
-                    RuntimeValue array_ref;
-                    array_ref.type = VAL_ARRAY;
-                    array_ref.value.arr_val = potential_array->value.arr_val;
-                    env_define(func_env, param->param.name, array_ref);
-                    continue;
-                }
-            }
+        int k = 0;
+        while (k < num_indices && bce_same_expr(indices[k], other_indices[k]))
+            k++;
+        if (k == num_indices)
+            same_as = plan->accesses[i].same_as >= 0 ? plan->accesses[i].same_as : i;
+    }
 
-            RuntimeValue arg_val = evaluate(arg, env);
-            env_define(func_env, param->param.name, arg_val);
-            free_runtime_value(&arg_val);
-        }
+    if (plan->count == plan->capacity)
+    {
+        plan->capacity = plan->capacity ? plan->capacity * 2 : 8;
+        plan->accesses = realloc(plan->accesses, plan->capacity * sizeof(BceAccess));
+    }
+    plan->accesses[plan->count].node = node;
+    plan->accesses[plan->count].same_as = same_as;
+    plan->accesses[plan->count].proven = false;
+    plan->count++;
+}
 
-        // Initialize return variable
-        RuntimeValue ret_val;
-        ret_val.type = VAL_REAL;
-        ret_val.value.real_val = 0.0;
-        env_define(func_env, function->subroutine.name, ret_val);
+static void bce_collect_expr(BcePlan *plan, ASTNode *loop, ASTNode *expr)
+{
+    if (!expr)
+        return;
 
-        // Execute function body
-        for (int i = 0; i < function->subroutine.num_stmts; i++)
+    switch (expr->type)
+    {
+    case AST_BINARY_OP:
+        bce_collect_expr(plan, loop, expr->binary.left);
+        bce_collect_expr(plan, loop, expr->binary.right);
+        break;
+    case AST_UNARY_OP:
+        bce_collect_expr(plan, loop, expr->unary.operand);
+        break;
+    case AST_ARRAY_ACCESS:
+        for (int i = 0; i < expr->array_access.num_indices; i++)
+            bce_collect_expr(plan, loop, expr->array_access.indices[i]);
+        bce_add_access(plan, loop, expr);
+        break;
+    default:
+        break;
+    }
+}
+
+static void bce_collect_block(BcePlan *plan, ASTNode *loop, ASTNode **stmts, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        ASTNode *stmt = stmts[i];
+        switch (stmt->type)
         {
-            execute_statement(function->subroutine.body[i], func_env);
+        case AST_ASSIGN:
+            bce_collect_expr(plan, loop, stmt->assign.value);
+            for (int j = 0; j < stmt->assign.num_indices; j++)
+                bce_collect_expr(plan, loop, stmt->assign.indices[j]);
+            if (stmt->assign.num_indices > 0)
+                bce_add_access(plan, loop, stmt);
+            break;
+        case AST_PRINT:
+            for (int j = 0; j < stmt->print.num_exprs; j++)
+                bce_collect_expr(plan, loop, stmt->print.expressions[j]);
+            break;
+        case AST_READ:
+            for (int j = 0; j < stmt->read.num_vars; j++)
+                bce_collect_expr(plan, loop, stmt->read.variables[j]);
+            break;
+        case AST_IF:
+            bce_collect_expr(plan, loop, stmt->if_stmt.condition);
+            bce_collect_block(plan, loop, stmt->if_stmt.then_branch, stmt->if_stmt.num_then);
+            bce_collect_block(plan, loop, stmt->if_stmt.else_branch, stmt->if_stmt.num_else);
+            break;
+        case AST_FOR:
+            bce_collect_expr(plan, loop, stmt->for_loop.start);
+            bce_collect_expr(plan, loop, stmt->for_loop.end);
+            bce_collect_expr(plan, loop, stmt->for_loop.step);
+            bce_collect_block(plan, loop, stmt->for_loop.body, stmt->for_loop.num_stmts);
+            break;
+        case AST_WHILE:
+            bce_collect_expr(plan, loop, stmt->while_loop.condition);
+            bce_collect_block(plan, loop, stmt->while_loop.body, stmt->while_loop.num_stmts);
+            break;
+        default:
+            break;
         }
+    }
+}
 
-        // Copy back reference parameters
-        for (int i = 0; i < function->subroutine.num_params && i < expr->call.num_args; i++)
+// Accesses of a FOR loop whose bounds can be proven on entry (cached)
+static BcePlan *bce_plan(ASTNode *loop)
+{
+    if (!loop->for_loop.bce)
+    {
+        BcePlan *plan = calloc(1, sizeof(BcePlan));
+        if (!bce_block_has_call(loop->for_loop.body, loop->for_loop.num_stmts) &&
+            !bce_block_assigns(loop->for_loop.body, loop->for_loop.num_stmts, loop->for_loop.variable))
         {
-            ASTNode *param = function->subroutine.parameters[i];
-            ASTNode *arg = expr->call.arguments[i];
-
-            if (param->param.is_reference)
-            {
-                RuntimeValue *func_val = env_get(func_env, param->param.name);
-
-                if (func_val->type == VAL_ARRAY)
-                    continue;
-
-                if (arg->type == AST_IDENTIFIER)
-                {
-                    env_assign(env, arg->identifier.name, *func_val);
-                }
-            }
+            bce_collect_block(plan, loop, loop->for_loop.body, loop->for_loop.num_stmts);
         }
-
-        // Get return value
-        RuntimeValue *return_val = env_get(func_env, function->subroutine.name);
-        RuntimeValue fn_result = copy_runtime_value(return_val);
-
-        return fn_result;
+        loop->for_loop.bce = plan;
     }
+    return loop->for_loop.bce;
+}
 
-    default:
-        result.type = VAL_INT;
-        result.value.int_val = 0;
-        return result;
-    }
+// Last value of the loop variable; false if the body never runs or the
+// loop does not terminate
+static bool bce_last_iteration(long long start, long long end, long long step, long long *last)
+{
+    if (step == 0 || (step > 0 ? start > end : start < end))
+        return false;
+    *last = start + (end - start) / step * step;
+    return true;
 }
 
-static void execute_statement(ASTNode *stmt, Environment *env)
+// Evaluates an index with the loop variable set to var_value. Fails instead
+// of raising errors, leaving the access checked
+static bool bce_eval(ASTNode *expr, Environment *env, const char *var, long long var_value, long long *out)
 {
-    switch (stmt->type)
+    switch (expr->type)
     {
+    case AST_LITERAL:
+        *out = expr->literal.value.value.int_val;
+        return true;
 
-    case AST_ASSIGN:
+    case AST_IDENTIFIER:
     {
-        RuntimeValue val = evaluate(stmt->assign.value, env);
+        if (str_equals_ignore_case(expr->identifier.name, var))
+        {
+            *out = var_value;
+            return true;
+        }
+        RuntimeValue *val = env_lookup(env, expr->identifier.name);
+        if (!val || val->type != VAL_INT)
+            return false;
+        *out = val->value.int_val;
+        return true;
+    }
 
-        if (stmt->assign.num_indices > 0)
+    case AST_UNARY_OP:
+        if (!bce_eval(expr->unary.operand, env, var, var_value, out))
+            return false;
+        *out = -*out;
+        return true;
+
+    case AST_BINARY_OP:
+    {
+        long long left, right;
+        if (!bce_eval(expr->binary.left, env, var, var_value, &left) ||
+            !bce_eval(expr->binary.right, env, var, var_value, &right))
+            return false;
+
+        char op = expr->binary.operator[0];
+        if (op == '*')
         {
-            // Ανάθεση σε πίνακα: A[indices] := value
-            RuntimeValue *arr_runtime = env_get(env, stmt->assign.identifier);
-            if (arr_runtime && arr_runtime->type == VAL_ARRAY)
-            {
-                int indices[MAX_ARRAY_DIMS];
-                for (int i = 0; i < stmt->assign.num_indices; i++)
-                {
-                    RuntimeValue idx_val = evaluate(stmt->assign.indices[i], env);
-                    indices[i] = to_int(&idx_val);
-                    free_runtime_value(&idx_val);
-                }
-                // Κλήση της συνάρτησης που φτιάξαμε
-                array_set(arr_runtime->value.arr_val, indices, stmt->assign.num_indices, val);
-            }
+            if (left != 0 && llabs(right) > BCE_LIMIT / llabs(left))
+                return false;
+            *out = left * right;
         }
         else
         {
-            // Απλή μεταβλητή
-            env_assign(env, stmt->assign.identifier, val);
+            *out = op == '+' ? left + right : left - right;
         }
-        free_runtime_value(&val);
-        break;
+        return llabs(*out) <= BCE_LIMIT;
     }
 
-    case AST_PRINT:
-    {
-        for (int i = 0; i < stmt->print.num_exprs; i++)
-        {
-            RuntimeValue val = evaluate(stmt->print.expressions[i], env);
+    default:
+        return false;
+    }
+}
 
-            // Check for EOLN
-            if (val.type == VAL_STRING && strcmp(val.value.str_val, "__EOLN__") == 0)
-            {
-                printf("\n");
-            }
-            else
-            {
-                if (i > 0)
-                    printf(" ");
+static bool bce_prove(ASTNode *node, ASTNode *loop, long long first, long long last, Environment *env)
+{
+    const char *name;
+    ASTNode **indices;
+    int num_indices;
+    bce_access_parts(node, &name, &indices, &num_indices);
 
-                switch (val.type)
-                {
-                case VAL_INT:
-                    printf("%d", val.value.int_val);
-                    break;
-                case VAL_REAL:
-                    printf("%g", val.value.real_val);
-                    break;
-                case VAL_BOOL:
-                    printf("%s", val.value.bool_val ? "TRUE" : "FALSE");
-                    break;
-                case VAL_STRING:
-                    printf("%s", val.value.str_val);
-                    break;
-                default:
-                    break;
-                }
-            }
+    RuntimeValue *arr = env_lookup(env, name);
+    if (!arr || arr->type != VAL_ARRAY || arr->value.arr_val->num_dims != num_indices)
+        return false;
 
-            free_runtime_value(&val);
-        }
-        break;
+    for (int i = 0; i < num_indices; i++)
+    {
+        ArrayBound *bound = &arr->value.arr_val->bounds[i];
+        long long lo, hi;
+        if (!bce_eval(indices[i], env, loop->for_loop.variable, first, &lo) ||
+            !bce_eval(indices[i], env, loop->for_loop.variable, last, &hi))
+            return false;
+        if (lo < bound->from || lo > bound->to || hi < bound->from || hi > bound->to)
+            return false;
     }
+    return true;
+}
 
-    case AST_READ:
+// Called by the interpreter once the loop bounds are known: marks every
+// read it can prove as unchecked until bce_leave (assignments are checked
+// anyway, so proofs of assignments only serve reads of the same element)
+static void bce_enter(BcePlan *plan, ASTNode *loop, int start, int end, int step, Environment *env)
+{
+    long long last = start;
+    bool runs = bce_last_iteration(start, end, step, &last);
+
+    for (int i = 0; i < plan->count; i++)
     {
-        for (int i = 0; i < stmt->read.num_vars; i++)
-        {
-            ASTNode *var = stmt->read.variables[i];
-            char input[256];
+        BceAccess *access = &plan->accesses[i];
+        if (!runs)
+            access->proven = false;
+        else if (access->same_as >= 0)
+            access->proven = plan->accesses[access->same_as].proven;
+        else
+            access->proven = bce_prove(access->node, loop, start, last, env);
 
-            fflush(stdout);
+        if (access->proven && access->node->type == AST_ARRAY_ACCESS)
+            access->node->array_access.unchecked++;
+    }
+}
 
-            if (fgets(input, sizeof(input), stdin) == NULL)
-            {
-                // EOF handling
-                break;
-            }
+static void bce_leave(BcePlan *plan)
+{
+    for (int i = 0; i < plan->count; i++)
+    {
+        if (plan->accesses[i].proven && plan->accesses[i].node->type == AST_ARRAY_ACCESS)
+            plan->accesses[i].node->array_access.unchecked--;
+    }
+}
 
-            input[strcspn(input, "\n")] = 0;
+// ============================================================================
+// PROFILER
+// ============================================================================
+// --profile counts every statement execution per source line and measures
+// its self time (time not spent in nested statements) with the CPU's cycle
+// counter where there is one. Subroutines get their call count, inclusive
+// time and the self time of their statements. The report is written at exit,
+// so programs stopped by a runtime error are profiled too.
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PROFILE_TICK_NAME "cycles"
+static inline uint64_t profile_clock(void)
+{
+    return __rdtsc();
+}
+#elif defined(_WIN32)
+#define PROFILE_TICK_NAME "ticks"
+static inline uint64_t profile_clock(void)
+{
+    return (uint64_t)clock();
+}
+#else
+#define PROFILE_TICK_NAME "ns"
+static inline uint64_t profile_clock(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+#endif
 
-            // Δημιουργία RuntimeValue από το input
-            RuntimeValue val;
-            memset(&val, 0, sizeof(RuntimeValue));
+#define PROFILE_TOP_LINES 20
 
-            if (strlen(input) == 0)
-            {
-                val.type = VAL_INT;
-                val.value.int_val = -1;
-            }
-            else if (strchr(input, '.'))
-            {
-                val.type = VAL_REAL;
-                val.value.real_val = atof(input);
-            }
-            else if (isdigit(input[0]) || input[0] == '-')
-            {
-                val.type = VAL_INT;
-                val.value.int_val = atoi(input);
-            }
-            else
-            {
-                val.type = VAL_STRING;
-                val.value.str_val = strdup(input);
-            }
+// Hardware counters of --perf-counters, attributed like the self time
+enum
+{
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_CACHE_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_NUM_COUNTERS
+};
 
-            // ΝΕΟ: Χειρισμός array access
-            if (var->type == AST_ARRAY_ACCESS)
-            {
-                // Βρες τον πίνακα
-                RuntimeValue *arr_val = env_get(env, var->array_access.name);
+static const char *perf_counter_names[PERF_NUM_COUNTERS] = {"cycles", "instructions", "cache-misses",
+                                                            "branch-misses"};
 
-                if (arr_val && arr_val->type == VAL_ARRAY)
-                {
-                    // Υπολόγισε τους δείκτες
-                    int indices[MAX_ARRAY_DIMS];
-                    for (int j = 0; j < var->array_access.num_indices; j++)
-                    {
-                        RuntimeValue idx = evaluate(var->array_access.indices[j], env);
-                        indices[j] = to_int(&idx);
-                        free_runtime_value(&idx);
-                    }
+typedef struct
+{
+    uint64_t count;
+    uint64_t self; // Ticks
+    uint64_t events[PERF_NUM_COUNTERS];
+} ProfileLine;
 
-                    // ΚΡΙΣΙΜΟ: Αποθήκευσε την τιμή στον πίνακα
-                    array_set(arr_val->value.arr_val, indices, var->array_access.num_indices, val);
+typedef struct
+{
+    ASTNode *subroutine; // NULL for the main program
+    uint64_t calls;
+    uint64_t total; // Inclusive ticks, outermost activations only
+    uint64_t self;  // Self ticks of the statements in its body
+    uint64_t events[PERF_NUM_COUNTERS];
+    int active; // Activations on the call stack
+} ProfileSubroutine;
 
-                    debug_log("READ: Set %s[%d] = %d", var->array_access.name, indices[0],
-                              val.type == VAL_INT ? val.value.int_val : 0);
-                }
-            }
-            else if (var->type == AST_IDENTIFIER)
-            {
-                // Απλή μεταβλητή
-                env_assign(env, var->identifier.name, val);
-            }
+typedef struct
+{
+    uint64_t start;
+    uint64_t saved_children;
+    int saved_current;
+    uint64_t events_start[PERF_NUM_COUNTERS];
+    uint64_t saved_event_children[PERF_NUM_COUNTERS];
+} ProfileFrame;
+
+static bool profile_enabled = false;
+static const char *profile_path = NULL;
+static char *profile_source = NULL; // Source text for the listing, may be NULL
+static const char *profile_program_name = NULL;
+static ProfileLine *profile_lines = NULL;
+static int profile_line_capacity = 0;
+static ProfileSubroutine *profile_subs = NULL;
+static int profile_num_subs = 0;
+static int profile_current = 0;       // Index into profile_subs
+static uint64_t profile_children = 0; // Ticks of finished frames nested in the open one
+static uint64_t profile_start_ticks = 0;
+static double profile_start_seconds = 0;
+
+static bool perf_enabled = false; // --perf-counters given
+static bool perf_active = false;  // Counters are open and counting
+static int perf_fd = -1;          // Group leader, read once for all counters
+static int perf_slot[PERF_NUM_COUNTERS]; // Position in a group read, -1 if unsupported
+static uint64_t profile_event_children[PERF_NUM_COUNTERS];
+
+static void perf_read(uint64_t *values)
+{
+    memset(values, 0, PERF_NUM_COUNTERS * sizeof(uint64_t));
+#ifdef __linux__
+    uint64_t buffer[1 + PERF_NUM_COUNTERS]; // Number of counters, then their values
+    if (read(perf_fd, buffer, sizeof(buffer)) < (ssize_t)sizeof(uint64_t))
+        return;
+    for (int i = 0; i < PERF_NUM_COUNTERS; i++)
+    {
+        if (perf_slot[i] >= 0 && (uint64_t)perf_slot[i] < buffer[0])
+            values[i] = buffer[1 + perf_slot[i]];
+    }
+#endif
+}
 
-            if (val.type == VAL_STRING)
-            {
-                free_runtime_value(&val);
-            }
+// Opens the counters for this thread (user space only, which the default
+// perf_event_paranoid setting allows). Counters the CPU or kernel refuses are
+// left out; without any, the profile only has times.
+static void perf_init(void)
+{
+#ifdef __linux__
+    static const uint64_t configs[PERF_NUM_COUNTERS] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                        PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+    const char *reason = NULL;
+    int group_size = 0;
+
+    for (int i = 0; i < PERF_NUM_COUNTERS; i++)
+    {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = configs[i];
+        attr.disabled = perf_fd < 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+
+        int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, perf_fd, 0);
+        if (fd < 0)
+        {
+            perf_slot[i] = -1;
+            if (!reason)
+                reason = strerror(errno);
+            continue;
         }
-        break;
+        if (perf_fd < 0)
+            perf_fd = fd;
+        perf_slot[i] = group_size++;
     }
 
-    case AST_IF:
+    if (perf_fd < 0)
     {
-        RuntimeValue cond = evaluate(stmt->if_stmt.condition, env);
+        fprintf(stderr, "Warning: Hardware counters are not available (%s), profiling time only. "
+                        "See /proc/sys/kernel/perf_event_paranoid\n",
+                reason);
+        return;
+    }
+    for (int i = 0; i < PERF_NUM_COUNTERS; i++)
+    {
+        if (perf_slot[i] < 0)
+            fprintf(stderr, "Warning: Hardware counter %s is not available\n", perf_counter_names[i]);
+    }
 
-        if (to_bool(&cond))
-        {
-            for (int i = 0; i < stmt->if_stmt.num_then; i++)
-            {
-                execute_statement(stmt->if_stmt.then_branch[i], env);
-            }
-        }
-        else if (stmt->if_stmt.else_branch)
-        {
-            for (int i = 0; i < stmt->if_stmt.num_else; i++)
-            {
-                execute_statement(stmt->if_stmt.else_branch[i], env);
-            }
-        }
+    ioctl(perf_fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(perf_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    perf_active = true;
+#else
+    fprintf(stderr, "Warning: --perf-counters is only available on Linux, profiling time only\n");
+#endif
+}
 
-        free_runtime_value(&cond);
-        break;
+static double profile_wall_seconds(void)
+{
+#ifdef _WIN32
+    return (double)clock() / CLOCKS_PER_SEC;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+}
+
+static ProfileLine *profile_line(int line)
+{
+    if (line >= profile_line_capacity)
+    {
+        int capacity = profile_line_capacity * 2 > line ? profile_line_capacity * 2 : line + 1;
+        profile_lines = realloc(profile_lines, capacity * sizeof(ProfileLine));
+        memset(profile_lines + profile_line_capacity, 0, (capacity - profile_line_capacity) * sizeof(ProfileLine));
+        profile_line_capacity = capacity;
     }
+    return &profile_lines[line];
+}
 
-    case AST_FOR:
+static inline void profile_begin(ProfileFrame *frame)
+{
+    if (perf_active)
     {
-        fflush(stdout);
+        memcpy(frame->saved_event_children, profile_event_children, sizeof(profile_event_children));
+        memset(profile_event_children, 0, sizeof(profile_event_children));
+        perf_read(frame->events_start);
+    }
+    frame->saved_children = profile_children;
+    profile_children = 0;
+    frame->start = profile_clock();
+}
 
-        RuntimeValue start_val = evaluate(stmt->for_loop.start, env);
-        RuntimeValue end_val = evaluate(stmt->for_loop.end, env);
-        RuntimeValue step_val = evaluate(stmt->for_loop.step, env);
+static void profile_end_events(ProfileFrame *frame, ProfileLine *entry)
+{
+    uint64_t now[PERF_NUM_COUNTERS];
+    perf_read(now);
+    for (int i = 0; i < PERF_NUM_COUNTERS; i++)
+    {
+        uint64_t elapsed = now[i] - frame->events_start[i];
+        uint64_t self = elapsed > profile_event_children[i] ? elapsed - profile_event_children[i] : 0;
+        entry->events[i] += self;
+        profile_subs[profile_current].events[i] += self;
+        profile_event_children[i] = frame->saved_event_children[i] + elapsed;
+    }
+}
 
-        int start = to_int(&start_val);
-        int end = to_int(&end_val);
-        int step = to_int(&step_val);
+static inline void profile_end_statement(ProfileFrame *frame, int line)
+{
+    uint64_t elapsed = profile_clock() - frame->start;
+    uint64_t self = elapsed > profile_children ? elapsed - profile_children : 0;
+    ProfileLine *entry = line < profile_line_capacity ? &profile_lines[line] : profile_line(line);
+
+    entry->count++;
+    entry->self += self;
+    profile_subs[profile_current].self += self;
+    profile_children = frame->saved_children + elapsed;
+    if (perf_active)
+        profile_end_events(frame, entry);
+}
 
-        fflush(stdout);
+// Subroutine frames do not hide the time of their statements from the
+// calling statement: only statements have self time
+static void profile_enter_subroutine(ASTNode *sub, ProfileFrame *frame)
+{
+    int index = 1;
+    while (index < profile_num_subs && profile_subs[index].subroutine != sub)
+        index++;
+    if (index == profile_num_subs)
+    {
+        profile_subs = realloc(profile_subs, (profile_num_subs + 1) * sizeof(ProfileSubroutine));
+        memset(&profile_subs[profile_num_subs++], 0, sizeof(ProfileSubroutine));
+        profile_subs[index].subroutine = sub;
+    }
 
-        if (start_val.type != VAL_ARRAY)
-            free_runtime_value(&start_val);
-        if (end_val.type != VAL_ARRAY)
-            free_runtime_value(&end_val);
-        if (step_val.type != VAL_ARRAY)
-            free_runtime_value(&step_val);
+    profile_subs[index].calls++;
+    profile_subs[index].active++;
+    frame->saved_current = profile_current;
+    profile_current = index;
+    frame->start = profile_clock();
+}
 
-        fflush(stdout);
+static void profile_leave_subroutine(ProfileFrame *frame)
+{
+    ProfileSubroutine *entry = &profile_subs[profile_current];
+    if (--entry->active == 0)
+        entry->total += profile_clock() - frame->start;
+    profile_current = frame->saved_current;
+}
 
-        int current = start;
+static void profile_init(ASTNode *prog, const char *source, const char *path)
+{
+    // Copied: the report is written after main has freed the source
+    profile_source = source ? strdup(source) : NULL;
+    profile_path = path;
+    profile_program_name = prog->program.name;
 
-        if (step > 0)
-        {
-            while (current <= end)
-            {
-                fflush(stdout);
+    // One counter per source line, so the hot path is a single index
+    int lines = 1;
+    for (const char *p = source; p && *p; p++)
+    {
+        if (*p == '\n')
+            lines++;
+    }
+    profile_line(lines + 1);
 
-                RuntimeValue loop_var;
-                loop_var.type = VAL_INT;
-                loop_var.value.int_val = current;
+    profile_subs = calloc(1 + prog->program.num_decls, sizeof(ProfileSubroutine));
+    profile_num_subs = 1;
+    for (int i = 0; i < prog->program.num_decls; i++)
+    {
+        ASTNode *decl = prog->program.declarations[i];
+        if (decl->type == AST_FUNC_DECL || decl->type == AST_PROC_DECL)
+            profile_subs[profile_num_subs++].subroutine = decl;
+    }
 
-                fflush(stdout);
+    if (perf_enabled)
+        perf_init();
 
-                env_assign(env, stmt->for_loop.variable, loop_var);
+    profile_start_seconds = profile_wall_seconds();
+    profile_start_ticks = profile_clock();
+}
 
-                fflush(stdout);
+// Start of source line `line` (1-based) and its length without indentation
+static const char *profile_source_line(int line, int *len)
+{
+    const char *p = profile_source;
+    for (int i = 1; p && i < line; i++)
+    {
+        p = strchr(p, '\n');
+        if (p)
+            p++;
+    }
+    if (!p || !*p)
+    {
+        *len = 0;
+        return "";
+    }
+    while (*p == ' ' || *p == '\t')
+        p++;
+    *len = (int)strcspn(p, "\r\n");
+    return p;
+}
 
-                for (int i = 0; i < stmt->for_loop.num_stmts; i++)
-                {
-                    execute_statement(stmt->for_loop.body[i], env);
-                }
+static int profile_compare_lines(const void *a, const void *b)
+{
+    uint64_t sa = profile_lines[*(const int *)a].self;
+    uint64_t sb = profile_lines[*(const int *)b].self;
+    return sa < sb ? 1 : sa > sb ? -1 : *(const int *)a - *(const int *)b;
+}
 
-                fflush(stdout);
-                current += step;
-            }
-        }
-        else
-        {
-            while (current >= end)
-            {
-                RuntimeValue loop_var;
-                loop_var.type = VAL_INT;
-                loop_var.value.int_val = current;
-                env_assign(env, stmt->for_loop.variable, loop_var);
+static int perf_sort_counter = PERF_CACHE_MISSES;
 
-                for (int i = 0; i < stmt->for_loop.num_stmts; i++)
-                {
-                    execute_statement(stmt->for_loop.body[i], env);
-                }
+static int profile_compare_line_events(const void *a, const void *b)
+{
+    uint64_t ea = profile_lines[*(const int *)a].events[perf_sort_counter];
+    uint64_t eb = profile_lines[*(const int *)b].events[perf_sort_counter];
+    return ea < eb ? 1 : ea > eb ? -1 : *(const int *)a - *(const int *)b;
+}
 
-                current += step;
-            }
-        }
+static int profile_compare_subs(const void *a, const void *b)
+{
+    uint64_t sa = ((const ProfileSubroutine *)a)->self;
+    uint64_t sb = ((const ProfileSubroutine *)b)->self;
+    return sa < sb ? 1 : sa > sb ? -1 : 0;
+}
 
-        fflush(stdout);
-        break;
-    }
+// Cuts a source line to at most max bytes without splitting a UTF-8 character
+static int profile_clip(const char *text, int len, int max)
+{
+    if (len <= max)
+        return len;
+    while (max > 0 && ((unsigned char)text[max] & 0xC0) == 0x80)
+        max--;
+    return max;
+}
 
-    case AST_WHILE:
+static void profile_print_events(FILE *out, uint64_t *events)
+{
+    for (int i = 0; i < PERF_NUM_COUNTERS; i++)
     {
-        if (stmt->while_loop.is_repeat_until)
-        {
-            // REPEAT-UNTIL: Execute body FIRST, then check to STOP when TRUE
-            do
-            {
-                for (int i = 0; i < stmt->while_loop.num_stmts; i++)
-                {
-                    execute_statement(stmt->while_loop.body[i], env);
-                }
+        if (perf_slot[i] >= 0)
+            fprintf(out, " %14llu", (unsigned long long)events[i]);
+        else
+            fprintf(out, " %14s", "-");
+    }
+    if (perf_slot[PERF_CYCLES] >= 0 && perf_slot[PERF_INSTRUCTIONS] >= 0 && events[PERF_CYCLES])
+        fprintf(out, " %6.2f", (double)events[PERF_INSTRUCTIONS] / events[PERF_CYCLES]);
+    else
+        fprintf(out, " %6s", "-");
+}
 
-                RuntimeValue cond = evaluate(stmt->while_loop.condition, env);
-                bool should_stop = to_bool(&cond);
-                free_runtime_value(&cond);
+// Tables of --perf-counters, worst lines first by cache misses (or by the
+// first counter that is available)
+static void profile_report_events(FILE *out, int *order, int num_lines)
+{
+    perf_sort_counter = PERF_CACHE_MISSES;
+    for (int i = 0; perf_slot[perf_sort_counter] < 0 && i < PERF_NUM_COUNTERS; i++)
+        perf_sort_counter = i;
+    qsort(order, num_lines, sizeof(int), profile_compare_line_events);
+
+    fprintf(out, "\nHardware counters by line (self, sorted by %s)\n%6s", perf_counter_names[perf_sort_counter], "Line");
+    for (int i = 0; i < PERF_NUM_COUNTERS; i++)
+        fprintf(out, " %14s", perf_counter_names[i]);
+    fprintf(out, " %6s  %s\n", "IPC", "Source");
+    for (int i = 0; i < num_lines && i < PROFILE_TOP_LINES; i++)
+    {
+        int len;
+        const char *text = profile_source_line(order[i], &len);
+        fprintf(out, "%6d", order[i]);
+        profile_print_events(out, profile_lines[order[i]].events);
+        fprintf(out, "  %.*s\n", profile_clip(text, len, 60), text);
+    }
+
+    fprintf(out, "\nHardware counters by subroutine (self)\n%-24s", "Name");
+    for (int i = 0; i < PERF_NUM_COUNTERS; i++)
+        fprintf(out, " %14s", perf_counter_names[i]);
+    fprintf(out, " %6s\n", "IPC");
+    for (int i = 0; i < profile_num_subs; i++)
+    {
+        ProfileSubroutine *entry = &profile_subs[i];
+        if (entry->subroutine && entry->calls == 0)
+            continue;
+        fprintf(out, "%-24s", entry->subroutine ? entry->subroutine->subroutine.name : "(main program)");
+        profile_print_events(out, entry->events);
+        fprintf(out, "\n");
+    }
+}
 
-                if (should_stop)
-                    break; // Stop when UNTIL condition is TRUE
-            } while (true);
-        }
-        else
-        {
-            // WHILE: Check condition FIRST, continue while TRUE
-            while (true)
-            {
-                RuntimeValue cond = evaluate(stmt->while_loop.condition, env);
-                bool should_continue = to_bool(&cond);
-                free_runtime_value(&cond);
+static void profile_report(void)
+{
+    uint64_t total_ticks = profile_clock() - profile_start_ticks;
+    double seconds = profile_wall_seconds() - profile_start_seconds;
+    double ms_per_tick = total_ticks ? seconds * 1000.0 / total_ticks : 0;
 
-                if (!should_continue)
-                    break; // Stop when WHILE condition is FALSE
+    FILE *out = fopen(profile_path, "w");
+    if (!out)
+    {
+        fprintf(stderr, "Warning: Cannot write profile to %s: %s\n", profile_path, strerror(errno));
+        return;
+    }
 
-                for (int i = 0; i < stmt->while_loop.num_stmts; i++)
-                {
-                    execute_statement(stmt->while_loop.body[i], env);
-                }
-            }
-        }
-        break;
+    uint64_t statements = 0, self_total = 0;
+    int *order = malloc(profile_line_capacity * sizeof(int));
+    int num_lines = 0;
+    for (int i = 0; i < profile_line_capacity; i++)
+    {
+        statements += profile_lines[i].count;
+        self_total += profile_lines[i].self;
+        if (profile_lines[i].count)
+            order[num_lines++] = i;
     }
+    qsort(order, num_lines, sizeof(int), profile_compare_lines);
+    double denominator = self_total ? (double)self_total : 1.0;
 
-    case AST_CALL:
+    fprintf(out, "EAP profile of %s\n", profile_program_name);
+    fprintf(out, "Run time: %.3f ms, %llu %s, %llu statements executed\n\n",
+            seconds * 1000.0, (unsigned long long)total_ticks, PROFILE_TICK_NAME,
+            (unsigned long long)statements);
+
+    fprintf(out, "Hot spots (self time)\n");
+    fprintf(out, "%6s %12s %16s %10s %7s  %s\n", "Line", "Count", PROFILE_TICK_NAME, "ms", "%", "Source");
+    for (int i = 0; i < num_lines && i < PROFILE_TOP_LINES; i++)
     {
+        ProfileLine *entry = &profile_lines[order[i]];
+        int len;
+        const char *text = profile_source_line(order[i], &len);
+        fprintf(out, "%6d %12llu %16llu %10.3f %6.1f%%  %.*s\n", order[i],
+                (unsigned long long)entry->count, (unsigned long long)entry->self,
+                entry->self * ms_per_tick, 100.0 * entry->self / denominator,
+                profile_clip(text, len, 60), text);
+    }
 
-        ASTNode *subroutine = env_get_subroutine(env, stmt->call.name);
+    qsort(profile_subs, profile_num_subs, sizeof(ProfileSubroutine), profile_compare_subs);
+    fprintf(out, "\nSubroutines\n");
+    fprintf(out, "%-24s %10s %12s %12s %7s\n", "Name", "Calls", "Total ms", "Self ms", "Self %");
+    for (int i = 0; i < profile_num_subs; i++)
+    {
+        ProfileSubroutine *entry = &profile_subs[i];
+        if (entry->subroutine && entry->calls == 0)
+            continue;
+        // The main program is active for the whole run
+        uint64_t total = entry->subroutine ? entry->total : total_ticks;
+        fprintf(out, "%-24s %10llu %12.3f %12.3f %6.1f%%\n",
+                entry->subroutine ? entry->subroutine->subroutine.name : "(main program)",
+                (unsigned long long)(entry->subroutine ? entry->calls : 1),
+                total * ms_per_tick, entry->self * ms_per_tick, 100.0 * entry->self / denominator);
+    }
 
-        if (!subroutine)
+    if (perf_active)
+        profile_report_events(out, order, num_lines);
+
+    if (profile_source)
+    {
+        fprintf(out, "\nAnnotated source (count, self ms)\n");
+        const char *p = profile_source;
+        for (int line = 1; *p; line++)
         {
-            fprintf(stderr, "Runtime Error: Undefined subroutine: %s\n", stmt->call.name);
-            exit(1);
+            int len = (int)strcspn(p, "\r\n");
+            ProfileLine *entry = line < profile_line_capacity ? &profile_lines[line] : NULL;
+            if (entry && entry->count)
+                fprintf(out, "%12llu %10.3f %5d | %.*s\n", (unsigned long long)entry->count,
+                        entry->self * ms_per_tick, line, len, p);
+            else
+                fprintf(out, "%12s %10s %5d | %.*s\n", "", "", line, len, p);
+            p = strchr(p, '\n');
+            if (!p)
+                break;
+            p++;
         }
+    }
 
-        // Create new environment for subroutine
-        Environment *sub_env = create_environment(env);
+    free(order);
+    fclose(out);
+    fprintf(stderr, "Profile written to %s\n", profile_path);
+}
 
-        // Initialize local variables from DATA section
-        if (subroutine->subroutine.local_decls)
-        {
-            for (int i = 0; i < subroutine->subroutine.num_local_decls; i++)
-            {
-                ASTNode *decl = subroutine->subroutine.local_decls[i];
-                RuntimeValue val;
-                val.type = VAL_INT;
-                val.value.int_val = 0;
-                env_define(sub_env, decl->decl.name, val);
-            }
-        }
+// ============================================================================
+// SAMPLING PROFILER
+// ============================================================================
+// --sample keeps a shadow stack of the running subroutines and the line each
+// of them is executing. A SIGPROF timer copies that stack into a buffer
+// allocated up front, so the handler is async-signal-safe and the program
+// only pays for the shadow stack updates. At exit the samples are written in
+// the folded-stack format ("main:12;fib:5;fib:5 42") read by flame graph
+// tools such as flamegraph.pl, speedscope or inferno.
 
-        for (int i = 0; i < subroutine->subroutine.num_params && i < stmt->call.num_args; i++)
-        {
-            ASTNode *param = subroutine->subroutine.parameters[i];
-            ASTNode *arg = stmt->call.arguments[i];
+#define SAMPLE_MAX_DEPTH 4096
+#define SAMPLE_BUFFER_FRAMES (1 << 20)
 
-            // Special handling for arrays passed by reference
-            if (arg->type == AST_IDENTIFIER)
-            {
-                RuntimeValue *potential_array = env_get(env, arg->identifier.name);
-                if (potential_array && potential_array->type == VAL_ARRAY)
-                {
-                    // Pass the array reference directly (shallow copy for arrays)
-                    RuntimeValue array_ref;
-                    array_ref.type = VAL_ARRAY;
-                    array_ref.value.arr_val = potential_array->value.arr_val;
-                    env_define(sub_env, param->param.name, array_ref);
-                    continue;
-                }
-            }
+typedef struct
+{
+    ASTNode *subroutine; // NULL for the main program
+    int line;
+} SampleFrame;
 
-            // Regular parameter handling
-            if (param->param.is_reference)
-            {
-                // Pass by reference - evaluate and bind
-                RuntimeValue arg_val = evaluate(arg, env);
-                env_define(sub_env, param->param.name, arg_val);
-                // Don't free here - we need to copy back later
-            }
-            else
+static bool sample_enabled = false;
+static long sample_rate = 1000; // Samples per second of CPU time
+static const char *sample_path = NULL;
+static const char *sample_program_name = NULL;
+
+static volatile SampleFrame sample_stack[SAMPLE_MAX_DEPTH];
+static volatile int sample_depth = 0;
+static int sample_overflow = 0; // Calls deeper than SAMPLE_MAX_DEPTH
+
+// Each sample is a header frame (subroutine NULL, line = depth) followed by
+// its frames from the outermost in
+static SampleFrame *sample_buffer = NULL;
+static volatile int sample_used = 0;
+static volatile int sample_count = 0;
+static volatile int sample_dropped = 0;
+
+static inline void sample_line(int line)
+{
+    sample_stack[sample_depth - 1].line = line;
+}
+
+static inline void sample_push(ASTNode *sub)
+{
+    if (sample_depth == SAMPLE_MAX_DEPTH)
+    {
+        sample_overflow++;
+        return;
+    }
+    // Fill the frame before publishing it to the signal handler
+    sample_stack[sample_depth].subroutine = sub;
+    sample_stack[sample_depth].line = sub->line;
+    sample_depth = sample_depth + 1;
+}
+
+static inline void sample_pop(void)
+{
+    if (sample_overflow > 0)
+        sample_overflow--;
+    else
+        sample_depth = sample_depth - 1;
+}
+
+#ifndef _WIN32
+static void sample_signal(int sig)
+{
+    (void)sig;
+    int depth = sample_depth;
+    if (sample_used + depth + 1 > SAMPLE_BUFFER_FRAMES)
+    {
+        sample_dropped = sample_dropped + 1;
+        return;
+    }
+
+    SampleFrame *record = &sample_buffer[sample_used];
+    record->subroutine = NULL;
+    record->line = depth;
+    for (int i = 0; i < depth; i++)
+    {
+        record[i + 1].subroutine = sample_stack[i].subroutine;
+        record[i + 1].line = sample_stack[i].line;
+    }
+    sample_used = sample_used + depth + 1;
+    sample_count = sample_count + 1;
+}
+#endif
+
+typedef struct
+{
+    char *stack;
+    long count;
+} SampleStack;
+
+static int sample_compare(const void *a, const void *b)
+{
+    return strcmp(((const SampleStack *)a)->stack, ((const SampleStack *)b)->stack);
+}
+
+static void sample_report(void)
+{
+#ifndef _WIN32
+    struct itimerval off;
+    memset(&off, 0, sizeof(off));
+    setitimer(ITIMER_PROF, &off, NULL);
+#endif
+
+    // Identical stacks are merged through a map from folded text to count
+    HashMap *counts = create_hashmap();
+    int num_stacks = 0;
+    size_t capacity = 256;
+    char *text = malloc(capacity);
+
+    for (int pos = 0; pos < sample_used;)
+    {
+        int depth = sample_buffer[pos].line;
+        size_t len = 0;
+        text[0] = '\0';
+        for (int i = 1; i <= depth; i++)
+        {
+            SampleFrame *frame = &sample_buffer[pos + i];
+            const char *name = frame->subroutine ? frame->subroutine->subroutine.name : sample_program_name;
+            size_t need = len + strlen(name) + 16;
+            if (need > capacity)
             {
-                // Pass by value
-                RuntimeValue arg_val = evaluate(arg, env);
-                env_define(sub_env, param->param.name, arg_val);
-                free_runtime_value(&arg_val);
+                capacity = need * 2;
+                text = realloc(text, capacity);
             }
+            len += sprintf(text + len, "%s%s:%d", i > 1 ? ";" : "", name, frame->line);
         }
+        pos += depth + 1;
 
-        // Execute subroutine body
-        for (int i = 0; i < subroutine->subroutine.num_stmts; i++)
+        long *count = hashmap_get(counts, text);
+        if (!count)
         {
-            execute_statement(subroutine->subroutine.body[i], sub_env);
+            count = calloc(1, sizeof(long));
+            hashmap_set(counts, text, count);
+            num_stacks++;
         }
+        (*count)++;
+    }
+    free(text);
 
-        // Copy back reference parameters (but NOT arrays - they're already shared)
-        for (int i = 0; i < subroutine->subroutine.num_params && i < stmt->call.num_args; i++)
+    SampleStack *stacks = malloc((num_stacks ? num_stacks : 1) * sizeof(SampleStack));
+    int n = 0;
+    for (int i = 0; i < MAX_HASH_SIZE; i++)
+    {
+        for (HashNode *node = counts->buckets[i]; node; node = node->next)
         {
-            ASTNode *param = subroutine->subroutine.parameters[i];
-            ASTNode *arg = stmt->call.arguments[i];
+            stacks[n].stack = node->key;
+            stacks[n].count = *(long *)node->value;
+            n++;
+        }
+    }
+    qsort(stacks, n, sizeof(SampleStack), sample_compare);
 
-            if (param->param.is_reference)
-            {
-                // Get the value from subroutine environment
-                RuntimeValue *sub_val = env_get(sub_env, param->param.name);
+    FILE *out = fopen(sample_path, "w");
+    if (!out)
+    {
+        fprintf(stderr, "Warning: Cannot write samples to %s: %s\n", sample_path, strerror(errno));
+    }
+    else
+    {
+        for (int i = 0; i < n; i++)
+            fprintf(out, "%s %ld\n", stacks[i].stack, stacks[i].count);
+        fclose(out);
+        fprintf(stderr, "%d samples written to %s", sample_count, sample_path);
+        if (sample_dropped > 0)
+            fprintf(stderr, " (%d dropped, buffer full)", sample_dropped);
+        fprintf(stderr, "\n");
+    }
 
-                // Skip arrays - they're already shared by reference
-                if (sub_val->type == VAL_ARRAY)
-                {
-                    continue;
-                }
+    for (int i = 0; i < MAX_HASH_SIZE; i++)
+    {
+        for (HashNode *node = counts->buckets[i]; node; node = node->next)
+            free(node->value);
+    }
+    free_hashmap(counts);
+    free(stacks);
+}
 
-                // Copy back simple variables
-                if (arg->type == AST_IDENTIFIER)
-                {
-                    env_assign(env, arg->identifier.name, *sub_val);
-                }
-                else if (arg->type == AST_ARRAY_ACCESS)
-                {
-                    // Array element - assign back
-                    RuntimeValue *arr_val = env_get(env, arg->array_access.name);
-                    if (arr_val->type == VAL_ARRAY)
-                    {
-                        int indices[MAX_ARRAY_DIMS];
-                        for (int j = 0; j < arg->array_access.num_indices; j++)
-                        {
-                            RuntimeValue idx = evaluate(arg->array_access.indices[j], env);
-                            indices[j] = to_int(&idx);
-                            free_runtime_value(&idx);
-                        }
-                        array_set(arr_val->value.arr_val, indices, arg->array_access.num_indices, *sub_val);
-                    }
-                }
-            }
-        }
+static void sample_init(ASTNode *prog, const char *path)
+{
+    sample_path = path;
+    sample_program_name = prog->program.name;
+    sample_stack[0].subroutine = NULL;
+    sample_stack[0].line = prog->line;
+    sample_depth = 1;
+
+#ifdef _WIN32
+    fprintf(stderr, "Warning: --sample is not available on Windows\n");
+    sample_enabled = false;
+#else
+    sample_buffer = malloc(SAMPLE_BUFFER_FRAMES * sizeof(SampleFrame));
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = sample_signal;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGPROF, &action, NULL);
+
+    long interval = sample_rate > 0 && sample_rate <= 1000000 ? 1000000 / sample_rate : 1000;
+    struct itimerval timer;
+    timer.it_interval.tv_sec = interval / 1000000;
+    timer.it_interval.tv_usec = interval % 1000000;
+    timer.it_value = timer.it_interval;
+    setitimer(ITIMER_PROF, &timer, NULL);
+
+    atexit(sample_report);
+#endif
+}
 
-        break;
+// ============================================================================
+// TIMELINE TRACE
+// ============================================================================
+// --trace-out=FILE records when every subroutine call, ΔΙΑΒΑΣΕ, ΤΥΠΩΣΕ and
+// top-level statement started and how long it took, in wall time, so time
+// blocked on stdin shows up too. Finished events go into a ring buffer of
+// TRACE_BUFFER_EVENTS entries that overwrites the oldest ones on long runs;
+// at exit they are written as Chrome trace-event JSON ("X" complete events,
+// one begin/end pair each), viewable in chrome://tracing or Perfetto.
+
+#define TRACE_BUFFER_EVENTS (1 << 18)
+#define TRACE_MAX_DEPTH 4096
+
+typedef struct
+{
+    const char *name;
+    const char *category;
+    int line;
+    double start; // Microseconds since the start of the run
+    double duration;
+} TraceEvent;
+
+static bool trace_enabled = false;
+static const char *trace_path = NULL;
+static double trace_origin = 0;
+static TraceEvent *trace_ring = NULL;
+static long trace_written = 0; // Events ever finished; the ring keeps the last ones
+static TraceEvent trace_open[TRACE_MAX_DEPTH];
+static int trace_depth = 0;
+static int trace_overflow = 0; // Nesting deeper than TRACE_MAX_DEPTH
+
+static inline double trace_now(void)
+{
+    return (profile_wall_seconds() - trace_origin) * 1e6;
+}
+
+static void trace_begin(const char *name, const char *category, int line)
+{
+    if (trace_depth == TRACE_MAX_DEPTH)
+    {
+        trace_overflow++;
+        return;
+    }
+    TraceEvent *event = &trace_open[trace_depth++];
+    event->name = name;
+    event->category = category;
+    event->line = line;
+    event->start = trace_now();
+}
+
+static void trace_end(void)
+{
+    if (trace_overflow > 0)
+    {
+        trace_overflow--;
+        return;
     }
+    TraceEvent *event = &trace_open[--trace_depth];
+    event->duration = trace_now() - event->start;
+    trace_ring[trace_written++ % TRACE_BUFFER_EVENTS] = *event;
+}
 
+// Display name of a top-level statement
+static const char *trace_statement_name(ASTNode *stmt)
+{
+    switch (stmt->type)
+    {
+    case AST_ASSIGN:
+        return stmt->assign.identifier;
+    case AST_PRINT:
+        return "ΤΥΠΩΣΕ";
+    case AST_READ:
+        return "ΔΙΑΒΑΣΕ";
+    case AST_IF:
+        return "ΕΑΝ";
+    case AST_FOR:
+        return "ΓΙΑ";
+    case AST_WHILE:
+        return stmt->while_loop.is_repeat_until ? "ΜΕΧΡΙ" : "ΕΝΟΣΩ";
+    case AST_CALL:
+        return stmt->call.name;
     default:
-        fprintf(stderr, "Runtime Error: Unknown statement type\n");
-        exit(1);
+        return "statement";
     }
 }
 
-static void execute_program(ASTNode *prog)
+static void trace_write_string(FILE *out, const char *text)
 {
-    Environment *env = create_environment(NULL);
+    fputc('"', out);
+    for (const char *p = text; *p; p++)
+    {
+        if (*p == '"' || *p == '\\')
+            fputc('\\', out);
+        if ((unsigned char)*p >= 0x20)
+            fputc(*p, out);
+    }
+    fputc('"', out);
+}
 
-    // Define EOLN constant - use a static string to avoid malloc
-    RuntimeValue eoln;
-    eoln.type = VAL_STRING;
-    eoln.value.str_val = "__EOLN__"; // Static string, not malloc'd
-    env_define(env, "EOLN", eoln);
+static void trace_write_event(FILE *out, TraceEvent *event, bool first)
+{
+    fprintf(out, "%s\n{\"name\":", first ? "" : ",");
+    trace_write_string(out, event->name);
+    fprintf(out, ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":1,\"args\":{\"line\":%d}}",
+            event->category, event->start, event->duration, event->line);
+}
 
-    // Phase 1: Define constants and subroutines
-    for (int i = 0; i < prog->program.num_decls; i++)
+static void trace_report(void)
+{
+    FILE *out = fopen(trace_path, "w");
+    if (!out)
     {
-        ASTNode *decl = prog->program.declarations[i];
-
-        if (decl->type == AST_CONST_DECL)
-        {
-            RuntimeValue val = evaluate(decl->decl.value, env);
-            env_define(env, decl->decl.name, val);
-            debug_log("Defined constant: %s", decl->decl.name);
-        }
-        else if (decl->type == AST_FUNC_DECL || decl->type == AST_PROC_DECL)
-        {
-            env_define_subroutine(env, decl->subroutine.name, decl);
-            debug_log("Defined subroutine: %s", decl->subroutine.name);
-        }
+        fprintf(stderr, "Warning: Cannot write trace to %s: %s\n", trace_path, strerror(errno));
+        return;
     }
 
-    // Phase 2: Define variables
-    for (int i = 0; i < prog->program.num_decls; i++)
+    // Events still open (the program stopped inside them) end now
+    double now = trace_now();
+    while (trace_depth > 0)
     {
-        ASTNode *decl = prog->program.declarations[i];
+        TraceEvent *event = &trace_open[--trace_depth];
+        event->duration = now - event->start;
+        trace_ring[trace_written++ % TRACE_BUFFER_EVENTS] = *event;
+    }
 
-        if (decl->type == AST_VAR_DECL)
-        {
-            RuntimeValue val;
+    long first = trace_written > TRACE_BUFFER_EVENTS ? trace_written - TRACE_BUFFER_EVENTS : 0;
+    fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    for (long i = first; i < trace_written; i++)
+        trace_write_event(out, &trace_ring[i % TRACE_BUFFER_EVENTS], i == first);
+    fprintf(out, "\n]}\n");
+    fclose(out);
 
-            if (decl->decl.num_arr_dims > 0)
-            {
-                // Array variable - evaluate bounds
-                ArrayBound bounds[MAX_ARRAY_DIMS];
-                for (int j = 0; j < decl->decl.num_arr_dims; j++)
-                {
-                    RuntimeValue start_val = evaluate(decl->decl.arr_bound_exprs[j].start_expr, env);
-                    RuntimeValue end_val = evaluate(decl->decl.arr_bound_exprs[j].end_expr, env);
-                    bounds[j].from = to_int(&start_val);
-                    bounds[j].to = to_int(&end_val);
-                    free_runtime_value(&start_val);
-                    free_runtime_value(&end_val);
-                }
+    fprintf(stderr, "%ld trace events written to %s", trace_written - first, trace_path);
+    if (first > 0)
+        fprintf(stderr, " (%ld oldest dropped)", first);
+    fprintf(stderr, "\n");
+}
 
-                val.type = VAL_ARRAY;
-                val.value.arr_val = create_array(bounds, decl->decl.num_arr_dims);
-                debug_log("Declared array: %s", decl->decl.name);
-            }
-            else
-            {
-                // Simple variable
-                val.type = VAL_INT;
-                val.value.int_val = 0;
-                debug_log("Declared variable: %s", decl->decl.name);
-            }
+static void trace_init(const char *path)
+{
+    trace_path = path;
+    trace_ring = malloc(TRACE_BUFFER_EVENTS * sizeof(TraceEvent));
+    trace_origin = profile_wall_seconds();
+    atexit(trace_report);
+}
 
-            env_define(env, decl->decl.name, val);
-        }
+// ============================================================================
+// RESOURCE LIMITS
+// ============================================================================
+// --max-steps, --max-memory and --max-time stop runaway programs. The limits
+// are checked only at loop back-edges and subroutine calls, the only places a
+// program can keep running from, against counters that are kept anyway: the
+// statement count and live heap of --stats, and a flag set by SIGALRM once
+// the time is up. Steps and memory are deterministic, so the same program and
+// input always stop at the same statement.
+
+#define LIMIT_EXIT_STEPS 3
+#define LIMIT_EXIT_MEMORY 4
+#define LIMIT_EXIT_TIME 5
+
+static uint64_t limit_steps = UINT64_MAX;  // Statements allowed
+static uint64_t limit_memory = UINT64_MAX; // Bytes of live heap allowed
+static double limit_seconds = 0;           // Wall time allowed, 0 for none
+static volatile sig_atomic_t limit_time_up = 0;
+static double limit_start = 0;
+#ifdef _WIN32
+static double limit_deadline = 0;
+#endif
+
+static void limit_exceeded(int line, const char *callee)
+{
+    const char *what;
+    int code;
+
+    if (stats.statements >= limit_steps)
+    {
+        what = "step";
+        code = LIMIT_EXIT_STEPS;
+    }
+    else if (stats.bytes_live > limit_memory)
+    {
+        what = "memory";
+        code = LIMIT_EXIT_MEMORY;
+    }
+    else
+    {
+        what = "time";
+        code = LIMIT_EXIT_TIME;
     }
 
-    // Execute main body
-    for (int i = 0; i < prog->program.num_stmts; i++)
+    fflush(stdout);
+    fprintf(stderr, "\nLimit Error: %s limit reached at line %d", what, line);
+    if (callee)
+        fprintf(stderr, " (calling %s)", callee);
+    fprintf(stderr, " after %llu statements, ", (unsigned long long)stats.statements);
+    if (alloc_accounting)
+        fprintf(stderr, "%llu bytes in use, ", (unsigned long long)stats.bytes_live);
+    fprintf(stderr, "%.3f s\n", profile_wall_seconds() - limit_start);
+    exit(code);
+}
+
+// Called at every back-edge and call site
+static inline void limit_check(int line, const char *callee)
+{
+#ifdef _WIN32
+    if (limit_deadline > 0 && profile_wall_seconds() > limit_deadline)
+        limit_time_up = 1;
+#endif
+    if (stats.statements >= limit_steps || stats.bytes_live > limit_memory || limit_time_up)
+        limit_exceeded(line, callee);
+}
+
+#ifndef _WIN32
+static void limit_alarm(int sig)
+{
+    (void)sig;
+    limit_time_up = 1;
+}
+#endif
+
+static void limit_init(void)
+{
+    limit_start = profile_wall_seconds();
+    if (limit_seconds <= 0)
+        return;
+#ifdef _WIN32
+    limit_deadline = limit_start + limit_seconds;
+#else
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = limit_alarm;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGALRM, &action, NULL);
+
+    struct itimerval timer;
+    memset(&timer, 0, sizeof(timer));
+    timer.it_value.tv_sec = (time_t)limit_seconds;
+    timer.it_value.tv_usec = (suseconds_t)((limit_seconds - (double)timer.it_value.tv_sec) * 1e6);
+    if (timer.it_value.tv_sec == 0 && timer.it_value.tv_usec == 0)
+        timer.it_value.tv_usec = 1;
+    setitimer(ITIMER_REAL, &timer, NULL);
+#endif
+}
+
+// "64M" -> 67108864
+static uint64_t parse_size(const char *text)
+{
+    char *end;
+    double size = strtod(text, &end);
+    switch (toupper((unsigned char)*end))
     {
-        execute_statement(prog->program.body[i], env);
+    case 'K':
+        size *= 1024;
+        break;
+    case 'M':
+        size *= 1024 * 1024;
+        break;
+    case 'G':
+        size *= 1024.0 * 1024 * 1024;
+        break;
     }
+    return size > 0 ? (uint64_t)size : 0;
 }
 
 // ============================================================================
-// MAIN
+// COST MODEL
 // ============================================================================
+// --cost-report counts abstract operations instead of time, so the numbers are
+// the same on every machine: comparisons, arithmetic and logical operators,
+// array element reads and writes, assignments and calls. A ΓΙΑ iteration
+// costs one comparison, one addition and one assignment of its variable, as
+// the equivalent ΕΝΟΣΩ loop would. Operations are counted for the subroutine
+// executing them (self) and for every subroutine on the call stack (total).
 
-// Helper function for token names
-// ============================================================================
-static const char *token_type_name(TokenType type)
+typedef enum
 {
-    switch (type)
-    {
-    case TOK_ALGORITHM:
-        return "ALGORITHM";
-    case TOK_CONSTANTS:
-        return "CONSTANTS";
-    case TOK_DATA:
-        return "DATA";
+    COST_COMPARISON,
+    COST_ARITHMETIC,
+    COST_LOGICAL,
+    COST_ARRAY_READ,
+    COST_ARRAY_WRITE,
+    COST_ASSIGNMENT,
+    COST_CALL,
+    COST_KINDS
+} CostKind;
+
+static const char *cost_kind_names[COST_KINDS] = {
+    "Compare", "Arith", "Logic", "ArrRead", "ArrWrite", "Assign", "Calls"};
+
+typedef struct
+{
+    ASTNode *subroutine; // NULL for the main program
+    uint64_t calls;
+    uint64_t self[COST_KINDS];
+    uint64_t total[COST_KINDS];
+    int active; // Recursive calls only count their outermost total
+} CostSubroutine;
+
+typedef struct
+{
+    int saved_current;
+    uint64_t start[COST_KINDS];
+} CostFrame;
+
+static bool cost_enabled = false;
+static const char *cost_path = NULL; // NULL for stderr
+static CostSubroutine *cost_subs = NULL;
+static int cost_num_subs = 0;
+static int cost_current = 0;
+static uint64_t *cost_self = NULL; // cost_subs[cost_current].self
+static uint64_t cost_all[COST_KINDS];
+
+static inline void cost_count(CostKind kind)
+{
+    cost_self[kind]++;
+    cost_all[kind]++;
+}
+
+// The test, increment and assignment of one ΓΙΑ iteration
+static inline void cost_for_iteration(void)
+{
+    cost_count(COST_COMPARISON);
+    cost_count(COST_ARITHMETIC);
+    cost_count(COST_ASSIGNMENT);
+}
+
+static CostKind cost_operator_kind(const char *op)
+{
+    if (op[0] == '<' || op[0] == '>' || op[0] == '=')
+        return COST_COMPARISON;
+    if (op[0] == '+' || op[0] == '-' || op[0] == '*' || op[0] == '/' ||
+        str_equals_ignore_case(op, "DIV") || str_equals_ignore_case(op, "MOD"))
+        return COST_ARITHMETIC;
+    return COST_LOGICAL;
+}
+
+static void cost_enter_subroutine(ASTNode *sub, CostFrame *frame)
+{
+    int index = 1;
+    while (index < cost_num_subs && cost_subs[index].subroutine != sub)
+        index++;
+    if (index == cost_num_subs)
+    {
+        cost_subs = realloc(cost_subs, (cost_num_subs + 1) * sizeof(CostSubroutine));
+        memset(&cost_subs[cost_num_subs++], 0, sizeof(CostSubroutine));
+        cost_subs[index].subroutine = sub;
+    }
+
+    cost_subs[index].calls++;
+    cost_subs[index].active++;
+    frame->saved_current = cost_current;
+    memcpy(frame->start, cost_all, sizeof(cost_all));
+    cost_current = index;
+    cost_self = cost_subs[index].self;
+}
+
+static void cost_leave_subroutine(CostFrame *frame)
+{
+    CostSubroutine *entry = &cost_subs[cost_current];
+    if (--entry->active == 0)
+    {
+        for (int i = 0; i < COST_KINDS; i++)
+            entry->total[i] += cost_all[i] - frame->start[i];
+    }
+    cost_current = frame->saved_current;
+    cost_self = cost_subs[cost_current].self;
+}
+
+static uint64_t cost_sum(const uint64_t *counts)
+{
+    uint64_t sum = 0;
+    for (int i = 0; i < COST_KINDS; i++)
+        sum += counts[i];
+    return sum;
+}
+
+static void cost_print_row(FILE *out, const char *name, uint64_t calls, const uint64_t *self, uint64_t total)
+{
+    fprintf(out, "%-24s %10llu", name, (unsigned long long)calls);
+    for (int i = 0; i < COST_KINDS; i++)
+        fprintf(out, " %12llu", (unsigned long long)self[i]);
+    fprintf(out, " %14llu %14llu\n", (unsigned long long)cost_sum(self), (unsigned long long)total);
+}
+
+static void cost_report(void)
+{
+    FILE *out = stderr;
+    if (cost_path)
+    {
+        out = fopen(cost_path, "w");
+        if (!out)
+        {
+            fprintf(stderr, "Warning: Cannot write cost report to %s: %s\n", cost_path, strerror(errno));
+            return;
+        }
+    }
+
+    // The main program is on the stack for the whole run
+    memcpy(cost_subs[0].total, cost_all, sizeof(cost_all));
+
+    fprintf(out, "%sCost report (abstract operations, self counts per subroutine)\n", cost_path ? "" : "\n");
+    fprintf(out, "%-24s %10s", "Name", "Invoked");
+    for (int i = 0; i < COST_KINDS; i++)
+        fprintf(out, " %12s", cost_kind_names[i]);
+    fprintf(out, " %14s %14s\n", "Self ops", "Total ops");
+
+    for (int i = 0; i < cost_num_subs; i++)
+    {
+        CostSubroutine *entry = &cost_subs[i];
+        cost_print_row(out, entry->subroutine ? entry->subroutine->subroutine.name : "(main program)",
+                       entry->subroutine ? entry->calls : 1, entry->self, cost_sum(entry->total));
+    }
+    cost_print_row(out, "(whole program)", 1, cost_all, cost_sum(cost_all));
+
+    if (cost_path)
+    {
+        fclose(out);
+        fprintf(stderr, "Cost report written to %s\n", cost_path);
+    }
+}
+
+static void cost_start(void)
+{
+    cost_enabled = true;
+    cost_subs = calloc(1, sizeof(CostSubroutine));
+    cost_num_subs = 1;
+    cost_self = cost_subs[0].self;
+}
+
+static void cost_init(const char *path)
+{
+    cost_path = path;
+    cost_start();
+    atexit(cost_report);
+}
+
+// ============================================================================
+// COVERAGE
+// ============================================================================
+// --coverage gives every statement and subroutine a counter before the run
+// starts; the interpreter bumps it through the node, so a hit costs one
+// increment and no lookup. At exit the counts are written as an lcov
+// tracefile (genhtml turns it into an annotated listing).
+
+struct CoverageCounter
+{
+    uint64_t hits;  // Executions of the statement, calls of the subroutine
+    uint64_t taken; // ΕΑΝ: times the condition held; loops: iterations
+};
+
+static ASTNode *coverage_program = NULL;
+static const char *coverage_source = NULL;
+static const char *coverage_path = NULL;
+static CoverageCounter *coverage_counters = NULL;
+static int coverage_num_counters = 0;
+static int coverage_max_line = 0;
+
+static inline void coverage_hit(ASTNode *node)
+{
+    if (node->coverage)
+        node->coverage->hits++;
+}
+
+static inline void coverage_taken(ASTNode *node)
+{
+    if (node->coverage)
+        node->coverage->taken++;
+}
+
+// Counts the statements of a block (counters == NULL) or hands out counters
+static void coverage_attach_block(ASTNode **stmts, int count, CoverageCounter *counters)
+{
+    for (int i = 0; i < count; i++)
+    {
+        ASTNode *stmt = stmts[i];
+        if (counters)
+            stmt->coverage = &counters[coverage_num_counters];
+        coverage_num_counters++;
+        if (stmt->line > coverage_max_line)
+            coverage_max_line = stmt->line;
+
+        switch (stmt->type)
+        {
+        case AST_IF:
+            coverage_attach_block(stmt->if_stmt.then_branch, stmt->if_stmt.num_then, counters);
+            coverage_attach_block(stmt->if_stmt.else_branch, stmt->if_stmt.num_else, counters);
+            break;
+        case AST_FOR:
+            coverage_attach_block(stmt->for_loop.body, stmt->for_loop.num_stmts, counters);
+            break;
+        case AST_WHILE:
+            coverage_attach_block(stmt->while_loop.body, stmt->while_loop.num_stmts, counters);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+static void coverage_attach_program(ASTNode *prog, CoverageCounter *counters)
+{
+    coverage_num_counters = 0;
+    for (int i = 0; i < prog->program.num_decls; i++)
+    {
+        ASTNode *decl = prog->program.declarations[i];
+        if (decl->type != AST_FUNC_DECL && decl->type != AST_PROC_DECL)
+            continue;
+        if (counters)
+            decl->coverage = &counters[coverage_num_counters];
+        coverage_num_counters++;
+        coverage_attach_block(decl->subroutine.body, decl->subroutine.num_stmts, counters);
+    }
+    coverage_attach_block(prog->program.body, prog->program.num_stmts, counters);
+}
+
+// Line counts (the most executed statement of each line) and branch records
+// of a block, in source order
+static void coverage_collect_block(ASTNode **stmts, int count, uint64_t *line_hits, bool *line_found,
+                                   FILE *out, int *branches, int *branches_hit)
+{
+    for (int i = 0; i < count; i++)
+    {
+        ASTNode *stmt = stmts[i];
+        CoverageCounter *counter = stmt->coverage;
+        if (!line_found[stmt->line] || counter->hits > line_hits[stmt->line])
+            line_hits[stmt->line] = counter->hits;
+        line_found[stmt->line] = true;
+
+        if (out && (stmt->type == AST_IF || stmt->type == AST_FOR || stmt->type == AST_WHILE))
+        {
+            // ΕΑΝ: then / else; loops: body / exit
+            uint64_t outcome[2] = {counter->taken, stmt->type == AST_IF ? counter->hits - counter->taken : counter->hits};
+            int block = (*branches) / 2;
+            for (int b = 0; b < 2; b++)
+            {
+                if (counter->hits)
+                    fprintf(out, "BRDA:%d,%d,%d,%llu\n", stmt->line, block, b, (unsigned long long)outcome[b]);
+                else
+                    fprintf(out, "BRDA:%d,%d,%d,-\n", stmt->line, block, b);
+                (*branches)++;
+                if (outcome[b])
+                    (*branches_hit)++;
+            }
+        }
+
+        switch (stmt->type)
+        {
+        case AST_IF:
+            coverage_collect_block(stmt->if_stmt.then_branch, stmt->if_stmt.num_then, line_hits, line_found, out, branches, branches_hit);
+            coverage_collect_block(stmt->if_stmt.else_branch, stmt->if_stmt.num_else, line_hits, line_found, out, branches, branches_hit);
+            break;
+        case AST_FOR:
+            coverage_collect_block(stmt->for_loop.body, stmt->for_loop.num_stmts, line_hits, line_found, out, branches, branches_hit);
+            break;
+        case AST_WHILE:
+            coverage_collect_block(stmt->while_loop.body, stmt->while_loop.num_stmts, line_hits, line_found, out, branches, branches_hit);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+static void coverage_report(void)
+{
+    FILE *out = fopen(coverage_path, "w");
+    if (!out)
+    {
+        fprintf(stderr, "Warning: Cannot write coverage to %s: %s\n", coverage_path, strerror(errno));
+        return;
+    }
+
+    ASTNode *prog = coverage_program;
+    fprintf(out, "TN:\nSF:%s\n", coverage_source);
+
+    int functions = 0, functions_hit = 0;
+    for (int i = 0; i < prog->program.num_decls; i++)
+    {
+        ASTNode *decl = prog->program.declarations[i];
+        if (decl->coverage)
+            fprintf(out, "FN:%d,%s\n", decl->line, decl->subroutine.name);
+    }
+    for (int i = 0; i < prog->program.num_decls; i++)
+    {
+        ASTNode *decl = prog->program.declarations[i];
+        if (!decl->coverage)
+            continue;
+        fprintf(out, "FNDA:%llu,%s\n", (unsigned long long)decl->coverage->hits, decl->subroutine.name);
+        functions++;
+        if (decl->coverage->hits)
+            functions_hit++;
+    }
+    fprintf(out, "FNF:%d\nFNH:%d\n", functions, functions_hit);
+
+    uint64_t *line_hits = calloc(coverage_max_line + 1, sizeof(uint64_t));
+    bool *line_found = calloc(coverage_max_line + 1, sizeof(bool));
+    int branches = 0, branches_hit = 0;
+    for (int i = 0; i < prog->program.num_decls; i++)
+    {
+        ASTNode *decl = prog->program.declarations[i];
+        if (decl->coverage)
+            coverage_collect_block(decl->subroutine.body, decl->subroutine.num_stmts, line_hits, line_found,
+                                   out, &branches, &branches_hit);
+    }
+    coverage_collect_block(prog->program.body, prog->program.num_stmts, line_hits, line_found, out,
+                           &branches, &branches_hit);
+    fprintf(out, "BRF:%d\nBRH:%d\n", branches, branches_hit);
+
+    int lines = 0, lines_hit = 0;
+    for (int line = 1; line <= coverage_max_line; line++)
+    {
+        if (!line_found[line])
+            continue;
+        fprintf(out, "DA:%d,%llu\n", line, (unsigned long long)line_hits[line]);
+        lines++;
+        if (line_hits[line])
+            lines_hit++;
+    }
+    fprintf(out, "LF:%d\nLH:%d\nend_of_record\n", lines, lines_hit);
+    free(line_hits);
+    free(line_found);
+    fclose(out);
+
+    fprintf(stderr, "Coverage: %d of %d lines, %d of %d branches, %d of %d subroutines; written to %s\n",
+            lines_hit, lines, branches_hit, branches, functions_hit, functions, coverage_path);
+}
+
+static void coverage_init(ASTNode *prog, const char *source, const char *path)
+{
+    coverage_program = prog;
+    coverage_source = source;
+    coverage_path = path;
+
+    coverage_attach_program(prog, NULL);
+    coverage_counters = calloc(coverage_num_counters ? coverage_num_counters : 1, sizeof(CoverageCounter));
+    coverage_attach_program(prog, coverage_counters);
+    atexit(coverage_report);
+}
+
+// ============================================================================
+// COMPLEXITY ESTIMATION
+// ============================================================================
+// --complexity=TEMPLATE runs the program once per input size, each time in a
+// forked child reading an input generated from the template, and fits the
+// operation counts of the cost model (and the times) against the usual
+// growth rates. In the template {N} is replaced by the size, and {RANDOM},
+// {ASCENDING} and {DESCENDING} by N integers, one per line; the random ones
+// come from a fixed seed so every run sees the same input.
+
+#define COMPLEXITY_MAX_SIZES 32
+
+static void execute_program(ASTNode *prog);
+static char *read_file(const char *filename);
+
+typedef struct
+{
+    int ok;
+    uint64_t operations;
+    uint64_t statements;
+    double seconds;
+} ComplexityRun;
+
+static const char *complexity_model_names[] = {"O(1)", "O(log n)", "O(n)", "O(n log n)", "O(n^2)", "O(n^3)"};
+#define COMPLEXITY_MODELS ((int)(sizeof(complexity_model_names) / sizeof(complexity_model_names[0])))
+
+static double complexity_model(int model, double n)
+{
+    switch (model)
+    {
+    case 0:
+        return 1;
+    case 1:
+        return log(n);
+    case 2:
+        return n;
+    case 3:
+        return n * log(n);
+    case 4:
+        return n * n;
+    default:
+        return n * n * n;
+    }
+}
+
+// Least squares y = a * f(n) + b with a >= 0; returns the residual sum of
+// squares and the coefficient of determination in *r2
+static double complexity_fit(int model, const double *n, const double *y, int count, double *r2)
+{
+    double mean_f = 0, mean_y = 0;
+    for (int i = 0; i < count; i++)
+    {
+        mean_f += complexity_model(model, n[i]);
+        mean_y += y[i];
+    }
+    mean_f /= count;
+    mean_y /= count;
+
+    double covariance = 0, variance = 0, total = 0;
+    for (int i = 0; i < count; i++)
+    {
+        double f = complexity_model(model, n[i]) - mean_f;
+        covariance += f * (y[i] - mean_y);
+        variance += f * f;
+        total += (y[i] - mean_y) * (y[i] - mean_y);
+    }
+    double a = variance > 0 && covariance > 0 ? covariance / variance : 0;
+
+    double residual = 0;
+    for (int i = 0; i < count; i++)
+    {
+        double error = y[i] - (mean_y + a * (complexity_model(model, n[i]) - mean_f));
+        residual += error * error;
+    }
+    *r2 = total > 0 ? 1 - residual / total : 1;
+    return residual;
+}
+
+// Prints the fit of every model and returns the best one
+static int complexity_report_fit(const char *what, const double *n, const double *y, int count)
+{
+    double residual[COMPLEXITY_MODELS], r2[COMPLEXITY_MODELS];
+    int best = 0, second = -1;
+    for (int model = 0; model < COMPLEXITY_MODELS; model++)
+    {
+        residual[model] = complexity_fit(model, n, y, count, &r2[model]);
+        if (residual[model] < residual[best])
+            best = model;
+    }
+    for (int model = 0; model < COMPLEXITY_MODELS; model++)
+    {
+        if (model != best && (second < 0 || residual[model] < residual[second]))
+            second = model;
+    }
+
+    // How much worse the runner-up explains the data
+    double ratio = residual[best] > 0 ? residual[second] / residual[best] : (residual[second] > 0 ? INFINITY : 1);
+    const char *confidence = ratio >= 10 && r2[best] >= 0.99 ? "high" : ratio >= 2 ? "medium" : "low";
+
+    printf("\nFit of %s\n", what);
+    for (int model = 0; model < COMPLEXITY_MODELS; model++)
+        printf("  %-12s R^2 %8.5f%s\n", complexity_model_names[model], r2[model], model == best ? "  <-" : "");
+    printf("Best fit: %s (R^2 %.5f, confidence %s, next best %s)\n", complexity_model_names[best], r2[best],
+           confidence, complexity_model_names[second]);
+    return best;
+}
+
+static void complexity_write_numbers(FILE *out, const char *kind, int size)
+{
+    unsigned int seed = 12345;
+    for (int i = 1; i <= size; i++)
+    {
+        int value = i;
+        if (kind[0] == 'D')
+            value = size - i + 1;
+        else if (kind[0] == 'R')
+        {
+            seed = seed * 1103515245u + 12345u;
+            value = (int)((seed >> 8) % 1000000u);
+        }
+        fprintf(out, "%d\n", value);
+    }
+}
+
+static FILE *complexity_input(const char *template, int size)
+{
+    FILE *input = tmpfile();
+    if (!input)
+    {
+        fprintf(stderr, "Runtime Error: Cannot create input file: %s\n", strerror(errno));
+        exit(1);
+    }
+
+    for (const char *p = template; *p; p++)
+    {
+        if (*p == '{')
+        {
+            const char *close = strchr(p, '}');
+            size_t len = close ? (size_t)(close - p - 1) : 0;
+            if (close && len == 1 && p[1] == 'N')
+            {
+                fprintf(input, "%d", size);
+                p = close;
+                continue;
+            }
+            if (close && ((len == 6 && strncmp(p + 1, "RANDOM", 6) == 0) ||
+                          (len == 9 && strncmp(p + 1, "ASCENDING", 9) == 0) ||
+                          (len == 10 && strncmp(p + 1, "DESCENDING", 10) == 0)))
+            {
+                complexity_write_numbers(input, p + 1, size);
+                p = close;
+                // The numbers end with a newline already
+                if (p[1] == '\n')
+                    p++;
+                continue;
+            }
+        }
+        fputc(*p, input);
+    }
+
+    fflush(input);
+    rewind(input);
+    return input;
+}
+
+static ComplexityRun complexity_measure(ASTNode *program, const char *template, int size, bool limits)
+{
+    ComplexityRun run = {0};
+#ifdef _WIN32
+    (void)program;
+    (void)template;
+    (void)size;
+    (void)limits;
+#else
+    FILE *input = complexity_input(template, size);
+    int channel[2];
+    if (pipe(channel) != 0)
+    {
+        fprintf(stderr, "Runtime Error: pipe failed: %s\n", strerror(errno));
+        exit(1);
+    }
+    fflush(stdout);
+    fflush(stderr);
+
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        fprintf(stderr, "Runtime Error: fork failed: %s\n", strerror(errno));
+        exit(1);
+    }
+    if (pid == 0)
+    {
+        // The child runs the program on the generated input and reports back
+        close(channel[0]);
+        dup2(fileno(input), STDIN_FILENO);
+        if (!freopen("/dev/null", "w", stdout))
+            _exit(1);
+        cost_start();
+        if (limits)
+            limit_init();
+        double start = profile_wall_seconds();
+        execute_program(program);
+        fflush(stdout);
+
+        run.ok = 1;
+        run.operations = cost_sum(cost_all);
+        run.statements = stats.statements;
+        run.seconds = profile_wall_seconds() - start;
+        if (write(channel[1], &run, sizeof(run)) != (ssize_t)sizeof(run))
+            _exit(1);
+        _exit(0);
+    }
+
+    close(channel[1]);
+    if (read(channel[0], &run, sizeof(run)) != (ssize_t)sizeof(run))
+        run.ok = 0;
+    close(channel[0]);
+    waitpid(pid, NULL, 0);
+    fclose(input);
+#endif
+    return run;
+}
+
+static int complexity_run(ASTNode *program, const char *template_path, const char *sizes_text, bool limits)
+{
+#ifdef _WIN32
+    (void)program;
+    (void)template_path;
+    (void)sizes_text;
+    (void)limits;
+    fprintf(stderr, "Runtime Error: --complexity needs fork() and is not available on Windows\n");
+    return 1;
+#else
+    int sizes[COMPLEXITY_MAX_SIZES];
+    int num_sizes = 0;
+    const char *p = sizes_text ? sizes_text : "16,32,64,128,256,512,1024";
+    while (*p && num_sizes < COMPLEXITY_MAX_SIZES)
+    {
+        int size = atoi(p);
+        if (size > 0)
+            sizes[num_sizes++] = size;
+        p += strcspn(p, ",");
+        if (*p == ',')
+            p++;
+    }
+    if (num_sizes < 3)
+    {
+        fprintf(stderr, "Runtime Error: --complexity needs at least 3 input sizes\n");
+        return 1;
+    }
+
+    char *template = read_file(template_path);
+
+    printf("Complexity of %s (input template %s)\n", program->program.name, template_path);
+    printf("%10s %16s %16s %12s\n", "N", "Operations", "Statements", "Time ms");
+
+    double n[COMPLEXITY_MAX_SIZES], operations[COMPLEXITY_MAX_SIZES], seconds[COMPLEXITY_MAX_SIZES];
+    int count = 0;
+    for (int i = 0; i < num_sizes; i++)
+    {
+        ComplexityRun run = complexity_measure(program, template, sizes[i], limits);
+        if (!run.ok)
+        {
+            printf("%10d %16s\n", sizes[i], "failed");
+            continue;
+        }
+        printf("%10d %16llu %16llu %12.3f\n", sizes[i], (unsigned long long)run.operations,
+               (unsigned long long)run.statements, run.seconds * 1000.0);
+        fflush(stdout);
+        n[count] = sizes[i];
+        operations[count] = (double)run.operations;
+        seconds[count] = run.seconds;
+        count++;
+    }
+    free(template);
+
+    if (count < 3)
+    {
+        fprintf(stderr, "Runtime Error: fewer than 3 runs succeeded, nothing to fit\n");
+        return 1;
+    }
+    complexity_report_fit("operation counts", n, operations, count);
+    complexity_report_fit("times", n, seconds, count);
+    return 0;
+#endif
+}
+
+// ============================================================================
+// QUICKENING
+// ============================================================================
+// A binary operator records the operand types of its first evaluation and
+// specializes itself to them: both INTEGER, both REAL or both BOOLEAN. A
+// specialized node checks its operands with a single guard and computes the
+// result directly, without looking at the operator string. The first time the
+// guard fails the node goes back to the generic path for good.
+
+typedef enum
+{
+    QUICK_UNSEEN, // Not evaluated yet
+    QUICK_INT,
+    QUICK_REAL,
+    QUICK_BOOL,
+    QUICK_GENERIC
+} QuickState;
+
+typedef enum
+{
+    BINOP_ADD,
+    BINOP_SUB,
+    BINOP_MUL,
+    BINOP_DIVIDE,
+    BINOP_DIV,
+    BINOP_MOD,
+    BINOP_EQ,
+    BINOP_NE,
+    BINOP_LT,
+    BINOP_GT,
+    BINOP_LE,
+    BINOP_GE,
+    BINOP_AND,
+    BINOP_OR,
+    BINOP_OTHER
+} BinaryOperator;
+
+static BinaryOperator quick_operator(const char *op)
+{
+    static const char *const names[] = {"+", "-", "*", "/", "DIV", "MOD", "=", "<>", "<", ">", "<=", ">="};
+    for (int i = 0; i < (int)(sizeof(names) / sizeof(names[0])); i++)
+        if (strcmp(op, names[i]) == 0)
+            return (BinaryOperator)i;
+    if (str_equals_ignore_case(op, "AND") || str_equals_ignore_case(op, "ΚΑΙ"))
+        return BINOP_AND;
+    if (str_equals_ignore_case(op, "OR") || str_equals_ignore_case(op, "Ή"))
+        return BINOP_OR;
+    return BINOP_OTHER;
+}
+
+// Called after the generic path evaluated the node for the first time
+static void quick_observe(ASTNode *expr, ValueType left, ValueType right)
+{
+    BinaryOperator op = quick_operator(expr->binary.operator);
+    QuickState state = QUICK_GENERIC;
+    if (left == VAL_INT && right == VAL_INT && op <= BINOP_GE)
+        state = QUICK_INT;
+    else if (left == VAL_REAL && right == VAL_REAL && op <= BINOP_GE && op != BINOP_DIV && op != BINOP_MOD)
+        state = QUICK_REAL;
+    else if (left == VAL_BOOL && right == VAL_BOOL && (op == BINOP_AND || op == BINOP_OR))
+        state = QUICK_BOOL;
+
+    expr->binary.op = op;
+    expr->binary.quick = state;
+    if (state != QUICK_GENERIC)
+        stats.quickened++;
+}
+
+static void quick_deoptimize(ASTNode *expr)
+{
+    expr->binary.quick = QUICK_GENERIC;
+    stats.deoptimized++;
+    DEBUG_LOG("Quickening: %s at line %d sees new operand types, using the generic path", expr->binary.operator,
+              expr->line);
+}
+
+static void quick_zero_divisor(BinaryOperator op)
+{
+    fprintf(stderr, "Runtime Error: %s by zero\n", op == BINOP_MOD ? "Modulo" : "Division");
+    exit(1);
+}
+
+static inline RuntimeValue quick_int(BinaryOperator op, int l, int r)
+{
+    RuntimeValue result;
+    result.type = VAL_INT;
+    switch (op)
+    {
+    case BINOP_ADD:
+        result.value.int_val = l + r;
+        break;
+    case BINOP_SUB:
+        result.value.int_val = l - r;
+        break;
+    case BINOP_MUL:
+        result.value.int_val = l * r;
+        break;
+    case BINOP_DIVIDE:
+        if (r == 0)
+            quick_zero_divisor(op);
+        result.type = VAL_REAL;
+        result.value.real_val = (double)l / r;
+        break;
+    case BINOP_DIV:
+        if (r == 0)
+            quick_zero_divisor(op);
+        result.value.int_val = l / r;
+        break;
+    case BINOP_MOD:
+        if (r == 0)
+            quick_zero_divisor(op);
+        result.value.int_val = l % r;
+        break;
+    default:
+        result.type = VAL_BOOL;
+        result.value.bool_val = op == BINOP_EQ   ? l == r
+                                : op == BINOP_NE ? l != r
+                                : op == BINOP_LT ? l < r
+                                : op == BINOP_GT ? l > r
+                                : op == BINOP_LE ? l <= r
+                                                 : l >= r;
+        break;
+    }
+    return result;
+}
+
+static inline RuntimeValue quick_real(BinaryOperator op, double l, double r)
+{
+    RuntimeValue result;
+    result.type = VAL_REAL;
+    switch (op)
+    {
+    case BINOP_ADD:
+        result.value.real_val = l + r;
+        break;
+    case BINOP_SUB:
+        result.value.real_val = l - r;
+        break;
+    case BINOP_MUL:
+        result.value.real_val = l * r;
+        break;
+    case BINOP_DIVIDE:
+        if (r == 0)
+            quick_zero_divisor(op);
+        result.value.real_val = l / r;
+        break;
+    default:
+        result.type = VAL_BOOL;
+        result.value.bool_val = op == BINOP_EQ   ? l == r
+                                : op == BINOP_NE ? l != r
+                                : op == BINOP_LT ? l < r
+                                : op == BINOP_GT ? l > r
+                                : op == BINOP_LE ? l <= r
+                                                 : l >= r;
+        break;
+    }
+    return result;
+}
+
+// ============================================================================
+// TYPE CHECKER
+// ============================================================================
+// Runs before execution (--no-typecheck skips it). Propagates the declared
+// types of variables, parameters and functions through every expression,
+// stores the result in static_type and reports mismatches. Names it cannot
+// resolve (dynamic scoping lets a subroutine see its caller's variables) are
+// VAL_NONE and accepted anywhere. The interpreter uses the annotations to store
+// INTEGER values into REAL variables as REAL and to start operators whose
+// operand types are known already quickened.
+
+typedef struct
+{
+    const char *name;
+    ValueType type;      // VAL_ARRAY for arrays
+    ValueType element;   // Of arrays
+    int dims;            // Of arrays, 0 if unknown (array parameters)
+    ASTNode *subroutine; // For functions and procedures
+} TypeSymbol;
+
+typedef struct
+{
+    TypeSymbol *symbols;
+    int num_symbols;
+    int num_globals;     // symbols[num_globals..] are the current subroutine's
+    ASTNode *subroutine; // Being checked, NULL for the main program
+    int errors;
+} TypeChecker;
+
+static bool is_array_type(const char *type);
+
+// Value type of a declared type name; VAL_NONE for array types
+static ValueType declared_value_type(const char *type)
+{
+    if (!type || strncmp(type, "ARRAY", 5) == 0)
+        return VAL_NONE;
+    const char *c_type = map_type(type);
+    if (strcmp(c_type, "double") == 0)
+        return VAL_REAL;
+    if (strcmp(c_type, "bool") == 0)
+        return VAL_BOOL;
+    if (strcmp(c_type, "char*") == 0 || strcmp(c_type, "char") == 0)
+        return VAL_STRING;
+    return VAL_INT;
+}
+
+// Initial value of a variable of the given declared type
+static RuntimeValue declared_initial_value(const char *type)
+{
+    RuntimeValue val;
+    memset(&val, 0, sizeof(val));
+    val.type = declared_value_type(type);
+    if (val.type == VAL_NONE)
+        val.type = VAL_INT;
+    else if (val.type == VAL_STRING)
+        val.value.str_val = ""; // Copied by env_define
+    return val;
+}
+
+// Initial value of a declared scalar variable. --mem-report charges a STRING
+// variable's text to an owner, which gets the line of the declaration here.
+static RuntimeValue declared_variable_value(ASTNode *decl)
+{
+    RuntimeValue val = declared_initial_value(decl->decl.var_type);
+    if (mem_report_enabled && val.type == VAL_STRING)
+        mem_variable(decl->decl.name, "string", decl->line);
+    return val;
+}
+
+// INTEGER values stored into REAL variables become REAL, as in the C the
+// transpiler writes
+static inline void type_coerce(RuntimeValue *val, ValueType target)
+{
+    if (target == VAL_REAL && val->type == VAL_INT)
+    {
+        val->type = VAL_REAL;
+        val->value.real_val = val->value.int_val;
+    }
+}
+
+static const char *type_name(ValueType type)
+{
+    switch (type)
+    {
+    case VAL_INT:
+        return "INTEGER";
+    case VAL_REAL:
+        return "REAL";
+    case VAL_BOOL:
+        return "BOOLEAN";
+    case VAL_STRING:
+        return "STRING";
+    case VAL_ARRAY:
+        return "ARRAY";
+    default:
+        return "unknown";
+    }
+}
+
+static void type_error(TypeChecker *tc, int line, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    fprintf(stderr, "Type Error at line %d: ", line);
+    vfprintf(stderr, fmt, args);
+    fprintf(stderr, "\n");
+    va_end(args);
+    tc->errors++;
+}
+
+static TypeSymbol *type_add(TypeChecker *tc, const char *name, ValueType type)
+{
+    tc->symbols = realloc(tc->symbols, (tc->num_symbols + 1) * sizeof(TypeSymbol));
+    TypeSymbol *sym = &tc->symbols[tc->num_symbols++];
+    memset(sym, 0, sizeof(*sym));
+    sym->name = name;
+    sym->type = type;
+    return sym;
+}
+
+static void type_add_declaration(TypeChecker *tc, ASTNode *decl)
+{
+    if (decl->decl.num_arr_dims > 0)
+    {
+        TypeSymbol *sym = type_add(tc, decl->decl.name, VAL_ARRAY);
+        sym->element = declared_value_type(decl->decl.var_type);
+        sym->dims = decl->decl.num_arr_dims;
+    }
+    else
+    {
+        type_add(tc, decl->decl.name, declared_value_type(decl->decl.var_type));
+    }
+}
+
+// The current subroutine's names first, then the globals
+static TypeSymbol *type_lookup(TypeChecker *tc, const char *name)
+{
+    for (int i = tc->num_symbols - 1; i >= 0; i--)
+        if (str_equals_ignore_case(tc->symbols[i].name, name))
+            return &tc->symbols[i];
+    return NULL;
+}
+
+static bool type_numeric(ValueType type)
+{
+    return type == VAL_INT || type == VAL_REAL || type == VAL_NONE;
+}
+
+static bool type_assignable(ValueType target, ValueType value)
+{
+    return target == VAL_NONE || value == VAL_NONE || target == value || (target == VAL_REAL && value == VAL_INT);
+}
+
+static ValueType type_expression(TypeChecker *tc, ASTNode *expr);
+
+static void type_indices(TypeChecker *tc, ASTNode *node, const char *name, ASTNode **indices, int num_indices)
+{
+    TypeSymbol *sym = type_lookup(tc, name);
+    if (sym && sym->type != VAL_ARRAY && sym->type != VAL_NONE)
+        type_error(tc, node->line, "%s has type %s, not an array", name, type_name(sym->type));
+    else if (sym && sym->dims && sym->dims != num_indices)
+        type_error(tc, node->line, "%s has %d dimension%s, indexed with %d", name, sym->dims, sym->dims == 1 ? "" : "s",
+                   num_indices);
+
+    for (int i = 0; i < num_indices; i++)
+    {
+        ValueType index = type_expression(tc, indices[i]);
+        if (index != VAL_INT && index != VAL_NONE)
+            type_error(tc, indices[i]->line, "index of %s must be INTEGER, not %s", name, type_name(index));
+    }
+}
+
+static void type_arguments(TypeChecker *tc, ASTNode *call, ASTNode *sub)
+{
+    if (call->call.num_args != sub->subroutine.num_params)
+    {
+        type_error(tc, call->line, "%s takes %d argument%s, called with %d", sub->subroutine.name,
+                   sub->subroutine.num_params, sub->subroutine.num_params == 1 ? "" : "s", call->call.num_args);
+    }
+
+    for (int i = 0; i < call->call.num_args; i++)
+    {
+        ASTNode *arg = call->call.arguments[i];
+        ValueType value = type_expression(tc, arg);
+        if (i >= sub->subroutine.num_params)
+            continue;
+
+        ASTNode *param = sub->subroutine.parameters[i];
+        if (is_array_type(param->param.param_type))
+        {
+            if (value != VAL_ARRAY && value != VAL_NONE)
+                type_error(tc, arg->line, "argument %d of %s must be an array, not %s", i + 1, sub->subroutine.name,
+                           type_name(value));
+        }
+        else if (!type_assignable(declared_value_type(param->param.param_type), value) ||
+                 (param->param.is_reference && value == VAL_INT &&
+                  declared_value_type(param->param.param_type) == VAL_REAL))
+        {
+            type_error(tc, arg->line, "argument %d of %s must be %s, not %s", i + 1, sub->subroutine.name,
+                       type_name(declared_value_type(param->param.param_type)), type_name(value));
+        }
+    }
+}
+
+// Operators whose operands have the same known type start quickened
+static void type_quicken(ASTNode *expr, ValueType left, ValueType right)
+{
+    if (left == right && (left == VAL_INT || left == VAL_REAL || left == VAL_BOOL))
+        quick_observe(expr, left, right);
+}
+
+static ValueType type_binary(TypeChecker *tc, ASTNode *expr)
+{
+    ValueType left = type_expression(tc, expr->binary.left);
+    ValueType right = type_expression(tc, expr->binary.right);
+    BinaryOperator op = quick_operator(expr->binary.operator);
+    type_quicken(expr, left, right);
+
+    switch (op)
+    {
+    case BINOP_ADD:
+    case BINOP_SUB:
+    case BINOP_MUL:
+    case BINOP_DIVIDE:
+        if (!type_numeric(left) || !type_numeric(right))
+        {
+            type_error(tc, expr->line, "operator %s needs numbers, not %s and %s", expr->binary.operator,
+                       type_name(left), type_name(right));
+            return VAL_NONE;
+        }
+        if (op == BINOP_DIVIDE || left == VAL_REAL || right == VAL_REAL)
+            return VAL_REAL;
+        return left == VAL_INT && right == VAL_INT ? VAL_INT : VAL_NONE;
+
+    case BINOP_DIV:
+    case BINOP_MOD:
+        if ((left != VAL_INT && left != VAL_NONE) || (right != VAL_INT && right != VAL_NONE))
+            type_error(tc, expr->line, "operator %s needs INTEGER operands, not %s and %s", expr->binary.operator,
+                       type_name(left), type_name(right));
+        return VAL_INT;
+
+    case BINOP_AND:
+    case BINOP_OR:
+        if ((left != VAL_BOOL && left != VAL_NONE) || (right != VAL_BOOL && right != VAL_NONE))
+            type_error(tc, expr->line, "operator %s needs BOOLEAN operands, not %s and %s", expr->binary.operator,
+                       type_name(left), type_name(right));
+        return VAL_BOOL;
+
+    case BINOP_OTHER:
+        return VAL_NONE;
+
+    default: // Comparisons
+        if (!(type_numeric(left) && type_numeric(right)) && left != right && left != VAL_NONE && right != VAL_NONE)
+            type_error(tc, expr->line, "cannot compare %s with %s", type_name(left), type_name(right));
+        return VAL_BOOL;
+    }
+}
+
+static ValueType type_expression(TypeChecker *tc, ASTNode *expr)
+{
+    if (!expr)
+        return VAL_NONE;
+
+    ValueType type = VAL_NONE;
+    switch (expr->type)
+    {
+    case AST_LITERAL:
+        type = expr->literal.value.type;
+        break;
+
+    case AST_IDENTIFIER:
+    {
+        TypeSymbol *sym = type_lookup(tc, expr->identifier.name);
+        if (sym && !sym->subroutine)
+            type = sym->type;
+        else if (sym && sym->subroutine == tc->subroutine) // A function's result so far
+            type = sym->type;
+        break;
+    }
+
+    case AST_ARRAY_ACCESS:
+    {
+        type_indices(tc, expr, expr->array_access.name, expr->array_access.indices, expr->array_access.num_indices);
+        TypeSymbol *sym = type_lookup(tc, expr->array_access.name);
+        if (sym && sym->type == VAL_ARRAY)
+            type = sym->element;
+        break;
+    }
+
+    case AST_CALL:
+    {
+        TypeSymbol *sym = type_lookup(tc, expr->call.name);
+        if (sym && sym->subroutine)
+        {
+            if (sym->subroutine->type != AST_FUNC_DECL)
+                type_error(tc, expr->line, "%s is a procedure and has no value", expr->call.name);
+            type_arguments(tc, expr, sym->subroutine);
+            type = sym->type;
+        }
+        else
+        {
+            for (int i = 0; i < expr->call.num_args; i++)
+                type_expression(tc, expr->call.arguments[i]);
+        }
+        break;
+    }
+
+    case AST_UNARY_OP:
+    {
+        ValueType operand = type_expression(tc, expr->unary.operand);
+        if (strcmp(expr->unary.operator, "-") == 0)
+        {
+            if (!type_numeric(operand))
+                type_error(tc, expr->line, "cannot negate a %s", type_name(operand));
+            else
+                type = operand;
+        }
+        else
+        {
+            if (operand != VAL_BOOL && operand != VAL_NONE)
+                type_error(tc, expr->line, "operator %s needs a BOOLEAN operand, not %s", expr->unary.operator,
+                           type_name(operand));
+            type = VAL_BOOL;
+        }
+        break;
+    }
+
+    case AST_BINARY_OP:
+        type = type_binary(tc, expr);
+        break;
+
+    default:
+        break;
+    }
+
+    expr->static_type = type;
+    return type;
+}
+
+static void type_block(TypeChecker *tc, ASTNode **stmts, int count);
+
+static void type_condition(TypeChecker *tc, ASTNode *condition, const char *statement)
+{
+    ValueType type = type_expression(tc, condition);
+    if (type != VAL_BOOL && type != VAL_NONE)
+        type_error(tc, condition->line, "condition of %s must be BOOLEAN, not %s", statement, type_name(type));
+}
+
+// Type of an assignment target; arrays are checked like an access
+static ValueType type_target(TypeChecker *tc, ASTNode *node, const char *name, ASTNode **indices, int num_indices)
+{
+    if (tc->subroutine && tc->subroutine->type == AST_FUNC_DECL && num_indices == 0 &&
+        str_equals_ignore_case(name, tc->subroutine->subroutine.name))
+        return declared_value_type(tc->subroutine->subroutine.return_type);
+
+    TypeSymbol *sym = type_lookup(tc, name);
+    if (num_indices > 0)
+    {
+        type_indices(tc, node, name, indices, num_indices);
+        return sym && sym->type == VAL_ARRAY ? sym->element : VAL_NONE;
+    }
+    if (sym && sym->subroutine)
+    {
+        type_error(tc, node->line, "cannot assign to %s %s", sym->subroutine->type == AST_FUNC_DECL ? "function" : "procedure",
+                   name);
+        return VAL_NONE;
+    }
+    if (sym && sym->type == VAL_ARRAY)
+    {
+        type_error(tc, node->line, "cannot assign to the whole array %s", name);
+        return VAL_NONE;
+    }
+    return sym ? sym->type : VAL_NONE;
+}
+
+static void type_statement(TypeChecker *tc, ASTNode *stmt)
+{
+    switch (stmt->type)
+    {
+    case AST_ASSIGN:
+    {
+        ValueType target = type_target(tc, stmt, stmt->assign.identifier, stmt->assign.indices, stmt->assign.num_indices);
+        ValueType value = type_expression(tc, stmt->assign.value);
+        if (!type_assignable(target, value))
+            type_error(tc, stmt->line, "cannot assign %s to %s %s", type_name(value), type_name(target),
+                       stmt->assign.identifier);
+        stmt->static_type = target;
+        break;
+    }
+
+    case AST_PRINT:
+        for (int i = 0; i < stmt->print.num_exprs; i++)
+            type_expression(tc, stmt->print.expressions[i]);
+        break;
+
+    case AST_READ:
+        for (int i = 0; i < stmt->read.num_vars; i++)
+        {
+            ASTNode *var = stmt->read.variables[i];
+            if (var->type == AST_ARRAY_ACCESS)
+                var->static_type = type_target(tc, var, var->array_access.name, var->array_access.indices,
+                                               var->array_access.num_indices);
+            else if (var->type == AST_IDENTIFIER)
+                var->static_type = type_target(tc, var, var->identifier.name, NULL, 0);
+        }
+        break;
+
+    case AST_IF:
+        type_condition(tc, stmt->if_stmt.condition, "ΕΑΝ");
+        type_block(tc, stmt->if_stmt.then_branch, stmt->if_stmt.num_then);
+        type_block(tc, stmt->if_stmt.else_branch, stmt->if_stmt.num_else);
+        break;
+
+    case AST_FOR:
+    {
+        // The interpreter counts in integers, truncating REAL bounds
+        ValueType var = type_target(tc, stmt, stmt->for_loop.variable, NULL, 0);
+        if (!type_numeric(var))
+            type_error(tc, stmt->line, "loop variable %s must be a number, not %s", stmt->for_loop.variable,
+                       type_name(var));
+        ASTNode *parts[3] = {stmt->for_loop.start, stmt->for_loop.end, stmt->for_loop.step};
+        const char *names[3] = {"start", "end", "step"};
+        for (int i = 0; i < 3; i++)
+        {
+            ValueType type = type_expression(tc, parts[i]);
+            if (!type_numeric(type))
+                type_error(tc, parts[i]->line, "%s of the loop over %s must be a number, not %s", names[i],
+                           stmt->for_loop.variable, type_name(type));
+        }
+        type_block(tc, stmt->for_loop.body, stmt->for_loop.num_stmts);
+        break;
+    }
+
+    case AST_WHILE:
+        type_condition(tc, stmt->while_loop.condition, stmt->while_loop.is_repeat_until ? "ΜΕΧΡΙ" : "ΕΝΟΣΩ");
+        type_block(tc, stmt->while_loop.body, stmt->while_loop.num_stmts);
+        break;
+
+    case AST_CALL:
+    {
+        TypeSymbol *sym = type_lookup(tc, stmt->call.name);
+        if (sym && sym->subroutine)
+            type_arguments(tc, stmt, sym->subroutine);
+        else
+            for (int i = 0; i < stmt->call.num_args; i++)
+                type_expression(tc, stmt->call.arguments[i]);
+        break;
+    }
+
+    default:
+        break;
+    }
+}
+
+static void type_block(TypeChecker *tc, ASTNode **stmts, int count)
+{
+    for (int i = 0; i < count; i++)
+        type_statement(tc, stmts[i]);
+}
+
+// Returns the number of errors reported
+static int typecheck_program(ASTNode *prog)
+{
+    TypeChecker tc = {0};
+    for (int i = 0; i < prog->program.num_decls; i++)
+    {
+        ASTNode *decl = prog->program.declarations[i];
+        if (decl->type == AST_CONST_DECL)
+        {
+            type_add(&tc, decl->decl.name, type_expression(&tc, decl->decl.value));
+        }
+        else if (decl->type == AST_VAR_DECL)
+        {
+            type_add_declaration(&tc, decl);
+        }
+        else if (decl->type == AST_FUNC_DECL || decl->type == AST_PROC_DECL)
+        {
+            TypeSymbol *sym = type_add(&tc, decl->subroutine.name, declared_value_type(decl->subroutine.return_type));
+            sym->subroutine = decl;
+        }
+    }
+    tc.num_globals = tc.num_symbols;
+
+    for (int i = 0; i < prog->program.num_decls; i++)
+    {
+        ASTNode *sub = prog->program.declarations[i];
+        if (sub->type != AST_FUNC_DECL && sub->type != AST_PROC_DECL)
+            continue;
+
+        tc.num_symbols = tc.num_globals;
+        tc.subroutine = sub;
+        for (int j = 0; j < sub->subroutine.num_params; j++)
+        {
+            ASTNode *param = sub->subroutine.parameters[j];
+            if (is_array_type(param->param.param_type))
+            {
+                TypeSymbol *sym = type_add(&tc, param->param.name, VAL_ARRAY);
+                const char *of = strstr(param->param.param_type, " OF ");
+                sym->element = declared_value_type(of ? of + 4 : NULL);
+            }
+            else
+            {
+                param->static_type = declared_value_type(param->param.param_type);
+                type_add(&tc, param->param.name, param->static_type);
+            }
+        }
+        for (int j = 0; j < sub->subroutine.num_local_decls; j++)
+            type_add_declaration(&tc, sub->subroutine.local_decls[j]);
+        type_block(&tc, sub->subroutine.body, sub->subroutine.num_stmts);
+    }
+
+    tc.num_symbols = tc.num_globals;
+    tc.subroutine = NULL;
+    type_block(&tc, prog->program.body, prog->program.num_stmts);
+
+    free(tc.symbols);
+    return tc.errors;
+}
+
+// ============================================================================
+// INTERPRETER
+// ============================================================================
+
+// An operator on operands of any type, after the quickened paths gave up
+static RuntimeValue binary_generic(BinaryOperator op, RuntimeValue *left, RuntimeValue *right)
+{
+    RuntimeValue result;
+    memset(&result, 0, sizeof(RuntimeValue));
+    result.type = VAL_INT;
+
+    switch (op)
+    {
+    case BINOP_ADD:
+    case BINOP_SUB:
+    case BINOP_MUL:
+        if (left->type == VAL_REAL || right->type == VAL_REAL)
+        {
+            double l = left->type == VAL_REAL ? left->value.real_val : left->value.int_val;
+            double r = right->type == VAL_REAL ? right->value.real_val : right->value.int_val;
+            result.type = VAL_REAL;
+            result.value.real_val = op == BINOP_ADD ? l + r : op == BINOP_SUB ? l - r : l * r;
+        }
+        else
+        {
+            int l = left->value.int_val;
+            int r = right->value.int_val;
+            result.value.int_val = op == BINOP_ADD ? l + r : op == BINOP_SUB ? l - r : l * r;
+        }
+        break;
+    case BINOP_DIVIDE:
+    {
+        result.type = VAL_REAL;
+        double l = left->type == VAL_REAL ? left->value.real_val : left->value.int_val;
+        double r = right->type == VAL_REAL ? right->value.real_val : right->value.int_val;
+        if (r == 0)
+        {
+            fprintf(stderr, "Runtime Error: Division by zero\n");
+            exit(1);
+        }
+        result.value.real_val = l / r;
+        break;
+    }
+    case BINOP_DIV:
+    case BINOP_MOD:
+    {
+        int r = to_int(right);
+        if (r == 0)
+        {
+            fprintf(stderr, "Runtime Error: %s by zero\n", op == BINOP_MOD ? "Modulo" : "Division");
+            exit(1);
+        }
+        result.value.int_val = op == BINOP_DIV ? to_int(left) / r : to_int(left) % r;
+        break;
+    }
+    case BINOP_EQ:
+    case BINOP_NE:
+    {
+        // Non-numeric operands compare as 0
+        result.type = VAL_BOOL;
+        double l = left->type == VAL_REAL ? left->value.real_val : (left->type == VAL_INT ? left->value.int_val : 0);
+        double r = right->type == VAL_REAL ? right->value.real_val : (right->type == VAL_INT ? right->value.int_val : 0);
+        result.value.bool_val = op == BINOP_EQ ? l == r : l != r;
+        break;
+    }
+    case BINOP_LT:
+    case BINOP_GT:
+    case BINOP_LE:
+    case BINOP_GE:
+    {
+        result.type = VAL_BOOL;
+        double l = (left->type == VAL_REAL) ? left->value.real_val : (double)left->value.int_val;
+        double r = (right->type == VAL_REAL) ? right->value.real_val : (double)right->value.int_val;
+        result.value.bool_val = op == BINOP_LT ? l < r : op == BINOP_GT ? l > r : op == BINOP_LE ? l <= r : l >= r;
+        break;
+    }
+    case BINOP_AND:
+        result.type = VAL_BOOL;
+        result.value.bool_val = to_bool(left) && to_bool(right);
+        break;
+    case BINOP_OR:
+        result.type = VAL_BOOL;
+        result.value.bool_val = to_bool(left) || to_bool(right);
+        break;
+    default:
+        break;
+    }
+    return result;
+}
+
+// One value of a ΤΥΠΩΣΕ list; position is its index in the list
+static void print_value(RuntimeValue *val, int position)
+{
+    // Check for EOLN
+    if (val->type == VAL_STRING && strcmp(val->value.str_val, "__EOLN__") == 0)
+    {
+        printf("\n");
+        return;
+    }
+    if (position > 0)
+        printf(" ");
+
+    switch (val->type)
+    {
+    case VAL_INT:
+        printf("%d", val->value.int_val);
+        break;
+    case VAL_REAL:
+        printf("%g", val->value.real_val);
+        break;
+    case VAL_BOOL:
+        printf("%s", val->value.bool_val ? "TRUE" : "FALSE");
+        break;
+    case VAL_STRING:
+        printf("%s", val->value.str_val);
+        break;
+    default:
+        break;
+    }
+}
+
+// The value of a line of input read into var. An empty line reads as -1 (or
+// "-1" into a string), whatever the variable. With
+// a declared type the whole line must be a value of that type, so the variable
+// keeps its type; without one (--no-typecheck) the type is guessed from the text.
+static RuntimeValue read_value(const char *input, ASTNode *var)
+{
+    ValueType type = var->static_type;
+    RuntimeValue val;
+    memset(&val, 0, sizeof(RuntimeValue));
+
+    if (type == VAL_STRING)
+    {
+        val.type = VAL_STRING;
+        val.value.str_val = strdup(strlen(input) ? input : "-1");
+        return val;
+    }
+    if (type == VAL_NONE)
+    {
+        if (strlen(input) == 0)
+        {
+            val.type = VAL_INT;
+            val.value.int_val = -1;
+        }
+        else if (strchr(input, '.'))
+        {
+            val.type = VAL_REAL;
+            val.value.real_val = atof(input);
+        }
+        else if (isdigit(input[0]) || input[0] == '-')
+        {
+            val.type = VAL_INT;
+            val.value.int_val = atoi(input);
+        }
+        else
+        {
+            val.type = VAL_STRING;
+            val.value.str_val = strdup(input);
+        }
+        return val;
+    }
+
+    // Surrounding blanks (and the '\r' of a Windows line end) are not part of
+    // the value
+    char text[256];
+    while (isspace((unsigned char)*input))
+        input++;
+    snprintf(text, sizeof(text), "%s", input);
+    size_t len = strlen(text);
+    while (len > 0 && isspace((unsigned char)text[len - 1]))
+        text[--len] = '\0';
+
+    val.type = type;
+    char *end = text;
+    errno = 0;
+    if (type == VAL_INT)
+    {
+        long number = len ? strtol(text, &end, 10) : -1;
+        if (number < INT_MIN || number > INT_MAX)
+            errno = ERANGE;
+        val.value.int_val = (int)number;
+    }
+    else if (type == VAL_REAL)
+    {
+        val.value.real_val = len ? strtod(text, &end) : -1;
+    }
+    else if (type == VAL_BOOL)
+    {
+        val.value.bool_val = is_keyword(text, "ΑΛΗΘΗΣ") || is_keyword(text, "TRUE");
+        if (val.value.bool_val || is_keyword(text, "ΨΕΥΔΗΣ") || is_keyword(text, "FALSE"))
+            end = text + len;
+    }
+
+    if (*end || errno || (len == 0 && type == VAL_BOOL))
+    {
+        fflush(stdout);
+        fprintf(stderr, "Runtime Error: Cannot read '%s' into %s: not a valid %s\n", text,
+                var->type == AST_ARRAY_ACCESS ? var->array_access.name : var->identifier.name, type_name(type));
+        exit(1);
+    }
+    return val;
+}
+
+static RuntimeValue evaluate(ASTNode *expr, Environment *env)
+{
+    RuntimeValue result;
+    memset(&result, 0, sizeof(RuntimeValue));
+    result.type = VAL_NONE;
+
+    if (!expr)
+        return result;
+
+    switch (expr->type)
+    {
+    case AST_LITERAL:
+        // ΠΑΝΤΑ επιστρέφουμε αντίγραφο για να αποφύγουμε double-free με το AST
+        return copy_runtime_value(&expr->literal.value);
+
+    case AST_IDENTIFIER:
+    {
+        RuntimeValue *val = env_get(env, expr->identifier.name);
+        return copy_runtime_value(val);
+    }
+
+    case AST_BINARY_OP:
+    {
+        RuntimeValue left = evaluate(expr->binary.left, env);
+        RuntimeValue right = evaluate(expr->binary.right, env);
+        if (cost_enabled)
+            cost_count(cost_operator_kind(expr->binary.operator));
+
+        switch (expr->binary.quick)
+        {
+        case QUICK_INT:
+            if (left.type == VAL_INT && right.type == VAL_INT)
+                return quick_int((BinaryOperator)expr->binary.op, left.value.int_val, right.value.int_val);
+            quick_deoptimize(expr);
+            break;
+        case QUICK_REAL:
+            if (left.type == VAL_REAL && right.type == VAL_REAL)
+                return quick_real((BinaryOperator)expr->binary.op, left.value.real_val, right.value.real_val);
+            quick_deoptimize(expr);
+            break;
+        case QUICK_BOOL:
+            if (left.type == VAL_BOOL && right.type == VAL_BOOL)
+            {
+                result.type = VAL_BOOL;
+                result.value.bool_val = expr->binary.op == BINOP_AND ? left.value.bool_val && right.value.bool_val
+                                                                     : left.value.bool_val || right.value.bool_val;
+                return result;
+            }
+            quick_deoptimize(expr);
+            break;
+        case QUICK_UNSEEN:
+            quick_observe(expr, left.type, right.type);
+            break;
+        default:
+            break;
+        }
+
+        result = binary_generic((BinaryOperator)expr->binary.op, &left, &right);
+
+        // Καθαρισμός προσωρινών τιμών
+        free_runtime_value(&left);
+        free_runtime_value(&right);
+        return result;
+    }
+
+    case AST_UNARY_OP:
+    {
+        RuntimeValue operand = evaluate(expr->unary.operand, env);
+        if (cost_enabled)
+            cost_count(strcmp(expr->unary.operator, "-") == 0 ? COST_ARITHMETIC : COST_LOGICAL);
+        if (strcmp(expr->unary.operator, "-") == 0)
+        {
+            if (operand.type == VAL_REAL)
+            {
+                result.type = VAL_REAL;
+                result.value.real_val = -operand.value.real_val;
+            }
+            else
+            {
+                result.type = VAL_INT;
+                result.value.int_val = -operand.value.int_val;
+            }
+        }
+        else if (str_equals_ignore_case(expr->unary.operator, "NOT") || str_equals_ignore_case(expr->unary.operator, "ΟΧΙ"))
+        {
+
+            result.type = VAL_BOOL;
+            bool operand_bool = to_bool(&operand);
+            result.value.bool_val = !operand_bool;
+            result.value.bool_val = !to_bool(&operand);
+        }
+
+        free_runtime_value(&operand);
+        return result;
+    }
+
+    case AST_ARRAY_ACCESS:
+    {
+        RuntimeValue *arr_val = env_get(env, expr->array_access.name);
+        int indices[MAX_ARRAY_DIMS];
+        for (int i = 0; i < expr->array_access.num_indices; i++)
+        {
+            RuntimeValue idx = evaluate(expr->array_access.indices[i], env);
+            indices[i] = to_int(&idx);
+            free_runtime_value(&idx);
+        }
+        if (cost_enabled)
+            cost_count(COST_ARRAY_READ);
+        // ΠΡΟΣΟΧΗ: Παίρνουμε την τιμή από τον πίνακα και επιστρέφουμε ΑΝΤΙΓΡΑΦΟ
+        RuntimeValue val_in_array = expr->array_access.unchecked
+                                        ? array_get_unchecked(arr_val->value.arr_val, indices, expr->array_access.num_indices)
+                                        : array_get(arr_val->value.arr_val, indices, expr->array_access.num_indices);
+        return copy_runtime_value(&val_in_array);
+    }
+
+    case AST_CALL:
+    {
+
+        ASTNode *function = env_get_subroutine(env, expr->call.name);
+
+        if (!function || function->type != AST_FUNC_DECL)
+        {
+            fprintf(stderr, "Runtime Error: %s is not a function\n", expr->call.name);
+            exit(1);
+        }
+        limit_check(expr->line, expr->call.name);
+        if (cost_enabled)
+            cost_count(COST_CALL);
+
+        // Hot functions run natively once compiled (--jit)
+        if (jit_enabled && jit_try_call(function, expr->call.arguments, expr->call.num_args, env, &result))
+            return result;
+        int jit_caller = jit_enter(function);
+
+        // Create environment with parent for global access
+        Environment *func_env = create_environment(env);
+
+        // Initialize local variables
+        if (function->subroutine.local_decls)
+        {
+            for (int i = 0; i < function->subroutine.num_local_decls; i++)
+            {
+                ASTNode *decl = function->subroutine.local_decls[i];
+                if (decl->decl.num_arr_dims > 0)
+                    continue;
+                env_define(func_env, decl->decl.name, declared_variable_value(decl));
+            }
+        }
+
+        // Bind parameters
+        for (int i = 0; i < function->subroutine.num_params && i < expr->call.num_args; i++)
+        {
+            ASTNode *param = function->subroutine.parameters[i];
+            ASTNode *arg = expr->call.arguments[i];
+
+            // Handle array parameters
+            if (arg->type == AST_IDENTIFIER)
+            {
+                RuntimeValue *potential_array = env_get(env, arg->identifier.name);
+                if (potential_array && potential_array->type == VAL_ARRAY)
+                { // <-- ΑΦΑΙΡΕΣΗ του && param->param.is_reference
+                    RuntimeValue array_ref;
+                    array_ref.type = VAL_ARRAY;
+                    array_ref.value.arr_val = potential_array->value.arr_val;
+                    env_define(func_env, param->param.name, array_ref);
+                    continue;
+                }
+            }
+
+            RuntimeValue arg_val = evaluate(arg, env);
+            type_coerce(&arg_val, param->static_type);
+            env_define(func_env, param->param.name, arg_val);
+            free_runtime_value(&arg_val);
+        }
+
+        define_local_arrays(function, func_env);
+
+        // Initialize return variable
+        env_define(func_env, function->subroutine.name, declared_initial_value(function->subroutine.return_type));
+
+        // Execute function body
+        ProfileFrame profile_frame;
+        CostFrame cost_frame;
+        if (profile_enabled)
+            profile_enter_subroutine(function, &profile_frame);
+        if (cost_enabled)
+            cost_enter_subroutine(function, &cost_frame);
+        coverage_hit(function);
+        if (sample_enabled)
+            sample_push(function);
+        if (trace_enabled)
+            trace_begin(function->subroutine.name, "call", expr->line);
+        execute_block(function->subroutine.body, function->subroutine.num_stmts, func_env);
+        if (trace_enabled)
+            trace_end();
+        if (sample_enabled)
+            sample_pop();
+        if (cost_enabled)
+            cost_leave_subroutine(&cost_frame);
+        if (profile_enabled)
+            profile_leave_subroutine(&profile_frame);
+        jit_leave(jit_caller);
+
+        // Copy back reference parameters
+        for (int i = 0; i < function->subroutine.num_params && i < expr->call.num_args; i++)
+        {
+            ASTNode *param = function->subroutine.parameters[i];
+            ASTNode *arg = expr->call.arguments[i];
+
+            if (param->param.is_reference)
+            {
+                RuntimeValue *func_val = env_get(func_env, param->param.name);
+
+                if (func_val->type == VAL_ARRAY)
+                    continue;
+
+                if (arg->type == AST_IDENTIFIER)
+                {
+                    env_assign(env, arg->identifier.name, *func_val);
+                }
+            }
+        }
+
+        // Get return value
+        RuntimeValue *return_val = env_get(func_env, function->subroutine.name);
+        RuntimeValue fn_result = copy_runtime_value(return_val);
+
+        return fn_result;
+    }
+
+    default:
+        result.type = VAL_INT;
+        result.value.int_val = 0;
+        return result;
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Statement dispatch
+// ----------------------------------------------------------------------------
+// execute_block runs a list of statements. Built with GCC or Clang it uses
+// threaded dispatch: each statement handler ends by looking up the handler of
+// the next statement and jumping there itself (labels as values). Every
+// handler then has an indirect jump of its own, which the branch predictor
+// learns per kind of statement, where a switch in a loop sends all statements
+// through one shared jump. Other compilers, and builds with
+// -DEAP_NO_COMPUTED_GOTO, use the switch. evaluate keeps its switch: it
+// recurses once per node, so there is no next node to jump to.
+
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(EAP_NO_COMPUTED_GOTO)
+#define EAP_COMPUTED_GOTO 1
+#else
+#define EAP_COMPUTED_GOTO 0
+#endif
+
+#if EAP_COMPUTED_GOTO
+#define STATEMENT_CASE(type) do_##type:
+#define STATEMENT_DEFAULT do_default:
+#define NEXT_STATEMENT                                  \
+    do                                                  \
+    {                                                   \
+        statement_end(stmt, &profile_frame, traced);    \
+        if (++pc == count)                              \
+            return;                                     \
+        stmt = stmts[pc];                               \
+        traced = statement_begin(stmt, &profile_frame); \
+        goto *statement_handlers[stmt->type];           \
+    } while (0)
+#else
+#define STATEMENT_CASE(type) case type:
+#define STATEMENT_DEFAULT default:
+#define NEXT_STATEMENT break
+#endif
+
+// Bookkeeping of the profilers and limits around every statement
+static inline bool statement_begin(ASTNode *stmt, ProfileFrame *profile_frame)
+{
+    stats.statements++;
+    coverage_hit(stmt);
+    if (profile_enabled)
+    {
+        memset(profile_frame, 0, sizeof(ProfileFrame));
+        profile_begin(profile_frame);
+    }
+    if (sample_enabled)
+        sample_line(stmt->line);
+    bool traced = trace_enabled && (stmt->type == AST_PRINT || stmt->type == AST_READ);
+    if (traced)
+        trace_begin(stmt->type == AST_PRINT ? "ΤΥΠΩΣΕ" : "ΔΙΑΒΑΣΕ", "io", stmt->line);
+    return traced;
+}
+
+static inline void statement_end(ASTNode *stmt, ProfileFrame *profile_frame, bool traced)
+{
+    if (traced)
+        trace_end();
+    if (profile_enabled)
+        profile_end_statement(profile_frame, stmt->line);
+}
+
+static void execute_block(ASTNode **stmts, int count, Environment *env)
+{
+    ASTNode *stmt;
+    ProfileFrame profile_frame;
+    bool traced;
+    int pc = 0;
+
+#if EAP_COMPUTED_GOTO
+    static void *const statement_handlers[] = {
+        [AST_PROGRAM] = &&do_default,   [AST_CONST_DECL] = &&do_default,  [AST_VAR_DECL] = &&do_default,
+        [AST_ARRAY_TYPE] = &&do_default, [AST_FUNC_DECL] = &&do_default,  [AST_PROC_DECL] = &&do_default,
+        [AST_PARAMETER] = &&do_default, [AST_ASSIGN] = &&do_AST_ASSIGN,   [AST_PRINT] = &&do_AST_PRINT,
+        [AST_READ] = &&do_AST_READ,     [AST_IF] = &&do_AST_IF,           [AST_FOR] = &&do_AST_FOR,
+        [AST_WHILE] = &&do_AST_WHILE,   [AST_CALL] = &&do_AST_CALL,       [AST_BINARY_OP] = &&do_default,
+        [AST_UNARY_OP] = &&do_default,  [AST_LITERAL] = &&do_default,     [AST_IDENTIFIER] = &&do_default,
+        [AST_ARRAY_ACCESS] = &&do_default,
+    };
+
+    if (count <= 0)
+        return;
+    stmt = stmts[0];
+    traced = statement_begin(stmt, &profile_frame);
+    goto *statement_handlers[stmt->type];
+    {
+#else
+    for (; pc < count; pc++)
+    {
+        stmt = stmts[pc];
+        traced = statement_begin(stmt, &profile_frame);
+
+        switch (stmt->type)
+        {
+#endif
+
+    STATEMENT_CASE(AST_ASSIGN)
+    {
+        RuntimeValue val = evaluate(stmt->assign.value, env);
+        type_coerce(&val, stmt->static_type);
+        if (cost_enabled)
+            cost_count(stmt->assign.num_indices > 0 ? COST_ARRAY_WRITE : COST_ASSIGNMENT);
+
+        if (stmt->assign.num_indices > 0)
+        {
+            // Ανάθεση σε πίνακα: A[indices] := value
+            RuntimeValue *arr_runtime = env_get(env, stmt->assign.identifier);
+            if (arr_runtime && arr_runtime->type == VAL_ARRAY)
+            {
+                int indices[MAX_ARRAY_DIMS];
+                for (int i = 0; i < stmt->assign.num_indices; i++)
+                {
+                    RuntimeValue idx_val = evaluate(stmt->assign.indices[i], env);
+                    indices[i] = to_int(&idx_val);
+                    free_runtime_value(&idx_val);
+                }
+                // Κλήση της συνάρτησης που φτιάξαμε
+                array_set(arr_runtime->value.arr_val, indices, stmt->assign.num_indices, val);
+            }
+        }
+        else
+        {
+            // Απλή μεταβλητή
+            env_assign(env, stmt->assign.identifier, val);
+        }
+        free_runtime_value(&val);
+        NEXT_STATEMENT;
+    }
+
+    STATEMENT_CASE(AST_PRINT)
+    {
+        for (int i = 0; i < stmt->print.num_exprs; i++)
+        {
+            RuntimeValue val = evaluate(stmt->print.expressions[i], env);
+            print_value(&val, i);
+            free_runtime_value(&val);
+        }
+        NEXT_STATEMENT;
+    }
+
+    STATEMENT_CASE(AST_READ)
+    {
+        for (int i = 0; i < stmt->read.num_vars; i++)
+        {
+            ASTNode *var = stmt->read.variables[i];
+            char input[256];
+
+            fflush(stdout);
+
+            if (fgets(input, sizeof(input), stdin) == NULL)
+            {
+                // EOF handling
+                break;
+            }
+
+            input[strcspn(input, "\n")] = 0;
+
+            // Δημιουργία RuntimeValue από το input
+            RuntimeValue val = read_value(input, var);
+
+            // ΝΕΟ: Χειρισμός array access
+            if (var->type == AST_ARRAY_ACCESS)
+            {
+                // Βρες τον πίνακα
+                RuntimeValue *arr_val = env_get(env, var->array_access.name);
+
+                if (arr_val && arr_val->type == VAL_ARRAY)
+                {
+                    // Υπολόγισε τους δείκτες
+                    int indices[MAX_ARRAY_DIMS];
+                    for (int j = 0; j < var->array_access.num_indices; j++)
+                    {
+                        RuntimeValue idx = evaluate(var->array_access.indices[j], env);
+                        indices[j] = to_int(&idx);
+                        free_runtime_value(&idx);
+                    }
+
+                    // ΚΡΙΣΙΜΟ: Αποθήκευσε την τιμή στον πίνακα
+                    array_set(arr_val->value.arr_val, indices, var->array_access.num_indices, val);
+                    if (cost_enabled)
+                        cost_count(COST_ARRAY_WRITE);
+
+                    DEBUG_LOG("READ: Set %s[%d] = %d", var->array_access.name, indices[0],
+                              val.type == VAL_INT ? val.value.int_val : 0);
+                }
+            }
+            else if (var->type == AST_IDENTIFIER)
+            {
+                // Απλή μεταβλητή
+                env_assign(env, var->identifier.name, val);
+            }
+
+            if (val.type == VAL_STRING)
+            {
+                free_runtime_value(&val);
+            }
+        }
+        NEXT_STATEMENT;
+    }
+
+    STATEMENT_CASE(AST_IF)
+    {
+        RuntimeValue cond = evaluate(stmt->if_stmt.condition, env);
+
+        if (to_bool(&cond))
+        {
+            coverage_taken(stmt);
+            execute_block(stmt->if_stmt.then_branch, stmt->if_stmt.num_then, env);
+        }
+        else if (stmt->if_stmt.else_branch)
+        {
+            execute_block(stmt->if_stmt.else_branch, stmt->if_stmt.num_else, env);
+        }
+
+        free_runtime_value(&cond);
+        NEXT_STATEMENT;
+    }
+
+    STATEMENT_CASE(AST_FOR)
+    {
+        fflush(stdout);
+
+        RuntimeValue start_val = evaluate(stmt->for_loop.start, env);
+        RuntimeValue end_val = evaluate(stmt->for_loop.end, env);
+        RuntimeValue step_val = evaluate(stmt->for_loop.step, env);
+
+        int start = to_int(&start_val);
+        int end = to_int(&end_val);
+        int step = to_int(&step_val);
+
+        fflush(stdout);
+
+        if (start_val.type != VAL_ARRAY)
+            free_runtime_value(&start_val);
+        if (end_val.type != VAL_ARRAY)
+            free_runtime_value(&end_val);
+        if (step_val.type != VAL_ARRAY)
+            free_runtime_value(&step_val);
+
+        fflush(stdout);
+
+        // Array accesses proven in bounds for the whole loop skip their checks
+        BcePlan *bce = bce_plan(stmt);
+        bce_enter(bce, stmt, start, end, step, env);
+
+        int current = start;
+
+        if (step > 0)
+        {
+            while (current <= end)
+            {
+                fflush(stdout);
+
+                RuntimeValue loop_var;
+                loop_var.type = VAL_INT;
+                loop_var.value.int_val = current;
+
+                fflush(stdout);
+
+                env_assign(env, stmt->for_loop.variable, loop_var);
+                if (cost_enabled)
+                    cost_for_iteration();
+
+                fflush(stdout);
+
+                execute_block(stmt->for_loop.body, stmt->for_loop.num_stmts, env);
+                coverage_taken(stmt);
+                if (jit_enabled)
+                    jit_backedge();
+                limit_check(stmt->line, NULL);
+
+                fflush(stdout);
+                current += step;
+            }
+        }
+        else
+        {
+            while (current >= end)
+            {
+                RuntimeValue loop_var;
+                loop_var.type = VAL_INT;
+                loop_var.value.int_val = current;
+                env_assign(env, stmt->for_loop.variable, loop_var);
+                if (cost_enabled)
+                    cost_for_iteration();
+
+                execute_block(stmt->for_loop.body, stmt->for_loop.num_stmts, env);
+                coverage_taken(stmt);
+                if (jit_enabled)
+                    jit_backedge();
+                limit_check(stmt->line, NULL);
+
+                current += step;
+            }
+        }
+
+        bce_leave(bce);
+        fflush(stdout);
+        NEXT_STATEMENT;
+    }
+
+    STATEMENT_CASE(AST_WHILE)
+    {
+        if (stmt->while_loop.is_repeat_until)
+        {
+            // REPEAT-UNTIL: Execute body FIRST, then check to STOP when TRUE
+            do
+            {
+                execute_block(stmt->while_loop.body, stmt->while_loop.num_stmts, env);
+                coverage_taken(stmt);
+                if (jit_enabled)
+                    jit_backedge();
+                limit_check(stmt->line, NULL);
+
+                RuntimeValue cond = evaluate(stmt->while_loop.condition, env);
+                bool should_stop = to_bool(&cond);
+                free_runtime_value(&cond);
+
+                if (should_stop)
+                    break; // Stop when UNTIL condition is TRUE
+            } while (true);
+        }
+        else
+        {
+            // WHILE: Check condition FIRST, continue while TRUE
+            while (true)
+            {
+                RuntimeValue cond = evaluate(stmt->while_loop.condition, env);
+                bool should_continue = to_bool(&cond);
+                free_runtime_value(&cond);
+
+                if (!should_continue)
+                    break; // Stop when WHILE condition is FALSE
+
+                execute_block(stmt->while_loop.body, stmt->while_loop.num_stmts, env);
+                coverage_taken(stmt);
+                if (jit_enabled)
+                    jit_backedge();
+                limit_check(stmt->line, NULL);
+            }
+        }
+        NEXT_STATEMENT;
+    }
+
+    STATEMENT_CASE(AST_CALL)
+    {
+
+        ASTNode *subroutine = env_get_subroutine(env, stmt->call.name);
+
+        if (!subroutine)
+        {
+            fprintf(stderr, "Runtime Error: Undefined subroutine: %s\n", stmt->call.name);
+            exit(1);
+        }
+        limit_check(stmt->line, stmt->call.name);
+        if (cost_enabled)
+            cost_count(COST_CALL);
+
+        // Hot procedures run natively once compiled (--jit)
+        RuntimeValue jit_result;
+        if (jit_enabled && jit_try_call(subroutine, stmt->call.arguments, stmt->call.num_args, env, &jit_result))
+            NEXT_STATEMENT;
+        int jit_caller = jit_enter(subroutine);
+
+        // Create new environment for subroutine
+        Environment *sub_env = create_environment(env);
+
+        // Initialize local variables from DATA section
+        if (subroutine->subroutine.local_decls)
+        {
+            for (int i = 0; i < subroutine->subroutine.num_local_decls; i++)
+            {
+                ASTNode *decl = subroutine->subroutine.local_decls[i];
+                if (decl->decl.num_arr_dims > 0)
+                    continue;
+                env_define(sub_env, decl->decl.name, declared_variable_value(decl));
+            }
+        }
+
+        for (int i = 0; i < subroutine->subroutine.num_params && i < stmt->call.num_args; i++)
+        {
+            ASTNode *param = subroutine->subroutine.parameters[i];
+            ASTNode *arg = stmt->call.arguments[i];
+
+            // Special handling for arrays passed by reference
+            if (arg->type == AST_IDENTIFIER)
+            {
+                RuntimeValue *potential_array = env_get(env, arg->identifier.name);
+                if (potential_array && potential_array->type == VAL_ARRAY)
+                {
+                    // Pass the array reference directly (shallow copy for arrays)
+                    RuntimeValue array_ref;
+                    array_ref.type = VAL_ARRAY;
+                    array_ref.value.arr_val = potential_array->value.arr_val;
+                    env_define(sub_env, param->param.name, array_ref);
+                    continue;
+                }
+            }
+
+            // Regular parameter handling
+            if (param->param.is_reference)
+            {
+                // Pass by reference - evaluate and bind
+                RuntimeValue arg_val = evaluate(arg, env);
+                env_define(sub_env, param->param.name, arg_val);
+                // Don't free here - we need to copy back later
+            }
+            else
+            {
+                // Pass by value
+                RuntimeValue arg_val = evaluate(arg, env);
+                type_coerce(&arg_val, param->static_type);
+                env_define(sub_env, param->param.name, arg_val);
+                free_runtime_value(&arg_val);
+            }
+        }
+
+        define_local_arrays(subroutine, sub_env);
+
+        // Execute subroutine body
+        ProfileFrame sub_frame;
+        CostFrame cost_frame;
+        if (profile_enabled)
+            profile_enter_subroutine(subroutine, &sub_frame);
+        if (cost_enabled)
+            cost_enter_subroutine(subroutine, &cost_frame);
+        coverage_hit(subroutine);
+        if (sample_enabled)
+            sample_push(subroutine);
+        if (trace_enabled)
+            trace_begin(subroutine->subroutine.name, "call", stmt->line);
+        execute_block(subroutine->subroutine.body, subroutine->subroutine.num_stmts, sub_env);
+        if (trace_enabled)
+            trace_end();
+        if (sample_enabled)
+            sample_pop();
+        if (cost_enabled)
+            cost_leave_subroutine(&cost_frame);
+        if (profile_enabled)
+            profile_leave_subroutine(&sub_frame);
+        jit_leave(jit_caller);
+
+        // Copy back reference parameters (but NOT arrays - they're already shared)
+        for (int i = 0; i < subroutine->subroutine.num_params && i < stmt->call.num_args; i++)
+        {
+            ASTNode *param = subroutine->subroutine.parameters[i];
+            ASTNode *arg = stmt->call.arguments[i];
+
+            if (param->param.is_reference)
+            {
+                // Get the value from subroutine environment
+                RuntimeValue *sub_val = env_get(sub_env, param->param.name);
+
+                // Skip arrays - they're already shared by reference
+                if (sub_val->type == VAL_ARRAY)
+                {
+                    continue;
+                }
+
+                // Copy back simple variables
+                if (arg->type == AST_IDENTIFIER)
+                {
+                    env_assign(env, arg->identifier.name, *sub_val);
+                }
+                else if (arg->type == AST_ARRAY_ACCESS)
+                {
+                    // Array element - assign back
+                    RuntimeValue *arr_val = env_get(env, arg->array_access.name);
+                    if (arr_val->type == VAL_ARRAY)
+                    {
+                        int indices[MAX_ARRAY_DIMS];
+                        for (int j = 0; j < arg->array_access.num_indices; j++)
+                        {
+                            RuntimeValue idx = evaluate(arg->array_access.indices[j], env);
+                            indices[j] = to_int(&idx);
+                            free_runtime_value(&idx);
+                        }
+                        array_set(arr_val->value.arr_val, indices, arg->array_access.num_indices, *sub_val);
+                    }
+                }
+            }
+        }
+
+        NEXT_STATEMENT;
+    }
+
+    STATEMENT_DEFAULT
+        fprintf(stderr, "Runtime Error: Unknown statement type\n");
+        exit(1);
+#if EAP_COMPUTED_GOTO
+    }
+#else
+        }
+        statement_end(stmt, &profile_frame, traced);
+    }
+#endif
+}
+
+static void execute_statement(ASTNode *stmt, Environment *env)
+{
+    execute_block(&stmt, 1, env);
+}
+
+// Creates the array of a DATA declaration, evaluating its bounds in env
+static RuntimeValue create_declared_array(ASTNode *decl, Environment *env)
+{
+    ArrayBound bounds[MAX_ARRAY_DIMS];
+    for (int j = 0; j < decl->decl.num_arr_dims; j++)
+    {
+        RuntimeValue start_val = evaluate(decl->decl.arr_bound_exprs[j].start_expr, env);
+        RuntimeValue end_val = evaluate(decl->decl.arr_bound_exprs[j].end_expr, env);
+        bounds[j].from = to_int(&start_val);
+        bounds[j].to = to_int(&end_val);
+        free_runtime_value(&start_val);
+        free_runtime_value(&end_val);
+    }
+
+    int saved_owner = mem_owner;
+    if (mem_report_enabled)
+        mem_enter(mem_variable(decl->decl.name, "array", decl->line));
+
+    RuntimeValue val;
+    val.type = VAL_ARRAY;
+    val.value.arr_val = create_array(bounds, decl->decl.num_arr_dims);
+    mem_owner = saved_owner;
+    return val;
+}
+
+// Creates the local arrays of a subroutine. Called after the parameters are
+// bound, so that bounds may refer to them.
+static void define_local_arrays(ASTNode *subroutine, Environment *sub_env)
+{
+    for (int i = 0; i < subroutine->subroutine.num_local_decls; i++)
+    {
+        ASTNode *decl = subroutine->subroutine.local_decls[i];
+        if (decl->decl.num_arr_dims > 0)
+            env_define(sub_env, decl->decl.name, create_declared_array(decl, sub_env));
+    }
+}
+
+static bool closure_engine = false; // --engine=closure
+static void closure_execute_program(ASTNode *prog, Environment *env);
+
+static void execute_program(ASTNode *prog)
+{
+    Environment *env = create_environment(NULL);
+
+    // Define EOLN constant - use a static string to avoid malloc
+    RuntimeValue eoln;
+    eoln.type = VAL_STRING;
+    eoln.value.str_val = "__EOLN__"; // Static string, not malloc'd
+    env_define(env, "EOLN", eoln);
+
+    // Phase 1: Define constants and subroutines
+    for (int i = 0; i < prog->program.num_decls; i++)
+    {
+        ASTNode *decl = prog->program.declarations[i];
+
+        if (decl->type == AST_CONST_DECL)
+        {
+            RuntimeValue val = evaluate(decl->decl.value, env);
+            env_define(env, decl->decl.name, val);
+            DEBUG_LOG("Defined constant: %s", decl->decl.name);
+        }
+        else if (decl->type == AST_FUNC_DECL || decl->type == AST_PROC_DECL)
+        {
+            env_define_subroutine(env, decl->subroutine.name, decl);
+            DEBUG_LOG("Defined subroutine: %s", decl->subroutine.name);
+        }
+    }
+
+    // Phase 2: Define variables
+    for (int i = 0; i < prog->program.num_decls; i++)
+    {
+        ASTNode *decl = prog->program.declarations[i];
+
+        if (decl->type == AST_VAR_DECL)
+        {
+            RuntimeValue val;
+
+            if (decl->decl.num_arr_dims > 0)
+            {
+                val = create_declared_array(decl, env);
+                DEBUG_LOG("Declared array: %s", decl->decl.name);
+            }
+            else
+            {
+                // Simple variable
+                val = declared_variable_value(decl);
+                DEBUG_LOG("Declared variable: %s", decl->decl.name);
+            }
+
+            env_define(env, decl->decl.name, val);
+        }
+    }
+
+    // Execute main body
+    if (closure_engine)
+    {
+        closure_execute_program(prog, env);
+        return;
+    }
+    for (int i = 0; i < prog->program.num_stmts; i++)
+    {
+        ASTNode *stmt = prog->program.body[i];
+        if (trace_enabled)
+            trace_begin(trace_statement_name(stmt), "statement", stmt->line);
+        execute_statement(stmt, env);
+        if (trace_enabled)
+            trace_end();
+    }
+}
+
+// ============================================================================
+// CLOSURE COMPILER (--engine=closure)
+// ============================================================================
+// An alternative to the tree walker above. Before the program runs, every
+// statement and expression is converted once into a Closure: a record of its
+// operands and a pointer to a C function specialized for the node's shape and
+// static types, such as closure_add_int_variable_constant for i + 1. Running
+// the program is then a chain of indirect calls, with no switch on the node
+// type and no operator strings.
+//
+// Each closure that names a variable keeps an inline cache of the value slot
+// it found in the last environment it was looked up in. Environments are never
+// freed and a name always resolves to the same entry of a given environment,
+// so inside a loop a variable costs a pointer compare instead of the
+// upper-casing and hashing of env_lookup. Specialized closures still check the
+// tags of their operands and take the generic path when the guess was wrong,
+// so a program prints exactly what it prints in the tree walker.
+//
+// Some idioms that dominate the loops of the benchmark workloads under
+// --profile (bench/) run as one superinstruction instead of several closures:
+// x := x + 1, sum := sum + A[i], A[j] > A[j + 1], a[j] > key, A[i] := B[j],
+// and the swap t := A[i]; A[i] := A[j]; A[j] := t. They read operands where
+// they are stored instead of copying them into temporaries.
+//
+// --profile, --perf-counters, --sample, --trace-out, --stats, --cost-report,
+// --coverage, --mem-report and --jit hook into the tree walker, so with any of
+// them the program runs there. READ statements are handed to the tree walker.
+
+typedef RuntimeValue (*ClosureEval)(Closure *c, Environment *env);
+typedef void (*ClosureExec)(Closure *c, Environment *env);
+
+struct Closure
+{
+    ClosureEval eval; // Expressions
+    ClosureExec exec; // Statements
+    ASTNode *node;
+    Closure *left;   // Operand, condition, assigned value or loop start
+    Closure *right;  // Operand or loop end
+    Closure *step;   // Loop step
+    Closure **items; // Indices, arguments or printed expressions
+    int num_items;
+    Closure **body; // ΤΟΤΕ branch or loop body
+    int num_body;
+    Closure **else_body;
+    int num_else;
+    BinaryOperator op;
+    RuntimeValue constant; // Literal, or the constant right operand
+    Closure *temp;         // The temporary of a fused swap
+
+    // Inline cache: what the name meant in cache_env
+    Environment *cache_env;
+    RuntimeValue *cache_slot;
+    ASTNode *cache_subroutine;
+};
+
+static inline void closure_run(Closure **body, int count, Environment *env)
+{
+    for (int i = 0; i < count; i++)
+        body[i]->exec(body[i], env);
+}
+
+static inline RuntimeValue *closure_variable_slot(Closure *c, Environment *env, const char *name)
+{
+    if (c->cache_env != env)
+    {
+        c->cache_slot = env_get(env, name);
+        c->cache_env = env;
+    }
+    return c->cache_slot;
+}
+
+// Stores a copy of value in a variable, like env_assign. Assigning a name
+// that does not exist yet defines it in the global environment, uncached.
+static void closure_assign_variable(Closure *c, Environment *env, const char *name, RuntimeValue *value)
+{
+    if (c->cache_env != env)
+    {
+        RuntimeValue *slot = env_lookup(env, name);
+        if (!slot)
+        {
+            env_assign(env, name, *value);
+            return;
+        }
+        c->cache_slot = slot;
+        c->cache_env = env;
+    }
+
+    RuntimeValue *slot = c->cache_slot;
+    if (slot->type != VAL_STRING && value->type != VAL_STRING)
+    {
+        *slot = *value;
+        return;
+    }
+    free_runtime_value(slot);
+    *slot = env_copy_value(name, value);
+}
+
+static inline ASTNode *closure_subroutine(Closure *c, Environment *env)
+{
+    if (c->cache_env != env)
+    {
+        c->cache_subroutine = env_get_subroutine(env, c->node->call.name);
+        c->cache_env = env;
+    }
+    return c->cache_subroutine;
+}
+
+static inline void closure_indices(Closure **items, int count, Environment *env, int *indices)
+{
+    for (int i = 0; i < count; i++)
+    {
+        RuntimeValue idx = items[i]->eval(items[i], env);
+        indices[i] = to_int(&idx);
+        free_runtime_value(&idx);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Expressions
+// ----------------------------------------------------------------------------
+
+static RuntimeValue closure_none(Closure *c, Environment *env)
+{
+    (void)c;
+    (void)env;
+    RuntimeValue result;
+    memset(&result, 0, sizeof(RuntimeValue));
+    result.type = VAL_NONE;
+    return result;
+}
+
+static RuntimeValue closure_constant(Closure *c, Environment *env)
+{
+    (void)env;
+    return c->constant;
+}
+
+static RuntimeValue closure_string(Closure *c, Environment *env)
+{
+    (void)env;
+    return copy_runtime_value(&c->constant);
+}
+
+static RuntimeValue closure_variable(Closure *c, Environment *env)
+{
+    RuntimeValue *slot = closure_variable_slot(c, env, c->node->identifier.name);
+    if (slot->type == VAL_STRING)
+        return copy_runtime_value(slot);
+    return *slot;
+}
+
+// Nodes the closure compiler has no specialization for
+static RuntimeValue closure_tree_expression(Closure *c, Environment *env)
+{
+    return evaluate(c->node, env);
+}
+
+static RuntimeValue closure_binary_slow(Closure *c, RuntimeValue *left, RuntimeValue *right)
+{
+    RuntimeValue result = binary_generic(c->op, left, right);
+    free_runtime_value(left);
+    free_runtime_value(right);
+    return result;
+}
+
+static RuntimeValue closure_binary(Closure *c, Environment *env)
+{
+    RuntimeValue left = c->left->eval(c->left, env);
+    RuntimeValue right = c->right->eval(c->right, env);
+    return closure_binary_slow(c, &left, &right);
+}
+
+// Operands the type checker found to be INTEGER: the closure for any two
+// operands, and the one for a variable and an INTEGER literal (i + 1, j < n)
+#define CLOSURE_INT_OPERATOR(NAME, TYPE, FIELD, EXPR)                                                 \
+    static RuntimeValue closure_##NAME##_int(Closure *c, Environment *env)                            \
+    {                                                                                                 \
+        RuntimeValue left = c->left->eval(c->left, env);                                              \
+        RuntimeValue right = c->right->eval(c->right, env);                                           \
+        if (left.type != VAL_INT || right.type != VAL_INT)                                            \
+            return closure_binary_slow(c, &left, &right);                                             \
+        int l = left.value.int_val;                                                                   \
+        int r = right.value.int_val;                                                                  \
+        RuntimeValue result;                                                                          \
+        result.type = TYPE;                                                                           \
+        result.value.FIELD = EXPR;                                                                    \
+        return result;                                                                                \
+    }                                                                                                 \
+    static RuntimeValue closure_##NAME##_int_variable_constant(Closure *c, Environment *env)          \
+    {                                                                                                 \
+        RuntimeValue *slot = closure_variable_slot(c->left, env, c->node->binary.left->identifier.name); \
+        if (slot->type != VAL_INT)                                                                    \
+        {                                                                                             \
+            RuntimeValue left = copy_runtime_value(slot);                                             \
+            RuntimeValue right = c->constant;                                                         \
+            return closure_binary_slow(c, &left, &right);                                             \
+        }                                                                                             \
+        int l = slot->value.int_val;                                                                  \
+        int r = c->constant.value.int_val;                                                            \
+        RuntimeValue result;                                                                          \
+        result.type = TYPE;                                                                           \
+        result.value.FIELD = EXPR;                                                                    \
+        return result;                                                                                \
+    }
+CLOSURE_INT_OPERATOR(add, VAL_INT, int_val, l + r)
+CLOSURE_INT_OPERATOR(sub, VAL_INT, int_val, l - r)
+CLOSURE_INT_OPERATOR(mul, VAL_INT, int_val, l * r)
+CLOSURE_INT_OPERATOR(eq, VAL_BOOL, bool_val, l == r)
+CLOSURE_INT_OPERATOR(ne, VAL_BOOL, bool_val, l != r)
+CLOSURE_INT_OPERATOR(lt, VAL_BOOL, bool_val, l < r)
+CLOSURE_INT_OPERATOR(gt, VAL_BOOL, bool_val, l > r)
+CLOSURE_INT_OPERATOR(le, VAL_BOOL, bool_val, l <= r)
+CLOSURE_INT_OPERATOR(ge, VAL_BOOL, bool_val, l >= r)
+
+// INTEGER /, DIV and MOD, which check their divisor
+static RuntimeValue closure_binary_int(Closure *c, Environment *env)
+{
+    RuntimeValue left = c->left->eval(c->left, env);
+    RuntimeValue right = c->right->eval(c->right, env);
+    if (left.type != VAL_INT || right.type != VAL_INT)
+        return closure_binary_slow(c, &left, &right);
+    return quick_int(c->op, left.value.int_val, right.value.int_val);
+}
+
+static RuntimeValue closure_binary_real(Closure *c, Environment *env)
+{
+    RuntimeValue left = c->left->eval(c->left, env);
+    RuntimeValue right = c->right->eval(c->right, env);
+    if (left.type != VAL_REAL || right.type != VAL_REAL)
+        return closure_binary_slow(c, &left, &right);
+    return quick_real(c->op, left.value.real_val, right.value.real_val);
+}
+
+static RuntimeValue closure_negate(Closure *c, Environment *env)
+{
+    RuntimeValue operand = c->left->eval(c->left, env);
+    RuntimeValue result;
+    memset(&result, 0, sizeof(RuntimeValue));
+    if (operand.type == VAL_REAL)
+    {
+        result.type = VAL_REAL;
+        result.value.real_val = -operand.value.real_val;
+    }
+    else
+    {
+        result.type = VAL_INT;
+        result.value.int_val = -operand.value.int_val;
+    }
+    free_runtime_value(&operand);
+    return result;
+}
+
+static RuntimeValue closure_not(Closure *c, Environment *env)
+{
+    RuntimeValue operand = c->left->eval(c->left, env);
+    RuntimeValue result;
+    memset(&result, 0, sizeof(RuntimeValue));
+    result.type = VAL_BOOL;
+    result.value.bool_val = !to_bool(&operand);
+    free_runtime_value(&operand);
+    return result;
+}
+
+// The element an array access names, not copied: valid until the element is
+// assigned (array_set leaves the old value alone)
+static inline RuntimeValue closure_peek_element(Closure *c, Environment *env, int *indices)
+{
+    ASTNode *node = c->node;
+    RuntimeValue *array = closure_variable_slot(c, env, node->array_access.name);
+    closure_indices(c->items, c->num_items, env, indices);
+    return node->array_access.unchecked ? array_get_unchecked(array->value.arr_val, indices, c->num_items)
+                                        : array_get(array->value.arr_val, indices, c->num_items);
+}
+
+static RuntimeValue closure_element(Closure *c, Environment *env)
+{
+    int indices[MAX_ARRAY_DIMS];
+    RuntimeValue val = closure_peek_element(c, env, indices);
+    return copy_runtime_value(&val);
+}
+
+// A[j] > A[j + 1], a[i] <= b[j]: INTEGER elements compared in place
+static RuntimeValue closure_compare_elements(Closure *c, Environment *env)
+{
+    int indices[MAX_ARRAY_DIMS];
+    RuntimeValue left = closure_peek_element(c->left, env, indices);
+    if (left.type != VAL_INT)
+    {
+        left = copy_runtime_value(&left);
+        RuntimeValue right = c->right->eval(c->right, env);
+        return closure_binary_slow(c, &left, &right);
+    }
+    RuntimeValue right = closure_peek_element(c->right, env, indices);
+    if (right.type != VAL_INT)
+    {
+        right = copy_runtime_value(&right);
+        return closure_binary_slow(c, &left, &right);
+    }
+    return quick_int(c->op, left.value.int_val, right.value.int_val);
+}
+
+// a[j] > key
+static RuntimeValue closure_compare_element_variable(Closure *c, Environment *env)
+{
+    int indices[MAX_ARRAY_DIMS];
+    RuntimeValue left = closure_peek_element(c->left, env, indices);
+    RuntimeValue *right = closure_variable_slot(c->right, env, c->right->node->identifier.name);
+    if (left.type != VAL_INT || right->type != VAL_INT)
+    {
+        RuntimeValue left_copy = copy_runtime_value(&left);
+        RuntimeValue right_copy = copy_runtime_value(right);
+        return closure_binary_slow(c, &left_copy, &right_copy);
+    }
+    return quick_int(c->op, left.value.int_val, right->value.int_val);
+}
+
+// Picks the closure of a binary operator by its operand types and shape
+static ClosureEval closure_binary_function(Closure *c)
+{
+    ASTNode *left = c->node->binary.left;
+    ASTNode *right = c->node->binary.right;
+
+    if (left->static_type == VAL_INT && right->static_type == VAL_INT)
+    {
+        if (c->op >= BINOP_EQ && c->op <= BINOP_GE && left->type == AST_ARRAY_ACCESS)
+        {
+            if (right->type == AST_ARRAY_ACCESS)
+            {
+                DEBUG_LOG("Closure: fused an element comparison at line %d", c->node->line);
+                return closure_compare_elements;
+            }
+            if (right->type == AST_IDENTIFIER)
+            {
+                DEBUG_LOG("Closure: fused an element and variable comparison at line %d", c->node->line);
+                return closure_compare_element_variable;
+            }
+        }
+
+        bool variable_constant = left->type == AST_IDENTIFIER && right->type == AST_LITERAL;
+        if (variable_constant)
+            c->constant = right->literal.value;
+        switch (c->op)
+        {
+        case BINOP_ADD:
+            return variable_constant ? closure_add_int_variable_constant : closure_add_int;
+        case BINOP_SUB:
+            return variable_constant ? closure_sub_int_variable_constant : closure_sub_int;
+        case BINOP_MUL:
+            return variable_constant ? closure_mul_int_variable_constant : closure_mul_int;
+        case BINOP_EQ:
+            return variable_constant ? closure_eq_int_variable_constant : closure_eq_int;
+        case BINOP_NE:
+            return variable_constant ? closure_ne_int_variable_constant : closure_ne_int;
+        case BINOP_LT:
+            return variable_constant ? closure_lt_int_variable_constant : closure_lt_int;
+        case BINOP_GT:
+            return variable_constant ? closure_gt_int_variable_constant : closure_gt_int;
+        case BINOP_LE:
+            return variable_constant ? closure_le_int_variable_constant : closure_le_int;
+        case BINOP_GE:
+            return variable_constant ? closure_ge_int_variable_constant : closure_ge_int;
+        case BINOP_DIVIDE:
+        case BINOP_DIV:
+        case BINOP_MOD:
+            return closure_binary_int;
+        default:
+            return closure_binary;
+        }
+    }
+
+    if (left->static_type == VAL_REAL && right->static_type == VAL_REAL && c->op <= BINOP_GE && c->op != BINOP_DIV &&
+        c->op != BINOP_MOD)
+        return closure_binary_real;
+    return closure_binary;
+}
+
+static Closure *closure_body(ASTNode *subroutine);
+
+// Creates the environment of a call and binds the arguments, as the tree
+// walker does for a function (in an expression) or a procedure (a statement)
+static Environment *closure_enter(Closure *c, ASTNode *subroutine, Environment *env, bool is_statement)
+{
+    Environment *sub_env = create_environment(env);
+
+    for (int i = 0; i < subroutine->subroutine.num_local_decls; i++)
+    {
+        ASTNode *decl = subroutine->subroutine.local_decls[i];
+        if (decl->decl.num_arr_dims == 0)
+            env_define(sub_env, decl->decl.name, declared_variable_value(decl));
+    }
+
+    for (int i = 0; i < subroutine->subroutine.num_params && i < c->num_items; i++)
+    {
+        ASTNode *param = subroutine->subroutine.parameters[i];
+        Closure *arg = c->items[i];
+
+        // Arrays are shared, whatever the parameter says
+        if (arg->node->type == AST_IDENTIFIER)
+        {
+            RuntimeValue *potential_array = closure_variable_slot(arg, env, arg->node->identifier.name);
+            if (potential_array->type == VAL_ARRAY)
+            {
+                env_define(sub_env, param->param.name, *potential_array);
+                continue;
+            }
+        }
+
+        RuntimeValue arg_val = arg->eval(arg, env);
+        if (!is_statement || !param->param.is_reference)
+            type_coerce(&arg_val, param->static_type);
+        env_define(sub_env, param->param.name, arg_val);
+        free_runtime_value(&arg_val);
+    }
+
+    define_local_arrays(subroutine, sub_env);
+    if (!is_statement)
+        env_define(sub_env, subroutine->subroutine.name, declared_initial_value(subroutine->subroutine.return_type));
+    return sub_env;
+}
+
+// Copies back the reference parameters that are not arrays
+static void closure_leave(Closure *c, ASTNode *subroutine, Environment *env, Environment *sub_env, bool is_statement)
+{
+    for (int i = 0; i < subroutine->subroutine.num_params && i < c->num_items; i++)
+    {
+        ASTNode *param = subroutine->subroutine.parameters[i];
+        ASTNode *arg = c->items[i]->node;
+        if (!param->param.is_reference)
+            continue;
+
+        RuntimeValue *sub_val = env_get(sub_env, param->param.name);
+        if (sub_val->type == VAL_ARRAY)
+            continue;
+
+        if (arg->type == AST_IDENTIFIER)
+        {
+            env_assign(env, arg->identifier.name, *sub_val);
+        }
+        else if (arg->type == AST_ARRAY_ACCESS && is_statement)
+        {
+            RuntimeValue *arr_val = env_get(env, arg->array_access.name);
+            if (arr_val->type == VAL_ARRAY)
+            {
+                int indices[MAX_ARRAY_DIMS];
+                closure_indices(c->items[i]->items, c->items[i]->num_items, env, indices);
+                array_set(arr_val->value.arr_val, indices, arg->array_access.num_indices, *sub_val);
+            }
+        }
+    }
+}
+
+static RuntimeValue closure_call_function(Closure *c, Environment *env)
+{
+    ASTNode *function = closure_subroutine(c, env);
+    if (function->type != AST_FUNC_DECL)
+    {
+        fprintf(stderr, "Runtime Error: %s is not a function\n", c->node->call.name);
+        exit(1);
+    }
+    limit_check(c->node->line, c->node->call.name);
+
+    Environment *func_env = closure_enter(c, function, env, false);
+    Closure *body = closure_body(function);
+    closure_run(body->body, body->num_body, func_env);
+    closure_leave(c, function, env, func_env, false);
+
+    return copy_runtime_value(env_get(func_env, function->subroutine.name));
+}
+
+// ----------------------------------------------------------------------------
+// Statements
+// ----------------------------------------------------------------------------
+// Every statement counts towards --max-steps, as in execute_statement.
+
+static void closure_tree_statement(Closure *c, Environment *env)
+{
+    execute_statement(c->node, env);
+}
+
+static void closure_assign(Closure *c, Environment *env)
+{
+    stats.statements++;
+    RuntimeValue val = c->left->eval(c->left, env);
+    type_coerce(&val, c->node->static_type);
+    closure_assign_variable(c, env, c->node->assign.identifier, &val);
+    free_runtime_value(&val);
+}
+
+static void closure_assign_element(Closure *c, Environment *env)
+{
+    stats.statements++;
+    RuntimeValue val = c->left->eval(c->left, env);
+    type_coerce(&val, c->node->static_type);
+
+    RuntimeValue *array = closure_variable_slot(c, env, c->node->assign.identifier);
+    if (array->type == VAL_ARRAY)
+    {
+        int indices[MAX_ARRAY_DIMS];
+        closure_indices(c->items, c->num_items, env, indices);
+        array_set(array->value.arr_val, indices, c->num_items, val);
+    }
+    free_runtime_value(&val);
+}
+
+static void closure_print(Closure *c, Environment *env)
+{
+    stats.statements++;
+    for (int i = 0; i < c->num_items; i++)
+    {
+        RuntimeValue val = c->items[i]->eval(c->items[i], env);
+        print_value(&val, i);
+        free_runtime_value(&val);
+    }
+}
+
+static void closure_if(Closure *c, Environment *env)
+{
+    stats.statements++;
+    RuntimeValue cond = c->left->eval(c->left, env);
+    if (to_bool(&cond))
+        closure_run(c->body, c->num_body, env);
+    else
+        closure_run(c->else_body, c->num_else, env);
+    free_runtime_value(&cond);
+}
+
+static void closure_for(Closure *c, Environment *env)
+{
+    stats.statements++;
+    ASTNode *stmt = c->node;
+    fflush(stdout);
+
+    RuntimeValue start_val = c->left->eval(c->left, env);
+    RuntimeValue end_val = c->right->eval(c->right, env);
+    RuntimeValue step_val = c->step->eval(c->step, env);
+    int start = to_int(&start_val);
+    int end = to_int(&end_val);
+    int step = to_int(&step_val);
+    free_runtime_value(&start_val);
+    free_runtime_value(&end_val);
+    free_runtime_value(&step_val);
+
+    BcePlan *bce = bce_plan(stmt);
+    bce_enter(bce, stmt, start, end, step, env);
+
+    // Counting up, the tree walker flushes the output every time round, which
+    // orders it before the message of a runtime error in the body
+    RuntimeValue loop_var;
+    loop_var.type = VAL_INT;
+    for (int current = start; step > 0 ? current <= end : current >= end; current += step)
+    {
+        if (step > 0)
+            fflush(stdout);
+        loop_var.value.int_val = current;
+        closure_assign_variable(c, env, stmt->for_loop.variable, &loop_var);
+        closure_run(c->body, c->num_body, env);
+        limit_check(stmt->line, NULL);
+    }
+
+    bce_leave(bce);
+    fflush(stdout);
+}
+
+static void closure_while(Closure *c, Environment *env)
+{
+    stats.statements++;
+    for (;;)
+    {
+        RuntimeValue cond = c->left->eval(c->left, env);
+        bool should_continue = to_bool(&cond);
+        free_runtime_value(&cond);
+        if (!should_continue)
+            break;
+
+        closure_run(c->body, c->num_body, env);
+        limit_check(c->node->line, NULL);
+    }
+}
+
+static void closure_repeat(Closure *c, Environment *env)
+{
+    stats.statements++;
+    for (;;)
+    {
+        closure_run(c->body, c->num_body, env);
+        limit_check(c->node->line, NULL);
+
+        RuntimeValue cond = c->left->eval(c->left, env);
+        bool should_stop = to_bool(&cond);
+        free_runtime_value(&cond);
+        if (should_stop)
+            break;
+    }
+}
+
+static void closure_call_procedure(Closure *c, Environment *env)
+{
+    stats.statements++;
+    ASTNode *subroutine = closure_subroutine(c, env);
+    limit_check(c->node->line, c->node->call.name);
+
+    Environment *sub_env = closure_enter(c, subroutine, env, true);
+    Closure *body = closure_body(subroutine);
+    closure_run(body->body, body->num_body, sub_env);
+    closure_leave(c, subroutine, env, sub_env, true);
+}
+
+// ----------------------------------------------------------------------------
+// Superinstructions
+// ----------------------------------------------------------------------------
+// Each one runs what would otherwise be one or more statement closures and
+// their operand closures, and counts as that many statements. They assume the
+// static types the type checker found and hand over to the unfused closure
+// (closure_assign) when the variable holds something else at run time.
+
+// count := count + 1, j := j - 1
+static void closure_increment(Closure *c, Environment *env)
+{
+    RuntimeValue *slot = closure_variable_slot(c, env, c->node->assign.identifier);
+    if (slot->type != VAL_INT)
+    {
+        closure_assign(c, env);
+        return;
+    }
+    stats.statements++;
+    if (c->op == BINOP_ADD)
+        slot->value.int_val += c->constant.value.int_val;
+    else
+        slot->value.int_val -= c->constant.value.int_val;
+}
+
+// j := j + i, s := s + x[i, k] * y[k, j]: INTEGER or REAL, updated in place
+static void closure_accumulate(Closure *c, Environment *env)
+{
+    ValueType type = c->node->static_type;
+    RuntimeValue *slot = closure_variable_slot(c, env, c->node->assign.identifier);
+    if (slot->type != type)
+    {
+        closure_assign(c, env);
+        return;
+    }
+    stats.statements++;
+
+    RuntimeValue delta = c->right->eval(c->right, env);
+    if (delta.type == VAL_INT && type == VAL_INT)
+    {
+        if (c->op == BINOP_ADD)
+            slot->value.int_val += delta.value.int_val;
+        else
+            slot->value.int_val -= delta.value.int_val;
+        return;
+    }
+    if (delta.type == VAL_REAL && type == VAL_REAL)
+    {
+        if (c->op == BINOP_ADD)
+            slot->value.real_val += delta.value.real_val;
+        else
+            slot->value.real_val -= delta.value.real_val;
+        return;
+    }
+
+    RuntimeValue old = *slot;
+    RuntimeValue result = binary_generic(c->op, &old, &delta);
+    free_runtime_value(&delta);
+    type_coerce(&result, type);
+    closure_assign_variable(c, env, c->node->assign.identifier, &result);
+    free_runtime_value(&result);
+}
+
+// a[j + 1] := a[j], b[k] := a[i]: the element is stored without a temporary
+// copy (array_set copies it, and does not free the value it replaces)
+static void closure_copy_element(Closure *c, Environment *env)
+{
+    stats.statements++;
+    int indices[MAX_ARRAY_DIMS];
+    RuntimeValue val = closure_peek_element(c->left, env, indices);
+    type_coerce(&val, c->node->static_type);
+
+    RuntimeValue *array = closure_variable_slot(c, env, c->node->assign.identifier);
+    if (array->type == VAL_ARRAY)
+    {
+        closure_indices(c->items, c->num_items, env, indices);
+        array_set(array->value.arr_val, indices, c->num_items, val);
+    }
+}
+
+// t := A[x]; A[x] := B[y]; B[y] := t, with the indices evaluated once. B may
+// be A. The closure is compiled from A[x] := B[y]: left is A[x], right is
+// B[y] and temp is t. Both are checked by the reads, in the order the three
+// statements check them, so the writes need not check them again.
+static void closure_swap_elements(Closure *c, Environment *env)
+{
+    stats.statements += 3;
+    ASTNode *stmt = c->node;
+    const char *temp = c->temp->node->identifier.name;
+    int first[MAX_ARRAY_DIMS];
+    int second[MAX_ARRAY_DIMS];
+
+    RuntimeValue val = closure_peek_element(c->left, env, first);
+    type_coerce(&val, c->temp->node->static_type);
+    closure_assign_variable(c->temp, env, temp, &val);
+
+    val = closure_peek_element(c->right, env, second);
+    type_coerce(&val, stmt->static_type);
+    RuntimeValue *array = closure_variable_slot(c->left, env, stmt->assign.identifier);
+    array_set_unchecked(array->value.arr_val, first, c->num_items, val);
+
+    // B[y] := t, converted to the element type of B
+    val = *closure_variable_slot(c->temp, env, temp);
+    type_coerce(&val, c->right->node->static_type);
+    array = closure_variable_slot(c->right, env, c->right->node->array_access.name);
+    array_set_unchecked(array->value.arr_val, second, c->right->num_items, val);
+}
+
+// ----------------------------------------------------------------------------
+// Compilation
+// ----------------------------------------------------------------------------
+
+static Closure *closure_expression(ASTNode *expr);
+
+static Closure **closure_expressions(ASTNode **exprs, int count)
+{
+    Closure **list = malloc((count > 0 ? count : 1) * sizeof(Closure *));
+    for (int i = 0; i < count; i++)
+        list[i] = closure_expression(exprs[i]);
+    return list;
+}
+
+static Closure *closure_expression(ASTNode *expr)
+{
+    Closure *c = calloc(1, sizeof(Closure));
+    c->node = expr;
+    c->eval = closure_tree_expression;
+    if (!expr)
+    {
+        c->eval = closure_none;
+        return c;
+    }
+
+    switch (expr->type)
+    {
+    case AST_LITERAL:
+        c->constant = expr->literal.value;
+        c->eval = c->constant.type == VAL_STRING ? closure_string : closure_constant;
+        break;
+
+    case AST_IDENTIFIER:
+        c->eval = closure_variable;
+        break;
+
+    case AST_BINARY_OP:
+        c->left = closure_expression(expr->binary.left);
+        c->right = closure_expression(expr->binary.right);
+        c->op = quick_operator(expr->binary.operator);
+        c->eval = closure_binary_function(c);
+        break;
+
+    case AST_UNARY_OP:
+        c->left = closure_expression(expr->unary.operand);
+        if (strcmp(expr->unary.operator, "-") == 0)
+            c->eval = closure_negate;
+        else if (str_equals_ignore_case(expr->unary.operator, "NOT") || str_equals_ignore_case(expr->unary.operator, "ΟΧΙ"))
+            c->eval = closure_not;
+        break;
+
+    case AST_ARRAY_ACCESS:
+        c->items = closure_expressions(expr->array_access.indices, expr->array_access.num_indices);
+        c->num_items = expr->array_access.num_indices;
+        c->eval = closure_element;
+        break;
+
+    case AST_CALL:
+        c->items = closure_expressions(expr->call.arguments, expr->call.num_args);
+        c->num_items = expr->call.num_args;
+        c->eval = closure_call_function;
+        break;
+
+    default:
+        break;
+    }
+    return c;
+}
+
+static Closure **closure_block(ASTNode **stmts, int count, int *num_closures);
+
+// Whether expr is the variable called name
+static bool closure_is_variable(ASTNode *expr, const char *name)
+{
+    return expr && expr->type == AST_IDENTIFIER && str_equals_ignore_case(expr->identifier.name, name);
+}
+
+static bool closure_mentions(ASTNode *expr, const char *name)
+{
+    switch (expr->type)
+    {
+    case AST_IDENTIFIER:
+        return str_equals_ignore_case(expr->identifier.name, name);
+    case AST_UNARY_OP:
+        return closure_mentions(expr->unary.operand, name);
+    case AST_BINARY_OP:
+        return closure_mentions(expr->binary.left, name) || closure_mentions(expr->binary.right, name);
+    default:
+        return false;
+    }
+}
+
+// Whether the indices of a statement's target match an array access, with
+// expressions that cannot change between the statements of a swap
+static bool closure_same_indices(ASTNode *stmt, ASTNode *access, const char *temp)
+{
+    if (!str_equals_ignore_case(stmt->assign.identifier, access->array_access.name) ||
+        stmt->assign.num_indices != access->array_access.num_indices)
+        return false;
+    for (int i = 0; i < stmt->assign.num_indices; i++)
+    {
+        if (!bce_same_expr(stmt->assign.indices[i], access->array_access.indices[i]) ||
+            closure_mentions(stmt->assign.indices[i], temp) ||
+            closure_mentions(stmt->assign.indices[i], stmt->assign.identifier))
+            return false;
+    }
+    return true;
+}
+
+// t := A[x]; A[x] := B[y]; B[y] := t, where B may be A
+static bool closure_is_swap(ASTNode **stmts, int count)
+{
+    if (count < 3 || stmts[0]->type != AST_ASSIGN || stmts[1]->type != AST_ASSIGN || stmts[2]->type != AST_ASSIGN)
+        return false;
+
+    ASTNode *save = stmts[0];
+    ASTNode *move = stmts[1];
+    ASTNode *restore = stmts[2];
+    if (save->assign.num_indices > 0 || save->assign.value->type != AST_ARRAY_ACCESS ||
+        move->assign.value->type != AST_ARRAY_ACCESS)
+        return false;
+
+    const char *temp = save->assign.identifier;
+    return !str_equals_ignore_case(temp, move->assign.identifier) &&
+           !str_equals_ignore_case(temp, move->assign.value->array_access.name) &&
+           closure_same_indices(move, save->assign.value, temp) &&
+           closure_same_indices(restore, move->assign.value, temp) &&
+           closure_is_variable(restore->assign.value, temp);
+}
+
+static Closure *closure_swap(ASTNode **stmts)
+{
+    Closure *c = calloc(1, sizeof(Closure));
+    c->node = stmts[1];
+    c->left = closure_expression(stmts[0]->assign.value);
+    c->right = closure_expression(stmts[1]->assign.value);
+    c->temp = closure_expression(stmts[2]->assign.value);
+    c->num_items = stmts[1]->assign.num_indices;
+    c->exec = closure_swap_elements;
+    DEBUG_LOG("Closure: fused a swap at line %d", stmts[0]->line);
+    return c;
+}
+
+// The superinstruction of x := x + e or x := x - e, if there is one
+static ClosureExec closure_update_function(Closure *c)
+{
+    ASTNode *stmt = c->node;
+    ASTNode *value = stmt->assign.value;
+    ValueType type = stmt->static_type;
+    if (value->type != AST_BINARY_OP || (type != VAL_INT && type != VAL_REAL) ||
+        !closure_is_variable(value->binary.left, stmt->assign.identifier) ||
+        value->binary.left->static_type != type || value->binary.right->static_type != type)
+        return NULL;
+
+    BinaryOperator op = quick_operator(value->binary.operator);
+    ASTNode *delta = value->binary.right;
+    if ((op != BINOP_ADD && op != BINOP_SUB) || bce_expr_has_call(delta))
+        return NULL;
+
+    c->op = op;
+    if (delta->type == AST_LITERAL && delta->literal.value.type == VAL_INT && type == VAL_INT)
+    {
+        c->constant = delta->literal.value;
+        DEBUG_LOG("Closure: fused an increment at line %d", stmt->line);
+        return closure_increment;
+    }
+    c->right = closure_expression(delta);
+    DEBUG_LOG("Closure: fused an update in place at line %d", stmt->line);
+    return closure_accumulate;
+}
+
+static Closure *closure_statement(ASTNode *stmt)
+{
+    Closure *c = calloc(1, sizeof(Closure));
+    c->node = stmt;
+    c->exec = closure_tree_statement;
+
+    switch (stmt->type)
+    {
+    case AST_ASSIGN:
+        c->left = closure_expression(stmt->assign.value);
+        c->exec = closure_assign;
+        if (stmt->assign.num_indices > 0)
+        {
+            c->items = closure_expressions(stmt->assign.indices, stmt->assign.num_indices);
+            c->num_items = stmt->assign.num_indices;
+            c->exec = closure_assign_element;
+            if (stmt->assign.value->type == AST_ARRAY_ACCESS)
+            {
+                DEBUG_LOG("Closure: fused an element copy at line %d", stmt->line);
+                c->exec = closure_copy_element;
+            }
+        }
+        else
+        {
+            ClosureExec update = closure_update_function(c);
+            if (update)
+                c->exec = update;
+        }
+        break;
+
+    case AST_PRINT:
+        c->items = closure_expressions(stmt->print.expressions, stmt->print.num_exprs);
+        c->num_items = stmt->print.num_exprs;
+        c->exec = closure_print;
+        break;
+
+    case AST_IF:
+        c->left = closure_expression(stmt->if_stmt.condition);
+        c->body = closure_block(stmt->if_stmt.then_branch, stmt->if_stmt.num_then, &c->num_body);
+        if (stmt->if_stmt.else_branch)
+            c->else_body = closure_block(stmt->if_stmt.else_branch, stmt->if_stmt.num_else, &c->num_else);
+        c->exec = closure_if;
+        break;
+
+    case AST_FOR:
+        c->left = closure_expression(stmt->for_loop.start);
+        c->right = closure_expression(stmt->for_loop.end);
+        c->step = closure_expression(stmt->for_loop.step);
+        c->body = closure_block(stmt->for_loop.body, stmt->for_loop.num_stmts, &c->num_body);
+        c->exec = closure_for;
+        break;
+
+    case AST_WHILE:
+        c->left = closure_expression(stmt->while_loop.condition);
+        c->body = closure_block(stmt->while_loop.body, stmt->while_loop.num_stmts, &c->num_body);
+        c->exec = stmt->while_loop.is_repeat_until ? closure_repeat : closure_while;
+        break;
+
+    case AST_CALL:
+        c->items = closure_expressions(stmt->call.arguments, stmt->call.num_args);
+        c->num_items = stmt->call.num_args;
+        c->exec = closure_call_procedure;
+        break;
+
+    default:
+        // ΔΙΑΒΑΣΕ waits for input anyway
+        break;
+    }
+    return c;
+}
+
+// Fusing statements leaves fewer closures than statements
+static Closure **closure_block(ASTNode **stmts, int count, int *num_closures)
+{
+    Closure **list = malloc((count > 0 ? count : 1) * sizeof(Closure *));
+    int n = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (closure_is_swap(stmts + i, count - i))
+        {
+            list[n++] = closure_swap(stmts + i);
+            i += 2;
+        }
+        else
+            list[n++] = closure_statement(stmts[i]);
+    }
+    *num_closures = n;
+    return list;
+}
+
+// A body as a closure whose body is the compiled statements
+static Closure *closure_block_closure(ASTNode *node, ASTNode **stmts, int count)
+{
+    Closure *c = calloc(1, sizeof(Closure));
+    c->node = node;
+    c->body = closure_block(stmts, count, &c->num_body);
+    return c;
+}
+
+static Closure *closure_body(ASTNode *subroutine)
+{
+    if (!subroutine->subroutine.closure)
+        subroutine->subroutine.closure = closure_block_closure(subroutine, subroutine->subroutine.body, subroutine->subroutine.num_stmts);
+    return subroutine->subroutine.closure;
+}
+
+// Runs the main body; the declarations were set up by execute_program
+static void closure_execute_program(ASTNode *prog, Environment *env)
+{
+    if (!prog->program.closure)
+        prog->program.closure = closure_block_closure(prog, prog->program.body, prog->program.num_stmts);
+    closure_run(prog->program.closure->body, prog->program.closure->num_body, env);
+}
+
+// ============================================================================
+// IN-PROCESS BENCHMARK
+// ============================================================================
+// --bench N [--warmup K] parses once and executes the program K + N times in
+// this process. Every run starts from a fresh global environment and reads
+// the same input: stdin is captured to a temporary file up front and rewound
+// before each run. Output goes to the null device, and the time and the
+// allocations of the timed runs are reported on stderr.
+
+#ifdef _WIN32
+#define NULL_DEVICE "NUL"
+#else
+#define NULL_DEVICE "/dev/null"
+#endif
+
+// The count after --bench or --warmup, or -1 if it is missing, not a number
+// or below minimum
+static int bench_parse_count(const char *text, int minimum)
+{
+    if (!text)
+        return -1;
+    char *end;
+    errno = 0;
+    long count = strtol(text, &end, 10);
+    if (end == text || *end || errno || count < minimum || count > INT_MAX)
+        return -1;
+    return (int)count;
+}
+
+static int bench_compare_times(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void bench_program(ASTNode *program, int runs, int warmup)
+{
+    // Capture the whole input once; every run reads it from the start
+    FILE *input = tmpfile();
+    if (!input)
+    {
+        fprintf(stderr, "Runtime Error: Cannot create input file: %s\n", strerror(errno));
+        exit(1);
+    }
+    char buffer[8192];
+    size_t got;
+    while ((got = fread(buffer, 1, sizeof(buffer), stdin)) > 0)
+        fwrite(buffer, 1, got, input);
+    fflush(input);
+    if (dup2(fileno(input), fileno(stdin)) < 0)
+    {
+        fprintf(stderr, "Runtime Error: Cannot replay input: %s\n", strerror(errno));
+        exit(1);
+    }
+
+    fflush(stdout);
+    if (!freopen(NULL_DEVICE, "w", stdout))
+    {
+        fprintf(stderr, "Runtime Error: Cannot discard output: %s\n", strerror(errno));
+        exit(1);
+    }
+
+    double *times = malloc(runs * sizeof(double));
+    uint64_t statements = 0, allocations = 0, bytes = 0;
+    for (int run = -warmup; run < runs; run++)
+    {
+        // Shares the file offset with the capture: rewinds both
+        clearerr(stdin);
+        fseek(stdin, 0, SEEK_SET);
+
+        uint64_t start_statements = stats.statements;
+        uint64_t start_allocations = stats.allocations;
+        uint64_t start_bytes = stats.bytes_allocated;
+        double start = profile_wall_seconds();
+        execute_program(program);
+        fflush(stdout);
+        double seconds = profile_wall_seconds() - start;
+
+        if (run < 0)
+            continue;
+        times[run] = seconds * 1000.0;
+        statements += stats.statements - start_statements;
+        allocations += stats.allocations - start_allocations;
+        bytes += stats.bytes_allocated - start_bytes;
+    }
+
+    double mean = 0, variance = 0;
+    for (int i = 0; i < runs; i++)
+        mean += times[i];
+    mean /= runs;
+    for (int i = 0; i < runs; i++)
+        variance += (times[i] - mean) * (times[i] - mean);
+    double stddev = runs > 1 ? sqrt(variance / (runs - 1)) : 0;
+
+    qsort(times, runs, sizeof(double), bench_compare_times);
+    double median = runs % 2 ? times[runs / 2] : (times[runs / 2 - 1] + times[runs / 2]) / 2;
+    int p95 = (int)ceil(0.95 * runs) - 1;
+
+    fprintf(stderr, "Benchmark of %s: %d runs after %d warm-up runs\n", program->program.name, runs, warmup);
+    fprintf(stderr, "  min %.3f ms, median %.3f ms, p95 %.3f ms, max %.3f ms\n",
+            times[0], median, times[p95 < 0 ? 0 : p95], times[runs - 1]);
+    fprintf(stderr, "  mean %.3f ms, stddev %.3f ms (%.1f%%)\n", mean, stddev, mean > 0 ? 100.0 * stddev / mean : 0);
+    if (alloc_accounting)
+        fprintf(stderr, "  per run: %llu statements, %llu allocations, %llu bytes allocated\n",
+                (unsigned long long)(statements / runs), (unsigned long long)(allocations / runs),
+                (unsigned long long)(bytes / runs));
+    else
+        fprintf(stderr, "  per run: %llu statements (add --stats to count allocations)\n",
+                (unsigned long long)(statements / runs));
+
+    free(times);
+    fclose(input);
+}
+
+// ============================================================================
+// MAIN
+// ============================================================================
+
+// Helper function for token names
+// ============================================================================
+static const char *token_type_name(TokenType type)
+{
+    switch (type)
+    {
+    case TOK_ALGORITHM:
+        return "ALGORITHM";
+    case TOK_CONSTANTS:
+        return "CONSTANTS";
+    case TOK_DATA:
+        return "DATA";
     case TOK_BEGIN:
         return "BEGIN";
     case TOK_END:
@@ -3263,1455 +8224,3825 @@ static const char *token_type_name(TokenType type)
     case TOK_COMMA:
         return "COMMA ,";
     default:
-        return "OTHER";
+        return "OTHER";
+    }
+}
+
+// Windows-1253 (Greek) to UTF-8 conversion table for Greek characters
+static void convert_windows1253_to_utf8(char *content, size_t size)
+{
+    // Mapping table for Windows-1253 Greek characters to UTF-8
+    // This covers the Greek character range (0x80-0xFF in Windows-1253)
+    static const struct
+    {
+        unsigned char win1253;
+        const char *utf8;
+    } greek_map[] = {
+        // Greek uppercase letters
+        {0xC1, "Α"},
+        {0xC2, "Β"},
+        {0xC3, "Γ"},
+        {0xC4, "Δ"},
+        {0xC5, "Ε"},
+        {0xC6, "Ζ"},
+        {0xC7, "Η"},
+        {0xC8, "Θ"},
+        {0xC9, "Ι"},
+        {0xCA, "Κ"},
+        {0xCB, "Λ"},
+        {0xCC, "Μ"},
+        {0xCD, "Ν"},
+        {0xCE, "Ξ"},
+        {0xCF, "Ο"},
+        {0xD0, "Π"},
+        {0xD1, "Ρ"},
+        {0xD3, "Σ"},
+        {0xD4, "Τ"},
+        {0xD5, "Υ"},
+        {0xD6, "Φ"},
+        {0xD7, "Χ"},
+        {0xD8, "Ψ"},
+        {0xD9, "Ω"},
+
+        // Greek lowercase letters
+        {0xE1, "α"},
+        {0xE2, "β"},
+        {0xE3, "γ"},
+        {0xE4, "δ"},
+        {0xE5, "ε"},
+        {0xE6, "ζ"},
+        {0xE7, "η"},
+        {0xE8, "θ"},
+        {0xE9, "ι"},
+        {0xEA, "κ"},
+        {0xEB, "λ"},
+        {0xEC, "μ"},
+        {0xED, "ν"},
+        {0xEE, "ξ"},
+        {0xEF, "ο"},
+        {0xF0, "π"},
+        {0xF1, "ρ"},
+        {0xF2, "ς"},
+        {0xF3, "σ"},
+        {0xF4, "τ"},
+        {0xF5, "υ"},
+        {0xF6, "φ"},
+        {0xF7, "χ"},
+        {0xF8, "ψ"},
+        {0xF9, "ω"},
+
+        // Greek uppercase with tonos (accented)
+        {0xA1, "Ά"},
+        {0xA2, "Έ"},
+        {0xA3, "Ή"},
+        {0xA4, "Ί"},
+        {0xA5, "Ό"},
+        {0xA6, "Ύ"},
+        {0xA7, "Ώ"},
+
+        // Greek lowercase with tonos (accented)
+        {0xDC, "ά"},
+        {0xDD, "έ"},
+        {0xDE, "ή"},
+        {0xDF, "ί"},
+        {0xFC, "ό"},
+        {0xFD, "ύ"},
+        {0xFE, "ώ"},
+
+        // Greek lowercase with dialytika
+        {0xCA, "ϊ"},
+        {0xCB, "ϋ"},
+
+        {0, NULL} // Terminator
+    };
+
+    // Calculate new size (UTF-8 can be up to 3 bytes per Greek char)
+    size_t new_size = 0;
+    for (size_t i = 0; i < size; i++)
+    {
+        unsigned char c = (unsigned char)content[i];
+        if (c >= 0x80)
+        {
+            // Find in map
+            int found = 0;
+            for (int j = 0; greek_map[j].utf8 != NULL; j++)
+            {
+                if (greek_map[j].win1253 == c)
+                {
+                    new_size += strlen(greek_map[j].utf8);
+                    found = 1;
+                    break;
+                }
+            }
+            if (!found)
+                new_size++; // Keep as-is if not in map
+        }
+        else
+        {
+            new_size++;
+        }
+    }
+
+    // Allocate new buffer
+    char *new_content = malloc(new_size + 1);
+    if (!new_content)
+        return;
+
+    // Convert
+    size_t out_pos = 0;
+    for (size_t i = 0; i < size; i++)
+    {
+        unsigned char c = (unsigned char)content[i];
+        if (c >= 0x80)
+        {
+            // Find in map
+            int found = 0;
+            for (int j = 0; greek_map[j].utf8 != NULL; j++)
+            {
+                if (greek_map[j].win1253 == c)
+                {
+                    const char *utf8 = greek_map[j].utf8;
+                    while (*utf8)
+                    {
+                        new_content[out_pos++] = *utf8++;
+                    }
+                    found = 1;
+                    break;
+                }
+            }
+            if (!found)
+            {
+                new_content[out_pos++] = c; // Keep as-is
+            }
+        }
+        else
+        {
+            new_content[out_pos++] = c;
+        }
+    }
+    new_content[out_pos] = '\0';
+
+    // Copy back to original buffer
+    if (out_pos <= size)
+    {
+        memcpy(content, new_content, out_pos + 1);
+    }
+    else
+    {
+        // Need to inform caller about size change
+        // For now, just copy what fits
+        memcpy(content, new_content, size);
+        content[size] = '\0';
+    }
+
+    free(new_content);
+}
+
+// Better version that returns new buffer
+static char *convert_windows1253_to_utf8_new(const char *content, size_t size)
+{
+    // Mapping table
+    static const struct
+    {
+        unsigned char win1253;
+        const char *utf8;
+    } greek_map[] = {
+        {0xC1, "Α"}, {0xC2, "Β"}, {0xC3, "Γ"}, {0xC4, "Δ"}, {0xC5, "Ε"}, {0xC6, "Ζ"}, {0xC7, "Η"}, {0xC8, "Θ"}, {0xC9, "Ι"}, {0xCA, "Κ"}, {0xCB, "Λ"}, {0xCC, "Μ"}, {0xCD, "Ν"}, {0xCE, "Ξ"}, {0xCF, "Ο"}, {0xD0, "Π"}, {0xD1, "Ρ"}, {0xD3, "Σ"}, {0xD4, "Τ"}, {0xD5, "Υ"}, {0xD6, "Φ"}, {0xD7, "Χ"}, {0xD8, "Ψ"}, {0xD9, "Ω"}, {0xE1, "α"}, {0xE2, "β"}, {0xE3, "γ"}, {0xE4, "δ"}, {0xE5, "ε"}, {0xE6, "ζ"}, {0xE7, "η"}, {0xE8, "θ"}, {0xE9, "ι"}, {0xEA, "κ"}, {0xEB, "λ"}, {0xEC, "μ"}, {0xED, "ν"}, {0xEE, "ξ"}, {0xEF, "ο"}, {0xF0, "π"}, {0xF1, "ρ"}, {0xF2, "ς"}, {0xF3, "σ"}, {0xF4, "τ"}, {0xF5, "υ"}, {0xF6, "φ"}, {0xF7, "χ"}, {0xF8, "ψ"}, {0xF9, "ω"}, {0xDC, "ά"}, {0xDD, "έ"}, {0xDE, "ή"}, {0xDF, "ί"}, {0xFC, "ό"}, {0xFD, "ύ"}, {0xFE, "ώ"}, {0xA1, "Ά"}, {0xA2, "Έ"}, {0xA3, "Ή"}, {0xA4, "Ί"}, {0xA5, "Ό"}, {0xA6, "Ύ"}, {0xA7, "Ώ"}, {0, NULL}};
+
+    // Calculate required size
+    size_t new_size = 0;
+    for (size_t i = 0; i < size; i++)
+    {
+        unsigned char c = (unsigned char)content[i];
+        if (c >= 0x80)
+        {
+            int found = 0;
+            for (int j = 0; greek_map[j].utf8 != NULL; j++)
+            {
+                if (greek_map[j].win1253 == c)
+                {
+                    new_size += strlen(greek_map[j].utf8);
+                    found = 1;
+                    break;
+                }
+            }
+            if (!found)
+                new_size++;
+        }
+        else
+        {
+            new_size++;
+        }
+    }
+
+    // Allocate and convert
+    char *new_content = malloc(new_size + 1);
+    if (!new_content)
+        return NULL;
+
+    size_t out_pos = 0;
+    for (size_t i = 0; i < size; i++)
+    {
+        unsigned char c = (unsigned char)content[i];
+        if (c >= 0x80)
+        {
+            int found = 0;
+            for (int j = 0; greek_map[j].utf8 != NULL; j++)
+            {
+                if (greek_map[j].win1253 == c)
+                {
+                    const char *utf8 = greek_map[j].utf8;
+                    while (*utf8)
+                    {
+                        new_content[out_pos++] = *utf8++;
+                    }
+                    found = 1;
+                    break;
+                }
+            }
+            if (!found)
+                new_content[out_pos++] = c;
+        }
+        else
+        {
+            new_content[out_pos++] = c;
+        }
+    }
+    new_content[out_pos] = '\0';
+
+    return new_content;
+}
+
+bool is_valid_utf8(const char *str, size_t len)
+{
+    const unsigned char *bytes = (const unsigned char *)str;
+    for (size_t i = 0; i < len;)
+    {
+        if (bytes[i] <= 0x7F)
+            i++;
+        else if (bytes[i] >= 0xC2 && bytes[i] <= 0xDF && i + 1 < len && bytes[i + 1] >= 0x80 && bytes[i + 1] <= 0xBF)
+            i += 2;
+        else if (bytes[i] == 0xE0 && i + 2 < len && bytes[i + 1] >= 0xA0 && bytes[i + 1] <= 0xBF && bytes[i + 2] >= 0x80 && bytes[i + 2] <= 0xBF)
+            i += 3;
+        else if (bytes[i] >= 0xE1 && bytes[i] <= 0xEF && i + 2 < len && bytes[i + 1] >= 0x80 && bytes[i + 1] <= 0xBF && bytes[i + 2] >= 0x80 && bytes[i + 2] <= 0xBF)
+            i += 3;
+        else if (bytes[i] == 0xF0 && i + 3 < len && bytes[i + 1] >= 0x90 && bytes[i + 1] <= 0xBF && bytes[i + 2] >= 0x80 && bytes[i + 2] <= 0xBF && bytes[i + 3] >= 0x80 && bytes[i + 3] <= 0xBF)
+            i += 4;
+        else
+            return false;
+    }
+    return true;
+}
+static char *read_file(const char *filename)
+{
+    FILE *file = fopen(filename, "rb");
+    if (!file)
+    {
+        fprintf(stderr, "Error: Cannot open file '%s'\n", filename);
+        exit(1);
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char *content = malloc(size + 1);
+    fread(content, 1, size, file);
+    content[size] = '\0';
+
+    fclose(file);
+
+    // --- ΑΡΧΗ ΔΙΟΡΘΩΣΗΣ ---
+
+    // 1. Ορίζουμε τη λέξη "ΑΛΓΟΡΙΘΜΟΣ" σε UTF-8 format (hex bytes)
+    const unsigned char utf8_algo[] = {0xCE, 0x91, 0xCE, 0x9B, 0xCE, 0x93, 0xCE, 0x9F, 0xCE, 0xA1, 0xCE, 0x99, 0xCE, 0x98, 0xCE, 0x9C, 0xCE, 0x9F, 0xCE, 0xA3, 0};
+
+    // 2. Ελέγχουμε αν το αρχείο περιέχει ήδη τη λέξη ΑΛΓΟΡΙΘΜΟΣ σε UTF-8
+    bool is_already_utf8 = (strstr(content, (const char *)utf8_algo) != NULL);
+
+    // 3. Simple heuristic για Windows-1253
+    int has_greek_win1253 = 0;
+    for (long i = 0; i < size; i++)
+    {
+        unsigned char c = (unsigned char)content[i];
+        if ((c >= 0xC1 && c <= 0xD9) || (c >= 0xE1 && c <= 0xF9))
+        {
+            has_greek_win1253 = 1;
+            break;
+        }
+    }
+
+    // ΜΕΤΑΤΡΟΠΗ: Μόνο αν βρήκαμε bytes της Win-1253 ΚΑΙ ΔΕΝ βρήκαμε το UTF-8 anchor
+    if (has_greek_win1253 && !is_already_utf8)
+    {
+        DEBUG_LOG("Detected Windows-1253 (UTF-8 anchor not found), converting...");
+        char *utf8_content = convert_windows1253_to_utf8_new(content, size);
+        free(content);
+        return utf8_content;
+    }
+
+    // --- ΤΕΛΟΣ ΔΙΟΡΘΩΣΗΣ ---
+
+    return content;
+}
+
+// ============================================================================
+// PRECOMPILED PROGRAM FORMAT (.eapc)
+// ============================================================================
+//
+// Layout (all integers little-endian):
+//   header:  "EAPC" | u32 version | u32 node count | u32 child slot count |
+//            u32 payload size | u64 payload checksum (FNV-1a)
+//   payload: source path, then the AST in pre-order.
+//
+// Children are implied by their position in the pre-order stream, never by
+// address, so the file can be mapped anywhere. Strings keep their trailing
+// NUL and are used in place by the loader, which makes loading a single pass
+// over the mapping with one allocation for all nodes and one for all child
+// pointer arrays.
+
+#define EAPC_MAGIC "EAPC"
+#define EAPC_VERSION 1
+#define EAPC_HEADER_SIZE 28
+#define EAPC_NULL_STRING 0xFFFFFFFFu
+
+static uint64_t fnv1a_hash(const void *data, size_t len, uint64_t hash)
+{
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < len; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+#define FNV1A_SEED 14695981039346656037ULL
+
+typedef struct
+{
+    unsigned char *data;
+    size_t len;
+    size_t cap;
+    uint32_t node_count;
+    uint32_t slot_count;
+} EapcWriter;
+
+static void eapc_put_bytes(EapcWriter *w, const void *bytes, size_t n)
+{
+    if (w->len + n > w->cap)
+    {
+        while (w->len + n > w->cap)
+            w->cap = w->cap ? w->cap * 2 : 4096;
+        w->data = realloc(w->data, w->cap);
+    }
+    memcpy(w->data + w->len, bytes, n);
+    w->len += n;
+}
+
+static void eapc_put_u8(EapcWriter *w, uint8_t v)
+{
+    eapc_put_bytes(w, &v, 1);
+}
+
+static void eapc_put_u32(EapcWriter *w, uint32_t v)
+{
+    unsigned char b[4] = {v & 0xFF, (v >> 8) & 0xFF, (v >> 16) & 0xFF, (v >> 24) & 0xFF};
+    eapc_put_bytes(w, b, 4);
+}
+
+static void eapc_put_f64(EapcWriter *w, double v)
+{
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    eapc_put_u32(w, (uint32_t)bits);
+    eapc_put_u32(w, (uint32_t)(bits >> 32));
+}
+
+static void eapc_put_string(EapcWriter *w, const char *s)
+{
+    if (!s)
+    {
+        eapc_put_u32(w, EAPC_NULL_STRING);
+        return;
+    }
+    uint32_t n = (uint32_t)strlen(s);
+    eapc_put_u32(w, n);
+    eapc_put_bytes(w, s, n + 1);
+}
+
+static void eapc_put_node(EapcWriter *w, ASTNode *node);
+
+static void eapc_put_list(EapcWriter *w, ASTNode **nodes, int count)
+{
+    eapc_put_u32(w, (uint32_t)count);
+    w->slot_count += count;
+    for (int i = 0; i < count; i++)
+    {
+        eapc_put_node(w, nodes[i]);
+    }
+}
+
+static void eapc_put_node(EapcWriter *w, ASTNode *node)
+{
+    if (!node)
+    {
+        eapc_put_u8(w, 0);
+        return;
+    }
+
+    w->node_count++;
+    eapc_put_u8(w, (uint8_t)(node->type + 1));
+    eapc_put_u32(w, (uint32_t)node->line);
+
+    switch (node->type)
+    {
+    case AST_PROGRAM:
+        eapc_put_string(w, node->program.name);
+        eapc_put_list(w, node->program.declarations, node->program.num_decls);
+        eapc_put_list(w, node->program.body, node->program.num_stmts);
+        break;
+
+    case AST_CONST_DECL:
+    case AST_VAR_DECL:
+        eapc_put_string(w, node->decl.name);
+        eapc_put_node(w, node->decl.value);
+        eapc_put_string(w, node->decl.var_type);
+        eapc_put_u32(w, (uint32_t)node->decl.num_arr_dims);
+        for (int i = 0; i < node->decl.num_arr_dims; i++)
+        {
+            eapc_put_node(w, node->decl.arr_bound_exprs[i].start_expr);
+            eapc_put_node(w, node->decl.arr_bound_exprs[i].end_expr);
+        }
+        break;
+
+    case AST_FUNC_DECL:
+    case AST_PROC_DECL:
+        eapc_put_string(w, node->subroutine.name);
+        eapc_put_string(w, node->subroutine.return_type);
+        eapc_put_list(w, node->subroutine.parameters, node->subroutine.num_params);
+        eapc_put_list(w, node->subroutine.local_decls, node->subroutine.num_local_decls);
+        eapc_put_list(w, node->subroutine.body, node->subroutine.num_stmts);
+        break;
+
+    case AST_PARAMETER:
+        eapc_put_string(w, node->param.name);
+        eapc_put_string(w, node->param.param_type);
+        eapc_put_u8(w, node->param.is_reference);
+        break;
+
+    case AST_ASSIGN:
+        eapc_put_string(w, node->assign.identifier);
+        eapc_put_list(w, node->assign.indices, node->assign.num_indices);
+        eapc_put_node(w, node->assign.value);
+        break;
+
+    case AST_PRINT:
+        eapc_put_list(w, node->print.expressions, node->print.num_exprs);
+        break;
+
+    case AST_READ:
+        eapc_put_list(w, node->read.variables, node->read.num_vars);
+        break;
+
+    case AST_IF:
+        eapc_put_node(w, node->if_stmt.condition);
+        eapc_put_list(w, node->if_stmt.then_branch, node->if_stmt.num_then);
+        eapc_put_list(w, node->if_stmt.else_branch, node->if_stmt.else_branch ? node->if_stmt.num_else : 0);
+        break;
+
+    case AST_FOR:
+        eapc_put_string(w, node->for_loop.variable);
+        eapc_put_node(w, node->for_loop.start);
+        eapc_put_node(w, node->for_loop.end);
+        eapc_put_node(w, node->for_loop.step);
+        eapc_put_list(w, node->for_loop.body, node->for_loop.num_stmts);
+        break;
+
+    case AST_WHILE:
+        eapc_put_node(w, node->while_loop.condition);
+        eapc_put_list(w, node->while_loop.body, node->while_loop.num_stmts);
+        eapc_put_u8(w, node->while_loop.is_repeat_until);
+        break;
+
+    case AST_CALL:
+        eapc_put_string(w, node->call.name);
+        eapc_put_list(w, node->call.arguments, node->call.num_args);
+        eapc_put_u8(w, node->call.is_statement);
+        break;
+
+    case AST_BINARY_OP:
+        eapc_put_string(w, node->binary.operator);
+        eapc_put_node(w, node->binary.left);
+        eapc_put_node(w, node->binary.right);
+        break;
+
+    case AST_UNARY_OP:
+        eapc_put_string(w, node->unary.operator);
+        eapc_put_node(w, node->unary.operand);
+        break;
+
+    case AST_LITERAL:
+        eapc_put_u8(w, (uint8_t)node->literal.value.type);
+        switch (node->literal.value.type)
+        {
+        case VAL_INT:
+            eapc_put_u32(w, (uint32_t)node->literal.value.value.int_val);
+            break;
+        case VAL_REAL:
+            eapc_put_f64(w, node->literal.value.value.real_val);
+            break;
+        case VAL_BOOL:
+            eapc_put_u8(w, node->literal.value.value.bool_val);
+            break;
+        case VAL_STRING:
+            eapc_put_string(w, node->literal.value.value.str_val);
+            break;
+        default:
+            break;
+        }
+        break;
+
+    case AST_IDENTIFIER:
+        eapc_put_string(w, node->identifier.name);
+        break;
+
+    case AST_ARRAY_ACCESS:
+        eapc_put_string(w, node->array_access.name);
+        eapc_put_list(w, node->array_access.indices, node->array_access.num_indices);
+        break;
+
+    default:
+        fprintf(stderr, "Error: Cannot serialize AST node type %d\n", node->type);
+        exit(1);
+    }
+}
+
+static void save_precompiled(ASTNode *prog, const char *source_path, const char *out_path)
+{
+    EapcWriter w = {0};
+    eapc_put_string(&w, source_path);
+    eapc_put_node(&w, prog);
+
+    EapcWriter header = {0};
+    eapc_put_bytes(&header, EAPC_MAGIC, 4);
+    eapc_put_u32(&header, EAPC_VERSION);
+    eapc_put_u32(&header, w.node_count);
+    eapc_put_u32(&header, w.slot_count);
+    eapc_put_u32(&header, (uint32_t)w.len);
+    uint64_t checksum = fnv1a_hash(w.data, w.len, FNV1A_SEED);
+    eapc_put_u32(&header, (uint32_t)checksum);
+    eapc_put_u32(&header, (uint32_t)(checksum >> 32));
+
+    FILE *out = fopen(out_path, "wb");
+    if (!out)
+    {
+        fprintf(stderr, "Error: Cannot create file '%s'\n", out_path);
+        exit(1);
+    }
+    if (fwrite(header.data, 1, header.len, out) != header.len ||
+        fwrite(w.data, 1, w.len, out) != w.len || fclose(out) != 0)
+    {
+        fprintf(stderr, "Error: Failed writing '%s'\n", out_path);
+        exit(1);
+    }
+
+    DEBUG_LOG("Wrote %s: %u nodes, %zu bytes", out_path, w.node_count, header.len + w.len);
+    free(header.data);
+    free(w.data);
+}
+
+typedef struct
+{
+    const unsigned char *data;
+    size_t len;
+    size_t pos;
+    const char *path;
+    ASTNode *nodes;
+    uint32_t next_node;
+    uint32_t node_count;
+    ASTNode **slots;
+    uint32_t next_slot;
+    uint32_t slot_count;
+} EapcReader;
+
+static void eapc_corrupt(EapcReader *r)
+{
+    fprintf(stderr, "Error: Corrupt precompiled file '%s' (offset %zu)\n", r->path, r->pos);
+    exit(1);
+}
+
+static uint8_t eapc_get_u8(EapcReader *r)
+{
+    if (r->pos + 1 > r->len)
+        eapc_corrupt(r);
+    return r->data[r->pos++];
+}
+
+static uint32_t eapc_get_u32(EapcReader *r)
+{
+    if (r->pos + 4 > r->len)
+        eapc_corrupt(r);
+    const unsigned char *b = r->data + r->pos;
+    r->pos += 4;
+    return (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+}
+
+static double eapc_get_f64(EapcReader *r)
+{
+    uint64_t lo = eapc_get_u32(r);
+    uint64_t hi = eapc_get_u32(r);
+    uint64_t bits = lo | (hi << 32);
+    double v;
+    memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+static char *eapc_get_string(EapcReader *r)
+{
+    uint32_t n = eapc_get_u32(r);
+    if (n == EAPC_NULL_STRING)
+        return NULL;
+    if (r->pos + n + 1 > r->len || r->data[r->pos + n] != '\0')
+        eapc_corrupt(r);
+    char *s = (char *)(r->data + r->pos);
+    r->pos += n + 1;
+    return s;
+}
+
+static ASTNode *eapc_get_node(EapcReader *r);
+
+static ASTNode **eapc_get_list(EapcReader *r, int *count)
+{
+    uint32_t n = eapc_get_u32(r);
+    if (n > r->slot_count - r->next_slot)
+        eapc_corrupt(r);
+    *count = (int)n;
+    if (n == 0)
+        return NULL;
+
+    ASTNode **list = &r->slots[r->next_slot];
+    r->next_slot += n;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        list[i] = eapc_get_node(r);
+    }
+    return list;
+}
+
+static ASTNode *eapc_get_node(EapcReader *r)
+{
+    uint8_t tag = eapc_get_u8(r);
+    if (tag == 0)
+        return NULL;
+    if (tag - 1 > AST_ARRAY_ACCESS || r->next_node >= r->node_count)
+        eapc_corrupt(r);
+
+    ASTNode *node = &r->nodes[r->next_node++];
+    node->type = (ASTNodeType)(tag - 1);
+    node->line = (int)eapc_get_u32(r);
+    node->static_type = VAL_NONE;
+
+    switch (node->type)
+    {
+    case AST_PROGRAM:
+        node->program.name = eapc_get_string(r);
+        node->program.declarations = eapc_get_list(r, &node->program.num_decls);
+        node->program.body = eapc_get_list(r, &node->program.num_stmts);
+        break;
+
+    case AST_CONST_DECL:
+    case AST_VAR_DECL:
+        node->decl.name = eapc_get_string(r);
+        node->decl.value = eapc_get_node(r);
+        node->decl.var_type = eapc_get_string(r);
+        node->decl.num_arr_dims = (int)eapc_get_u32(r);
+        if (node->decl.num_arr_dims > MAX_ARRAY_DIMS)
+            eapc_corrupt(r);
+        if (node->decl.num_arr_dims > 0)
+        {
+            node->decl.arr_bound_exprs = malloc(node->decl.num_arr_dims * sizeof(ArrayBoundExpr));
+            for (int i = 0; i < node->decl.num_arr_dims; i++)
+            {
+                node->decl.arr_bound_exprs[i].start_expr = eapc_get_node(r);
+                node->decl.arr_bound_exprs[i].end_expr = eapc_get_node(r);
+            }
+        }
+        break;
+
+    case AST_FUNC_DECL:
+    case AST_PROC_DECL:
+        node->subroutine.name = eapc_get_string(r);
+        node->subroutine.return_type = eapc_get_string(r);
+        node->subroutine.parameters = eapc_get_list(r, &node->subroutine.num_params);
+        node->subroutine.local_decls = eapc_get_list(r, &node->subroutine.num_local_decls);
+        node->subroutine.body = eapc_get_list(r, &node->subroutine.num_stmts);
+        break;
+
+    case AST_PARAMETER:
+        node->param.name = eapc_get_string(r);
+        node->param.param_type = eapc_get_string(r);
+        node->param.is_reference = eapc_get_u8(r) != 0;
+        break;
+
+    case AST_ASSIGN:
+        node->assign.identifier = eapc_get_string(r);
+        node->assign.indices = eapc_get_list(r, &node->assign.num_indices);
+        node->assign.value = eapc_get_node(r);
+        break;
+
+    case AST_PRINT:
+        node->print.expressions = eapc_get_list(r, &node->print.num_exprs);
+        break;
+
+    case AST_READ:
+        node->read.variables = eapc_get_list(r, &node->read.num_vars);
+        break;
+
+    case AST_IF:
+        node->if_stmt.condition = eapc_get_node(r);
+        node->if_stmt.then_branch = eapc_get_list(r, &node->if_stmt.num_then);
+        node->if_stmt.else_branch = eapc_get_list(r, &node->if_stmt.num_else);
+        break;
+
+    case AST_FOR:
+        node->for_loop.variable = eapc_get_string(r);
+        node->for_loop.start = eapc_get_node(r);
+        node->for_loop.end = eapc_get_node(r);
+        node->for_loop.step = eapc_get_node(r);
+        node->for_loop.body = eapc_get_list(r, &node->for_loop.num_stmts);
+        break;
+
+    case AST_WHILE:
+        node->while_loop.condition = eapc_get_node(r);
+        node->while_loop.body = eapc_get_list(r, &node->while_loop.num_stmts);
+        node->while_loop.is_repeat_until = eapc_get_u8(r) != 0;
+        break;
+
+    case AST_CALL:
+        node->call.name = eapc_get_string(r);
+        node->call.arguments = eapc_get_list(r, &node->call.num_args);
+        node->call.is_statement = eapc_get_u8(r) != 0;
+        break;
+
+    case AST_BINARY_OP:
+        node->binary.operator = eapc_get_string(r);
+        node->binary.left = eapc_get_node(r);
+        node->binary.right = eapc_get_node(r);
+        break;
+
+    case AST_UNARY_OP:
+        node->unary.operator = eapc_get_string(r);
+        node->unary.operand = eapc_get_node(r);
+        break;
+
+    case AST_LITERAL:
+        node->literal.value.type = (ValueType)eapc_get_u8(r);
+        switch (node->literal.value.type)
+        {
+        case VAL_INT:
+            node->literal.value.value.int_val = (int)eapc_get_u32(r);
+            break;
+        case VAL_REAL:
+            node->literal.value.value.real_val = eapc_get_f64(r);
+            break;
+        case VAL_BOOL:
+            node->literal.value.value.bool_val = eapc_get_u8(r) != 0;
+            break;
+        case VAL_STRING:
+            node->literal.value.value.str_val = eapc_get_string(r);
+            break;
+        default:
+            break;
+        }
+        break;
+
+    case AST_IDENTIFIER:
+        node->identifier.name = eapc_get_string(r);
+        break;
+
+    case AST_ARRAY_ACCESS:
+        node->array_access.name = eapc_get_string(r);
+        node->array_access.indices = eapc_get_list(r, &node->array_access.num_indices);
+        break;
+
+    default:
+        eapc_corrupt(r);
+    }
+
+    return node;
+}
+
+// Maps the file read-only where mmap is available; the mapping lives for the
+// rest of the process because the loaded AST points into it.
+static const unsigned char *map_file(const char *filename, size_t *size)
+{
+#ifndef _WIN32
+    int fd = open(filename, O_RDONLY);
+    if (fd >= 0)
+    {
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0)
+        {
+            void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+            if (data != MAP_FAILED)
+            {
+                *size = (size_t)st.st_size;
+                return data;
+            }
+        }
+        else
+        {
+            close(fd);
+        }
+    }
+#endif
+
+    FILE *file = fopen(filename, "rb");
+    if (!file)
+    {
+        fprintf(stderr, "Error: Cannot open file '%s'\n", filename);
+        exit(1);
+    }
+    fseek(file, 0, SEEK_END);
+    long len = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    unsigned char *data = malloc(len > 0 ? len : 1);
+    *size = fread(data, 1, len > 0 ? len : 0, file);
+    fclose(file);
+    return data;
+}
+
+static bool is_precompiled_file(const char *filename)
+{
+    FILE *file = fopen(filename, "rb");
+    if (!file)
+        return false;
+    char magic[4] = {0};
+    size_t n = fread(magic, 1, sizeof(magic), file);
+    fclose(file);
+    return n == sizeof(magic) && memcmp(magic, EAPC_MAGIC, sizeof(magic)) == 0;
+}
+
+static ASTNode *load_precompiled(const char *filename, const char **source_path)
+{
+    EapcReader r = {0};
+    r.path = filename;
+    r.data = map_file(filename, &r.len);
+
+    if (r.len < EAPC_HEADER_SIZE || memcmp(r.data, EAPC_MAGIC, 4) != 0)
+        eapc_corrupt(&r);
+    r.pos = 4;
+
+    uint32_t version = eapc_get_u32(&r);
+    if (version != EAPC_VERSION)
+    {
+        fprintf(stderr, "Error: '%s' was built by an incompatible version (format %u, expected %u). Recompile it.\n",
+                filename, version, EAPC_VERSION);
+        exit(1);
+    }
+
+    r.node_count = eapc_get_u32(&r);
+    r.slot_count = eapc_get_u32(&r);
+    uint32_t payload_size = eapc_get_u32(&r);
+    uint64_t checksum = eapc_get_u32(&r);
+    checksum |= (uint64_t)eapc_get_u32(&r) << 32;
+
+    if (payload_size != r.len - EAPC_HEADER_SIZE ||
+        fnv1a_hash(r.data + EAPC_HEADER_SIZE, payload_size, FNV1A_SEED) != checksum)
+        eapc_corrupt(&r);
+
+    r.nodes = calloc(r.node_count ? r.node_count : 1, sizeof(ASTNode));
+    r.slots = calloc(r.slot_count ? r.slot_count : 1, sizeof(ASTNode *));
+
+    const char *source = eapc_get_string(&r);
+    if (source_path)
+        *source_path = source;
+
+    ASTNode *prog = eapc_get_node(&r);
+    if (!prog || prog->type != AST_PROGRAM || r.pos != r.len)
+        eapc_corrupt(&r);
+
+    DEBUG_LOG("Loaded %s: %u nodes", filename, r.node_count);
+    return prog;
+}
+// ============================================================================
+// CODE GENERATOR IMPLEMENTATION (Missing Helpers)
+// ============================================================================
+
+// C keywords, names the included headers declare that make plausible
+// variable names, and the generated helpers (eap_*)
+static bool codegen_reserved(const char *name)
+{
+    static const char *reserved[] = {
+        "auto", "bool", "break", "case", "char", "const", "continue", "default", "do", "double", "else", "enum",
+        "extern", "false", "float", "for", "goto", "if", "inline", "int", "long", "register", "restrict", "return",
+        "short", "signed", "sizeof", "static", "struct", "switch", "true", "typedef", "union", "unsigned", "void",
+        "volatile", "while", "main", "NULL", "EOF", "stdin", "stdout", "stderr", "abs", "acos", "asin", "atan",
+        "atoi", "ceil", "cos", "div", "exit", "exp", "fabs", "floor", "fmod", "free", "gamma", "index", "j0", "j1",
+        "jn", "labs", "log", "log10", "log2", "malloc", "pow", "printf", "putchar", "puts", "rand", "remove",
+        "rename", "rindex", "round", "scanf", "sin", "sqrt", "srand", "strcat", "strcmp", "strcpy", "strlen",
+        "system", "tan", "trunc", "y0", "y1", "yn"};
+    if (strncmp(name, "eap_", 4) == 0)
+        return true;
+    for (size_t i = 0; i < sizeof(reserved) / sizeof(reserved[0]); i++)
+    {
+        if (strcmp(name, reserved[i]) == 0)
+            return true;
+    }
+    return false;
+}
+
+char *sanitize_identifier(const char *name)
+{
+    if (!name)
+        return NULL;
+    static char buffer[MAX_TOKEN_LEN * 3 + 1];
+    int j = 0;
+    for (int i = 0; name[i] && j < MAX_TOKEN_LEN * 3 - 3; i++)
+    {
+        unsigned char c = (unsigned char)name[i];
+        // C identifiers can only have alphanumeric and underscores.
+        // Other bytes (Greek UTF-8 sequences, '-') are spelled out in hex so
+        // that distinct EAP names never collapse into the same C name.
+        if (isalnum(c) || c == '_')
+        {
+            buffer[j++] = c;
+        }
+        else
+        {
+            j += sprintf(buffer + j, "_%02x", c);
+        }
+    }
+    buffer[j] = '\0';
+    // round becomes round_, clear of round() in <math.h>
+    if (codegen_reserved(buffer))
+        strcpy(buffer + j, "_");
+    return buffer;
+}
+const char *map_type(const char *eap_type)
+{
+    if (!eap_type)
+        return "int";
+
+    if (str_equals_ignore_case(eap_type, "INTEGER") ||
+        str_equals_ignore_case(eap_type, "ΑΚΕΡΑΙΟΣ"))
+        return "int";
+
+    if (str_equals_ignore_case(eap_type, "REAL") ||
+        str_equals_ignore_case(eap_type, "ΠΡΑΓΜΑΤΙΚΟΣ"))
+        return "double";
+
+    if (str_equals_ignore_case(eap_type, "BOOLEAN") ||
+        str_equals_ignore_case(eap_type, "ΛΟΓΙΚΟΣ"))
+        return "bool";
+
+    if (str_equals_ignore_case(eap_type, "STRING") ||
+        str_equals_ignore_case(eap_type, "ΣΥΜΒΟΛΟΣΕΙΡΑ"))
+        return "char*";
+
+    if (str_equals_ignore_case(eap_type, "CHAR") ||
+        str_equals_ignore_case(eap_type, "ΧΑΡΑΚΤΗΡΑΣ"))
+        return "char";
+
+    return "int"; // default fallback
+}
+
+static bool is_string_type(const char *type)
+{
+    return type && (str_equals_ignore_case(type, "STRING") || str_equals_ignore_case(type, "ΣΥΜΒΟΛΟΣΕΙΡΑ") ||
+                    str_equals_ignore_case(type, "CHAR") || str_equals_ignore_case(type, "ΧΑΡΑΚΤΗΡΑΣ"));
+}
+
+static bool is_array_type(const char *type)
+{
+    return type && strncmp(type, "ARRAY", 5) == 0;
+}
+
+// ============================================================================
+// CODEGEN HELPER FUNCTIONS
+// ============================================================================
+
+static CodegenSymbol *codegen_lookup(CodeGenerator *gen, const char *name)
+{
+    char *key = str_upper(name);
+    CodegenSymbol *sym = gen->locals ? hashmap_get(gen->locals, key) : NULL;
+    if (!sym && gen->globals)
+        sym = hashmap_get(gen->globals, key);
+    free(key);
+    return sym;
+}
+
+// Defines a symbol in the current scope, replacing an earlier definition
+static CodegenSymbol *codegen_define(CodeGenerator *gen, const char *name, const char *c_type)
+{
+    HashMap *scope = gen->locals ? gen->locals : gen->globals;
+    char *key = str_upper(name);
+    CodegenSymbol *sym = hashmap_get(scope, key);
+    if (!sym)
+    {
+        sym = malloc(sizeof(CodegenSymbol));
+        hashmap_set(scope, key, sym);
+    }
+    free(key);
+
+    memset(sym, 0, sizeof(CodegenSymbol));
+    sym->c_type = c_type;
+    return sym;
+}
+
+static void codegen_free_symbols(HashMap *scope)
+{
+    for (int i = 0; i < MAX_HASH_SIZE; i++)
+    {
+        for (HashNode *node = scope->buckets[i]; node; node = node->next)
+            free(node->value);
+    }
+    free_hashmap(scope);
+}
+
+// Frees what the generator allocated; the output file stays open
+static void codegen_release(CodeGenerator *gen)
+{
+    codegen_free_symbols(gen->globals);
+    free(gen->unchecked);
+}
+
+// Register array bounds
+void codegen_register_array(CodeGenerator *gen, const char *name, int start, int end, int dimension)
+{
+    CodegenSymbol *sym = codegen_lookup(gen, name);
+    if (sym && dimension < MAX_ARRAY_DIMS)
+    {
+        sym->bounds_start[dimension] = start;
+        sym->bounds_end[dimension] = end;
+        if (dimension >= sym->num_dims)
+        {
+            sym->num_dims = dimension + 1;
+        }
+    }
+}
+
+// Register variable type
+void codegen_register_var_type(CodeGenerator *gen, const char *name, const char *type)
+{
+    codegen_define(gen, name, type);
+}
+
+const char *codegen_get_var_type(CodeGenerator *gen, const char *name)
+{
+    CodegenSymbol *sym = codegen_lookup(gen, name);
+    return sym ? sym->c_type : "int";
+}
+
+static bool codegen_is_array(CodeGenerator *gen, const char *name)
+{
+    CodegenSymbol *sym = codegen_lookup(gen, name);
+    return sym && sym->num_dims > 0;
+}
+
+// Find constant declaration by name
+ASTNode *codegen_find_constant(CodeGenerator *gen, const char *name)
+{
+    if (!gen->program)
+        return NULL;
+
+    // Local variables shadow constants
+    if (gen->locals)
+    {
+        char *key = str_upper(name);
+        bool is_local = hashmap_get(gen->locals, key) != NULL;
+        free(key);
+        if (is_local)
+            return NULL;
+    }
+
+    for (int i = 0; i < gen->program->program.num_decls; i++)
+    {
+        ASTNode *decl = gen->program->program.declarations[i];
+        if (decl->type == AST_CONST_DECL && str_equals_ignore_case(decl->decl.name, name))
+        {
+            return decl;
+        }
+    }
+    return NULL;
+}
+
+// Folds an integer expression over literals and constants
+static bool codegen_constant_int(CodeGenerator *gen, ASTNode *expr, int *out)
+{
+    int l, r;
+
+    switch (expr->type)
+    {
+    case AST_LITERAL:
+        if (expr->literal.value.type != VAL_INT)
+            return false;
+        *out = expr->literal.value.value.int_val;
+        return true;
+
+    case AST_IDENTIFIER:
+    {
+        ASTNode *constant = codegen_find_constant(gen, expr->identifier.name);
+        if (!constant || !gen->env)
+            return false;
+        RuntimeValue val = evaluate(constant->decl.value, gen->env);
+        bool ok = val.type == VAL_INT;
+        if (ok)
+            *out = val.value.int_val;
+        free_runtime_value(&val);
+        return ok;
+    }
+
+    case AST_UNARY_OP:
+        if (strcmp(expr->unary.operator, "-") != 0 || !codegen_constant_int(gen, expr->unary.operand, out))
+            return false;
+        *out = -*out;
+        return true;
+
+    case AST_BINARY_OP:
+        if (!codegen_constant_int(gen, expr->binary.left, &l) || !codegen_constant_int(gen, expr->binary.right, &r))
+            return false;
+        if (strcmp(expr->binary.operator, "+") == 0)
+            *out = l + r;
+        else if (strcmp(expr->binary.operator, "-") == 0)
+            *out = l - r;
+        else if (strcmp(expr->binary.operator, "*") == 0)
+            *out = l * r;
+        else if (strcmp(expr->binary.operator, "DIV") == 0 && r != 0)
+            *out = l / r;
+        else if (strcmp(expr->binary.operator, "MOD") == 0 && r != 0)
+            *out = l % r;
+        else
+            return false;
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+// Evaluates one bound of an array parameter type. The type is kept as the
+// parameter's tokens separated by spaces, e.g. "1", "N" or "N + 1".
+static bool codegen_fold_bound_text(CodeGenerator *gen, const char *text, int *out)
+{
+    int sum = 0, product = 1, sign = 1;
+    bool expect_operand = true, negate = false;
+    char word[MAX_TOKEN_LEN];
+
+    while (*text)
+    {
+        int len = 0;
+        while (*text == ' ')
+            text++;
+        while (*text && *text != ' ' && len < MAX_TOKEN_LEN - 1)
+            word[len++] = *text++;
+        word[len] = '\0';
+        if (len == 0)
+            break;
+
+        if (expect_operand)
+        {
+            int value;
+            if (strcmp(word, "-") == 0)
+            {
+                negate = !negate;
+                continue;
+            }
+            if (isdigit((unsigned char)word[0]))
+            {
+                value = atoi(word);
+            }
+            else
+            {
+                ASTNode *constant = codegen_find_constant(gen, word);
+                if (!constant || !codegen_constant_int(gen, constant->decl.value, &value))
+                    return false;
+            }
+            product *= negate ? -value : value;
+            negate = false;
+            expect_operand = false;
+        }
+        else if (strcmp(word, "*") == 0)
+        {
+            expect_operand = true;
+        }
+        else if (strcmp(word, "+") == 0 || strcmp(word, "-") == 0)
+        {
+            sum += sign * product;
+            product = 1;
+            sign = word[0] == '+' ? 1 : -1;
+            expect_operand = true;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    if (expect_operand)
+        return false;
+    *out = sum + sign * product;
+    return true;
+}
+
+// Element type of an array parameter type "ARRAY [ ... ] OF type"
+static const char *codegen_param_element_type(const char *type)
+{
+    const char *of = strstr(type, " OF ");
+    return map_type(of ? of + 4 : NULL);
+}
+
+// Reads the bounds of an array parameter type "ARRAY [ a .. b , ... ] OF type"
+// into sym. Returns false if they are not constant.
+static bool codegen_param_bounds(CodeGenerator *gen, const char *type, CodegenSymbol *sym)
+{
+    const char *open = strchr(type, '[');
+    const char *close = open ? strchr(open, ']') : NULL;
+    if (!close)
+        return false;
+
+    char text[256];
+    snprintf(text, sizeof(text), "%.*s", (int)(close - open - 1), open + 1);
+
+    sym->num_dims = 0;
+    char *dim = text;
+    while (dim && sym->num_dims < MAX_ARRAY_DIMS)
+    {
+        char *next = strstr(dim, " , ");
+        if (next)
+        {
+            *next = '\0';
+            next += 3;
+        }
+
+        char *dots = strstr(dim, "..");
+        if (!dots)
+            return false;
+        *dots = '\0';
+        if (!codegen_fold_bound_text(gen, dim, &sym->bounds_start[sym->num_dims]) ||
+            !codegen_fold_bound_text(gen, dots + 2, &sym->bounds_end[sym->num_dims]))
+            return false;
+        sym->num_dims++;
+        dim = next;
+    }
+    return sym->num_dims > 0;
+}
+
+// Defines a parameter in the current scope
+static void codegen_define_parameter(CodeGenerator *gen, ASTNode *param)
+{
+    const char *type = param->param.param_type;
+    if (!is_array_type(type))
+    {
+        codegen_define(gen, param->param.name, map_type(type));
+        return;
+    }
+
+    CodegenSymbol *sym = codegen_define(gen, param->param.name, codegen_param_element_type(type));
+    if (!codegen_param_bounds(gen, type, sym))
+    {
+        // Unknown bounds: treat as a one-dimensional array checked from below only
+        sym->num_dims = 1;
+        sym->bounds_start[0] = 1;
+        sym->bounds_end[0] = INT_MAX;
+    }
+}
+
+// Emits a parameter declaration. Arrays are passed as a pointer to their
+// first element, whether they are reference parameters or not, as in the
+// interpreter.
+static void codegen_parameter(CodeGenerator *gen, ASTNode *param, bool with_name)
+{
+    const char *type = param->param.param_type;
+    bool pointer = param->param.is_reference || is_array_type(type);
+    const char *c_type = is_array_type(type) ? codegen_param_element_type(type) : map_type(type);
+
+    if (with_name)
+        fprintf(gen->output, "%s %s%s", c_type, pointer ? "*" : "", sanitize_identifier(param->param.name));
+    else
+        fprintf(gen->output, "%s%s", c_type, pointer ? "*" : "");
+}
+
+static bool codegen_is_unchecked(CodeGenerator *gen, ASTNode *access)
+{
+    for (int i = 0; i < gen->num_unchecked; i++)
+    {
+        if (gen->unchecked[i] == access)
+            return true;
+    }
+    return false;
+}
+
+// Emits the element of a lowered array. Arrays are stored row-major in one
+// buffer, so every access is a single linear index; each index is checked
+// against its bounds like in the interpreter, unless a loop guard has
+// already proven the access (see codegen_bce_guard).
+static void codegen_array_element(CodeGenerator *gen, const char *name, ASTNode **indices, int num_indices,
+                                  bool checked)
+{
+    CodegenSymbol *sym = codegen_lookup(gen, name);
+    char cname[MAX_TOKEN_LEN * 3 + 1];
+    snprintf(cname, sizeof(cname), "%s", sanitize_identifier(name));
+
+    fprintf(gen->output, "%s[", cname);
+    if (!sym || sym->num_dims == 0)
+    {
+        // Not an array we know of: assume one dimension starting at 1
+        fprintf(gen->output, "(");
+        codegen_expression(gen, indices[0]);
+        fprintf(gen->output, ") - 1]");
+        return;
+    }
+
+    for (int i = 0; i < num_indices && i < sym->num_dims; i++)
+    {
+        if (i > 0)
+            fprintf(gen->output, " + ");
+        fprintf(gen->output, checked ? "eap_chk(" : "(");
+        codegen_expression(gen, indices[i]);
+
+        if (sym->dynamic)
+        {
+            if (checked)
+                fprintf(gen->output, ", %s_lo%d, %s_hi%d, %d)", cname, i, cname, i, i + 1);
+            else
+                fprintf(gen->output, " - %s_lo%d)", cname, i);
+            if (i < sym->num_dims - 1)
+                fprintf(gen->output, " * %s_st%d", cname, i);
+        }
+        else
+        {
+            long stride = 1;
+            for (int j = i + 1; j < sym->num_dims; j++)
+            {
+                int len = sym->bounds_end[j] - sym->bounds_start[j] + 1;
+                stride *= len > 0 ? len : 0;
+            }
+            if (checked)
+                fprintf(gen->output, ", %d, %d, %d)", sym->bounds_start[i], sym->bounds_end[i], i + 1);
+            else if (sym->bounds_start[i] > 0)
+                fprintf(gen->output, " - %d)", sym->bounds_start[i]);
+            else if (sym->bounds_start[i] < 0)
+                fprintf(gen->output, " + %d)", -sym->bounds_start[i]);
+            else
+                fprintf(gen->output, ")");
+            if (i < sym->num_dims - 1)
+                fprintf(gen->output, " * %ld", stride);
+        }
+    }
+    fprintf(gen->output, "]");
+}
+
+// Number of elements of an array with constant bounds
+static long codegen_array_length(CodegenSymbol *sym)
+{
+    long total = 1;
+    for (int i = 0; i < sym->num_dims; i++)
+    {
+        int len = sym->bounds_end[i] - sym->bounds_start[i] + 1;
+        total *= len > 0 ? len : 0;
+    }
+    return total;
+}
+
+// Emits the statements that compute the bounds of an array and allocate it.
+// With declare the variables are declared as well (local arrays); otherwise
+// they are assigned (global arrays with run-time bounds, set up in main).
+static void codegen_array_allocation(CodeGenerator *gen, ASTNode *decl, bool declare)
+{
+    CodegenSymbol *sym = codegen_lookup(gen, decl->decl.name);
+    char cname[MAX_TOKEN_LEN * 3 + 1];
+    snprintf(cname, sizeof(cname), "%s", sanitize_identifier(decl->decl.name));
+    const char *int_decl = declare ? "int " : "";
+
+    if (!sym->dynamic)
+    {
+        codegen_indent(gen);
+        fprintf(gen->output, "%s%s%s = eap_alloc(%ld, sizeof(%s));\n", declare ? sym->c_type : "",
+                declare ? " *" : "", cname, codegen_array_length(sym), sym->c_type);
+        return;
+    }
+
+    for (int i = 0; i < sym->num_dims; i++)
+    {
+        codegen_indent(gen);
+        fprintf(gen->output, "%s%s_lo%d = ", int_decl, cname, i);
+        codegen_expression(gen, decl->decl.arr_bound_exprs[i].start_expr);
+        fprintf(gen->output, ";\n");
+        codegen_indent(gen);
+        fprintf(gen->output, "%s%s_hi%d = ", int_decl, cname, i);
+        codegen_expression(gen, decl->decl.arr_bound_exprs[i].end_expr);
+        fprintf(gen->output, ";\n");
+    }
+    for (int i = sym->num_dims - 1; i >= 0; i--)
+    {
+        codegen_indent(gen);
+        if (i == sym->num_dims - 1)
+            fprintf(gen->output, "%s%s_st%d = 1;\n", int_decl, cname, i);
+        else
+            fprintf(gen->output, "%s%s_st%d = %s_st%d * eap_len(%s_lo%d, %s_hi%d);\n", int_decl, cname, i,
+                    cname, i + 1, cname, i + 1, cname, i + 1);
+    }
+    codegen_indent(gen);
+    fprintf(gen->output, "%s%s%s = eap_alloc((long)%s_st0 * eap_len(%s_lo0, %s_hi0), sizeof(%s));\n",
+            declare ? sym->c_type : "", declare ? " *" : "", cname, cname, cname, cname, sym->c_type);
+}
+
+static void codegen_free_local_arrays(CodeGenerator *gen, ASTNode *subroutine)
+{
+    for (int i = 0; i < subroutine->subroutine.num_local_decls; i++)
+    {
+        ASTNode *local = subroutine->subroutine.local_decls[i];
+        if (local->decl.num_arr_dims > 0)
+            codegen_line(gen, "free(%s);", sanitize_identifier(local->decl.name));
+    }
+}
+
+static bool is_comparison_operator(const char *op)
+{
+    return strcmp(op, "=") == 0 || strcmp(op, "<>") == 0 || strcmp(op, "<") == 0 ||
+           strcmp(op, ">") == 0 || strcmp(op, "<=") == 0 || strcmp(op, ">=") == 0;
+}
+
+static bool is_logical_operator(const char *op)
+{
+    return str_equals_ignore_case(op, "AND") || str_equals_ignore_case(op, "ΚΑΙ") ||
+           str_equals_ignore_case(op, "OR") || str_equals_ignore_case(op, "Ή");
+}
+
+// Infer the C type of an expression ("int", "double", "bool" or "char*")
+const char *codegen_expr_ctype(CodeGenerator *gen, ASTNode *expr)
+{
+    if (!expr)
+        return "int";
+
+    switch (expr->type)
+    {
+    case AST_LITERAL:
+        switch (expr->literal.value.type)
+        {
+        case VAL_REAL:
+            return "double";
+        case VAL_BOOL:
+            return "bool";
+        case VAL_STRING:
+            return "char*";
+        default:
+            return "int";
+        }
+
+    case AST_IDENTIFIER:
+    {
+        ASTNode *constant = codegen_find_constant(gen, expr->identifier.name);
+        if (constant)
+            return codegen_expr_ctype(gen, constant->decl.value);
+        return codegen_get_var_type(gen, expr->identifier.name);
+    }
+
+    case AST_ARRAY_ACCESS:
+        return codegen_get_var_type(gen, expr->array_access.name);
+
+    case AST_CALL:
+        return codegen_get_var_type(gen, expr->call.name);
+
+    case AST_UNARY_OP:
+        if (str_equals_ignore_case(expr->unary.operator, "NOT") ||
+            str_equals_ignore_case(expr->unary.operator, "ΟΧΙ"))
+            return "bool";
+        return codegen_expr_ctype(gen, expr->unary.operand);
+
+    case AST_BINARY_OP:
+    {
+        const char *op = expr->binary.operator;
+        if (is_comparison_operator(op) || is_logical_operator(op))
+            return "bool";
+        if (strcmp(op, "/") == 0)
+            return "double";
+        if (str_equals_ignore_case(op, "DIV") || str_equals_ignore_case(op, "MOD"))
+            return "int";
+        if (strcmp(codegen_expr_ctype(gen, expr->binary.left), "double") == 0 ||
+            strcmp(codegen_expr_ctype(gen, expr->binary.right), "double") == 0)
+            return "double";
+        return "int";
+    }
+
+    default:
+        return "int";
     }
 }
 
-// Windows-1253 (Greek) to UTF-8 conversion table for Greek characters
-static void convert_windows1253_to_utf8(char *content, size_t size)
+// Infer printf format specifier
+const char *codegen_infer_printf_format(CodeGenerator *gen, ASTNode *expr)
 {
-    // Mapping table for Windows-1253 Greek characters to UTF-8
-    // This covers the Greek character range (0x80-0xFF in Windows-1253)
-    static const struct
+    if (expr && expr->type == AST_IDENTIFIER && str_equals_ignore_case(expr->identifier.name, "EOLN"))
+        return "%c";
+
+    const char *type = codegen_expr_ctype(gen, expr);
+    if (strcmp(type, "double") == 0)
+        return "%g";
+    if (strcmp(type, "bool") == 0 || strcmp(type, "char*") == 0)
+        return "%s";
+    return "%d";
+}
+
+// Find subroutine by name
+ASTNode *codegen_find_subroutine(CodeGenerator *gen, const char *name)
+{
+    if (!gen->program)
+        return NULL;
+
+    for (int i = 0; i < gen->program->program.num_decls; i++)
     {
-        unsigned char win1253;
-        const char *utf8;
-    } greek_map[] = {
-        // Greek uppercase letters
-        {0xC1, "Α"},
-        {0xC2, "Β"},
-        {0xC3, "Γ"},
-        {0xC4, "Δ"},
-        {0xC5, "Ε"},
-        {0xC6, "Ζ"},
-        {0xC7, "Η"},
-        {0xC8, "Θ"},
-        {0xC9, "Ι"},
-        {0xCA, "Κ"},
-        {0xCB, "Λ"},
-        {0xCC, "Μ"},
-        {0xCD, "Ν"},
-        {0xCE, "Ξ"},
-        {0xCF, "Ο"},
-        {0xD0, "Π"},
-        {0xD1, "Ρ"},
-        {0xD3, "Σ"},
-        {0xD4, "Τ"},
-        {0xD5, "Υ"},
-        {0xD6, "Φ"},
-        {0xD7, "Χ"},
-        {0xD8, "Ψ"},
-        {0xD9, "Ω"},
+        ASTNode *decl = gen->program->program.declarations[i];
+        if ((decl->type == AST_FUNC_DECL || decl->type == AST_PROC_DECL) &&
+            str_equals_ignore_case(decl->subroutine.name, name))
+        {
+            return decl;
+        }
+    }
+    return NULL;
+}
 
-        // Greek lowercase letters
-        {0xE1, "α"},
-        {0xE2, "β"},
-        {0xE3, "γ"},
-        {0xE4, "δ"},
-        {0xE5, "ε"},
-        {0xE6, "ζ"},
-        {0xE7, "η"},
-        {0xE8, "θ"},
-        {0xE9, "ι"},
-        {0xEA, "κ"},
-        {0xEB, "λ"},
-        {0xEC, "μ"},
-        {0xED, "ν"},
-        {0xEE, "ξ"},
-        {0xEF, "ο"},
-        {0xF0, "π"},
-        {0xF1, "ρ"},
-        {0xF2, "ς"},
-        {0xF3, "σ"},
-        {0xF4, "τ"},
-        {0xF5, "υ"},
-        {0xF6, "φ"},
-        {0xF7, "χ"},
-        {0xF8, "ψ"},
-        {0xF9, "ω"},
+// Check if parameter is by reference
+bool codegen_is_param_by_ref(ASTNode *subroutine, int param_index)
+{
+    if (!subroutine || param_index >= subroutine->subroutine.num_params)
+    {
+        return false;
+    }
+    return subroutine->subroutine.parameters[param_index]->param.is_reference;
+}
+void codegen_init(CodeGenerator *gen, FILE *out)
+{
+    gen->output = out;
+    gen->indent_level = 0;
+    gen->in_function = false;
+    gen->current_function_name = NULL;
+    gen->env = NULL;
+    gen->program = NULL;
+    gen->current_subroutine = NULL;
+    gen->globals = create_hashmap();
+    gen->locals = NULL;
+    gen->temp_counter = 0;
+    gen->unchecked = NULL;
+    gen->num_unchecked = 0;
+    gen->unchecked_capacity = 0;
+    gen->bce_var = NULL;
+    gen->bce_value = NULL;
+}
 
-        // Greek uppercase with tonos (accented)
-        {0xA1, "Ά"},
-        {0xA2, "Έ"},
-        {0xA3, "Ή"},
-        {0xA4, "Ί"},
-        {0xA5, "Ό"},
-        {0xA6, "Ύ"},
-        {0xA7, "Ώ"},
+void codegen_indent(CodeGenerator *gen)
+{
+    for (int i = 0; i < gen->indent_level; i++)
+    {
+        fprintf(gen->output, "    ");
+    }
+}
 
-        // Greek lowercase with tonos (accented)
-        {0xDC, "ά"},
-        {0xDD, "έ"},
-        {0xDE, "ή"},
-        {0xDF, "ί"},
-        {0xFC, "ό"},
-        {0xFD, "ύ"},
-        {0xFE, "ώ"},
+void codegen_line(CodeGenerator *gen, const char *fmt, ...)
+{
+    codegen_indent(gen);
+    va_list args;
+    va_start(args, fmt);
+    vfprintf(gen->output, fmt, args);
+    va_end(args);
+    fprintf(gen->output, "\n");
+}
 
-        // Greek lowercase with dialytika
-        {0xCA, "ϊ"},
-        {0xCB, "ϋ"},
+static bool codegen_is_ref_param(CodeGenerator *gen, const char *name);
 
-        {0, NULL} // Terminator
-    };
+void codegen_expression(CodeGenerator *gen, ASTNode *expr)
+{
+    if (!expr)
+    {
+        fprintf(gen->output, "0");
+        return;
+    }
 
-    // Calculate new size (UTF-8 can be up to 3 bytes per Greek char)
-    size_t new_size = 0;
-    for (size_t i = 0; i < size; i++)
+    switch (expr->type)
     {
-        unsigned char c = (unsigned char)content[i];
-        if (c >= 0x80)
+    case AST_LITERAL:
+        switch (expr->literal.value.type)
         {
-            // Find in map
-            int found = 0;
-            for (int j = 0; greek_map[j].utf8 != NULL; j++)
+        case VAL_INT:
+            fprintf(gen->output, "%d", expr->literal.value.value.int_val);
+            break;
+        case VAL_REAL:
+            fprintf(gen->output, "%g", expr->literal.value.value.real_val);
+            break;
+        case VAL_BOOL:
+            fprintf(gen->output, "%s", expr->literal.value.value.bool_val ? "true" : "false");
+            break;
+        case VAL_STRING:
+            // Handle EOLN marker vs regular string
+            if (strcmp(expr->literal.value.value.str_val, "__EOLN__") == 0 ||
+                strcmp(expr->literal.value.value.str_val, "EOLN") == 0)
             {
-                if (greek_map[j].win1253 == c)
-                {
-                    new_size += strlen(greek_map[j].utf8);
-                    found = 1;
-                    break;
-                }
+                // If we are in a printf argument list, use '\n'
+                fprintf(gen->output, "'\\n'");
             }
-            if (!found)
-                new_size++; // Keep as-is if not in map
+            else
+            {
+                fprintf(gen->output, "\"%s\"", expr->literal.value.value.str_val);
+            }
+            break;
+        default:
+            fprintf(gen->output, "0");
         }
-        else
+        break;
+
+    case AST_IDENTIFIER:
+    {
+        if (gen->bce_var && str_equals_ignore_case(expr->identifier.name, gen->bce_var))
         {
-            new_size++;
+            fprintf(gen->output, "%s", gen->bce_value);
+            break;
         }
-    }
 
-    // Allocate new buffer
-    char *new_content = malloc(new_size + 1);
-    if (!new_content)
-        return;
+        if (str_equals_ignore_case(expr->identifier.name, "EOLN"))
+        {
+            fprintf(gen->output, "'\\n'");
+            break;
+        }
 
-    // Convert
-    size_t out_pos = 0;
-    for (size_t i = 0; i < size; i++)
-    {
-        unsigned char c = (unsigned char)content[i];
-        if (c >= 0x80)
+        // Check if this identifier is a constant
+        bool is_constant = false;
+        RuntimeValue const_value;
+
+        ASTNode *const_decl = codegen_find_constant(gen, expr->identifier.name);
+        if (const_decl)
         {
-            // Find in map
-            int found = 0;
-            for (int j = 0; greek_map[j].utf8 != NULL; j++)
+            is_constant = true;
+            // Evaluate the constant value
+            const_value = evaluate(const_decl->decl.value, gen->env);
+        }
+
+        if (is_constant)
+        {
+            // Output the constant's VALUE, not its name
+            switch (const_value.type)
             {
-                if (greek_map[j].win1253 == c)
-                {
-                    const char *utf8 = greek_map[j].utf8;
-                    while (*utf8)
-                    {
-                        new_content[out_pos++] = *utf8++;
-                    }
-                    found = 1;
-                    break;
-                }
+            case VAL_INT:
+                fprintf(gen->output, "%d", const_value.value.int_val);
+                break;
+            case VAL_REAL:
+                fprintf(gen->output, "%.17g", const_value.value.real_val);
+                break;
+            case VAL_BOOL:
+                fprintf(gen->output, "%s", const_value.value.bool_val ? "true" : "false");
+                break;
+            default:
+                // Fall back to sanitized name
+                fprintf(gen->output, "%s", sanitize_identifier(expr->identifier.name));
+                break;
             }
-            if (!found)
+            free_runtime_value(&const_value);
+        }
+        else if (gen->in_function && gen->current_function_name &&
+                 str_equals_ignore_case(expr->identifier.name, gen->current_function_name))
+        {
+            // Reading the function's own return variable
+            fprintf(gen->output, "%s_result", sanitize_identifier(gen->current_function_name));
+        }
+        else
+        {
+            // Dereference if it's a pointer parameter
+            if (codegen_is_ref_param(gen, expr->identifier.name))
             {
-                new_content[out_pos++] = c; // Keep as-is
+                fprintf(gen->output, "(*%s)", sanitize_identifier(expr->identifier.name));
+            }
+            else
+            {
+                fprintf(gen->output, "%s", sanitize_identifier(expr->identifier.name));
             }
         }
+        break;
+    }
+
+    case AST_BINARY_OP:
+        // Division operators go through runtime helpers that match the
+        // interpreter: "/" is always real division, DIV/MOD truncate to int,
+        // and all three report division by zero the same way
+        if (strcmp(expr->binary.operator, "/") == 0 ||
+            str_equals_ignore_case(expr->binary.operator, "DIV") ||
+            str_equals_ignore_case(expr->binary.operator, "MOD"))
+        {
+            const char *helper = strcmp(expr->binary.operator, "/") == 0 ? "eap_rdiv"
+                                 : str_equals_ignore_case(expr->binary.operator, "DIV") ? "eap_div"
+                                                                                          : "eap_mod";
+            fprintf(gen->output, "%s(", helper);
+            codegen_expression(gen, expr->binary.left);
+            fprintf(gen->output, ", ");
+            codegen_expression(gen, expr->binary.right);
+            fprintf(gen->output, ")");
+            break;
+        }
+
+        fprintf(gen->output, "(");
+        codegen_expression(gen, expr->binary.left);
+
+        // Map operators
+        if (strcmp(expr->binary.operator, "=") == 0)
+        {
+            fprintf(gen->output, " == ");
+        }
+        else if (strcmp(expr->binary.operator, "<>") == 0)
+        {
+            fprintf(gen->output, " != ");
+        }
+        else if (str_equals_ignore_case(expr->binary.operator, "AND") ||
+                 str_equals_ignore_case(expr->binary.operator, "ΚΑΙ"))
+        {
+            fprintf(gen->output, " && ");
+        }
+        else if (str_equals_ignore_case(expr->binary.operator, "OR") ||
+                 str_equals_ignore_case(expr->binary.operator, "Ή"))
+        {
+            fprintf(gen->output, " || ");
+        }
         else
         {
-            new_content[out_pos++] = c;
+            fprintf(gen->output, " %s ", expr->binary.operator);
+        }
+
+        codegen_expression(gen, expr->binary.right);
+        fprintf(gen->output, ")");
+        break;
+
+    case AST_UNARY_OP:
+        if (str_equals_ignore_case(expr->unary.operator, "NOT") ||
+            str_equals_ignore_case(expr->unary.operator, "ΟΧΙ"))
+        {
+            fprintf(gen->output, "!(");
+        }
+        else
+        {
+            fprintf(gen->output, "%s(", expr->unary.operator);
+        }
+        codegen_expression(gen, expr->unary.operand);
+        fprintf(gen->output, ")");
+        break;
+
+    case AST_ARRAY_ACCESS:
+        codegen_array_element(gen, expr->array_access.name, expr->array_access.indices,
+                              expr->array_access.num_indices, !codegen_is_unchecked(gen, expr));
+        break;
+
+    case AST_CALL:
+        fprintf(gen->output, "%s(", sanitize_identifier(expr->call.name));
+        for (int i = 0; i < expr->call.num_args; i++)
+        {
+            if (i > 0)
+                fprintf(gen->output, ", ");
+            codegen_expression(gen, expr->call.arguments[i]);
         }
+        fprintf(gen->output, ")");
+        break;
+
+    default:
+        fprintf(gen->output, "0");
     }
-    new_content[out_pos] = '\0';
+}
 
-    // Copy back to original buffer
-    if (out_pos <= size)
+// ============================================================================
+// STATEMENT GENERATION
+// ============================================================================
+
+static bool codegen_is_eoln(ASTNode *expr)
+{
+    if (expr->type == AST_IDENTIFIER)
+        return str_equals_ignore_case(expr->identifier.name, "EOLN");
+    return expr->type == AST_LITERAL && expr->literal.value.type == VAL_STRING &&
+           strcmp(expr->literal.value.value.str_val, "__EOLN__") == 0;
+}
+
+// Scalar reference parameters are pointers that have to be dereferenced
+static bool codegen_is_ref_param(CodeGenerator *gen, const char *name)
+{
+    if (!gen->current_subroutine || codegen_is_array(gen, name))
+        return false;
+
+    for (int i = 0; i < gen->current_subroutine->subroutine.num_params; i++)
     {
-        memcpy(content, new_content, out_pos + 1);
+        ASTNode *param = gen->current_subroutine->subroutine.parameters[i];
+        if (str_equals_ignore_case(param->param.name, name) && param->param.is_reference)
+            return true;
     }
+    return false;
+}
+
+// Emit "name = " for a scalar variable, dereferencing reference parameters
+static void codegen_variable_target(CodeGenerator *gen, const char *name)
+{
+    if (codegen_is_ref_param(gen, name))
+        fprintf(gen->output, "*%s = ", sanitize_identifier(name));
     else
+        fprintf(gen->output, "%s = ", sanitize_identifier(name));
+}
+
+// Emit the address of a variable or array element (for READ)
+static void codegen_variable_address(CodeGenerator *gen, ASTNode *var)
+{
+    fprintf(gen->output, "&");
+    codegen_expression(gen, var);
+}
+
+// The counting loop of a FOR statement, inside the block declaring its
+// eap_start/eap_end (and eap_step) temporaries
+static void codegen_for_loop(CodeGenerator *gen, ASTNode *stmt, int id, const char *step)
+{
+    codegen_indent(gen);
+    if (isdigit((unsigned char)step[0]) || step[0] == '-')
     {
-        // Need to inform caller about size change
-        // For now, just copy what fits
-        memcpy(content, new_content, size);
-        content[size] = '\0';
+        fprintf(gen->output, "for (int eap_i%d = eap_start%d; eap_i%d %s eap_end%d; eap_i%d += %s) {\n",
+                id, id, id, atoi(step) > 0 ? "<=" : ">=", id, id, step);
+    }
+    else
+    {
+        fprintf(gen->output, "for (int eap_i%d = eap_start%d; %s > 0 ? eap_i%d <= eap_end%d : eap_i%d >= eap_end%d; eap_i%d += %s) {\n",
+                id, id, step, id, id, id, id, id, step);
     }
 
-    free(new_content);
+    gen->indent_level++;
+    codegen_indent(gen);
+    codegen_variable_target(gen, stmt->for_loop.variable);
+    fprintf(gen->output, "eap_i%d;\n", id);
+    for (int i = 0; i < stmt->for_loop.num_stmts; i++)
+    {
+        codegen_statement(gen, stmt->for_loop.body[i]);
+    }
+    gen->indent_level--;
+
+    codegen_indent(gen);
+    fprintf(gen->output, "}\n");
 }
 
-// Better version that returns new buffer
-static char *convert_windows1253_to_utf8_new(const char *content, size_t size)
+// Whether a loop guard can cover the access: a known array with one int
+// index per dimension
+static bool codegen_bce_usable(CodeGenerator *gen, ASTNode *access)
 {
-    // Mapping table
-    static const struct
+    const char *name;
+    ASTNode **indices;
+    int num_indices;
+    bce_access_parts(access, &name, &indices, &num_indices);
+
+    CodegenSymbol *sym = codegen_lookup(gen, name);
+    if (!sym || sym->num_dims != num_indices)
+        return false;
+    for (int i = 0; i < num_indices; i++)
     {
-        unsigned char win1253;
-        const char *utf8;
-    } greek_map[] = {
-        {0xC1, "Α"}, {0xC2, "Β"}, {0xC3, "Γ"}, {0xC4, "Δ"}, {0xC5, "Ε"}, {0xC6, "Ζ"}, {0xC7, "Η"}, {0xC8, "Θ"}, {0xC9, "Ι"}, {0xCA, "Κ"}, {0xCB, "Λ"}, {0xCC, "Μ"}, {0xCD, "Ν"}, {0xCE, "Ξ"}, {0xCF, "Ο"}, {0xD0, "Π"}, {0xD1, "Ρ"}, {0xD3, "Σ"}, {0xD4, "Τ"}, {0xD5, "Υ"}, {0xD6, "Φ"}, {0xD7, "Χ"}, {0xD8, "Ψ"}, {0xD9, "Ω"}, {0xE1, "α"}, {0xE2, "β"}, {0xE3, "γ"}, {0xE4, "δ"}, {0xE5, "ε"}, {0xE6, "ζ"}, {0xE7, "η"}, {0xE8, "θ"}, {0xE9, "ι"}, {0xEA, "κ"}, {0xEB, "λ"}, {0xEC, "μ"}, {0xED, "ν"}, {0xEE, "ξ"}, {0xEF, "ο"}, {0xF0, "π"}, {0xF1, "ρ"}, {0xF2, "ς"}, {0xF3, "σ"}, {0xF4, "τ"}, {0xF5, "υ"}, {0xF6, "φ"}, {0xF7, "χ"}, {0xF8, "ψ"}, {0xF9, "ω"}, {0xDC, "ά"}, {0xDD, "έ"}, {0xDE, "ή"}, {0xDF, "ί"}, {0xFC, "ό"}, {0xFD, "ύ"}, {0xFE, "ώ"}, {0xA1, "Ά"}, {0xA2, "Έ"}, {0xA3, "Ή"}, {0xA4, "Ί"}, {0xA5, "Ό"}, {0xA6, "Ύ"}, {0xA7, "Ώ"}, {0, NULL}};
+        if (strcmp(codegen_expr_ctype(gen, indices[i]), "int") != 0)
+            return false;
+    }
+    return true;
+}
+
+// One eap_in() test of an index, with the loop variable replaced by value
+static void codegen_bce_test(CodeGenerator *gen, ASTNode *index, const char *var, const char *value,
+                             CodegenSymbol *sym, const char *cname, int dim)
+{
+    fprintf(gen->output, " &&\n");
+    codegen_indent(gen);
+    fprintf(gen->output, "    eap_in(");
+    gen->bce_var = var;
+    gen->bce_value = value;
+    codegen_expression(gen, index);
+    gen->bce_var = NULL;
+    gen->bce_value = NULL;
+    if (sym->dynamic)
+        fprintf(gen->output, ", %s_lo%d, %s_hi%d)", cname, dim, cname, dim);
+    else
+        fprintf(gen->output, ", %d, %d)", sym->bounds_start[dim], sym->bounds_end[dim]);
+}
 
-    // Calculate required size
-    size_t new_size = 0;
-    for (size_t i = 0; i < size; i++)
+// Opens "if (guard) {" for the accesses of a FOR loop that bce_plan found
+// affine, and marks them unchecked. Returns how many were marked; nothing is
+// emitted when there are none.
+static int codegen_bce_guard(CodeGenerator *gen, ASTNode *stmt, int id, const char *step)
+{
+    BcePlan *plan = bce_plan(stmt);
+    int proven = 0;
+
+    for (int i = 0; i < plan->count; i++)
     {
-        unsigned char c = (unsigned char)content[i];
-        if (c >= 0x80)
+        BceAccess *access = &plan->accesses[i];
+        ASTNode *leader = access->same_as >= 0 ? plan->accesses[access->same_as].node : access->node;
+        if (!codegen_bce_usable(gen, leader))
+            continue;
+
+        if (proven == 0)
         {
-            int found = 0;
-            for (int j = 0; greek_map[j].utf8 != NULL; j++)
-            {
-                if (greek_map[j].win1253 == c)
-                {
-                    new_size += strlen(greek_map[j].utf8);
-                    found = 1;
-                    break;
-                }
-            }
-            if (!found)
-                new_size++;
+            codegen_indent(gen);
+            fprintf(gen->output, "long long eap_last%d;\n", id);
+            codegen_indent(gen);
+            fprintf(gen->output, "if (eap_for_last(eap_start%d, eap_end%d, %s, &eap_last%d)", id, id, step, id);
         }
-        else
+
+        if (access->same_as < 0)
         {
-            new_size++;
-        }
-    }
+            const char *name;
+            ASTNode **indices;
+            int num_indices;
+            bce_access_parts(access->node, &name, &indices, &num_indices);
 
-    // Allocate and convert
-    char *new_content = malloc(new_size + 1);
-    if (!new_content)
-        return NULL;
+            CodegenSymbol *sym = codegen_lookup(gen, name);
+            char cname[MAX_TOKEN_LEN * 3 + 1];
+            char first[48], last[32];
+            snprintf(cname, sizeof(cname), "%s", sanitize_identifier(name));
+            snprintf(first, sizeof(first), "(long long)eap_start%d", id);
+            snprintf(last, sizeof(last), "eap_last%d", id);
 
-    size_t out_pos = 0;
-    for (size_t i = 0; i < size; i++)
-    {
-        unsigned char c = (unsigned char)content[i];
-        if (c >= 0x80)
-        {
-            int found = 0;
-            for (int j = 0; greek_map[j].utf8 != NULL; j++)
+            for (int k = 0; k < num_indices; k++)
             {
-                if (greek_map[j].win1253 == c)
+                if (bce_degree(stmt, indices[k]) == 0)
                 {
-                    const char *utf8 = greek_map[j].utf8;
-                    while (*utf8)
-                    {
-                        new_content[out_pos++] = *utf8++;
-                    }
-                    found = 1;
-                    break;
+                    codegen_bce_test(gen, indices[k], NULL, NULL, sym, cname, k);
+                }
+                else
+                {
+                    codegen_bce_test(gen, indices[k], stmt->for_loop.variable, first, sym, cname, k);
+                    codegen_bce_test(gen, indices[k], stmt->for_loop.variable, last, sym, cname, k);
                 }
             }
-            if (!found)
-                new_content[out_pos++] = c;
         }
-        else
+
+        if (gen->num_unchecked == gen->unchecked_capacity)
         {
-            new_content[out_pos++] = c;
+            gen->unchecked_capacity = gen->unchecked_capacity ? gen->unchecked_capacity * 2 : 16;
+            gen->unchecked = realloc(gen->unchecked, gen->unchecked_capacity * sizeof(ASTNode *));
         }
+        gen->unchecked[gen->num_unchecked++] = access->node;
+        proven++;
     }
-    new_content[out_pos] = '\0';
 
-    return new_content;
+    if (proven > 0)
+        fprintf(gen->output, ") {\n");
+    return proven;
 }
 
-bool is_valid_utf8(const char *str, size_t len)
+void codegen_statement(CodeGenerator *gen, ASTNode *stmt)
 {
-    const unsigned char *bytes = (const unsigned char *)str;
-    for (size_t i = 0; i < len;)
+    if (!stmt)
+        return;
+
+    switch (stmt->type)
     {
-        if (bytes[i] <= 0x7F)
-            i++;
-        else if (bytes[i] >= 0xC2 && bytes[i] <= 0xDF && i + 1 < len && bytes[i + 1] >= 0x80 && bytes[i + 1] <= 0xBF)
-            i += 2;
-        else if (bytes[i] == 0xE0 && i + 2 < len && bytes[i + 1] >= 0xA0 && bytes[i + 1] <= 0xBF && bytes[i + 2] >= 0x80 && bytes[i + 2] <= 0xBF)
-            i += 3;
-        else if (bytes[i] >= 0xE1 && bytes[i] <= 0xEF && i + 2 < len && bytes[i + 1] >= 0x80 && bytes[i + 1] <= 0xBF && bytes[i + 2] >= 0x80 && bytes[i + 2] <= 0xBF)
-            i += 3;
-        else if (bytes[i] == 0xF0 && i + 3 < len && bytes[i + 1] >= 0x90 && bytes[i + 1] <= 0xBF && bytes[i + 2] >= 0x80 && bytes[i + 2] <= 0xBF && bytes[i + 3] >= 0x80 && bytes[i + 3] <= 0xBF)
-            i += 4;
-        else
-            return false;
-    }
-    return true;
-}
-static char *read_file(const char *filename)
-{
-    FILE *file = fopen(filename, "rb");
-    if (!file)
+    case AST_ASSIGN:
     {
-        fprintf(stderr, "Error: Cannot open file '%s'\n", filename);
-        exit(1);
-    }
+        codegen_indent(gen);
 
-    fseek(file, 0, SEEK_END);
-    long size = ftell(file);
-    fseek(file, 0, SEEK_SET);
+        // Check if assigning to function return value
+        if (gen->in_function && gen->current_function_name &&
+            str_equals_ignore_case(stmt->assign.identifier, gen->current_function_name))
+        {
+            fprintf(gen->output, "%s_result = ", sanitize_identifier(gen->current_function_name));
+        }
+        else
+        {
+            if (stmt->assign.num_indices > 0)
+            {
+                // Array element assignment
+                codegen_array_element(gen, stmt->assign.identifier, stmt->assign.indices, stmt->assign.num_indices,
+                                      !codegen_is_unchecked(gen, stmt));
+                fprintf(gen->output, " = ");
+            }
+            else
+            {
+                // Simple variable assignment
+                codegen_variable_target(gen, stmt->assign.identifier);
+            }
+        }
 
-    char *content = malloc(size + 1);
-    fread(content, 1, size, file);
-    content[size] = '\0';
+        codegen_expression(gen, stmt->assign.value);
+        fprintf(gen->output, ";\n");
+        break;
+    }
 
-    fclose(file);
+    case AST_PRINT:
+    {
+        // Same layout as the interpreter: items separated by a space,
+        // EOLN starts a new line, booleans print as TRUE/FALSE
+        codegen_indent(gen);
+        fprintf(gen->output, "printf(\"");
 
-    // --- ΑΡΧΗ ΔΙΟΡΘΩΣΗΣ ---
+        for (int i = 0; i < stmt->print.num_exprs; i++)
+        {
+            ASTNode *expr = stmt->print.expressions[i];
+            if (codegen_is_eoln(expr))
+            {
+                fprintf(gen->output, "\\n");
+                continue;
+            }
+            if (i > 0)
+                fprintf(gen->output, " ");
+            fprintf(gen->output, "%s", codegen_infer_printf_format(gen, expr));
+        }
+        fprintf(gen->output, "\"");
 
-    // 1. Ορίζουμε τη λέξη "ΑΛΓΟΡΙΘΜΟΣ" σε UTF-8 format (hex bytes)
-    const unsigned char utf8_algo[] = {0xCE, 0x91, 0xCE, 0x9B, 0xCE, 0x93, 0xCE, 0x9F, 0xCE, 0xA1, 0xCE, 0x99, 0xCE, 0x98, 0xCE, 0x9C, 0xCE, 0x9F, 0xCE, 0xA3, 0};
+        // Arguments
+        for (int i = 0; i < stmt->print.num_exprs; i++)
+        {
+            ASTNode *expr = stmt->print.expressions[i];
+            if (codegen_is_eoln(expr))
+                continue;
 
-    // 2. Ελέγχουμε αν το αρχείο περιέχει ήδη τη λέξη ΑΛΓΟΡΙΘΜΟΣ σε UTF-8
-    bool is_already_utf8 = (strstr(content, (const char *)utf8_algo) != NULL);
+            fprintf(gen->output, ", ");
+            if (strcmp(codegen_expr_ctype(gen, expr), "bool") == 0)
+            {
+                fprintf(gen->output, "(");
+                codegen_expression(gen, expr);
+                fprintf(gen->output, ") ? \"TRUE\" : \"FALSE\"");
+            }
+            else
+            {
+                codegen_expression(gen, expr);
+            }
+        }
+        fprintf(gen->output, ");\n");
+        break;
+    }
 
-    // 3. Simple heuristic για Windows-1253
-    int has_greek_win1253 = 0;
-    for (long i = 0; i < size; i++)
+    case AST_READ:
     {
-        unsigned char c = (unsigned char)content[i];
-        if ((c >= 0xC1 && c <= 0xD9) || (c >= 0xE1 && c <= 0xF9))
+        // Stop at the first failed read, like the interpreter does on EOF
+        codegen_indent(gen);
+        fprintf(gen->output, "(void)(");
+        for (int i = 0; i < stmt->read.num_vars; i++)
         {
-            has_greek_win1253 = 1;
-            break;
+            ASTNode *var = stmt->read.variables[i];
+            if (i > 0)
+                fprintf(gen->output, " && ");
+            const char *ctype = codegen_expr_ctype(gen, var);
+            if (strcmp(ctype, "double") == 0)
+                fprintf(gen->output, "eap_read_real(");
+            else if (strcmp(ctype, "char*") == 0)
+                fprintf(gen->output, "eap_read_str(");
+            else if (strcmp(ctype, "bool") == 0)
+                fprintf(gen->output, "eap_read_bool(");
+            else
+                fprintf(gen->output, "eap_read_int(");
+            codegen_variable_address(gen, var);
+            fprintf(gen->output, ", \"%s\")", var->type == AST_ARRAY_ACCESS ? var->array_access.name : var->identifier.name);
         }
+        fprintf(gen->output, ");\n");
+        break;
     }
 
-    // ΜΕΤΑΤΡΟΠΗ: Μόνο αν βρήκαμε bytes της Win-1253 ΚΑΙ ΔΕΝ βρήκαμε το UTF-8 anchor
-    if (has_greek_win1253 && !is_already_utf8)
+    case AST_IF:
     {
-        if (debug_mode)
+        codegen_indent(gen);
+        fprintf(gen->output, "if (");
+        codegen_expression(gen, stmt->if_stmt.condition);
+        fprintf(gen->output, ") {\n");
+
+        gen->indent_level++;
+        for (int i = 0; i < stmt->if_stmt.num_then; i++)
         {
-            fprintf(stderr, "[DEBUG] Detected Windows-1253 (UTF-8 anchor not found), converting...\n");
+            codegen_statement(gen, stmt->if_stmt.then_branch[i]);
         }
-        char *utf8_content = convert_windows1253_to_utf8_new(content, size);
-        free(content);
-        return utf8_content;
+        gen->indent_level--;
+
+        if (stmt->if_stmt.else_branch && stmt->if_stmt.num_else > 0)
+        {
+            codegen_indent(gen);
+            fprintf(gen->output, "} else {\n");
+            gen->indent_level++;
+            for (int i = 0; i < stmt->if_stmt.num_else; i++)
+            {
+                codegen_statement(gen, stmt->if_stmt.else_branch[i]);
+            }
+            gen->indent_level--;
+        }
+
+        codegen_indent(gen);
+        fprintf(gen->output, "}\n");
+        break;
     }
 
-    // --- ΤΕΛΟΣ ΔΙΟΡΘΩΣΗΣ ---
+    case AST_FOR:
+    {
+        // Bounds and step are evaluated once before the loop and the loop
+        // variable is assigned from a hidden counter on every iteration, so
+        // assignments to it inside the body and its value after the loop
+        // behave as in the interpreter
+        int id = ++gen->temp_counter;
 
-    return content;
-}
-// ============================================================================
-// CODE GENERATOR IMPLEMENTATION (Missing Helpers)
-// ============================================================================
+        codegen_indent(gen);
+        fprintf(gen->output, "{\n");
+        gen->indent_level++;
 
-char *sanitize_identifier(const char *name)
-{
-    if (!name)
-        return NULL;
-    static char buffer[MAX_TOKEN_LEN];
-    int j = 0;
-    for (int i = 0; name[i] && j < MAX_TOKEN_LEN - 1; i++)
+        codegen_indent(gen);
+        fprintf(gen->output, "int eap_start%d = (int)(", id);
+        codegen_expression(gen, stmt->for_loop.start);
+        fprintf(gen->output, ");\n");
+        codegen_indent(gen);
+        fprintf(gen->output, "int eap_end%d = (int)(", id);
+        codegen_expression(gen, stmt->for_loop.end);
+        fprintf(gen->output, ");\n");
+
+        char step[32];
+        if (stmt->for_loop.step->type == AST_LITERAL &&
+            stmt->for_loop.step->literal.value.type == VAL_INT)
+        {
+            snprintf(step, sizeof(step), "%d", stmt->for_loop.step->literal.value.value.int_val);
+        }
+        else
+        {
+            snprintf(step, sizeof(step), "eap_step%d", id);
+            codegen_indent(gen);
+            fprintf(gen->output, "int eap_step%d = (int)(", id);
+            codegen_expression(gen, stmt->for_loop.step);
+            fprintf(gen->output, ");\n");
+        }
+
+        // Loop versioning: a copy without bounds checks runs when the guard
+        // proves every access it covers
+        int proven = codegen_bce_guard(gen, stmt, id, step);
+        if (proven > 0)
+        {
+            gen->indent_level++;
+            codegen_for_loop(gen, stmt, id, step);
+            gen->num_unchecked -= proven;
+            gen->indent_level--;
+            codegen_indent(gen);
+            fprintf(gen->output, "} else {\n");
+            gen->indent_level++;
+            codegen_for_loop(gen, stmt, id, step);
+            gen->indent_level--;
+            codegen_indent(gen);
+            fprintf(gen->output, "}\n");
+        }
+        else
+        {
+            codegen_for_loop(gen, stmt, id, step);
+        }
+
+        gen->indent_level--;
+        codegen_indent(gen);
+        fprintf(gen->output, "}\n");
+        break;
+    }
+
+    case AST_WHILE:
     {
-        unsigned char c = (unsigned char)name[i];
-        // C identifiers can only have alphanumeric and underscores
-        // Replace Greek characters or other special characters with underscores
-        // or a safe mapping. For simplicity, we convert non-standard chars to '_'
-        if (isalnum(c) || c == '_')
+        if (stmt->while_loop.is_repeat_until)
         {
-            buffer[j++] = c;
+            // REPEAT-UNTIL
+            codegen_indent(gen);
+            fprintf(gen->output, "do {\n");
+
+            gen->indent_level++;
+            for (int i = 0; i < stmt->while_loop.num_stmts; i++)
+            {
+                codegen_statement(gen, stmt->while_loop.body[i]);
+            }
+            gen->indent_level--;
+
+            codegen_indent(gen);
+            fprintf(gen->output, "} while (!(");
+            codegen_expression(gen, stmt->while_loop.condition);
+            fprintf(gen->output, "));\n");
         }
         else
         {
-            // Check for common Greek characters if you want more readable C code,
-            // otherwise replace with underscore:
-            buffer[j++] = '_';
+            // WHILE
+            codegen_indent(gen);
+            fprintf(gen->output, "while (");
+            codegen_expression(gen, stmt->while_loop.condition);
+            fprintf(gen->output, ") {\n");
+
+            gen->indent_level++;
+            for (int i = 0; i < stmt->while_loop.num_stmts; i++)
+            {
+                codegen_statement(gen, stmt->while_loop.body[i]);
+            }
+            gen->indent_level--;
+
+            codegen_indent(gen);
+            fprintf(gen->output, "}\n");
         }
+        break;
     }
-    buffer[j] = '\0';
-    return buffer;
-}
-const char *map_type(const char *eap_type)
-{
-    if (!eap_type)
-        return "int";
+    case AST_CALL:
+    {
+        codegen_indent(gen);
 
-    if (str_equals_ignore_case(eap_type, "INTEGER") ||
-        str_equals_ignore_case(eap_type, "ΑΚΕΡΑΙΟΣ"))
-        return "int";
+        ASTNode *subroutine = codegen_find_subroutine(gen, stmt->call.name);
+        fprintf(gen->output, "%s(", sanitize_identifier(stmt->call.name));
 
-    if (str_equals_ignore_case(eap_type, "REAL") ||
-        str_equals_ignore_case(eap_type, "ΠΡΑΓΜΑΤΙΚΟΣ"))
-        return "double";
+        for (int i = 0; i < stmt->call.num_args; i++)
+        {
+            if (i > 0)
+                fprintf(gen->output, ", ");
 
-    if (str_equals_ignore_case(eap_type, "BOOLEAN") ||
-        str_equals_ignore_case(eap_type, "ΛΟΓΙΚΟΣ"))
-        return "bool";
+            ASTNode *arg = stmt->call.arguments[i];
+            bool needs_ref = subroutine && codegen_is_param_by_ref(subroutine, i);
 
-    if (str_equals_ignore_case(eap_type, "STRING") ||
-        str_equals_ignore_case(eap_type, "ΣΥΜΒΟΛΟΣΕΙΡΑ"))
-        return "char*";
+            // Arrays are already passed as pointers
+            bool is_array = arg->type == AST_IDENTIFIER && codegen_is_array(gen, arg->identifier.name);
 
-    if (str_equals_ignore_case(eap_type, "CHAR") ||
-        str_equals_ignore_case(eap_type, "ΧΑΡΑΚΤΗΡΑΣ"))
-        return "char";
+            if (needs_ref && !is_array && (arg->type == AST_IDENTIFIER || arg->type == AST_ARRAY_ACCESS))
+            {
+                fprintf(gen->output, "&");
+            }
 
-    return "int"; // default fallback
+            codegen_expression(gen, arg);
+        }
+
+        fprintf(gen->output, ");\n");
+        break;
+    }
+    default:
+        codegen_line(gen, "// Unknown statement type");
+    }
 }
 
 // ============================================================================
-// CODEGEN HELPER FUNCTIONS
+// DECLARATION GENERATION
 // ============================================================================
-
-// Register array bounds
-void codegen_register_array(CodeGenerator *gen, const char *name, int start, int end, int dimension)
+void codegen_declaration(CodeGenerator *gen, ASTNode *decl)
 {
-    // Find existing array or create new
-    ArrayBoundsInfo *info = NULL;
-    for (int i = 0; i < gen->num_arrays; i++)
+    if (decl->type == AST_CONST_DECL)
     {
-        if (strcmp(gen->array_bounds[i].array_name, name) == 0)
-        {
-            info = &gen->array_bounds[i];
-            break;
-        }
+        // Don't generate #define for constants since we inline them
+        return;
     }
 
-    if (!info && gen->num_arrays < 100)
+    if (decl->type == AST_VAR_DECL)
     {
-        info = &gen->array_bounds[gen->num_arrays++];
-        info->array_name = strdup(name);
-        info->num_dims = 0;
-    }
+        codegen_indent(gen);
 
-    if (info && dimension < MAX_ARRAY_DIMS)
-    {
-        info->bounds_start[dimension] = start;
-        info->bounds_end[dimension] = end;
-        if (dimension >= info->num_dims)
+        if (decl->decl.num_arr_dims > 0)
         {
-            info->num_dims = dimension + 1;
-        }
-    }
-}
+            // Array declaration, lowered to one flat buffer
+            const char *elem_type = map_type(decl->decl.var_type);
+            CodegenSymbol *sym = codegen_define(gen, decl->decl.name, elem_type);
+            sym->num_dims = decl->decl.num_arr_dims;
+            for (int i = 0; i < decl->decl.num_arr_dims; i++)
+            {
+                if (!codegen_constant_int(gen, decl->decl.arr_bound_exprs[i].start_expr, &sym->bounds_start[i]) ||
+                    !codegen_constant_int(gen, decl->decl.arr_bound_exprs[i].end_expr, &sym->bounds_end[i]))
+                    sym->dynamic = true;
+            }
 
-// Get array offset for dimension
-int codegen_get_array_offset(CodeGenerator *gen, const char *name, int dimension)
-{
-    for (int i = 0; i < gen->num_arrays; i++)
-    {
-        if (strcmp(gen->array_bounds[i].array_name, name) == 0)
-        {
-            if (dimension < gen->array_bounds[i].num_dims)
+            if (gen->locals)
             {
-                return gen->array_bounds[i].bounds_start[dimension];
+                // Local arrays live on the heap: they can be large and every
+                // recursive call needs its own copy
+                fprintf(gen->output, "/* %s: local array */\n", sanitize_identifier(decl->decl.name));
+                codegen_array_allocation(gen, decl, true);
+                return;
             }
-        }
-    }
-    return 1; // Default to 1-based
-}
 
-// Get array size for dimension
-int codegen_get_array_size(CodeGenerator *gen, const char *name, int dimension)
-{
-    for (int i = 0; i < gen->num_arrays; i++)
-    {
-        if (strcmp(gen->array_bounds[i].array_name, name) == 0)
-        {
-            if (dimension < gen->array_bounds[i].num_dims)
+            if (sym->dynamic)
+            {
+                // Bounds computed and buffer allocated at the start of main
+                char cname[MAX_TOKEN_LEN * 3 + 1];
+                snprintf(cname, sizeof(cname), "%s", sanitize_identifier(decl->decl.name));
+                fprintf(gen->output, "%s *%s;", elem_type, cname);
+                for (int i = 0; i < sym->num_dims; i++)
+                    fprintf(gen->output, " int %s_lo%d, %s_hi%d, %s_st%d;", cname, i, cname, i, cname, i);
+            }
+            else
+            {
+                long length = codegen_array_length(sym);
+                fprintf(gen->output, "%s %s[%ld];", elem_type, sanitize_identifier(decl->decl.name),
+                        length > 0 ? length : 1);
+            }
+
+            fprintf(gen->output, " /* bounds: ");
+            for (int i = 0; i < decl->decl.num_arr_dims; i++)
             {
-                return gen->array_bounds[i].bounds_end[dimension] -
-                       gen->array_bounds[i].bounds_start[dimension] + 1;
+                if (i > 0)
+                    fprintf(gen->output, ", ");
+                fprintf(gen->output, "[");
+                codegen_expression(gen, decl->decl.arr_bound_exprs[i].start_expr);
+                fprintf(gen->output, "..");
+                codegen_expression(gen, decl->decl.arr_bound_exprs[i].end_expr);
+                fprintf(gen->output, "]");
             }
+            fprintf(gen->output, " */\n");
+        }
+        else
+        {
+            // Simple variable - USE THE TYPE! Zero-initialized like the interpreter
+            const char *c_type = map_type(decl->decl.var_type);
+            codegen_define(gen, decl->decl.name, c_type);
+            fprintf(gen->output, "%s %s = 0;\n", c_type, sanitize_identifier(decl->decl.name));
         }
     }
-    return 100; // Default
 }
 
-// Register variable type
-void codegen_register_var_type(CodeGenerator *gen, const char *name, const char *type)
+// ============================================================================
+// FUNCTION/PROCEDURE GENERATION
+// ============================================================================
+
+// Emits "(params) {" and opens the subroutine's scope
+static void codegen_subroutine_header(CodeGenerator *gen, ASTNode *sub)
 {
-    if (gen->num_vars >= 1000)
-        return;
+    gen->current_subroutine = sub;
+    gen->locals = create_hashmap();
 
-    // Check if already exists
-    for (int i = 0; i < gen->num_vars; i++)
+    fprintf(gen->output, "(");
+    for (int i = 0; i < sub->subroutine.num_params; i++)
     {
-        if (strcmp(gen->var_types[i].var_name, name) == 0)
-        {
-            free(gen->var_types[i].type_name);
-            gen->var_types[i].type_name = strdup(type);
-            return;
-        }
+        if (i > 0)
+            fprintf(gen->output, ", ");
+        ASTNode *param = sub->subroutine.parameters[i];
+        codegen_define_parameter(gen, param);
+        codegen_parameter(gen, param, true);
     }
-
-    VarTypeInfo *info = &gen->var_types[gen->num_vars++];
-    info->var_name = strdup(name);
-    info->type_name = strdup(type);
+    fprintf(gen->output, ") {\n");
+    gen->indent_level++;
 }
 
-// Get variable type
-const char *codegen_get_var_type(CodeGenerator *gen, const char *name)
+// Local variables, declared after the parameters so array bounds can use them
+static void codegen_local_declarations(CodeGenerator *gen, ASTNode *sub)
 {
-    for (int i = 0; i < gen->num_vars; i++)
+    for (int i = 0; i < sub->subroutine.num_local_decls; i++)
     {
-        if (strcmp(gen->var_types[i].var_name, name) == 0)
-        {
-            return gen->var_types[i].type_name;
-        }
+        codegen_declaration(gen, sub->subroutine.local_decls[i]);
     }
-    return "int";
 }
 
-// Infer printf format specifier
-const char *codegen_infer_printf_format(CodeGenerator *gen, ASTNode *expr)
+// Frees local arrays and closes the subroutine's scope
+static void codegen_subroutine_footer(CodeGenerator *gen, ASTNode *sub)
 {
-    if (!expr)
-        return "%d";
-
-    switch (expr->type)
-    {
-    case AST_LITERAL:
-        switch (expr->literal.value.type)
-        {
-        case VAL_INT:
-            return "%d";
-        case VAL_REAL:
-            return "%g";
-        case VAL_BOOL:
-            return "%s";
-        case VAL_STRING:
-            return "%s";
-        default:
-            return "%d";
-        }
+    codegen_free_local_arrays(gen, sub);
+    codegen_free_symbols(gen->locals);
+    gen->locals = NULL;
+    gen->current_subroutine = NULL;
+}
 
-    case AST_IDENTIFIER:
-    {
-        if (str_equals_ignore_case(expr->identifier.name, "EOLN"))
-        {
-            return "%c";
-        }
-        const char *type = codegen_get_var_type(gen, expr->identifier.name);
-        if (strcmp(type, "double") == 0)
-            return "%g";
-        if (strcmp(type, "bool") == 0)
-            return "%d";
-        if (strcmp(type, "char*") == 0)
-            return "%s";
-        return "%d";
-    }
+void codegen_function(CodeGenerator *gen, ASTNode *func)
+{
+    fprintf(gen->output, "\n");
 
-    case AST_BINARY_OP:
-    {
-        if (strcmp(expr->binary.operator, "/") == 0)
-            return "%g";
+    // The function's name is global (its return type types calls to it)
+    codegen_register_var_type(gen, func->subroutine.name, map_type(func->subroutine.return_type));
 
-        const char *left_fmt = codegen_infer_printf_format(gen, expr->binary.left);
-        const char *right_fmt = codegen_infer_printf_format(gen, expr->binary.right);
+    // Return type
+    fprintf(gen->output, "%s %s",
+            map_type(func->subroutine.return_type),
+            sanitize_identifier(func->subroutine.name));
+    codegen_subroutine_header(gen, func);
 
-        if (strcmp(left_fmt, "%g") == 0 || strcmp(right_fmt, "%g") == 0)
-        {
-            return "%g";
-        }
-        return "%d";
-    }
+    // Return variable
+    codegen_indent(gen);
+    fprintf(gen->output, "%s %s_result = 0;\n",
+            map_type(func->subroutine.return_type),
+            sanitize_identifier(func->subroutine.name));
 
-    default:
-        return "%d";
-    }
-}
+    codegen_local_declarations(gen, func);
 
-// Find subroutine by name
-ASTNode *codegen_find_subroutine(CodeGenerator *gen, const char *name)
-{
-    if (!gen->program)
-        return NULL;
+    // Body
+    gen->in_function = true;
+    gen->current_function_name = func->subroutine.name;
 
-    for (int i = 0; i < gen->program->program.num_decls; i++)
+    for (int i = 0; i < func->subroutine.num_stmts; i++)
     {
-        ASTNode *decl = gen->program->program.declarations[i];
-        if ((decl->type == AST_FUNC_DECL || decl->type == AST_PROC_DECL) &&
-            str_equals_ignore_case(decl->subroutine.name, name))
-        {
-            return decl;
-        }
+        codegen_statement(gen, func->subroutine.body[i]);
     }
-    return NULL;
+
+    gen->in_function = false;
+
+    // Return
+    codegen_subroutine_footer(gen, func);
+    codegen_indent(gen);
+    fprintf(gen->output, "return %s_result;\n",
+            sanitize_identifier(func->subroutine.name));
+
+    gen->indent_level--;
+    fprintf(gen->output, "}\n");
 }
 
-// Check if parameter is by reference
-bool codegen_is_param_by_ref(ASTNode *subroutine, int param_index)
+void codegen_procedure(CodeGenerator *gen, ASTNode *proc)
 {
-    if (!subroutine || param_index >= subroutine->subroutine.num_params)
+    fprintf(gen->output, "\n");
+
+    // Return type is void
+    fprintf(gen->output, "void %s", sanitize_identifier(proc->subroutine.name));
+    codegen_subroutine_header(gen, proc);
+
+    codegen_local_declarations(gen, proc);
+
+    // Body
+    for (int i = 0; i < proc->subroutine.num_stmts; i++)
     {
-        return false;
+        codegen_statement(gen, proc->subroutine.body[i]);
     }
-    return subroutine->subroutine.parameters[param_index]->param.is_reference;
+
+    codegen_subroutine_footer(gen, proc);
+    gen->indent_level--;
+    fprintf(gen->output, "}\n");
 }
-void codegen_init(CodeGenerator *gen, FILE *out)
+
+// ============================================================================
+// PROGRAM GENERATION
+// ============================================================================
+
+// Makes the program's constants available for folding and inlining
+void codegen_bind_program(CodeGenerator *gen, ASTNode *prog)
 {
-    gen->output = out;
-    gen->indent_level = 0;
-    gen->in_function = false;
-    gen->current_function_name = NULL;
-    gen->env = NULL;
-    gen->program = NULL;
-    gen->current_subroutine = NULL;
-    gen->num_arrays = 0;
-    gen->num_vars = 0;
-}
+    // Store program for lookups
+    gen->program = prog;
+
+    // Create environment for constant evaluation
+    Environment *const_env = create_environment(NULL);
+    gen->env = const_env;
 
-void codegen_indent(CodeGenerator *gen)
-{
-    for (int i = 0; i < gen->indent_level; i++)
+    // First pass: Constants (and evaluate them)
+    for (int i = 0; i < prog->program.num_decls; i++)
     {
-        fprintf(gen->output, "    ");
+        ASTNode *decl = prog->program.declarations[i];
+        if (decl->type == AST_CONST_DECL)
+        {
+            RuntimeValue val = evaluate(decl->decl.value, const_env);
+            env_define(const_env, decl->decl.name, val);
+        }
     }
 }
 
-void codegen_line(CodeGenerator *gen, const char *fmt, ...)
+// Emits the includes and runtime helpers every generated translation unit
+// needs
+void codegen_prelude(CodeGenerator *gen, ASTNode *prog)
 {
-    codegen_indent(gen);
-    va_list args;
-    va_start(args, fmt);
-    vfprintf(gen->output, fmt, args);
-    va_end(args);
+    codegen_bind_program(gen, prog);
+
+    // Includes
+    fprintf(gen->output, "#include <stdio.h>\n");
+    fprintf(gen->output, "#include <stdlib.h>\n");
+    fprintf(gen->output, "#include <stdbool.h>\n");
+    fprintf(gen->output, "#include <math.h>\n");
+    fprintf(gen->output, "#include <string.h>\n");
+    fprintf(gen->output, "#include <strings.h>\n");
+    fprintf(gen->output, "#include <ctype.h>\n");
+    fprintf(gen->output, "#include <errno.h>\n");
+    fprintf(gen->output, "#include <limits.h>\n\n");
+
+    // Runtime helpers shared by all generated programs
+    fprintf(gen->output, "static void eap_runtime_error(const char *msg) { fflush(stdout); fprintf(stderr, \"Runtime Error: %%s\\n\", msg); exit(1); }\n");
+    fprintf(gen->output, "static inline int eap_chk(int index, int start, int end, int dim)\n{\n");
+    fprintf(gen->output, "    if (index < start || index > end)\n    {\n");
+    fprintf(gen->output, "        char msg[128];\n");
+    fprintf(gen->output, "        snprintf(msg, sizeof(msg), \"Array index %%d is out of bounds for dimension %%d. Expected [%%d..%%d].\", index, dim, start, end);\n");
+    fprintf(gen->output, "        eap_runtime_error(msg);\n    }\n");
+    fprintf(gen->output, "    return index - start;\n}\n");
+    fprintf(gen->output, "static inline int eap_len(int lo, int hi) { return hi >= lo ? hi - lo + 1 : 0; }\n");
+    fprintf(gen->output, "static inline bool eap_in(long long index, int start, int end) { return index >= start && index <= end; }\n");
+    fprintf(gen->output, "static inline bool eap_for_last(long long start, long long end, long long step, long long *last)\n{\n");
+    fprintf(gen->output, "    if (step == 0 || (step > 0 ? start > end : start < end))\n        return false;\n");
+    fprintf(gen->output, "    *last = start + (end - start) / step * step;\n");
+    fprintf(gen->output, "    return true;\n}\n");
+    fprintf(gen->output, "static inline void *eap_alloc(long count, size_t size)\n{\n");
+    fprintf(gen->output, "    void *p = calloc(count > 0 ? count : 1, size);\n");
+    fprintf(gen->output, "    if (!p)\n        eap_runtime_error(\"Out of memory\");\n");
+    fprintf(gen->output, "    return p;\n}\n");
+    fprintf(gen->output, "static inline int eap_div(int l, int r) { if (r == 0) eap_runtime_error(\"Division by zero\"); return l / r; }\n");
+    fprintf(gen->output, "static inline int eap_mod(int l, int r) { if (r == 0) eap_runtime_error(\"Modulo by zero\"); return l %% r; }\n");
+    fprintf(gen->output, "static inline double eap_rdiv(double l, double r) { if (r == 0) eap_runtime_error(\"Division by zero\"); return l / r; }\n");
+    // Reads behave as in the interpreter: an empty line reads as -1, anything
+    // else must be a whole value of the variable's type
+    fprintf(gen->output, "static int eap_read_line(char *line, int size)\n{\n");
+    fprintf(gen->output, "    fflush(stdout);\n");
+    fprintf(gen->output, "    if (!fgets(line, size, stdin))\n        return 0;\n");
+    fprintf(gen->output, "    line[strcspn(line, \"\\n\")] = 0;\n");
+    fprintf(gen->output, "    return 1;\n}\n");
+    fprintf(gen->output, "static char *eap_read_trim(char *line)\n{\n");
+    fprintf(gen->output, "    while (isspace((unsigned char)*line))\n        line++;\n");
+    fprintf(gen->output, "    size_t len = strlen(line);\n");
+    fprintf(gen->output, "    while (len > 0 && isspace((unsigned char)line[len - 1]))\n        line[--len] = 0;\n");
+    fprintf(gen->output, "    return line;\n}\n");
+    fprintf(gen->output, "static void eap_read_error(const char *text, const char *name, const char *type)\n{\n");
+    fprintf(gen->output, "    char msg[384];\n");
+    fprintf(gen->output, "    snprintf(msg, sizeof(msg), \"Cannot read '%%s' into %%s: not a valid %%s\", text, name, type);\n");
+    fprintf(gen->output, "    eap_runtime_error(msg);\n}\n");
+    fprintf(gen->output, "static inline int eap_read_int(int *dst, const char *name)\n{\n");
+    fprintf(gen->output, "    char buffer[256], *line = buffer, *end;\n");
+    fprintf(gen->output, "    if (!eap_read_line(buffer, sizeof(buffer)))\n        return 0;\n");
+    fprintf(gen->output, "    line = eap_read_trim(line);\n");
+    fprintf(gen->output, "    errno = 0;\n");
+    fprintf(gen->output, "    long number = line[0] ? strtol(line, &end, 10) : -1;\n");
+    fprintf(gen->output, "    if ((line[0] && *end) || errno || number < INT_MIN || number > INT_MAX)\n");
+    fprintf(gen->output, "        eap_read_error(line, name, \"INTEGER\");\n");
+    fprintf(gen->output, "    *dst = (int)number;\n");
+    fprintf(gen->output, "    return 1;\n}\n");
+    fprintf(gen->output, "static inline int eap_read_real(double *dst, const char *name)\n{\n");
+    fprintf(gen->output, "    char buffer[256], *line = buffer, *end;\n");
+    fprintf(gen->output, "    if (!eap_read_line(buffer, sizeof(buffer)))\n        return 0;\n");
+    fprintf(gen->output, "    line = eap_read_trim(line);\n");
+    fprintf(gen->output, "    errno = 0;\n");
+    fprintf(gen->output, "    double number = line[0] ? strtod(line, &end) : -1;\n");
+    fprintf(gen->output, "    if ((line[0] && *end) || errno)\n");
+    fprintf(gen->output, "        eap_read_error(line, name, \"REAL\");\n");
+    fprintf(gen->output, "    *dst = number;\n");
+    fprintf(gen->output, "    return 1;\n}\n");
+    fprintf(gen->output, "static inline int eap_read_bool(bool *dst, const char *name)\n{\n");
+    fprintf(gen->output, "    char buffer[256], *line = buffer;\n");
+    fprintf(gen->output, "    if (!eap_read_line(buffer, sizeof(buffer)))\n        return 0;\n");
+    fprintf(gen->output, "    line = eap_read_trim(line);\n");
+    fprintf(gen->output, "    if (strcmp(line, \"ΑΛΗΘΗΣ\") == 0 || strcasecmp(line, \"TRUE\") == 0)\n        *dst = true;\n");
+    fprintf(gen->output, "    else if (strcmp(line, \"ΨΕΥΔΗΣ\") == 0 || strcasecmp(line, \"FALSE\") == 0)\n        *dst = false;\n");
+    fprintf(gen->output, "    else\n        eap_read_error(line, name, \"BOOLEAN\");\n");
+    fprintf(gen->output, "    return 1;\n}\n");
+    fprintf(gen->output, "static inline int eap_read_str(char **dst, const char *name)\n{\n");
+    fprintf(gen->output, "    char line[256];\n");
+    fprintf(gen->output, "    (void)name;\n");
+    fprintf(gen->output, "    if (!eap_read_line(line, sizeof(line)))\n        return 0;\n");
+    fprintf(gen->output, "    *dst = strdup(line[0] ? line : \"-1\");\n");
+    fprintf(gen->output, "    return 1;\n}\n\n");
+
+    // fprintf(gen->output, "#define EOLN '\\n'\n");
+
     fprintf(gen->output, "\n");
 }
 
-void codegen_expression(CodeGenerator *gen, ASTNode *expr)
+void codegen_program(CodeGenerator *gen, ASTNode *prog)
 {
-    if (!expr)
-    {
-        fprintf(gen->output, "0");
-        return;
-    }
+    // Header
+    fprintf(gen->output, "/*\n");
+    fprintf(gen->output, " * Generated C code from EAP pseudocode\n");
+    fprintf(gen->output, " * Program: %s\n", prog->program.name);
+    fprintf(gen->output, " */\n\n");
 
-    switch (expr->type)
+    codegen_prelude(gen, prog);
+
+    // Forward declarations for functions/procedures
+    for (int i = 0; i < prog->program.num_decls; i++)
     {
-    case AST_LITERAL:
-        switch (expr->literal.value.type)
+        ASTNode *decl = prog->program.declarations[i];
+        if (decl->type == AST_FUNC_DECL || decl->type == AST_PROC_DECL)
         {
-        case VAL_INT:
-            fprintf(gen->output, "%d", expr->literal.value.value.int_val);
-            break;
-        case VAL_REAL:
-            fprintf(gen->output, "%g", expr->literal.value.value.real_val);
-            break;
-        case VAL_BOOL:
-            fprintf(gen->output, "%s", expr->literal.value.value.bool_val ? "true" : "false");
-            break;
-        case VAL_STRING:
-            // Handle EOLN marker vs regular string
-            if (strcmp(expr->literal.value.value.str_val, "__EOLN__") == 0 ||
-                strcmp(expr->literal.value.value.str_val, "EOLN") == 0)
+            if (decl->type == AST_FUNC_DECL)
             {
-                // If we are in a printf argument list, use '\n'
-                fprintf(gen->output, "'\\n'");
+                codegen_register_var_type(gen, decl->subroutine.name, map_type(decl->subroutine.return_type));
+                fprintf(gen->output, "%s %s(",
+                        map_type(decl->subroutine.return_type),
+                        sanitize_identifier(decl->subroutine.name));
             }
             else
             {
-                fprintf(gen->output, "\"%s\"", expr->literal.value.value.str_val);
+                fprintf(gen->output, "void %s(", sanitize_identifier(decl->subroutine.name));
             }
-            break;
-        default:
-            fprintf(gen->output, "0");
+            for (int j = 0; j < decl->subroutine.num_params; j++)
+            {
+                if (j > 0)
+                    fprintf(gen->output, ", ");
+                codegen_parameter(gen, decl->subroutine.parameters[j], false);
+            }
+            fprintf(gen->output, ");\n");
         }
-        break;
+    }
 
-    case AST_IDENTIFIER:
+    // NOW generate the declarations
+    fprintf(gen->output, "\n");
+    for (int i = 0; i < prog->program.num_decls; i++)
     {
-        if (str_equals_ignore_case(expr->identifier.name, "EOLN"))
-        {
-            fprintf(gen->output, "'\\n'");
-            break;
-        }
-
-        // Check if this identifier is a constant
-        bool is_constant = false;
-        RuntimeValue const_value;
-
-        // Search through program constants
-        if (gen->program)
+        ASTNode *decl = prog->program.declarations[i];
+        if (decl->type == AST_VAR_DECL)
         {
-            for (int i = 0; i < gen->program->program.num_decls; i++)
-            {
-                ASTNode *decl = gen->program->program.declarations[i];
-                if (decl->type == AST_CONST_DECL &&
-                    str_equals_ignore_case(decl->decl.name, expr->identifier.name))
-                {
-                    is_constant = true;
-                    // Evaluate the constant value
-                    const_value = evaluate(decl->decl.value, gen->env);
-                    break;
-                }
-            }
+            codegen_declaration(gen, decl);
         }
-
-        if (is_constant)
+    }
+    
+    // Functions and procedures
+    for (int i = 0; i < prog->program.num_decls; i++)
+    {
+        ASTNode *decl = prog->program.declarations[i];
+        if (decl->type == AST_FUNC_DECL)
         {
-            // Output the constant's VALUE, not its name
-            switch (const_value.type)
-            {
-            case VAL_INT:
-                fprintf(gen->output, "%d", const_value.value.int_val);
-                break;
-            case VAL_REAL:
-                fprintf(gen->output, "%f", const_value.value.real_val);
-                break;
-            case VAL_BOOL:
-                fprintf(gen->output, "%s", const_value.value.bool_val ? "true" : "false");
-                break;
-            default:
-                // Fall back to sanitized name
-                fprintf(gen->output, "%s", sanitize_identifier(expr->identifier.name));
-                break;
-            }
-            free_runtime_value(&const_value);
+            codegen_function(gen, decl);
         }
-        else
+        else if (decl->type == AST_PROC_DECL)
         {
-            // Check if this is a reference parameter that needs dereferencing
-            bool is_ref_param = false;
-            if (gen->current_subroutine)
-            {
-                for (int i = 0; i < gen->current_subroutine->subroutine.num_params; i++)
-                {
-                    ASTNode *param = gen->current_subroutine->subroutine.parameters[i];
-                    if (str_equals_ignore_case(param->param.name, expr->identifier.name) &&
-                        param->param.is_reference)
-                    {
-                        is_ref_param = true;
-                        break;
-                    }
-                }
-            }
-
-            // Dereference if it's a pointer parameter
-            if (is_ref_param)
-            {
-                fprintf(gen->output, "(*%s)", sanitize_identifier(expr->identifier.name));
-            }
-            else
-            {
-                fprintf(gen->output, "%s", sanitize_identifier(expr->identifier.name));
-            }
+            codegen_procedure(gen, decl);
         }
-        break;
     }
 
-    case AST_BINARY_OP:
-        fprintf(gen->output, "(");
-        codegen_expression(gen, expr->binary.left);
+    // Main function
+    fprintf(gen->output, "\nint main() {\n");
+    gen->indent_level = 1;
 
-        // Map operators
-        if (strcmp(expr->binary.operator, "=") == 0)
-        {
-            fprintf(gen->output, " == ");
-        }
-        else if (strcmp(expr->binary.operator, "<>") == 0)
-        {
-            fprintf(gen->output, " != ");
-        }
-        else if (str_equals_ignore_case(expr->binary.operator, "DIV"))
-        {
-            fprintf(gen->output, " / ");
-        }
-        else if (str_equals_ignore_case(expr->binary.operator, "MOD"))
-        {
-            fprintf(gen->output, " %% ");
-        }
-        else if (str_equals_ignore_case(expr->binary.operator, "AND") ||
-                 str_equals_ignore_case(expr->binary.operator, "ΚΑΙ"))
-        {
-            fprintf(gen->output, " && ");
-        }
-        else if (str_equals_ignore_case(expr->binary.operator, "OR") ||
-                 str_equals_ignore_case(expr->binary.operator, "Ή"))
-        {
-            fprintf(gen->output, " || ");
-        }
-        else
+    // Global arrays with run-time bounds
+    for (int i = 0; i < prog->program.num_decls; i++)
+    {
+        ASTNode *decl = prog->program.declarations[i];
+        if (decl->type == AST_VAR_DECL && codegen_is_array(gen, decl->decl.name) &&
+            codegen_lookup(gen, decl->decl.name)->dynamic)
         {
-            fprintf(gen->output, " %s ", expr->binary.operator);
+            codegen_array_allocation(gen, decl, false);
         }
+    }
 
-        codegen_expression(gen, expr->binary.right);
-        fprintf(gen->output, ")");
-        break;
+    for (int i = 0; i < prog->program.num_stmts; i++)
+    {
+        codegen_statement(gen, prog->program.body[i]);
+    }
 
-    case AST_UNARY_OP:
-        if (str_equals_ignore_case(expr->unary.operator, "NOT") ||
-            str_equals_ignore_case(expr->unary.operator, "ΟΧΙ"))
-        {
-            fprintf(gen->output, "!(");
-        }
-        else
-        {
-            fprintf(gen->output, "%s(", expr->unary.operator);
-        }
-        codegen_expression(gen, expr->unary.operand);
-        fprintf(gen->output, ")");
-        break;
+    codegen_line(gen, "return 0;");
+    fprintf(gen->output, "}\n");
+}
 
-    case AST_ARRAY_ACCESS:
+// ============================================================================
+// NATIVE COMPILATION (--native)
+// ============================================================================
+//
+// Transpiles the program, compiles it with the system C compiler and runs the
+// executable. Executables are cached on disk keyed by a hash of the generated
+// C source, the compiler and its flags, so a program is only compiled once.
+// Programs using constructs the transpiler cannot reproduce exactly are run in
+// the interpreter instead.
+
+typedef struct
+{
+    ASTNode *program;
+    CodeGenerator *gen;  // Folds constant array bounds
+    ASTNode *subroutine; // Subroutine being checked, NULL for the main body
+    const char *reason;  // First unsupported construct, NULL if none
+    int line;
+} NativeCheck;
+
+static void native_reject(NativeCheck *check, const char *reason, int line)
+{
+    if (!check->reason)
     {
-        fprintf(gen->output, "%s[", sanitize_identifier(expr->array_access.name));
-        for (int i = 0; i < expr->array_access.num_indices; i++)
-        {
-            if (i > 0)
-                fprintf(gen->output, "][");
+        check->reason = reason;
+        check->line = line;
+    }
+}
+
+static ASTNode *native_find_global(ASTNode *prog, const char *name)
+{
+    for (int i = 0; i < prog->program.num_decls; i++)
+    {
+        ASTNode *decl = prog->program.declarations[i];
+        if ((decl->type == AST_VAR_DECL || decl->type == AST_CONST_DECL) &&
+            str_equals_ignore_case(decl->decl.name, name))
+            return decl;
+    }
+    return NULL;
+}
 
-            int offset = codegen_get_array_offset(gen, expr->array_access.name, i);
+static bool native_is_local(ASTNode *sub, const char *name)
+{
+    if (str_equals_ignore_case(sub->subroutine.name, name))
+        return true;
+    for (int i = 0; i < sub->subroutine.num_params; i++)
+        if (str_equals_ignore_case(sub->subroutine.parameters[i]->param.name, name))
+            return true;
+    for (int i = 0; i < sub->subroutine.num_local_decls; i++)
+        if (str_equals_ignore_case(sub->subroutine.local_decls[i]->decl.name, name))
+            return true;
+    return false;
+}
 
-            if (offset != 0)
-            {
-                fprintf(gen->output, "(");
-                codegen_expression(gen, expr->array_access.indices[i]);
-                fprintf(gen->output, " - %d)", offset);
-            }
-            else
-            {
-                codegen_expression(gen, expr->array_access.indices[i]);
-            }
-        }
-        fprintf(gen->output, "]");
-        break;
+// Finds how a name visible at the current point was declared: a local
+// declaration, a parameter or a global declaration
+static ASTNode *native_find_declaration(NativeCheck *check, const char *name)
+{
+    ASTNode *sub = check->subroutine;
+    if (sub)
+    {
+        for (int i = 0; i < sub->subroutine.num_params; i++)
+            if (str_equals_ignore_case(sub->subroutine.parameters[i]->param.name, name))
+                return sub->subroutine.parameters[i];
+        for (int i = 0; i < sub->subroutine.num_local_decls; i++)
+            if (str_equals_ignore_case(sub->subroutine.local_decls[i]->decl.name, name))
+                return sub->subroutine.local_decls[i];
+        if (str_equals_ignore_case(sub->subroutine.name, name))
+            return NULL;
+    }
+    return native_find_global(check->program, name);
+}
+
+// Reads the constant bounds of an array variable or parameter into sym.
+// Returns false if name is not an array with constant bounds.
+static bool native_array_bounds(NativeCheck *check, const char *name, CodegenSymbol *sym)
+{
+    ASTNode *decl = native_find_declaration(check, name);
+    memset(sym, 0, sizeof(CodegenSymbol));
+    if (!decl)
+        return false;
+
+    if (decl->type == AST_PARAMETER)
+        return is_array_type(decl->param.param_type) && codegen_param_bounds(check->gen, decl->param.param_type, sym);
+
+    if (decl->type != AST_VAR_DECL || decl->decl.num_arr_dims == 0)
+        return false;
+    sym->num_dims = decl->decl.num_arr_dims;
+    for (int i = 0; i < sym->num_dims; i++)
+    {
+        if (!codegen_constant_int(check->gen, decl->decl.arr_bound_exprs[i].start_expr, &sym->bounds_start[i]) ||
+            !codegen_constant_int(check->gen, decl->decl.arr_bound_exprs[i].end_expr, &sym->bounds_end[i]))
+            return false;
     }
+    return true;
+}
 
-    case AST_CALL:
-        fprintf(gen->output, "%s(", sanitize_identifier(expr->call.name));
-        for (int i = 0; i < expr->call.num_args; i++)
+// The C code indexes an array parameter with the bounds it is declared with,
+// the interpreter with those of the array passed in. Both agree only if they
+// are the same.
+static void native_check_arguments(NativeCheck *check, ASTNode *sub, ASTNode **args, int num_args, int line)
+{
+    for (int i = 0; i < sub->subroutine.num_params && i < num_args; i++)
+    {
+        ASTNode *param = sub->subroutine.parameters[i];
+        bool is_array_arg = args[i]->type == AST_IDENTIFIER && native_array_bounds(check, args[i]->identifier.name,
+                                                                                     &(CodegenSymbol){0});
+        if (!is_array_type(param->param.param_type))
         {
-            if (i > 0)
-                fprintf(gen->output, ", ");
-            codegen_expression(gen, expr->call.arguments[i]);
+            if (is_array_arg)
+                native_reject(check, "array passed to a scalar parameter", line);
+            continue;
         }
-        fprintf(gen->output, ")");
-        break;
 
-    default:
-        fprintf(gen->output, "0");
+        CodegenSymbol declared, actual;
+        if (!codegen_param_bounds(check->gen, param->param.param_type, &declared) || args[i]->type != AST_IDENTIFIER ||
+            !native_array_bounds(check, args[i]->identifier.name, &actual) || declared.num_dims != actual.num_dims ||
+            memcmp(declared.bounds_start, actual.bounds_start, sizeof(int) * declared.num_dims) != 0 ||
+            memcmp(declared.bounds_end, actual.bounds_end, sizeof(int) * declared.num_dims) != 0)
+        {
+            native_reject(check, "array argument with bounds other than the parameter's", line);
+        }
     }
 }
 
-// ============================================================================
-// STATEMENT GENERATION
-// ============================================================================
-
-void codegen_statement(CodeGenerator *gen, ASTNode *stmt)
+// A name used in a subroutine that is not its own is looked up dynamically by
+// the interpreter (through the caller's environment) but statically in C.
+// Both agree only if the name is a global that no subroutine redeclares.
+static void native_check_name(NativeCheck *check, const char *name, int line)
 {
-    if (!stmt)
+    if (!check->subroutine || native_is_local(check->subroutine, name) ||
+        str_equals_ignore_case(name, "EOLN"))
         return;
 
-    switch (stmt->type)
-    {
-    case AST_ASSIGN:
+    if (!native_find_global(check->program, name))
     {
-        codegen_indent(gen);
+        native_reject(check, "access to a caller's local variable", line);
+        return;
+    }
 
-        // Check if assigning to function return value
-        if (gen->in_function && gen->current_function_name &&
-            str_equals_ignore_case(stmt->assign.identifier, gen->current_function_name))
+    for (int i = 0; i < check->program->program.num_decls; i++)
+    {
+        ASTNode *decl = check->program->program.declarations[i];
+        if ((decl->type == AST_FUNC_DECL || decl->type == AST_PROC_DECL) && native_is_local(decl, name))
         {
-            fprintf(gen->output, "%s_result = ", sanitize_identifier(gen->current_function_name));
+            native_reject(check, "global variable shadowed by a subroutine", line);
+            return;
         }
-        else
-        {
-            if (stmt->assign.num_indices > 0)
-            {
-                // Array element assignment
-
-                // First check if the array itself is a pointer parameter
-                bool is_ref_param = false;
-                if (gen->current_subroutine)
-                {
-                    for (int i = 0; i < gen->current_subroutine->subroutine.num_params; i++)
-                    {
-                        ASTNode *param = gen->current_subroutine->subroutine.parameters[i];
-                        if (str_equals_ignore_case(param->param.name, stmt->assign.identifier) &&
-                            param->param.is_reference)
-                        {
-                            is_ref_param = true;
-                            break;
-                        }
-                    }
-                }
+    }
+}
 
-                // Generate array access
-                fprintf(gen->output, "%s[", sanitize_identifier(stmt->assign.identifier));
-                for (int i = 0; i < stmt->assign.num_indices; i++)
-                {
-                    if (i > 0)
-                        fprintf(gen->output, "][");
+static void native_check_expr(NativeCheck *check, ASTNode *expr, bool in_print)
+{
+    if (!expr)
+        return;
 
-                    int offset = codegen_get_array_offset(gen, stmt->assign.identifier, i);
+    switch (expr->type)
+    {
+    case AST_LITERAL:
+        if (expr->literal.value.type == VAL_STRING && !in_print)
+            native_reject(check, "string values", expr->line);
+        break;
 
-                    if (offset != 0)
-                    {
-                        fprintf(gen->output, "(");
-                        codegen_expression(gen, stmt->assign.indices[i]);
-                        fprintf(gen->output, " - %d)", offset);
-                    }
-                    else
-                    {
-                        codegen_expression(gen, stmt->assign.indices[i]);
-                    }
-                }
-                fprintf(gen->output, "] = ");
-            }
-            else
-            {
-                // Simple variable assignment
+    case AST_IDENTIFIER:
+        native_check_name(check, expr->identifier.name, expr->line);
+        break;
 
-                // Check if this variable is a reference (pointer) parameter
-                bool is_ref_param = false;
-                if (gen->current_subroutine)
-                {
-                    for (int i = 0; i < gen->current_subroutine->subroutine.num_params; i++)
-                    {
-                        ASTNode *param = gen->current_subroutine->subroutine.parameters[i];
-                        if (str_equals_ignore_case(param->param.name, stmt->assign.identifier) &&
-                            param->param.is_reference)
-                        {
-                            is_ref_param = true;
-                            break;
-                        }
-                    }
-                }
+    case AST_ARRAY_ACCESS:
+        native_check_name(check, expr->array_access.name, expr->line);
+        for (int i = 0; i < expr->array_access.num_indices; i++)
+            native_check_expr(check, expr->array_access.indices[i], false);
+        break;
 
-                // If it's a reference parameter, dereference it
-                if (is_ref_param)
-                {
-                    fprintf(gen->output, "*%s = ", sanitize_identifier(stmt->assign.identifier));
-                }
-                else
-                {
-                    fprintf(gen->output, "%s = ", sanitize_identifier(stmt->assign.identifier));
-                }
-            }
-        }
+    case AST_BINARY_OP:
+        native_check_expr(check, expr->binary.left, false);
+        native_check_expr(check, expr->binary.right, false);
+        break;
 
-        codegen_expression(gen, stmt->assign.value);
-        fprintf(gen->output, ";\n");
+    case AST_UNARY_OP:
+        native_check_expr(check, expr->unary.operand, false);
         break;
-    }
 
-    case AST_PRINT:
+    case AST_CALL:
     {
-        codegen_indent(gen);
-        fprintf(gen->output, "printf(\"");
-
-        // Build format string with type inference
-        for (int i = 0; i < stmt->print.num_exprs; i++)
+        ASTNode *sub = NULL;
+        for (int i = 0; i < check->program->program.num_decls; i++)
         {
-            const char *format = codegen_infer_printf_format(gen, stmt->print.expressions[i]);
-            fprintf(gen->output, "%s", format);
+            ASTNode *decl = check->program->program.declarations[i];
+            if (decl->type == AST_FUNC_DECL && str_equals_ignore_case(decl->subroutine.name, expr->call.name))
+                sub = decl;
         }
-        fprintf(gen->output, "\"");
-
-        // Arguments
-        for (int i = 0; i < stmt->print.num_exprs; i++)
+        if (!sub)
         {
-            fprintf(gen->output, ", ");
-
-            ASTNode *expr = stmt->print.expressions[i];
-
-            if (expr->type == AST_LITERAL && expr->literal.value.type == VAL_BOOL)
-            {
-                fprintf(gen->output, "(%s ? \"true\" : \"false\")",
-                        expr->literal.value.value.bool_val ? "1" : "0");
-            }
-            else
-            {
-                codegen_expression(gen, expr);
-            }
+            native_reject(check, "call of an unknown function", expr->line);
+            break;
         }
-        fprintf(gen->output, ");\n");
+        for (int i = 0; i < sub->subroutine.num_params; i++)
+        {
+            ASTNode *param = sub->subroutine.parameters[i];
+            if (param->param.is_reference && !is_array_type(param->param.param_type))
+                native_reject(check, "reference parameters in a function", expr->line);
+        }
+        native_check_arguments(check, sub, expr->call.arguments, expr->call.num_args, expr->line);
+        for (int i = 0; i < expr->call.num_args; i++)
+            native_check_expr(check, expr->call.arguments[i], false);
         break;
     }
 
-    case AST_READ:
+    default:
+        break;
+    }
+}
+
+static void native_check_block(NativeCheck *check, ASTNode **stmts, int count);
+
+static void native_check_stmt(NativeCheck *check, ASTNode *stmt)
+{
+    switch (stmt->type)
     {
+    case AST_ASSIGN:
+        native_check_name(check, stmt->assign.identifier, stmt->line);
+        for (int i = 0; i < stmt->assign.num_indices; i++)
+            native_check_expr(check, stmt->assign.indices[i], false);
+        native_check_expr(check, stmt->assign.value, false);
+        break;
+
+    case AST_PRINT:
+        for (int i = 0; i < stmt->print.num_exprs; i++)
+            native_check_expr(check, stmt->print.expressions[i], true);
+        break;
+
+    case AST_READ:
         for (int i = 0; i < stmt->read.num_vars; i++)
         {
             ASTNode *var = stmt->read.variables[i];
-            codegen_indent(gen);
-
-            if (var->type == AST_IDENTIFIER)
-            {
-                fprintf(gen->output, "scanf(\"%%d\", &%s);\n",
-                        sanitize_identifier(var->identifier.name));
-            }
-            else if (var->type == AST_ARRAY_ACCESS)
+            if (var->type != AST_IDENTIFIER && var->type != AST_ARRAY_ACCESS)
             {
-                fprintf(gen->output, "scanf(\"%%d\", &%s[",
-                        sanitize_identifier(var->array_access.name));
-                for (int j = 0; j < var->array_access.num_indices; j++)
-                {
-                    if (j > 0)
-                        fprintf(gen->output, "][");
-                    codegen_expression(gen, var->array_access.indices[j]);
-                    fprintf(gen->output, " - 1");
-                }
-                fprintf(gen->output, "]);\n");
+                native_reject(check, "READ into an expression", stmt->line);
+                break;
             }
+
+            const char *name = var->type == AST_IDENTIFIER ? var->identifier.name : var->array_access.name;
+            ASTNode *decl = native_find_declaration(check, name);
+            const char *type = !decl                          ? "int"
+                               : decl->type == AST_VAR_DECL   ? map_type(decl->decl.var_type)
+                               : decl->type == AST_PARAMETER  ? (is_array_type(decl->param.param_type)
+                                                                    ? codegen_param_element_type(decl->param.param_type)
+                                                                    : map_type(decl->param.param_type))
+                                                              : "int";
+            if (strcmp(type, "int") != 0)
+                native_reject(check, "READ into a non-integer variable", stmt->line);
+            native_check_expr(check, var, false);
         }
         break;
-    }
 
     case AST_IF:
-    {
-        codegen_indent(gen);
-        fprintf(gen->output, "if (");
-        codegen_expression(gen, stmt->if_stmt.condition);
-        fprintf(gen->output, ") {\n");
+        native_check_expr(check, stmt->if_stmt.condition, false);
+        native_check_block(check, stmt->if_stmt.then_branch, stmt->if_stmt.num_then);
+        native_check_block(check, stmt->if_stmt.else_branch, stmt->if_stmt.num_else);
+        break;
 
-        gen->indent_level++;
-        for (int i = 0; i < stmt->if_stmt.num_then; i++)
+    case AST_FOR:
+        native_check_name(check, stmt->for_loop.variable, stmt->line);
+        native_check_expr(check, stmt->for_loop.start, false);
+        native_check_expr(check, stmt->for_loop.end, false);
+        native_check_expr(check, stmt->for_loop.step, false);
+        native_check_block(check, stmt->for_loop.body, stmt->for_loop.num_stmts);
+        break;
+
+    case AST_WHILE:
+        native_check_expr(check, stmt->while_loop.condition, false);
+        native_check_block(check, stmt->while_loop.body, stmt->while_loop.num_stmts);
+        break;
+
+    case AST_CALL:
+    {
+        ASTNode *sub = NULL;
+        for (int i = 0; i < check->program->program.num_decls; i++)
         {
-            codegen_statement(gen, stmt->if_stmt.then_branch[i]);
+            ASTNode *decl = check->program->program.declarations[i];
+            if (decl->type == AST_PROC_DECL && str_equals_ignore_case(decl->subroutine.name, stmt->call.name))
+                sub = decl;
         }
-        gen->indent_level--;
-
-        if (stmt->if_stmt.else_branch && stmt->if_stmt.num_else > 0)
+        if (!sub)
         {
-            codegen_indent(gen);
-            fprintf(gen->output, "} else {\n");
-            gen->indent_level++;
-            for (int i = 0; i < stmt->if_stmt.num_else; i++)
-            {
-                codegen_statement(gen, stmt->if_stmt.else_branch[i]);
-            }
-            gen->indent_level--;
+            native_reject(check, "call of an unknown procedure", stmt->line);
+            break;
         }
-
-        codegen_indent(gen);
-        fprintf(gen->output, "}\n");
+        native_check_arguments(check, sub, stmt->call.arguments, stmt->call.num_args, stmt->line);
+        for (int i = 0; i < stmt->call.num_args; i++)
+            native_check_expr(check, stmt->call.arguments[i], false);
         break;
     }
 
-    case AST_FOR:
+    default:
+        native_reject(check, "unknown statement", stmt->line);
+    }
+}
+
+static void native_check_block(NativeCheck *check, ASTNode **stmts, int count)
+{
+    for (int i = 0; i < count && !check->reason; i++)
     {
-        codegen_indent(gen);
-        const char *var = sanitize_identifier(stmt->for_loop.variable);
+        native_check_stmt(check, stmts[i]);
+    }
+}
 
-        bool is_positive_step = true;
-        if (stmt->for_loop.step->type == AST_LITERAL &&
-            stmt->for_loop.step->literal.value.type == VAL_INT)
+// Returns a description of the first construct --native cannot compile
+// faithfully, or NULL if the whole program is supported
+static const char *native_unsupported_reason(ASTNode *prog, int *line)
+{
+    CodeGenerator gen;
+    codegen_init(&gen, NULL);
+    codegen_bind_program(&gen, prog);
+    NativeCheck check = {prog, &gen, NULL, NULL, 0};
+
+    for (int i = 0; i < prog->program.num_decls && !check.reason; i++)
+    {
+        ASTNode *decl = prog->program.declarations[i];
+
+        if (decl->type == AST_VAR_DECL)
         {
-            is_positive_step = stmt->for_loop.step->literal.value.value.int_val >= 0;
+            if (is_string_type(decl->decl.var_type))
+                native_reject(&check, "string variables", decl->line);
+            for (int j = 0; j < decl->decl.num_arr_dims; j++)
+            {
+                native_check_expr(&check, decl->decl.arr_bound_exprs[j].start_expr, false);
+                native_check_expr(&check, decl->decl.arr_bound_exprs[j].end_expr, false);
+            }
         }
+        else if (decl->type == AST_FUNC_DECL || decl->type == AST_PROC_DECL)
+        {
+            check.subroutine = decl;
+            for (int j = 0; j < decl->subroutine.num_params; j++)
+            {
+                ASTNode *param = decl->subroutine.parameters[j];
+                const char *type = param->param.param_type;
+                CodegenSymbol bounds;
+                if (is_array_type(type) && !codegen_param_bounds(&gen, type, &bounds))
+                    native_reject(&check, "array parameter with non-constant bounds", param->line);
+                if (is_string_type(type) || (is_array_type(type) && is_string_type(strstr(type, " OF "))))
+                    native_reject(&check, "string parameters", param->line);
+            }
+            for (int j = 0; j < decl->subroutine.num_local_decls; j++)
+            {
+                ASTNode *local = decl->subroutine.local_decls[j];
+                if (is_string_type(local->decl.var_type))
+                    native_reject(&check, "string variables", local->line);
+                if (native_find_global(prog, local->decl.name))
+                    native_reject(&check, "local variable shadowing a global", local->line);
+                for (int k = 0; k < local->decl.num_arr_dims; k++)
+                {
+                    native_check_expr(&check, local->decl.arr_bound_exprs[k].start_expr, false);
+                    native_check_expr(&check, local->decl.arr_bound_exprs[k].end_expr, false);
+                }
+            }
+            native_check_block(&check, decl->subroutine.body, decl->subroutine.num_stmts);
+            check.subroutine = NULL;
+        }
+    }
 
-        fprintf(gen->output, "for (%s = ", var);
-        codegen_expression(gen, stmt->for_loop.start);
-
-        fprintf(gen->output, "; %s %s ", var, is_positive_step ? "<=" : ">=");
-        codegen_expression(gen, stmt->for_loop.end);
+    native_check_block(&check, prog->program.body, prog->program.num_stmts);
+    codegen_release(&gen);
 
-        fprintf(gen->output, "; %s += ", var);
-        codegen_expression(gen, stmt->for_loop.step);
-        fprintf(gen->output, ") {\n");
+    *line = check.line;
+    return check.reason;
+}
 
-        gen->indent_level++;
-        for (int i = 0; i < stmt->for_loop.num_stmts; i++)
-        {
-            codegen_statement(gen, stmt->for_loop.body[i]);
+static void make_directories(const char *path)
+{
+    char buf[1024];
+    snprintf(buf, sizeof(buf), "%s", path);
+    for (char *p = buf + 1;; p++)
+    {
+        if (*p == '/' || *p == '\\' || *p == '\0')
+        {
+            char saved = *p;
+            *p = '\0';
+#ifdef _WIN32
+            _mkdir(buf);
+#else
+            mkdir(buf, 0755);
+#endif
+            *p = saved;
+            if (saved == '\0')
+                break;
         }
-        gen->indent_level--;
-
-        codegen_indent(gen);
-        fprintf(gen->output, "}\n");
-        break;
     }
+}
 
-    case AST_WHILE:
-    {
-        if (stmt->while_loop.is_repeat_until)
-        {
-            // REPEAT-UNTIL
-            codegen_indent(gen);
-            fprintf(gen->output, "do {\n");
+static const char *native_cache_dir(void)
+{
+    static char dir[1024];
+    const char *override = getenv("EAP_CACHE_DIR");
+    if (override && *override)
+    {
+        snprintf(dir, sizeof(dir), "%s", override);
+        return dir;
+    }
+#ifdef _WIN32
+    const char *base = getenv("LOCALAPPDATA");
+    snprintf(dir, sizeof(dir), "%s\\eap-cache", base ? base : ".");
+#else
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    if (xdg && *xdg)
+        snprintf(dir, sizeof(dir), "%s/eap", xdg);
+    else if (home && *home)
+        snprintf(dir, sizeof(dir), "%s/.cache/eap", home);
+    else
+        snprintf(dir, sizeof(dir), "/tmp/eap-cache");
+#endif
+    return dir;
+}
 
-            gen->indent_level++;
-            for (int i = 0; i < stmt->while_loop.num_stmts; i++)
-            {
-                codegen_statement(gen, stmt->while_loop.body[i]);
-            }
-            gen->indent_level--;
+static bool file_exists(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return false;
+    fclose(f);
+    return true;
+}
 
-            codegen_indent(gen);
-            fprintf(gen->output, "} while (!(");
-            codegen_expression(gen, stmt->while_loop.condition);
-            fprintf(gen->output, "));\n");
-        }
-        else
-        {
-            // WHILE
-            codegen_indent(gen);
-            fprintf(gen->output, "while (");
-            codegen_expression(gen, stmt->while_loop.condition);
-            fprintf(gen->output, ") {\n");
+// Transpiles the program into a malloc'd string
+static char *transpile_to_string(ASTNode *prog, size_t *len)
+{
+    FILE *tmp = tmpfile();
+    if (!tmp)
+        return NULL;
 
-            gen->indent_level++;
-            for (int i = 0; i < stmt->while_loop.num_stmts; i++)
-            {
-                codegen_statement(gen, stmt->while_loop.body[i]);
-            }
-            gen->indent_level--;
+    CodeGenerator gen;
+    codegen_init(&gen, tmp);
+    codegen_program(&gen, prog);
+    codegen_release(&gen);
+
+    long size = ftell(tmp);
+    rewind(tmp);
+    char *text = malloc(size + 1);
+    *len = fread(text, 1, size, tmp);
+    text[*len] = '\0';
+    fclose(tmp);
+    return text;
+}
 
-            codegen_indent(gen);
-            fprintf(gen->output, "}\n");
-        }
-        break;
+typedef struct
+{
+    char artifact[1200]; // Cached executable or shared object
+    char tmp_path[1300]; // Compiler output, renamed to artifact on success
+    char log_path[1300]; // Compiler diagnostics
+    char command[4096];  // Compiler command line
+} NativeBuild;
+
+// Prepares a cached build of C source. extra_flags selects the artifact kind
+// (empty for an executable, "-shared -fPIC" for a shared object). Returns 1 if
+// the artifact is already cached, 0 if build->command has to be run and -1 if
+// the cache cannot be written.
+static int native_prepare_build(NativeBuild *build, const char *c_source, size_t len,
+                                const char *extra_flags, const char *suffix)
+{
+    const char *compiler = getenv("CC");
+    const char *cflags = getenv("EAP_NATIVE_CFLAGS");
+#ifdef _WIN32
+    if (!compiler || !*compiler)
+        compiler = "gcc";
+#else
+    if (!compiler || !*compiler)
+        compiler = "cc";
+#endif
+    if (!cflags)
+        cflags = "-O2";
+
+    uint64_t key = fnv1a_hash(c_source, len, FNV1A_SEED);
+    key = fnv1a_hash(compiler, strlen(compiler) + 1, key);
+    key = fnv1a_hash(cflags, strlen(cflags) + 1, key);
+    key = fnv1a_hash(extra_flags, strlen(extra_flags) + 1, key);
+
+    const char *dir = native_cache_dir();
+    snprintf(build->artifact, sizeof(build->artifact), "%s/eap-%016llx%s", dir, (unsigned long long)key, suffix);
+    if (file_exists(build->artifact))
+    {
+        DEBUG_LOG("Native: cache hit %s", build->artifact);
+        return 1;
     }
-    case AST_CALL:
-    {
-        codegen_indent(gen);
-
-        ASTNode *subroutine = codegen_find_subroutine(gen, stmt->call.name);
-        fprintf(gen->output, "%s(", sanitize_identifier(stmt->call.name));
 
-        for (int i = 0; i < stmt->call.num_args; i++)
-        {
-            if (i > 0)
-                fprintf(gen->output, ", ");
+    make_directories(dir);
 
-            ASTNode *arg = stmt->call.arguments[i];
-            bool needs_ref = subroutine && codegen_is_param_by_ref(subroutine, i);
+    char c_path[1200];
+    snprintf(c_path, sizeof(c_path), "%s/eap-%016llx.c", dir, (unsigned long long)key);
+    snprintf(build->tmp_path, sizeof(build->tmp_path), "%s.%ld.tmp", build->artifact, (long)getpid());
+    snprintf(build->log_path, sizeof(build->log_path), "%s/eap-%016llx.log", dir, (unsigned long long)key);
 
-            if (needs_ref && (arg->type == AST_IDENTIFIER || arg->type == AST_ARRAY_ACCESS))
-            {
-                fprintf(gen->output, "&");
-            }
+    FILE *out = fopen(c_path, "wb");
+    if (!out)
+        return -1;
+    fwrite(c_source, 1, len, out);
+    fclose(out);
 
-            codegen_expression(gen, arg);
-        }
+    snprintf(build->command, sizeof(build->command), "%s %s %s -o \"%s\" \"%s\" -lm > \"%s\" 2>&1",
+             compiler, cflags, extra_flags, build->tmp_path, c_path, build->log_path);
+    DEBUG_LOG("Native: %s", build->command);
+    return 0;
+}
 
-        fprintf(gen->output, ");\n");
-        break;
+// Publishes a finished build into the cache. status is the exit status of
+// build->command.
+static bool native_finish_build(NativeBuild *build, int status)
+{
+    if (status != 0)
+    {
+        DEBUG_LOG("Native: compilation failed, see %s", build->log_path);
+        remove(build->tmp_path);
+        return false;
     }
-    default:
-        codegen_line(gen, "// Unknown statement type");
+
+    // Publish atomically so concurrent runs never see a partial file
+    remove(build->artifact);
+    if (rename(build->tmp_path, build->artifact) != 0)
+    {
+        remove(build->tmp_path);
+        return false;
     }
+    return true;
 }
 
-// ============================================================================
-// DECLARATION GENERATION
-// ============================================================================
-void codegen_declaration(CodeGenerator *gen, ASTNode *decl)
+// Compiles C source into the on-disk cache and returns the cached artifact
+// path, or NULL if compilation failed
+static const char *native_compile_cached(const char *c_source, size_t len, const char *extra_flags, const char *suffix)
 {
-    if (decl->type == AST_CONST_DECL)
+    static NativeBuild build;
+    int cached = native_prepare_build(&build, c_source, len, extra_flags, suffix);
+    if (cached < 0)
+        return NULL;
+    if (cached == 0 && !native_finish_build(&build, system(build.command)))
+        return NULL;
+    return build.artifact;
+}
+
+// Runs the program natively. Only returns if the program has to be run in the
+// interpreter instead.
+static void run_native(ASTNode *prog)
+{
+    int line = 0;
+    const char *reason = native_unsupported_reason(prog, &line);
+    if (reason)
     {
-        // Don't generate #define for constants since we inline them
+        DEBUG_LOG("Native: %s at line %d is not supported, interpreting", reason, line);
         return;
     }
 
-    if (decl->type == AST_VAR_DECL)
-    {
-        codegen_indent(gen);
-
-        if (decl->decl.num_arr_dims > 0)
-        {
-            // Array declaration
-            const char *elem_type = map_type(decl->decl.var_type);
-            fprintf(gen->output, "%s %s", elem_type, sanitize_identifier(decl->decl.name));
+    size_t len = 0;
+    char *c_source = transpile_to_string(prog, &len);
+    if (!c_source)
+        return;
 
-            // Dimensions
-            for (int i = 0; i < decl->decl.num_arr_dims; i++)
-            {
-                // Calculate size from bounds
-                RuntimeValue start = evaluate(decl->decl.arr_bound_exprs[i].start_expr, gen->env);
-                RuntimeValue end = evaluate(decl->decl.arr_bound_exprs[i].end_expr, gen->env);
-                int size = to_int(&end) - to_int(&start) + 1;
-                fprintf(gen->output, "[%d]", size);
-                free_runtime_value(&start);
-                free_runtime_value(&end);
-            }
+#ifdef _WIN32
+    const char *exe = native_compile_cached(c_source, len, "", ".exe");
+#else
+    const char *exe = native_compile_cached(c_source, len, "", "");
+#endif
+    free(c_source);
+    if (!exe)
+        return;
 
-            fprintf(gen->output, "; /* bounds: ");
-            for (int i = 0; i < decl->decl.num_arr_dims; i++)
-            {
-                if (i > 0)
-                    fprintf(gen->output, ", ");
-                fprintf(gen->output, "[");
-                codegen_expression(gen, decl->decl.arr_bound_exprs[i].start_expr);
-                fprintf(gen->output, "..");
-                codegen_expression(gen, decl->decl.arr_bound_exprs[i].end_expr);
-                fprintf(gen->output, "]");
-            }
-            fprintf(gen->output, " */\n");
-        }
-        else
-        {
-            // Simple variable - USE THE TYPE!
-            const char *c_type = map_type(decl->decl.var_type);
-            fprintf(gen->output, "%s %s;\n", c_type, sanitize_identifier(decl->decl.name));
-        }
-    }
+    fflush(stdout);
+    fflush(stderr);
+#ifdef _WIN32
+    char command[1300];
+    snprintf(command, sizeof(command), "\"%s\"", exe);
+    exit(system(command));
+#else
+    char *const args[] = {(char *)exe, NULL};
+    execv(exe, args);
+    DEBUG_LOG("Native: cannot execute %s (%s), interpreting", exe, strerror(errno));
+#endif
 }
 
 // ============================================================================
-// FUNCTION/PROCEDURE GENERATION
+// JUST-IN-TIME COMPILATION (--jit)
 // ============================================================================
+//
+// Counts calls and loop iterations per subroutine. When a subroutine becomes
+// hot it is transpiled on its own, compiled into a shared object by a
+// background compiler process and loaded with dlopen. Later calls run the
+// native code instead of interpreting the body. Only self-contained
+// subroutines qualify: scalar INTEGER/REAL/BOOLEAN parameters and locals, no
+// PRINT/READ, no access to variables outside the subroutine and no calls to
+// other subroutines. Arguments are passed through an array of slots, so every
+// compiled subroutine has the same entry point signature.
 
-void codegen_function(CodeGenerator *gen, ASTNode *func)
+typedef union
 {
-    fprintf(gen->output, "\n");
+    int i;
+    double r;
+    bool b;
+} JitSlot;
 
-    gen->current_subroutine = func;
+typedef void (*JitEntryFn)(JitSlot *args, JitSlot *ret);
 
-    // Return type
-    fprintf(gen->output, "%s %s(",
-            map_type(func->subroutine.return_type),
-            sanitize_identifier(func->subroutine.name));
+typedef enum
+{
+    JIT_COLD,      // Counting calls and loop iterations
+    JIT_COMPILING, // Compiler running in the background
+    JIT_READY,     // Native code loaded
+    JIT_FAILED     // Not eligible or not compilable, always interpreted
+} JitState;
 
-    codegen_register_var_type(gen, func->subroutine.name, map_type(func->subroutine.return_type));
+typedef struct
+{
+    ASTNode *subroutine;
+    JitState state;
+    long hits; // Calls plus loop iterations while interpreted
+    char param_types[MAX_JIT_PARAMS]; // 'i', 'r' or 'b' per parameter
+    char return_type;
+#ifndef _WIN32
+    pid_t compiler;
+    NativeBuild build;
+#endif
+    JitEntryFn entry;
+} JitEntry;
+
+static long jit_threshold = 1000;
+static JitEntry *jit_entries = NULL;
+static int jit_num_entries = 0;
+static int jit_active = -1; // Entry of the subroutine being interpreted
+static ASTNode *jit_program = NULL;
+
+// Static type of a declared type name: 'i', 'r', 'b' or 0 if unsupported
+static char jit_type_of(const char *type)
+{
+    const char *c_type = map_type(type);
+    if (!type || is_array_type(type))
+        return 0;
+    if (strcmp(c_type, "int") == 0)
+        return 'i';
+    if (strcmp(c_type, "double") == 0)
+        return 'r';
+    if (strcmp(c_type, "bool") == 0)
+        return 'b';
+    return 0;
+}
+
+static bool jit_check_block(ASTNode *sub, ASTNode **stmts, int count);
 
-    // Parameters
-    for (int i = 0; i < func->subroutine.num_params; i++)
+// Static type of a name inside the subroutine, 0 if it is not local
+static char jit_name_type(ASTNode *sub, const char *name)
+{
+    if (sub->type == AST_FUNC_DECL && str_equals_ignore_case(sub->subroutine.name, name))
+        return jit_type_of(sub->subroutine.return_type);
+    for (int i = 0; i < sub->subroutine.num_params; i++)
     {
-        if (i > 0)
-            fprintf(gen->output, ", ");
-        ASTNode *param = func->subroutine.parameters[i];
+        ASTNode *param = sub->subroutine.parameters[i];
+        if (str_equals_ignore_case(param->param.name, name))
+            return jit_type_of(param->param.param_type);
+    }
+    for (int i = 0; i < sub->subroutine.num_local_decls; i++)
+    {
+        ASTNode *local = sub->subroutine.local_decls[i];
+        if (str_equals_ignore_case(local->decl.name, name))
+            return local->decl.num_arr_dims > 0 ? 0 : jit_type_of(local->decl.var_type);
+    }
+    return 0;
+}
 
-        if (param->param.is_reference)
-        {
-            fprintf(gen->output, "%s *%s",
-                    map_type(param->param.param_type),
-                    sanitize_identifier(param->param.name));
-        }
-        else
+// Static type of an expression, 0 if the native code could behave differently
+// from the interpreter
+static char jit_expr_type(ASTNode *sub, ASTNode *expr)
+{
+    switch (expr->type)
+    {
+    case AST_LITERAL:
+        switch (expr->literal.value.type)
         {
-            fprintf(gen->output, "%s %s",
-                    map_type(param->param.param_type),
-                    sanitize_identifier(param->param.name));
+        case VAL_INT:
+            return 'i';
+        case VAL_REAL:
+            return 'r';
+        case VAL_BOOL:
+            return 'b';
+        default:
+            return 0;
         }
+
+    case AST_IDENTIFIER:
+    {
+        char type = jit_name_type(sub, expr->identifier.name);
+        ASTNode *constant = native_find_global(jit_program, expr->identifier.name);
+        if (!type && constant && constant->type == AST_CONST_DECL)
+            return jit_expr_type(sub, constant->decl.value);
+        return type;
     }
 
-    fprintf(gen->output, ") {\n");
-    gen->indent_level++;
+    case AST_UNARY_OP:
+    {
+        char operand = jit_expr_type(sub, expr->unary.operand);
+        if (strcmp(expr->unary.operator, "-") == 0)
+            return operand == 'b' ? 0 : operand;
+        if (str_equals_ignore_case(expr->unary.operator, "NOT") || str_equals_ignore_case(expr->unary.operator, "ΟΧΙ"))
+            return operand == 'b' ? 'b' : 0;
+        return 0;
+    }
 
-    // Return variable
-    codegen_indent(gen);
-    fprintf(gen->output, "%s %s_result = 0;\n",
-            map_type(func->subroutine.return_type),
-            sanitize_identifier(func->subroutine.name));
+    case AST_BINARY_OP:
+    {
+        const char *op = expr->binary.operator;
+        char left = jit_expr_type(sub, expr->binary.left);
+        char right = jit_expr_type(sub, expr->binary.right);
+        bool numeric = (left == 'i' || left == 'r') && (right == 'i' || right == 'r');
+
+        if (is_logical_operator(op))
+            return left == 'b' && right == 'b' ? 'b' : 0;
+        if (is_comparison_operator(op))
+            return numeric ? 'b' : 0;
+        if (strcmp(op, "DIV") == 0 || strcmp(op, "MOD") == 0)
+            return left == 'i' && right == 'i' ? 'i' : 0;
+        if (strcmp(op, "/") == 0)
+            return numeric ? 'r' : 0;
+        if (strcmp(op, "+") == 0 || strcmp(op, "-") == 0 || strcmp(op, "*") == 0)
+            return !numeric ? 0 : (left == 'r' || right == 'r') ? 'r' : 'i';
+        return 0;
+    }
 
-    // Local variables
-    if (func->subroutine.local_decls)
+    case AST_CALL:
     {
-        for (int i = 0; i < func->subroutine.num_local_decls; i++)
+        if (sub->type != AST_FUNC_DECL || !str_equals_ignore_case(expr->call.name, sub->subroutine.name) ||
+            expr->call.num_args != sub->subroutine.num_params)
+            return 0;
+        for (int i = 0; i < expr->call.num_args; i++)
         {
-            codegen_declaration(gen, func->subroutine.local_decls[i]);
+            ASTNode *param = sub->subroutine.parameters[i];
+            ASTNode *arg = expr->call.arguments[i];
+            if (jit_expr_type(sub, arg) != jit_type_of(param->param.param_type))
+                return 0;
+            if (param->param.is_reference && arg->type != AST_IDENTIFIER)
+                return 0;
         }
+        return jit_type_of(sub->subroutine.return_type);
     }
 
-    // Body
-    gen->in_function = true;
-    gen->current_function_name = func->subroutine.name;
-
-    for (int i = 0; i < func->subroutine.num_stmts; i++)
-    {
-        codegen_statement(gen, func->subroutine.body[i]);
+    default:
+        return 0;
     }
+}
 
-    gen->in_function = false;
-
-    // Return
-    codegen_indent(gen);
-    fprintf(gen->output, "return %s_result;\n",
-            sanitize_identifier(func->subroutine.name));
-
-    gen->indent_level--;
-    fprintf(gen->output, "}\n");
+// Assigning an INTEGER to a REAL keeps its value; anything else must match
+static bool jit_assignable(char target, char value)
+{
+    return target && (target == value || (target == 'r' && value == 'i'));
 }
 
-void codegen_procedure(CodeGenerator *gen, ASTNode *proc)
+static bool jit_check_stmt(ASTNode *sub, ASTNode *stmt)
 {
-    fprintf(gen->output, "\n");
+    switch (stmt->type)
+    {
+    case AST_ASSIGN:
+        return stmt->assign.num_indices == 0 &&
+               jit_assignable(jit_name_type(sub, stmt->assign.identifier), jit_expr_type(sub, stmt->assign.value));
 
-    gen->current_subroutine = proc;
+    case AST_IF:
+        return jit_expr_type(sub, stmt->if_stmt.condition) == 'b' &&
+               jit_check_block(sub, stmt->if_stmt.then_branch, stmt->if_stmt.num_then) &&
+               jit_check_block(sub, stmt->if_stmt.else_branch, stmt->if_stmt.num_else);
 
-    // Return type is void
-    fprintf(gen->output, "void %s(", sanitize_identifier(proc->subroutine.name));
-    codegen_register_var_type(gen, proc->subroutine.name, map_type(proc->subroutine.return_type));
+    case AST_FOR:
+        return jit_name_type(sub, stmt->for_loop.variable) == 'i' &&
+               jit_expr_type(sub, stmt->for_loop.start) == 'i' &&
+               jit_expr_type(sub, stmt->for_loop.end) == 'i' &&
+               (!stmt->for_loop.step || jit_expr_type(sub, stmt->for_loop.step) == 'i') &&
+               jit_check_block(sub, stmt->for_loop.body, stmt->for_loop.num_stmts);
 
-    // Parameters
-    for (int i = 0; i < proc->subroutine.num_params; i++)
-    {
-        if (i > 0)
-            fprintf(gen->output, ", ");
-        ASTNode *param = proc->subroutine.parameters[i];
+    case AST_WHILE:
+        return jit_expr_type(sub, stmt->while_loop.condition) == 'b' &&
+               jit_check_block(sub, stmt->while_loop.body, stmt->while_loop.num_stmts);
 
-        if (param->param.is_reference)
-        {
-            fprintf(gen->output, "%s *%s",
-                    map_type(param->param.param_type),
-                    sanitize_identifier(param->param.name));
-        }
-        else
+    case AST_CALL:
+    {
+        if (sub->type != AST_PROC_DECL || !str_equals_ignore_case(stmt->call.name, sub->subroutine.name) ||
+            stmt->call.num_args != sub->subroutine.num_params)
+            return false;
+        for (int i = 0; i < stmt->call.num_args; i++)
         {
-            fprintf(gen->output, "%s %s",
-                    map_type(param->param.param_type),
-                    sanitize_identifier(param->param.name));
+            ASTNode *param = sub->subroutine.parameters[i];
+            ASTNode *arg = stmt->call.arguments[i];
+            if (jit_expr_type(sub, arg) != jit_type_of(param->param.param_type))
+                return false;
+            if (param->param.is_reference && arg->type != AST_IDENTIFIER)
+                return false;
         }
+        return true;
     }
 
-    fprintf(gen->output, ") {\n");
-    gen->indent_level++;
+    default:
+        return false;
+    }
+}
 
-    // Local variables
-    if (proc->subroutine.local_decls)
+static bool jit_check_block(ASTNode *sub, ASTNode **stmts, int count)
+{
+    for (int i = 0; i < count; i++)
     {
-        for (int i = 0; i < proc->subroutine.num_local_decls; i++)
-        {
-            codegen_declaration(gen, proc->subroutine.local_decls[i]);
-        }
+        if (!jit_check_stmt(sub, stmts[i]))
+            return false;
     }
+    return true;
+}
 
-    // Body
-    for (int i = 0; i < proc->subroutine.num_stmts; i++)
+// Fills in the slot types of an entry, returns false if the subroutine
+// cannot be compiled on its own
+static bool jit_eligible(JitEntry *entry)
+{
+    ASTNode *sub = entry->subroutine;
+
+    if (sub->subroutine.num_params > MAX_JIT_PARAMS)
+        return false;
+    for (int i = 0; i < sub->subroutine.num_params; i++)
     {
-        codegen_statement(gen, proc->subroutine.body[i]);
+        entry->param_types[i] = jit_type_of(sub->subroutine.parameters[i]->param.param_type);
+        if (!entry->param_types[i])
+            return false;
     }
-    gen->current_subroutine = NULL;
-    gen->indent_level--;
-    fprintf(gen->output, "}\n");
+    for (int i = 0; i < sub->subroutine.num_local_decls; i++)
+    {
+        ASTNode *local = sub->subroutine.local_decls[i];
+        if (local->decl.num_arr_dims > 0 || !jit_type_of(local->decl.var_type) ||
+            native_find_global(jit_program, local->decl.name))
+            return false;
+    }
+    if (sub->type == AST_FUNC_DECL)
+    {
+        entry->return_type = jit_type_of(sub->subroutine.return_type);
+        if (!entry->return_type)
+            return false;
+    }
+    return jit_check_block(sub, sub->subroutine.body, sub->subroutine.num_stmts);
 }
 
-// ============================================================================
-// PROGRAM GENERATION
-// ============================================================================
-void codegen_program(CodeGenerator *gen, ASTNode *prog)
+static const char *jit_slot_field(char type)
 {
-    // Store program for lookups
-    gen->program = prog;
+    return type == 'r' ? "r" : type == 'b' ? "b" : "i";
+}
 
-    // Header
-    fprintf(gen->output, "/*\n");
-    fprintf(gen->output, " * Generated C code from EAP pseudocode\n");
-    fprintf(gen->output, " * Program: %s\n", prog->program.name);
-    fprintf(gen->output, " */\n\n");
+// Transpiles one subroutine plus the uniform entry point into a malloc'd string
+static char *jit_transpile(JitEntry *entry, size_t *len)
+{
+    ASTNode *sub = entry->subroutine;
+    FILE *tmp = tmpfile();
+    if (!tmp)
+        return NULL;
 
-    // Includes
-    fprintf(gen->output, "#include <stdio.h>\n");
-    fprintf(gen->output, "#include <stdlib.h>\n");
-    fprintf(gen->output, "#include <stdbool.h>\n");
-    fprintf(gen->output, "#include <math.h>\n");
-    fprintf(gen->output, "#include <string.h>\n\n");
+    CodeGenerator gen;
+    codegen_init(&gen, tmp);
+    codegen_prelude(&gen, jit_program);
+    if (sub->type == AST_FUNC_DECL)
+        codegen_function(&gen, sub);
+    else
+        codegen_procedure(&gen, sub);
+
+    fprintf(tmp, "\ntypedef union { int i; double r; bool b; } eap_jit_slot;\n\n");
+    fprintf(tmp, "__attribute__((visibility(\"default\"))) void eap_jit_entry(eap_jit_slot *args, eap_jit_slot *ret)\n{\n");
+    fprintf(tmp, "    %s", sub->type == AST_FUNC_DECL ? "ret->" : "(void)ret;\n    ");
+    if (sub->type == AST_FUNC_DECL)
+        fprintf(tmp, "%s = ", jit_slot_field(entry->return_type));
+    fprintf(tmp, "%s(", sanitize_identifier(sub->subroutine.name));
+    for (int i = 0; i < sub->subroutine.num_params; i++)
+    {
+        fprintf(tmp, "%s%sargs[%d].%s", i > 0 ? ", " : "",
+                sub->subroutine.parameters[i]->param.is_reference ? "&" : "", i,
+                jit_slot_field(entry->param_types[i]));
+    }
+    fprintf(tmp, ");\n}\n");
+    codegen_release(&gen);
+
+    long size = ftell(tmp);
+    rewind(tmp);
+    char *text = malloc(size + 1);
+    *len = fread(text, 1, size, tmp);
+    text[*len] = '\0';
+    fclose(tmp);
+    return text;
+}
 
-    // fprintf(gen->output, "#define EOLN '\\n'\n");
+#ifndef _WIN32
+static void jit_load(JitEntry *entry)
+{
+    void *handle = dlopen(entry->build.artifact, RTLD_NOW | RTLD_LOCAL);
+    void *symbol = handle ? dlsym(handle, "eap_jit_entry") : NULL;
+    if (!symbol)
+    {
+        DEBUG_LOG("JIT: cannot load %s", entry->build.artifact);
+        entry->state = JIT_FAILED;
+        return;
+    }
 
-    // Create environment for constant evaluation
-    Environment *const_env = create_environment(NULL);
-    gen->env = const_env;
+    // Object to function pointer conversion as sanctioned by POSIX
+    *(void **)&entry->entry = symbol;
+    entry->state = JIT_READY;
+    DEBUG_LOG("JIT: %s is now native", entry->subroutine->subroutine.name);
+}
+
+static void jit_start_compile(JitEntry *entry)
+{
+    entry->state = JIT_FAILED;
+    if (!jit_eligible(entry))
+    {
+        DEBUG_LOG("JIT: %s is not eligible", entry->subroutine->subroutine.name);
+        return;
+    }
+
+    size_t len = 0;
+    char *c_source = jit_transpile(entry, &len);
+    if (!c_source)
+        return;
+    int cached = native_prepare_build(&entry->build, c_source, len, "-shared -fPIC -fvisibility=hidden", ".so");
+    free(c_source);
+
+    if (cached == 1)
+    {
+        jit_load(entry);
+        return;
+    }
+    if (cached < 0)
+        return;
+
+    // The compiler publishes the result itself, so the cache is filled even
+    // if the program ends before the compilation does
+    char command[sizeof(entry->build.command) + 2700];
+    snprintf(command, sizeof(command), "%s && mv -f \"%s\" \"%s\"",
+             entry->build.command, entry->build.tmp_path, entry->build.artifact);
+
+    fflush(stdout);
+    fflush(stderr);
+    entry->compiler = fork();
+    if (entry->compiler == 0)
+    {
+        execl("/bin/sh", "sh", "-c", command, (char *)NULL);
+        _exit(127);
+    }
+    if (entry->compiler > 0)
+        entry->state = JIT_COMPILING;
+}
+
+static void jit_poll_compile(JitEntry *entry)
+{
+    int status;
+    pid_t done = waitpid(entry->compiler, &status, WNOHANG);
+    if (done == 0)
+        return;
 
-    // First pass: Constants (and evaluate them)
-    for (int i = 0; i < prog->program.num_decls; i++)
+    if (done == entry->compiler && WIFEXITED(status) && WEXITSTATUS(status) == 0)
     {
-        ASTNode *decl = prog->program.declarations[i];
-        if (decl->type == AST_CONST_DECL)
-        {
-            RuntimeValue val = evaluate(decl->decl.value, const_env);
-            env_define(const_env, decl->decl.name, val);
-            codegen_declaration(gen, decl);
-        }
+        jit_load(entry);
+    }
+    else
+    {
+        DEBUG_LOG("JIT: compilation failed, see %s", entry->build.log_path);
+        remove(entry->build.tmp_path);
+        entry->state = JIT_FAILED;
     }
+}
+#endif
 
-    fprintf(gen->output, "\n");
+static JitEntry *jit_find(ASTNode *sub)
+{
+    for (int i = 0; i < jit_num_entries; i++)
+    {
+        if (jit_entries[i].subroutine == sub)
+            return &jit_entries[i];
+    }
+    return NULL;
+}
 
-    // Forward declarations for functions/procedures
+static void jit_init(ASTNode *prog)
+{
+    jit_program = prog;
+    jit_entries = calloc(prog->program.num_decls, sizeof(JitEntry));
     for (int i = 0; i < prog->program.num_decls; i++)
     {
         ASTNode *decl = prog->program.declarations[i];
-        if (decl->type == AST_FUNC_DECL)
+        if (decl->type == AST_FUNC_DECL || decl->type == AST_PROC_DECL)
+            jit_entries[jit_num_entries++].subroutine = decl;
+    }
+#ifdef _WIN32
+    DEBUG_LOG("JIT: not available on this platform");
+    for (int i = 0; i < jit_num_entries; i++)
+        jit_entries[i].state = JIT_FAILED;
+#endif
+}
+
+// Marks the start of an interpreted call, returns the caller's entry for
+// jit_leave
+static int jit_enter(ASTNode *sub)
+{
+    if (!jit_enabled)
+        return -1;
+    int caller = jit_active;
+    JitEntry *entry = jit_find(sub);
+    jit_active = entry ? (int)(entry - jit_entries) : -1;
+    return caller;
+}
+
+static void jit_leave(int caller)
+{
+    jit_active = caller;
+}
+
+static void jit_backedge(void)
+{
+    if (jit_active >= 0)
+        jit_entries[jit_active].hits++;
+}
+
+// Runs a call natively if the subroutine has been compiled. Returns false if
+// the call has to be interpreted. Arguments are evaluated in the caller's
+// environment and reference parameters are copied back the way the
+// interpreter does.
+static bool jit_try_call(ASTNode *sub, ASTNode **args, int num_args, Environment *env, RuntimeValue *result)
+{
+    JitEntry *entry = jit_find(sub);
+    if (!entry || entry->state == JIT_FAILED || num_args != sub->subroutine.num_params)
+        return false;
+
+#ifndef _WIN32
+    if (entry->state == JIT_COLD && ++entry->hits >= jit_threshold)
+        jit_start_compile(entry);
+    if (entry->state == JIT_COMPILING)
+        jit_poll_compile(entry);
+#endif
+    if (entry->state != JIT_READY)
+        return false;
+
+    JitSlot slots[MAX_JIT_PARAMS];
+    RuntimeValue values[MAX_JIT_PARAMS];
+    for (int i = 0; i < num_args; i++)
+    {
+        values[i] = evaluate(args[i], env);
+        char type = entry->param_types[i];
+
+        // The interpreter keeps the argument's own type, so only types that
+        // behave the same in C can be passed
+        if (values[i].type == VAL_INT && type != 'b')
         {
-            fprintf(gen->output, "%s %s(",
-                    map_type(decl->subroutine.return_type),
-                    sanitize_identifier(decl->subroutine.name));
-            for (int j = 0; j < decl->subroutine.num_params; j++)
-            {
-                if (j > 0)
-                    fprintf(gen->output, ", ");
-                ASTNode *param = decl->subroutine.parameters[j];
-                fprintf(gen->output, "%s%s",
-                        map_type(param->param.param_type),
-                        param->param.is_reference ? "*" : "");
-            }
-            fprintf(gen->output, ");\n");
+            if (type == 'i')
+                slots[i].i = values[i].value.int_val;
+            else
+                slots[i].r = values[i].value.int_val;
         }
-        else if (decl->type == AST_PROC_DECL)
+        else if (values[i].type == VAL_REAL && type == 'r')
+            slots[i].r = values[i].value.real_val;
+        else if (values[i].type == VAL_BOOL && type == 'b')
+            slots[i].b = values[i].value.bool_val;
+        else
         {
-            fprintf(gen->output, "void %s(", sanitize_identifier(decl->subroutine.name));
-            for (int j = 0; j < decl->subroutine.num_params; j++)
-            {
-                if (j > 0)
-                    fprintf(gen->output, ", ");
-                ASTNode *param = decl->subroutine.parameters[j];
-                fprintf(gen->output, "%s%s",
-                        map_type(param->param.param_type),
-                        param->param.is_reference ? "*" : "");
-            }
-            fprintf(gen->output, ");\n");
+            DEBUG_LOG("JIT: argument %d of %s has an unexpected type, interpreting", i + 1, sub->subroutine.name);
+            for (int j = 0; j <= i; j++)
+                free_runtime_value(&values[j]);
+            return false;
         }
     }
 
-    for (int i = 0; i < prog->program.num_decls; i++)
-    {
-        ASTNode *decl = prog->program.declarations[i];
-        if (decl->type == AST_VAR_DECL)
-        {
-            const char *c_type = map_type(decl->decl.var_type);
-            codegen_register_var_type(gen, decl->decl.name, c_type);
-        }
-    }
+    JitSlot ret;
+    entry->entry(slots, &ret);
 
-    // NOW generate the declarations
-    fprintf(gen->output, "\n");
-    for (int i = 0; i < prog->program.num_decls; i++)
+    for (int i = 0; i < num_args; i++)
     {
-        ASTNode *decl = prog->program.declarations[i];
-        if (decl->type == AST_VAR_DECL)
+        ASTNode *param = sub->subroutine.parameters[i];
+        if (!param->param.is_reference)
+            continue;
+
+        RuntimeValue out;
+        switch (entry->param_types[i])
         {
-            codegen_declaration(gen, decl);
+        case 'r':
+            out.type = VAL_REAL;
+            out.value.real_val = slots[i].r;
+            break;
+        case 'b':
+            out.type = VAL_BOOL;
+            out.value.bool_val = slots[i].b;
+            break;
+        default:
+            out.type = VAL_INT;
+            out.value.int_val = slots[i].i;
         }
-    }
-    
-    // Functions and procedures
-    for (int i = 0; i < prog->program.num_decls; i++)
-    {
-        ASTNode *decl = prog->program.declarations[i];
-        if (decl->type == AST_FUNC_DECL)
+
+        if (args[i]->type == AST_IDENTIFIER)
         {
-            codegen_function(gen, decl);
+            env_assign(env, args[i]->identifier.name, out);
         }
-        else if (decl->type == AST_PROC_DECL)
+        else if (args[i]->type == AST_ARRAY_ACCESS && sub->type == AST_PROC_DECL)
         {
-            codegen_procedure(gen, decl);
+            RuntimeValue *arr_val = env_get(env, args[i]->array_access.name);
+            if (arr_val && arr_val->type == VAL_ARRAY)
+            {
+                int indices[MAX_ARRAY_DIMS];
+                for (int j = 0; j < args[i]->array_access.num_indices; j++)
+                {
+                    RuntimeValue idx = evaluate(args[i]->array_access.indices[j], env);
+                    indices[j] = to_int(&idx);
+                    free_runtime_value(&idx);
+                }
+                array_set(arr_val->value.arr_val, indices, args[i]->array_access.num_indices, out);
+            }
         }
     }
 
-    // Main function
-    fprintf(gen->output, "\nint main() {\n");
-    gen->indent_level = 1;
+    for (int i = 0; i < num_args; i++)
+        free_runtime_value(&values[i]);
 
-    for (int i = 0; i < prog->program.num_stmts; i++)
+    if (sub->type == AST_FUNC_DECL)
     {
-        codegen_statement(gen, prog->program.body[i]);
+        switch (entry->return_type)
+        {
+        case 'r':
+            result->type = VAL_REAL;
+            result->value.real_val = ret.r;
+            break;
+        case 'b':
+            result->type = VAL_BOOL;
+            result->value.bool_val = ret.b;
+            break;
+        default:
+            result->type = VAL_INT;
+            result->value.int_val = ret.i;
+        }
     }
-
-    codegen_line(gen, "return 0;");
-    fprintf(gen->output, "}\n");
+    return true;
 }
 
 // Make these functions available to codegen.c
 bool str_equals_ignore_case(const char *a, const char *b); // Already exists
 
+// program.eap -> program<extension>, for default output files
+static char *with_extension(const char *filename, const char *extension)
+{
+    char *path = malloc(strlen(filename) + strlen(extension) + 1);
+    strcpy(path, filename);
+    char *dot = strrchr(path, '.');
+    if (dot && !strpbrk(dot, "/\\"))
+        *dot = '\0';
+    strcat(path, extension);
+    return path;
+}
+
+// bench/microbench.c includes this file with EAP_NO_MAIN to reach the internals
+#ifndef EAP_NO_MAIN
 int main(int argc, char **argv)
 {
     if (argc < 2)
     {
         printf("EAP Pseudocode Interpreter\n");
-        printf("Usage: %s <file.eap> [--debug|--transpile]\n", argv[0]);
+        printf("Usage: %s <file.eap|file.eapc> [--debug|--debug-trace=file|--no-typecheck|--engine=closure|--transpile|--native|--jit|--profile[=file]|--perf-counters|--stats[=json]|--mem-report[=file]|--cost-report[=file]|--coverage[=file]|--complexity=template [--complexity-sizes=n,n,...]|--bench n [--warmup k]|--max-steps=n|--max-memory=n[KMG]|--max-time=s|--sample[=file]|--trace-out=file|--compile-only [-o file.eapc]]\n", argv[0]);
         printf("\nExample:\n");
         printf("  %s program.eap\n", argv[0]);
         printf("  %s program.eap --debug --transpile\n", argv[0]);
+        printf("  %s program.eap --compile-only -o program.eapc\n", argv[0]);
+        printf("  %s --decode-trace debug.trace\n", argv[0]);
         return 1;
     }
 
+    if (strcmp(argv[1], "--decode-trace") == 0)
+    {
+        if (argc != 3)
+        {
+            fprintf(stderr, "Usage: %s --decode-trace file\n", argv[0]);
+            return 1;
+        }
+        return debug_trace_decode(argv[2]);
+    }
+
     const char *filename = argv[1];
+    const char *output_path = NULL;
     bool transpile_mode = false;
+    bool compile_only = false;
+    bool native_mode = false;
+    const char *output_profile = NULL;
+    const char *output_samples = NULL;
+    const char *output_trace = NULL;
+    bool stats_enabled = false;
+    bool coverage_enabled = false;
+    bool limits_enabled = false;
+    const char *output_cost = NULL;
+    const char *output_coverage = NULL;
+    const char *complexity_template = NULL;
+    const char *complexity_sizes = NULL;
+    int bench_runs = 0;
+    int bench_warmup = 0;
+    const char *debug_trace_path = NULL;
+    bool typecheck_enabled = true;
 
     debug_mode = (argc > 2 && strcmp(argv[2], "--debug") == 0);
 
+    // Heap accounting has to be decided before anything is allocated
+    for (int i = 2; i < argc; i++)
+    {
+        if (strncmp(argv[i], "--stats", 7) == 0 || strncmp(argv[i], "--mem-report", 12) == 0 ||
+            strncmp(argv[i], "--max-memory=", 13) == 0)
+            alloc_accounting = true;
+    }
+
     // Check for flags
     for (int i = 2; i < argc; i++)
     {
@@ -4719,33 +12050,230 @@ int main(int argc, char **argv)
         {
             debug_mode = true;
         }
+        else if (strncmp(argv[i], "--debug-trace=", 14) == 0)
+        {
+            debug_mode = true;
+            debug_trace_path = argv[i] + 14;
+        }
         else if (strcmp(argv[i], "--transpile") == 0)
         {
             transpile_mode = true;
         }
+        else if (strcmp(argv[i], "--no-typecheck") == 0)
+        {
+            typecheck_enabled = false;
+        }
+        else if (strcmp(argv[i], "--engine=closure") == 0)
+        {
+            closure_engine = true;
+        }
+        else if (strcmp(argv[i], "--engine=tree") == 0)
+        {
+            closure_engine = false;
+        }
+        else if (strncmp(argv[i], "--engine=", 9) == 0)
+        {
+            fprintf(stderr, "Error: Unknown engine '%s' (use tree or closure)\n", argv[i] + 9);
+            return 1;
+        }
+        else if (strcmp(argv[i], "--native") == 0)
+        {
+            native_mode = true;
+        }
+        else if (strcmp(argv[i], "--jit") == 0)
+        {
+            jit_enabled = true;
+        }
+        else if (strncmp(argv[i], "--jit-threshold=", 16) == 0)
+        {
+            jit_enabled = true;
+            jit_threshold = atol(argv[i] + 16);
+        }
+        else if (strcmp(argv[i], "--profile") == 0)
+        {
+            profile_enabled = true;
+        }
+        else if (strncmp(argv[i], "--profile=", 10) == 0)
+        {
+            profile_enabled = true;
+            output_profile = argv[i] + 10;
+        }
+        else if (strcmp(argv[i], "--stats") == 0 || strcmp(argv[i], "--stats=json") == 0)
+        {
+            stats_enabled = true;
+            stats_json = argv[i][7] == '=';
+        }
+        else if (strcmp(argv[i], "--perf-counters") == 0)
+        {
+            profile_enabled = true;
+            perf_enabled = true;
+        }
+        else if (strcmp(argv[i], "--sample") == 0)
+        {
+            sample_enabled = true;
+        }
+        else if (strncmp(argv[i], "--sample=", 9) == 0)
+        {
+            sample_enabled = true;
+            output_samples = argv[i] + 9;
+        }
+        else if (strncmp(argv[i], "--sample-rate=", 14) == 0)
+        {
+            sample_enabled = true;
+            sample_rate = atol(argv[i] + 14);
+        }
+        else if (strncmp(argv[i], "--trace-out=", 12) == 0)
+        {
+            trace_enabled = true;
+            output_trace = argv[i] + 12;
+        }
+        else if (strcmp(argv[i], "--cost-report") == 0)
+        {
+            cost_enabled = true;
+        }
+        else if (strncmp(argv[i], "--cost-report=", 14) == 0)
+        {
+            cost_enabled = true;
+            output_cost = argv[i] + 14;
+        }
+        else if (strcmp(argv[i], "--coverage") == 0)
+        {
+            coverage_enabled = true;
+        }
+        else if (strncmp(argv[i], "--coverage=", 11) == 0)
+        {
+            coverage_enabled = true;
+            output_coverage = argv[i] + 11;
+        }
+        else if (strcmp(argv[i], "--mem-report") == 0 || strncmp(argv[i], "--mem-report=", 13) == 0)
+        {
+            // Enabled here so that the source and the AST are charged too
+            mem_report_enabled = true;
+            if (argv[i][12] == '=')
+                mem_report_path = argv[i] + 13;
+        }
+        else if (strncmp(argv[i], "--complexity=", 13) == 0)
+        {
+            complexity_template = argv[i] + 13;
+        }
+        else if (strncmp(argv[i], "--complexity-sizes=", 19) == 0)
+        {
+            complexity_sizes = argv[i] + 19;
+        }
+        else if (strcmp(argv[i], "--bench") == 0)
+        {
+            bench_runs = bench_parse_count(i + 1 < argc ? argv[++i] : NULL, 1);
+            if (bench_runs < 0)
+            {
+                fprintf(stderr, "Error: --bench needs a number of runs of 1 or more\n");
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--warmup") == 0)
+        {
+            bench_warmup = bench_parse_count(i + 1 < argc ? argv[++i] : NULL, 0);
+            if (bench_warmup < 0)
+            {
+                fprintf(stderr, "Error: --warmup needs a number of runs of 0 or more\n");
+                return 1;
+            }
+        }
+        else if (strncmp(argv[i], "--max-steps=", 12) == 0)
+        {
+            limits_enabled = true;
+            limit_steps = strtoull(argv[i] + 12, NULL, 10);
+        }
+        else if (strncmp(argv[i], "--max-memory=", 13) == 0)
+        {
+            limits_enabled = true;
+            limit_memory = parse_size(argv[i] + 13);
+        }
+        else if (strncmp(argv[i], "--max-time=", 11) == 0)
+        {
+            limits_enabled = true;
+            limit_seconds = atof(argv[i] + 11);
+        }
+        else if (strcmp(argv[i], "--compile-only") == 0)
+        {
+            compile_only = true;
+        }
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+        {
+            output_path = argv[++i];
+        }
+    }
+
+#ifdef EAP_NO_TRACE
+    if (debug_mode || debug_trace_path)
+    {
+        fprintf(stderr, "Warning: Built with EAP_NO_TRACE, --debug has no effect\n");
     }
+#else
+    if (debug_trace_path)
+    {
+        debug_trace_init(debug_trace_path);
+    }
+#endif
 
-    char *code = read_file(filename);
+    char *code = NULL;
+    const char *source_path = filename;
+    ASTNode *program;
 
-    if (debug_mode)
+    if (is_precompiled_file(filename))
+    {
+        // Already tokenized, parsed and checked: skip straight to execution
+        mem_owner = MEM_AST;
+        program = load_precompiled(filename, &source_path);
+        if (!source_path)
+            source_path = filename;
+    }
+    else
     {
-        fprintf(stderr, "[DEBUG] File size: %zu characters\n", strlen(code));
+        mem_owner = MEM_SOURCE;
+        code = read_file(filename);
+        mem_owner = MEM_AST;
+
+        DEBUG_LOG("File size: %zu characters", strlen(code));
+
+        // Tokenize
+        tokenize(code);
+        DEBUG_LOG("Generated %d tokens", token_count);
+
+        // Parse
+        program = parse_program();
     }
+    mem_owner = MEM_INTERPRETER;
 
-    // Tokenize
-    tokenize(code);
-    if (debug_mode)
+    // Precompiled programs were checked when compiled; this annotates them again
+    if (typecheck_enabled && typecheck_program(program) > 0)
     {
-        fprintf(stderr, "[DEBUG] Generated %d tokens\n", token_count);
+        free(code);
+        return 1;
     }
 
-    // Parse
-    ASTNode *program = parse_program();
-    if (debug_mode)
+    DEBUG_LOG("Parsed program: %s", program->program.name);
+    DEBUG_LOG("Declarations: %d", program->program.num_decls);
+    DEBUG_LOG("Statements: %d", program->program.num_stmts);
+
+    if (compile_only)
     {
-        fprintf(stderr, "[DEBUG] Parsed program: %s\n", program->program.name);
-        fprintf(stderr, "[DEBUG] Declarations: %d\n", program->program.num_decls);
-        fprintf(stderr, "[DEBUG] Statements: %d\n", program->program.num_stmts);
+        char *default_path = NULL;
+        if (!output_path)
+        {
+            // program.eap -> program.eapc
+            default_path = malloc(strlen(filename) + 6);
+            strcpy(default_path, filename);
+            size_t len = strlen(default_path);
+            if (len >= 4 && str_equals_ignore_case(default_path + len - 4, ".eap"))
+                strcat(default_path, "c");
+            else
+                strcat(default_path, ".eapc");
+            output_path = default_path;
+        }
+        save_precompiled(program, source_path, output_path);
+        free(default_path);
+        free(code);
+        return 0;
     }
 
     if (transpile_mode)
@@ -4757,9 +12285,113 @@ int main(int argc, char **argv)
         return 0;
     }
 
+    if (complexity_template)
+    {
+        int status = complexity_run(program, complexity_template, complexity_sizes, limits_enabled);
+        free(code);
+        return status;
+    }
+
+    // The profilers measure the interpreter, so everything runs there
+    if (profile_enabled || sample_enabled || trace_enabled || stats_enabled || cost_enabled || mem_report_enabled ||
+        coverage_enabled)
+    {
+        native_mode = false;
+        jit_enabled = false;
+        closure_engine = false;
+    }
+
+    // The JIT counts calls and back-edges in the tree walker
+    if (jit_enabled)
+    {
+        closure_engine = false;
+    }
+
+    // Native code has no back-edge checks, so limited runs are interpreted
+    if (limits_enabled)
+    {
+        native_mode = false;
+        jit_enabled = false;
+    }
+
+    if (stats_enabled)
+    {
+        atexit(stats_report);
+    }
+
+    if (cost_enabled)
+    {
+        cost_init(output_cost);
+    }
+
+    if (mem_report_enabled)
+    {
+        atexit(mem_report);
+    }
+
+    if (coverage_enabled)
+    {
+        coverage_init(program, source_path, output_coverage ? output_coverage : with_extension(filename, ".info"));
+    }
+
+    if (profile_enabled)
+    {
+        char *profile_text = NULL;
+
+        // Precompiled programs are listed from their source if it is still there
+        if (!code)
+        {
+            FILE *source = fopen(source_path, "rb");
+            if (source)
+            {
+                fclose(source);
+                profile_text = read_file(source_path);
+            }
+        }
+        profile_init(program, code ? code : profile_text,
+                     output_profile ? output_profile : with_extension(filename, ".prof"));
+        free(profile_text);
+        atexit(profile_report);
+    }
+
+    if (sample_enabled)
+    {
+        sample_init(program, output_samples ? output_samples : with_extension(filename, ".folded"));
+    }
+
+    if (trace_enabled)
+    {
+        trace_init(output_trace);
+    }
+
+    // Repeated runs measure the interpreter (or the JIT), not the C compiler
+    if (bench_runs > 0)
+    {
+        native_mode = false;
+    }
+
+    if (native_mode)
+    {
+        run_native(program);
+    }
+
+    if (jit_enabled)
+    {
+        jit_init(program);
+    }
+
+    if (limits_enabled)
+    {
+        limit_init();
+    }
+
     // Execute
-    execute_program(program);
+    if (bench_runs > 0)
+        bench_program(program, bench_runs, bench_warmup < 0 ? 0 : bench_warmup);
+    else
+        execute_program(program);
 
     free(code);
     return 0;
 }
+#endif // EAP_NO_MAIN